@@ -0,0 +1,254 @@
+/*
+ * actuation_sim.c
+ *
+ * run the output batching (src/xbee_actuation.c) against simulated remote
+ * nodes - changes for random nodes turn up in scheduling windows the way the
+ * mail does in the action thread, and every frame that gets sent is checked,
+ * decoded and acted on by the node it is addressed to. a node holds on to
+ * queued changes (no apply changes option) until a command that applies them,
+ * and answers any command with a frame id
+ *
+ * after every batch each node's pins have to match the latest state asked for
+ * each output, with nothing left queued and never applied
+ *
+ * built twice - actuation_sim batches the changes, actuation_sim_unbatched
+ * sends every change with apply set (XBEE_ACTUATION_BATCHING = 0)
+ *
+ * usage: make && ./actuation_sim && ./actuation_sim_unbatched
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <string.h>
+
+// include the actuation batching
+#include "xbee_actuation.h"
+
+// the simulated network, and how many windows to run
+#define SIM_NODES				12				// more than XBEE_ACTUATION_NODES, so batches fill up
+#define WINDOWS					2000
+#define MAX_CHANGES			16				// the most mail in one window
+#define SAMPLE_CHANCE		10				// percent of mail that asks for a sample
+
+// a simulated remote node
+typedef struct
+{
+	uint64_t	serial;
+	uint16_t	my_address;
+	uint8_t		pin[NUM_OUTPUTS];					// what the pins are set to
+	uint8_t		queued[NUM_OUTPUTS];			// changes waiting for an apply
+	uint8_t		wanted[NUM_OUTPUTS];			// what we last asked for
+}
+sim_node_t;
+
+static sim_node_t nodes[SIM_NODES];
+static int errors = 0;
+
+// what came back over the air
+static uint32_t responses, samples;
+
+// the at command for each output (the same as src/xbee_actuation.c)
+static const char * const output_pins[NUM_OUTPUTS] = {"D5", "P1", "D7"};
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// REMOTE NODES
+
+// a remote at command arriving at the network - check it, find the node it's
+// for and act on it
+static void send_frame(uint8_t * frame, int length)
+{
+	uint8_t sum = 0;
+	uint64_t serial = 0;
+	int i;
+
+	for(i = 3; i < length; i++)
+	{
+		sum += frame[i];
+	}
+	if(length < 19 || frame[0] != 0x7E || ((frame[1] << 8) | frame[2]) != length - 4 ||
+		sum != 0xFF || frame[3] != XBEE_REMOTE_AT_COMMAND)
+	{
+		printf("bad frame sent (%d bytes)\n", length);
+		errors++;
+		return;
+	}
+
+	uint8_t frame_id = frame[4];
+	for(i = 5; i < 13; i++)
+	{
+		serial = (serial << 8) | frame[i];
+	}
+	uint16_t my_address = (frame[13] << 8) | frame[14];
+	uint8_t options = frame[15];
+	const uint8_t * command = &frame[16];
+
+	sim_node_t * node = NULL;
+	for(i = 0; i < SIM_NODES; i++)
+	{
+		if(nodes[i].serial == serial)
+		{
+			node = &nodes[i];
+			break;
+		}
+	}
+	if(node == NULL || node->my_address != my_address)
+	{
+		printf("frame for a node that isn't there (%016llX %04X)\n",
+			(unsigned long long)serial, my_address);
+		errors++;
+		return;
+	}
+
+	// an output change is queued up ...
+	for(i = 0; i < NUM_OUTPUTS; i++)
+	{
+		if(command[0] == output_pins[i][0] && command[1] == output_pins[i][1])
+		{
+			if(length != 20 || (frame[18] != XBEE_DIGITAL_LOW && frame[18] != XBEE_DIGITAL_HIGH))
+			{
+				printf("bad output change for %c%c\n", command[0], command[1]);
+				errors++;
+				return;
+			}
+			node->queued[i] = (frame[18] == XBEE_DIGITAL_HIGH) ? OUTPUT_ON : OUTPUT_OFF;
+			break;
+		}
+	}
+	if(i == NUM_OUTPUTS)
+	{
+		if(command[0] == 'I' && command[1] == 'S')
+		{
+			samples++;
+		}
+		else
+		{
+			printf("unexpected command %c%c\n", command[0], command[1]);
+			errors++;
+		}
+	}
+
+	// ... until something applies the lot
+	if(options & XBEE_APPLY_CHANGES)
+	{
+		for(i = 0; i < NUM_OUTPUTS; i++)
+		{
+			if(node->queued[i] != OUTPUT_NO_CHANGE)
+			{
+				node->pin[i] = node->queued[i];
+				node->queued[i] = OUTPUT_NO_CHANGE;
+			}
+		}
+	}
+
+	// and a frame id means the node answers
+	if(frame_id != 0)
+	{
+		responses++;
+	}
+}
+
+// every node has what we last asked for, with nothing left hanging
+static void check_nodes(int window)
+{
+	int i, j;
+
+	for(i = 0; i < SIM_NODES; i++)
+	{
+		for(j = 0; j < NUM_OUTPUTS; j++)
+		{
+			if(nodes[i].queued[j] != OUTPUT_NO_CHANGE)
+			{
+				printf("window %d: node %d has a %s change that was never applied\n", window, i,
+					output_pins[j]);
+				errors++;
+			}
+			if(nodes[i].pin[j] != nodes[i].wanted[j])
+			{
+				printf("window %d: node %d %s is %d (expected %d)\n", window, i, output_pins[j],
+					nodes[i].pin[j], nodes[i].wanted[j]);
+				errors++;
+			}
+		}
+	}
+}
+
+int main(void)
+{
+	static xbee_actuation_batch_t batch;
+	uint32_t mail = 0, changes = 0;
+	int window, i, j;
+
+	for(i = 0; i < SIM_NODES; i++)
+	{
+		nodes[i].serial = 0x0013A20041000000ULL + next_random() % 0x1000000;
+		nodes[i].my_address = next_random() % 0xFFF0 + 1;
+		for(j = 0; j < NUM_OUTPUTS; j++)
+		{
+			nodes[i].pin[j] = OUTPUT_OFF;
+			nodes[i].queued[j] = OUTPUT_NO_CHANGE;
+			nodes[i].wanted[j] = OUTPUT_OFF;
+		}
+	}
+
+	xbee_actuation_init(&batch);
+	for(window = 0; window < WINDOWS; window++)
+	{
+		int count = 1 + next_random() % MAX_CHANGES;
+
+		// the mail that turns up in this window (mostly for a few busy nodes)
+		for(i = 0; i < count; i++)
+		{
+			sim_node_t * node = &nodes[(next_random() % 2 == 0) ? next_random() % SIM_NODES :
+				next_random() % 3];
+			xbee_address_t address;
+			uint8_t state[NUM_OUTPUTS];
+			uint8_t sample = (next_random() % 100 < SAMPLE_CHANCE);
+
+			for(j = 0; j < NUM_OUTPUTS; j++)
+			{
+				state[j] = next_random() % 3;
+				if(state[j] != OUTPUT_NO_CHANGE)
+				{
+					node->wanted[j] = state[j];
+					changes++;
+				}
+			}
+			mail++;
+
+			// the same as the action thread - if there's no room, send what's
+			// waiting and start again
+			xbee_address_init(&address, node->serial, node->my_address);
+			if(!xbee_actuation_add(&batch, &address, node->my_address, state, sample))
+			{
+				xbee_actuation_flush(&batch, send_frame);
+				xbee_actuation_add(&batch, &address, node->my_address, state, sample);
+			}
+		}
+
+		xbee_actuation_flush(&batch, send_frame);
+		check_nodes(window);
+	}
+
+	xbee_actuation_stats_t * stats = &batch.stats;
+	printf("batching %s: %d windows, %u mails (%u output changes) for %d nodes\n",
+		XBEE_ACTUATION_BATCHING ? "on" : "off", WINDOWS, mail, changes, SIM_NODES);
+	printf("added %u (%u merged, %u changes superseded, %u sent early)\n", stats->requests,
+		stats->merged, stats->superseded, stats->full);
+	printf("sent %u frames in %u batches (%u applying changes), %u bytes\n", stats->frames,
+		stats->batches, stats->applies, stats->bytes);
+	printf("responses: %u (%u to samples)\n", responses, samples);
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * baud_sim.c
+ *
+ * the link rate negotiation (src/xbee_baud.c) against a simulated xbee - the
+ * radio only understands at commands sent at the rate its uart is running at,
+ * answers BD at the old rate and then switches (a few ms later), says no to
+ * rates it doesn't do, and keeps whatever rate it was left at (nothing is
+ * written to its flash). our end of the link can get stuck the way
+ * xbee_set_baud can (the last frame never finishes going out, so it gives up
+ * after XBEE_SET_BAUD_TIMEOUT and leaves the rate alone)
+ *
+ * each run checks where both ends end up, what was counted on the way, and
+ * how long it took (on a simulated clock)
+ *
+ * usage: make && ./baud_sim
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <string.h>
+
+// include the link rate negotiation
+#include "xbee_baud.h"
+
+// how long xbee_set_baud waits for the uart before giving up (in ms - as
+// XBEE_SET_BAUD_TIMEOUT in xbee.h) and how long the radio takes to switch
+// rates after it has answered
+#define SET_BAUD_TIMEOUT		2000
+#define RADIO_SWITCH				5
+
+// the rates we try to move to (fastest first - as main.c)
+static const uint32_t targets[] = {230400, 115200};
+
+// the simulated radio
+typedef struct
+{
+	uint32_t	baud_rate;			// the rate its uart is running at
+	uint32_t	max_rate;				// the fastest rate it will take
+	int				ignores_bd;			// answers BD but doesn't switch
+}
+sim_radio_t;
+
+static sim_radio_t radio;
+
+// our end of the link (and how many rate changes go through before it gets
+// stuck, and for how many)
+static uint32_t our_rate;
+static int changes_before_stuck;
+static int stuck_for;
+static uint32_t stuck;
+
+// the simulated clock (in us) and the bytes across the link
+static uint32_t clock_us;
+static uint32_t link_bytes;
+
+static int errors = 0;
+
+// the rates the xbee can run at (the index is the BD setting)
+static const uint32_t bd_rates[] =
+{
+	1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400
+};
+
+// OUR END
+
+static int sim_set_baud(uint32_t baud_rate)
+{
+	if(changes_before_stuck > 0)
+	{
+		changes_before_stuck--;
+	}
+	else if(stuck_for > 0)
+	{
+		stuck_for--;
+		stuck++;
+		clock_us += SET_BAUD_TIMEOUT * 1000;
+		return -1;
+	}
+	our_rate = baud_rate;
+	return 0;
+}
+
+static void sim_delay(uint32_t ms)
+{
+	clock_us += ms * 1000;
+}
+
+static uint32_t sim_time(void)
+{
+	return clock_us;
+}
+
+static uint32_t sim_bytes(void)
+{
+	return link_bytes;
+}
+
+// THE RADIO
+
+// the time (in us) to send some bytes at a rate (ten bits a byte)
+static uint32_t send_time(int bytes, uint32_t baud_rate)
+{
+	return (uint32_t)((uint64_t)bytes * 10 * 1000000 / baud_rate);
+}
+
+// a local at command - the command frame is 8 bytes (plus the parameter) and
+// the answer to BD is 9 bytes (plus the value when it's a query)
+static int sim_at_command(const char * command, const uint8_t * param, int length,
+	uint32_t timeout)
+{
+	int request = 8 + length;
+	clock_us += send_time(request, our_rate);
+
+	// at the wrong rate the radio just sees garbage (and we wait for nothing)
+	if(our_rate != radio.baud_rate)
+	{
+		clock_us += timeout * 1000 - send_time(request, our_rate);
+		return -1;
+	}
+	link_bytes += request;
+
+	// the radio takes a ms to answer
+	clock_us += 1000;
+	int status = 0;
+	int answer = 9;
+	if(strcmp(command, "BD") != 0)
+	{
+		status = 2;
+	}
+	else if(length == 0)
+	{
+		answer += 4;
+	}
+	else if(param[0] >= sizeof(bd_rates) / sizeof(bd_rates[0]) ||
+		bd_rates[param[0]] > radio.max_rate)
+	{
+		status = 3;
+	}
+	clock_us += send_time(answer, radio.baud_rate);
+	link_bytes += answer;
+
+	// then it switches (if it's going to)
+	if(length == 1 && status == 0 && !radio.ignores_bd)
+	{
+		clock_us += RADIO_SWITCH * 1000;
+		radio.baud_rate = bd_rates[param[0]];
+	}
+	return status;
+}
+
+// RUNNING
+
+typedef struct
+{
+	const char *	name;
+	sim_radio_t		radio;					// how the radio starts off
+	int						stuck_after;		// rate changes before our end gets stuck
+	int						stuck_for;			// and how many get stuck then
+	int						status;					// what xbee_baud_negotiate should return
+	uint32_t			baud_rate;			// where both ends should end up
+	uint32_t			found_at;
+	uint32_t			scans, refused, failed;
+}
+sim_t;
+
+static void run(const sim_t * sim)
+{
+	static const xbee_baud_ops_t ops =
+	{
+		sim_set_baud, sim_at_command, sim_delay, sim_time, 1000, sim_bytes
+	};
+	xbee_baud_result_t result;
+
+	radio = sim->radio;
+	our_rate = 9600;
+	changes_before_stuck = sim->stuck_after;
+	stuck_for = sim->stuck_for;
+	stuck = 0;
+	clock_us = 0;
+	link_bytes = 0;
+
+	int status = xbee_baud_negotiate(&ops, 9600, targets, sizeof(targets) / sizeof(targets[0]),
+		&result);
+
+	printf("%-20s %3d %7u %7u %7u %6u %5u %7u %6u %5u %7u %6.2f\n", sim->name, status,
+		result.baud_rate, radio.baud_rate, result.found_at, result.probes, result.scans,
+		result.refused, result.failed, stuck, result.throughput, clock_us / 1e6);
+
+	if(status != sim->status || result.baud_rate != sim->baud_rate ||
+		result.found_at != sim->found_at || result.scans != sim->scans ||
+		result.refused != sim->refused || result.failed != sim->failed)
+	{
+		printf("  expected %d at %u (found at %u, %u scans, %u refused, %u failed)\n",
+			sim->status, sim->baud_rate, sim->found_at, sim->scans, sim->refused, sim->failed);
+		errors++;
+	}
+
+	// our end has to be where the result says it is, and if the radio was
+	// found it has to be there too
+	if(our_rate != result.baud_rate || (status == 0 && radio.baud_rate != our_rate))
+	{
+		printf("  our end at %u, the radio at %u\n", our_rate, radio.baud_rate);
+		errors++;
+	}
+
+	// the throughput can't be more than the line rate (both ways at once) and
+	// should be a fair bit of it
+	if(status == 0 && (result.throughput > result.baud_rate / 5 ||
+		result.throughput < result.baud_rate / 40))
+	{
+		printf("  %u bytes/s at %u baud\n", result.throughput, result.baud_rate);
+		errors++;
+	}
+}
+
+int main(void)
+{
+	static const sim_t sims[] =
+	{
+		// the radio (its rate, the fastest it will take, whether it ignores BD),
+		// when our end gets stuck and for how many changes, then what should
+		// come out (status, rate, found at, scans, refused, failed)
+		{"factory default",		{9600, 230400, 0},		0, 0,		 0, 230400,	9600,		0, 0, 0},
+		{"left at 115200",		{115200, 230400, 0},	0, 0,		 0, 230400,	115200,	1, 0, 0},
+		{"left at 230400",		{230400, 230400, 0},	0, 0,		 0, 230400,	230400,	1, 0, 0},
+		{"no 230400",					{9600, 115200, 0},		0, 0,		 0, 115200,	9600,		0, 1, 0},
+		{"ignores BD",				{9600, 230400, 1},		0, 0,		 0, 9600,		9600,		0, 0, 2},
+		{"stuck switching",		{9600, 230400, 0},		1, 1,		 0, 230400,	9600,		1, 0, 1},
+		{"stuck for good",		{9600, 230400, 0},		0, 100,	-1, 9600,		0,			1, 0, 0},
+		{"no radio",					{0, 230400, 0},				0, 0,		-1, 9600,		0,			1, 0, 0},
+	};
+	unsigned int i;
+
+	printf("%-20s %3s %7s %7s %7s %6s %5s %7s %6s %5s %7s %6s\n", "", "", "ours", "radio",
+		"found", "probes", "scans", "refused", "failed", "stuck", "bytes/s", "secs");
+	for(i = 0; i < sizeof(sims) / sizeof(sims[0]); i++)
+	{
+		run(&sims[i]);
+	}
+	printf("\nours, radio: the rate each end finished at, stuck: rate changes that timed "
+		"out\nwaiting for the uart, secs: how long it all took\n");
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,425 @@
+/*
+ * config_store_sim.c
+ *
+ * run the config store on a file backed flash simulator:
+ *
+ * - wear: lots of updates to a node table sized set of keys, to see how the
+ *   erases are spread over the blocks and how long opening the store takes
+ * - power loss: cut the power at random points in writes and erases, then
+ *   reopen the store and check every value is the last one that was written
+ *   (or the one that was being written when the power went)
+ * - full: fill a small store up and keep changing values in it
+ * - torn erase: cut the power part way through erasing a block, with the
+ *   block's header (and some of its records) still there, and check nothing
+ *   that was in it comes back
+ * - evict: fill the index up, then make room for new keys the way the config
+ *   thread does (throwing away the key written longest ago)
+ *
+ * usage: make && ./config_store_sim [flash file]
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// include the store and the flash simulator
+#include "config_store.h"
+#include "flash_sim.h"
+
+// the same shape as the qspi store on the board (16 4k subsectors)
+#define BLOCK_SIZE		4096
+#define BLOCKS				16
+
+// how many keys, and how big the values are (the size of a room's settings)
+#define SIM_KEYS			200
+#define VALUE_SIZE		16
+
+#define WEAR_UPDATES	200000
+#define POWER_CYCLES	5000
+#define ERASE_CUTS		500
+
+static config_store_t store;
+static config_flash_t flash;
+
+// the version of each key's value we expect to find (0 for none), and the
+// change that was being made when the power went
+static uint32_t expected[SIM_KEYS];
+static int pending_key = -1;
+static uint32_t pending_version;
+
+static int errors = 0;
+
+// the value for a version of a key (so we can tell a value that's been
+// mixed up with another one)
+static void make_value(uint32_t key, uint32_t version, uint16_t size, uint8_t * value)
+{
+	uint16_t i;
+	memcpy(value, &version, 4);
+	for(i = 4; i < size; i++)
+	{
+		value[i] = (uint8_t)(key * 31 + version * 7 + i);
+	}
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// check the store against what we expect (taking the change that was being
+// made as done if it made it)
+static void check_store(const char * when)
+{
+	uint8_t value[CONFIG_STORE_MAX_VALUE], wanted[CONFIG_STORE_MAX_VALUE];
+	uint32_t key, version;
+
+	for(key = 0; key < SIM_KEYS; key++)
+	{
+		int length = config_store_get(&store, key, value, sizeof(value));
+		version = 0;
+		if(length >= 4)
+		{
+			memcpy(&version, value, 4);
+			make_value(key, version, length, wanted);
+			if(length != VALUE_SIZE || memcmp(value, wanted, length) != 0)
+			{
+				printf("%s: key %u has a bad value\n", when, key);
+				errors++;
+				continue;
+			}
+		}
+		else if(length != CONFIG_STORE_NOT_FOUND)
+		{
+			printf("%s: key %u came back with %d\n", when, key, length);
+			errors++;
+			continue;
+		}
+
+		if(version != expected[key] && !((int)key == pending_key && version == pending_version))
+		{
+			printf("%s: key %u is version %u, expected %u\n", when, key, version, expected[key]);
+			errors++;
+		}
+		expected[key] = version;
+	}
+	pending_key = -1;
+}
+
+// make a random change (returns what the store said)
+static int random_change(void)
+{
+	uint8_t value[VALUE_SIZE];
+	uint32_t key = rand() % SIM_KEYS;
+	int result, pick = rand() % 100;
+
+	if(pick < 85)
+	{
+		pending_key = key;
+		pending_version = expected[key] + 1 + rand() % 1000;
+		make_value(key, pending_version, VALUE_SIZE, value);
+		result = config_store_put(&store, key, value, VALUE_SIZE);
+	}
+	else if(pick < 90)
+	{
+		pending_key = key;
+		pending_version = 0;
+		result = config_store_delete(&store, key);
+		if(result == CONFIG_STORE_NOT_FOUND)
+		{
+			result = (expected[key] == 0) ? CONFIG_STORE_OK : CONFIG_STORE_NOT_FOUND;
+		}
+	}
+	else
+	{
+		while((result = config_store_maintain(&store)) > 0)
+		{
+		}
+		return result;
+	}
+
+	if(result == CONFIG_STORE_OK)
+	{
+		expected[key] = pending_version;
+		pending_key = -1;
+	}
+	return result;
+}
+
+static void open_store(const char * when)
+{
+	if(config_store_open(&store, &flash) != CONFIG_STORE_OK)
+	{
+		printf("%s: couldn't open the store\n", when);
+		errors++;
+	}
+}
+
+// lots of changes, no power cuts
+static void wear_test(void)
+{
+	uint32_t i, least = ~0u, most = 0;
+	int j;
+
+	flash_sim_wipe();
+	memset(expected, 0, sizeof(expected));
+	open_store("wear");
+	for(i = 0; i < WEAR_UPDATES; i++)
+	{
+		int result = random_change();
+		if(result < 0)
+		{
+			printf("wear: change %u failed (%d)\n", i, result);
+			errors++;
+			break;
+		}
+	}
+
+	for(j = 0; j < BLOCKS; j++)
+	{
+		least = (flash_sim_stats.erases[j] < least) ? flash_sim_stats.erases[j] : least;
+		most = (flash_sim_stats.erases[j] > most) ? flash_sim_stats.erases[j] : most;
+	}
+
+	config_store_stats_t stats = store.stats;
+
+	// how long it takes to start up with a well used store
+	double start = now_us();
+	for(j = 0; j < 1000; j++)
+	{
+		config_store_open(&store, &flash);
+	}
+	double open_time = (now_us() - start) / 1000;
+	check_store("wear");
+
+	printf("wear: %u changes to %d keys, %u puts, %u copies, %llu bytes programmed "
+		"(%.2f per byte put)\n", WEAR_UPDATES, SIM_KEYS, stats.puts, stats.copied,
+		(unsigned long long)flash_sim_stats.written, (double)flash_sim_stats.written /
+		((double)stats.puts * (12 + VALUE_SIZE)));
+	printf("      erases per block %u to %u, open %.1f us (%u records scanned, %u keys)\n",
+		least, most, open_time, store.stats.scanned, store.count);
+}
+
+// power cuts at random points
+static void power_test(void)
+{
+	uint32_t cycle, changes = 0;
+	double open_total = 0;
+
+	flash_sim_wipe();
+	memset(expected, 0, sizeof(expected));
+	open_store("power");
+	for(cycle = 0; cycle < POWER_CYCLES && errors < 20; cycle++)
+	{
+		// anywhere from part way through the next write to a few hundred changes
+		// from now
+		flash_sim_cut_power(rand() % ((cycle % 10 == 0) ? 20000 : 200));
+		while(random_change() != CONFIG_STORE_FLASH_ERROR)
+		{
+			changes++;
+		}
+
+		flash_sim_power_on();
+		double start = now_us();
+		open_store("power");
+		open_total += now_us() - start;
+		check_store("power");
+	}
+	printf("power: %u power cuts in %u changes, open %.1f us on average - %s\n",
+		flash_sim_stats.power_cuts, changes, open_total / cycle,
+		errors ? "FAILED" : "every value survived");
+}
+
+// fill a small store and keep changing it
+static void full_test(const char * path)
+{
+	uint8_t value[CONFIG_STORE_MAX_VALUE];
+	uint32_t key, i, stored = 0;
+
+	flash_sim_close();
+	flash_sim_open(path, BLOCK_SIZE, 4, &flash);
+	flash_sim_wipe();
+	open_store("full");
+
+	for(key = 0; key < CONFIG_STORE_MAX_KEYS; key++)
+	{
+		make_value(key, 1, sizeof(value), value);
+		int result = config_store_put(&store, key, value, sizeof(value));
+		if(result == CONFIG_STORE_FULL)
+		{
+			break;
+		}
+		if(result != CONFIG_STORE_OK)
+		{
+			printf("full: put %u failed (%d)\n", key, result);
+			errors++;
+		}
+		stored++;
+	}
+
+	// now it's full, every change to a value that's there should still work
+	for(i = 0; i < 20000; i++)
+	{
+		key = rand() % stored;
+		make_value(key, i + 2, sizeof(value), value);
+		int result = config_store_put(&store, key, value, sizeof(value));
+		if(result != CONFIG_STORE_OK)
+		{
+			printf("full: change %u (key %u) failed (%d)\n", i, key, result);
+			errors++;
+			break;
+		}
+	}
+	config_store_open(&store, &flash);
+	printf("full: %u of %d byte values in 4 blocks, %u changes after that, "
+		"%u keys after reopening\n", stored, CONFIG_STORE_MAX_VALUE, i, store.count);
+	if(store.count != stored)
+	{
+		errors++;
+	}
+}
+
+// power cuts part way through erases, with the start of the block (its header
+// at least) left as it was
+static void torn_erase_test(void)
+{
+	uint32_t cycle, changes = 0, bad = 0;
+
+	flash_sim_wipe();
+	memset(expected, 0, sizeof(expected));
+	memset(&flash_sim_stats, 0, sizeof(flash_sim_stats));
+	open_store("torn erase");
+	for(cycle = 0; cycle < ERASE_CUTS && errors < 20; cycle++)
+	{
+		flash_sim_cut_power_in_erase(rand() % 4, 16 + rand() % (BLOCK_SIZE - 16));
+		while(random_change() != CONFIG_STORE_FLASH_ERROR)
+		{
+			changes++;
+		}
+
+		flash_sim_power_on();
+		open_store("torn erase");
+		bad += store.stats.bad_records;
+		check_store("torn erase");
+
+		// nothing should have been read from the block that was being erased
+		// (no write was cut short, so that's the only place a bad record can be)
+		if(store.stats.bad_records != 0)
+		{
+			printf("torn erase: cut %u: read %u bad records\n", cycle, store.stats.bad_records);
+			errors++;
+		}
+	}
+	printf("torn erase: %u power cuts in %u changes, %u bad records read - %s\n",
+		flash_sim_stats.power_cuts, changes, bad,
+		errors ? "FAILED" : "every value survived");
+}
+
+// fill every slot in the index, then add new keys by throwing the oldest one
+// away each time - nothing gets copied in this many changes, so the oldest
+// key should always be the one that was put longest ago (and still should be
+// after reopening)
+static void evict_test(void)
+{
+	static uint32_t put_at[2 * CONFIG_STORE_MAX_KEYS];
+	uint8_t value[VALUE_SIZE];
+	uint32_t key, oldest, wanted, clock = 0, next_key, evicted = 0;
+	int i;
+
+	flash_sim_wipe();
+	open_store("evict");
+	memset(put_at, 0, sizeof(put_at));
+
+	// fill it up, then change some of them (in a random order)
+	for(key = 0; key < CONFIG_STORE_MAX_KEYS; key++)
+	{
+		make_value(key, 1, VALUE_SIZE, value);
+		config_store_put(&store, key, value, VALUE_SIZE);
+		put_at[key] = ++clock;
+	}
+	for(i = 0; i < CONFIG_STORE_MAX_KEYS; i++)
+	{
+		key = rand() % CONFIG_STORE_MAX_KEYS;
+		make_value(key, 2, VALUE_SIZE, value);
+		config_store_put(&store, key, value, VALUE_SIZE);
+		put_at[key] = ++clock;
+	}
+
+	for(next_key = CONFIG_STORE_MAX_KEYS; next_key < 2 * CONFIG_STORE_MAX_KEYS; next_key++)
+	{
+		if(next_key == CONFIG_STORE_MAX_KEYS * 3 / 2)
+		{
+			open_store("evict");
+		}
+
+		make_value(next_key, 1, VALUE_SIZE, value);
+		int result = config_store_put(&store, next_key, value, VALUE_SIZE);
+		while(result == CONFIG_STORE_FULL && config_store_oldest(&store, &oldest) == CONFIG_STORE_OK)
+		{
+			// the one we should be throwing away
+			wanted = ~0u;
+			for(key = 0; key < next_key; key++)
+			{
+				if(put_at[key] != 0 && (wanted == ~0u || put_at[key] < put_at[wanted]))
+				{
+					wanted = key;
+				}
+			}
+			if(oldest != wanted)
+			{
+				printf("evict: key %u: threw away key %u, should have been %u\n", next_key,
+					oldest, wanted);
+				errors++;
+			}
+
+			put_at[oldest] = 0;
+			evicted++;
+			result = config_store_delete(&store, oldest);
+			if(result == CONFIG_STORE_OK)
+			{
+				result = config_store_put(&store, next_key, value, VALUE_SIZE);
+			}
+		}
+		if(result != CONFIG_STORE_OK)
+		{
+			printf("evict: key %u couldn't be added (%d)\n", next_key, result);
+			errors++;
+			break;
+		}
+		put_at[next_key] = ++clock;
+	}
+
+	printf("evict: %d keys, %u more added by throwing away %u, %u copies\n",
+		CONFIG_STORE_MAX_KEYS, next_key - CONFIG_STORE_MAX_KEYS, evicted, store.stats.copied);
+	if(store.count != CONFIG_STORE_MAX_KEYS || store.stats.copied != 0)
+	{
+		errors++;
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	const char * path = (argc > 1) ? argv[1] : "flash.bin";
+
+	srand(1357);
+	if(flash_sim_open(path, BLOCK_SIZE, BLOCKS, &flash) != 0)
+	{
+		printf("couldn't open %s\n", path);
+		return 1;
+	}
+
+	wear_test();
+	power_test();
+	torn_erase_test();
+	evict_test();
+	full_test(path);
+
+	flash_sim_close();
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * discovery_sim.c
+ *
+ * run node discovery against a simulated mesh - nodes join and leave at random
+ * times (some come back with a new network address), most send io samples
+ * every few seconds (losing some of them) and a few only ever answer node
+ * discover sweeps. every simulated second the registry is checked against
+ * which nodes are really there
+ *
+ * usage: make && ./discovery_sim [seconds]
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+
+// include node discovery
+#include "node_discovery.h"
+
+// the same settings as the firmware (in seconds)
+#define DISCOVERY_PERIOD		60
+#define DISCOVERY_EXPIRY		300
+
+// the simulated mesh
+#define SIM_NODES						300
+#define SAMPLE_PERIOD				6
+#define SAMPLE_LOSS					10				// percent of samples lost
+#define ND_LOSS							20				// percent of ND responses lost
+#define QUIET_NODES					5					// percent of nodes that never send samples
+
+// a simulated node
+typedef struct
+{
+	uint64_t	serial;
+	uint16_t	my_address;
+	uint8_t		present;
+	uint8_t		quiet;
+	uint8_t		known;							// heard from since it joined
+	uint32_t	joined;
+	uint32_t	heard;							// when we last got a frame from it
+	uint32_t	left;
+	uint32_t	next_change;				// when it next joins or leaves
+}
+sim_node_t;
+
+static sim_node_t mesh[SIM_NODES];
+static node_registry_t registry;
+static node_discovery_t discovery;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 2468;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// pick a network address no node on the network has (like the coordinator
+// does when a node joins)
+static uint16_t new_my_address(void)
+{
+	while(1)
+	{
+		uint16_t my_address = next_random() % 0xFFF0 + 1;
+		int i;
+		for(i = 0; i < SIM_NODES; i++)
+		{
+			if(mesh[i].present && mesh[i].my_address == my_address)
+			{
+				break;
+			}
+		}
+		if(i == SIM_NODES)
+		{
+			return my_address;
+		}
+	}
+}
+
+// a node joins (with a new network address each time)
+static void join(sim_node_t * node, uint32_t now)
+{
+	node->present = 1;
+	node->known = 0;
+	node->joined = now;
+	node->my_address = new_my_address();
+	node->next_change = now + 600 + next_random() % 3600;
+}
+
+// the ND response a node would send (MY, SH, SL, NI and the rest)
+static int nd_response(const sim_node_t * node, uint8_t * data)
+{
+	int i, length = 0;
+	data[length++] = node->my_address >> 8;
+	data[length++] = node->my_address;
+	for(i = 7; i >= 0; i--)
+	{
+		data[length++] = node->serial >> (i * 8);
+	}
+	length += sprintf((char *)&data[length], "ROOM%d", (int)(node - mesh)) + 1;
+	data[length++] = 0xFF;										// parent
+	data[length++] = 0xFE;
+	data[length++] = 0x01;										// router
+	return length + 5;
+}
+
+// check the registry matches the mesh - returns the number of problems
+static int check(uint32_t now)
+{
+	int i, errors = 0;
+
+	for(i = 0; i < SIM_NODES; i++)
+	{
+		sim_node_t * node = &mesh[i];
+		node_id_t id = node_registry_find_serial(&registry, node->serial);
+
+		// a node we've heard from recently must be there, with its current
+		// address (a quiet node can miss enough sweeps to be expired, which is
+		// fine as long as it comes back when it next answers)
+		if(node->present && node->known && now - node->heard <= DISCOVERY_EXPIRY)
+		{
+			if(id == NODE_NONE || node_registry_find_my(&registry, node->my_address) != id)
+			{
+				printf("%6u: node %d (present) not registered properly\n", now, i);
+				errors++;
+			}
+		}
+
+		// and a node that left long enough ago must have gone
+		if(!node->present && now - node->left > DISCOVERY_EXPIRY + 1 && id != NODE_NONE)
+		{
+			printf("%6u: node %d left at %u but is still registered\n", now, i, node->left);
+			errors++;
+		}
+	}
+
+	// and every id in use must be findable by its own addresses
+	for(i = 0; i < registry.count; i++)
+	{
+		if(!registry.in_use[i])
+		{
+			continue;
+		}
+		if(node_registry_find_serial(&registry, registry.serial[i]) != i ||
+			(registry.my_address[i] != NODE_UNKNOWN_MY &&
+			node_registry_find_my(&registry, registry.my_address[i]) != i))
+		{
+			printf("%6u: registry entry %d is inconsistent\n", now, i);
+			errors++;
+		}
+	}
+	return errors;
+}
+
+int main(int argc, char ** argv)
+{
+	uint32_t seconds = (argc > 1) ? atoi(argv[1]) : 4 * 3600;
+	uint32_t now, learn_total = 0, learn_worst = 0, learnt = 0, frames = 0, dropped = 0;
+	int i, errors = 0, change;
+	uint8_t data[64];
+
+	node_registry_init(&registry);
+	node_discovery_init(&discovery, &registry, DISCOVERY_PERIOD, DISCOVERY_EXPIRY, 0);
+
+	// half the nodes are there from the start, the rest turn up later
+	for(i = 0; i < SIM_NODES; i++)
+	{
+		mesh[i].serial = 0x0013A20040000000ULL | (next_random() & 0xFFFFFF) << 4 | (i & 0xF);
+		mesh[i].quiet = (next_random() % 100) < QUIET_NODES;
+		mesh[i].next_change = (i % 2) ? next_random() % 3600 : 0;
+		mesh[i].left = 0;
+	}
+
+	for(now = 0; now < seconds; now++)
+	{
+		// nodes joining and leaving
+		for(i = 0; i < SIM_NODES; i++)
+		{
+			sim_node_t * node = &mesh[i];
+			if(now != node->next_change)
+			{
+				continue;
+			}
+			if(node->present)
+			{
+				node->present = 0;
+				node->left = now;
+				node->next_change = now + 30 + next_random() % 3600;
+			}
+			else
+			{
+				join(node, now);
+			}
+		}
+
+		// samples
+		for(i = 0; i < SIM_NODES; i++)
+		{
+			sim_node_t * node = &mesh[i];
+			if(!node->present || node->quiet || (now + i) % SAMPLE_PERIOD != 0 ||
+				(next_random() % 100) < SAMPLE_LOSS)
+			{
+				continue;
+			}
+			frames++;
+			if(node_discovery_heard(&discovery, node->serial, node->my_address, now,
+				&change) == NODE_NONE)
+			{
+				printf("%6u: node %d wasn't added\n", now, i);
+				errors++;
+			}
+			node->heard = now;
+			if(!node->known)
+			{
+				node->known = 1;
+				learnt++;
+				learn_total += now - node->joined;
+				learn_worst = (now - node->joined > learn_worst) ? now - node->joined : learn_worst;
+			}
+		}
+
+		// what the rx thread does when the discovery timer goes off
+		node_id_t id;
+		while((id = node_discovery_expire(&discovery, now)) != NODE_NONE)
+		{
+			for(i = 0; i < SIM_NODES; i++)
+			{
+				dropped += (mesh[i].present && mesh[i].serial == registry.serial[id]);
+			}
+		}
+		if(node_discovery_sweep_due(&discovery, now))
+		{
+			for(i = 0; i < SIM_NODES; i++)
+			{
+				sim_node_t * node = &mesh[i];
+				if(!node->present || (next_random() % 100) < ND_LOSS)
+				{
+					continue;
+				}
+				frames++;
+				int length = nd_response(node, data);
+				node_discovery_nd_response(&discovery, data, length, now, &change);
+				node->heard = now;
+				if(!node->known)
+				{
+					node->known = 1;
+					learnt++;
+					learn_total += now - node->joined;
+					learn_worst = (now - node->joined > learn_worst) ? now - node->joined : learn_worst;
+				}
+			}
+		}
+
+		// a frame from the coordinator itself shouldn't add anything
+		node_discovery_heard(&discovery, 0, 0, now, &change);
+
+		errors += check(now);
+		if(errors > 20)
+		{
+			break;
+		}
+	}
+
+	int present = 0;
+	for(i = 0; i < SIM_NODES; i++)
+	{
+		present += mesh[i].present;
+	}
+	printf("%u s simulated, %d nodes (%d there at the end), %u frames\n", now, SIM_NODES,
+		present, frames);
+	printf("learnt %u (from samples) + %u (from %u sweeps), %u moved, %u expired, "
+		"%u ignored\n", discovery.stats.learnt, discovery.stats.discovered,
+		discovery.stats.sweeps, discovery.stats.moved, discovery.stats.expired,
+		discovery.stats.ignored);
+	printf("time from joining to being known: %.1f s average, %u s worst\n",
+		learnt ? (double)learn_total / learnt : 0.0, learn_worst);
+	printf("quiet nodes expired while still there (missed every sweep): %u\n", dropped);
+	printf("registry: %u ids handed out, %u in the free list, %.2f probes a lookup\n",
+		registry.count, registry.free_count,
+		(double)registry.stats.probes / registry.stats.lookups);
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,303 @@
+/*
+ * dma_rx_test.c
+ *
+ * the dma receive buffer bookkeeping (src/xbee_dma_rx.c) against a simulated
+ * dma controller - bytes arrive in bursts and go round a circular buffer with
+ * the transfer count (NDTR) counting down and reloading, the half and full
+ * transfer interrupts and the idle line interrupt call xbee_dma_rx_update,
+ * and a simulated rx thread reads the spans (with the dma carrying on while
+ * it works through each one) and checks every byte it gets is the next one
+ * the dma wrote
+ *
+ * - keeping up: the rx thread never gets far behind, so every byte has to
+ *   come out once and in order with no overruns
+ * - falling behind: the rx thread stalls for longer than it takes to fill the
+ *   buffer, so overruns have to be counted and what comes after them has to
+ *   be right (and we count the bytes that get overwritten before an overrun
+ *   can be seen - the dma can be up to half a buffer past where the
+ *   interrupts last saw it)
+ * - restarts: uart errors stop the dma and it starts again from the
+ *   beginning of the buffer
+ *
+ * usage: make && ./dma_rx_test
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <string.h>
+
+// include the dma receive buffer
+#include "xbee_dma_rx.h"
+
+// the buffer size the firmware uses and how long each test runs (in bytes
+// received)
+#define BUFFER_SIZE		256
+#define RUN_BYTES			2000000
+
+// the dma receive buffer
+static uint8_t buffer[BUFFER_SIZE];
+static xbee_dma_rx_t rx;
+
+// the simulated dma - where it's writing, its transfer count and how many
+// bytes it has written altogether (which decides what each byte is)
+static uint16_t dma_index;
+static uint16_t ndtr;
+static uint32_t written;
+
+// the points (in bytes written) where the dma was restarted
+#define MAX_RESTARTS	4096
+static uint32_t restarts[MAX_RESTARTS];
+static int num_restarts;
+
+// what the rx thread saw
+static uint32_t checked, wrong, wrong_restart, interrupts, worst_lag;
+
+static int errors = 0;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// the value of the nth byte received (different from the bytes a few buffers
+// either side of it, so an overwritten byte shows up)
+static uint8_t byte_value(uint32_t n)
+{
+	return (uint8_t)((n * 2654435761u) >> 24);
+}
+
+// THE DMA SIDE
+
+// an interrupt - the handler reads the transfer count
+static void interrupt(void)
+{
+	xbee_dma_rx_update(&rx, ndtr);
+	interrupts++;
+}
+
+// the dma writes a byte (with the half and full transfer interrupts when it
+// gets half way and to the end)
+static void dma_write(void)
+{
+	buffer[dma_index] = byte_value(written++);
+	dma_index = (dma_index + 1) & (BUFFER_SIZE - 1);
+	ndtr = (ndtr == 1) ? BUFFER_SIZE : ndtr - 1;
+
+	if(dma_index == BUFFER_SIZE / 2 || dma_index == 0)
+	{
+		interrupt();
+	}
+}
+
+// a uart error - the error interrupt records where the dma got to, then it's
+// started again from the beginning of the buffer
+static void dma_restart(void)
+{
+	interrupt();
+	xbee_dma_rx_restart(&rx);
+	if(num_restarts < MAX_RESTARTS)
+	{
+		restarts[num_restarts++] = written;
+	}
+	dma_index = 0;
+	ndtr = BUFFER_SIZE;
+}
+
+// THE RX THREAD SIDE
+
+// did the dma restart after byte n had been written (so it may have been
+// overwritten or read from the wrong place - which the parser has to catch)
+static int restarted_since(uint32_t n)
+{
+	return num_restarts > 0 && restarts[num_restarts - 1] > n;
+}
+
+// read everything there is, with the dma writing another few bytes while each
+// span is worked through
+static void rx_thread(int dma_bytes)
+{
+	const uint8_t * data;
+	size_t length;
+
+	if(written - rx.consumed > worst_lag)
+	{
+		worst_lag = written - rx.consumed;
+	}
+
+	while(1)
+	{
+		uint32_t overruns = rx.overruns;
+		length = xbee_dma_rx_span(&rx, &data);
+		if(length == 0)
+		{
+			if(rx.overruns == overruns)
+			{
+				return;
+			}
+			continue;
+		}
+
+		uint32_t first = rx.consumed;
+		int i;
+		for(i = 0; i < dma_bytes; i++)
+		{
+			dma_write();
+		}
+
+		// sometimes only part of the span gets used
+		if(next_random() % 4 == 0)
+		{
+			length = 1 + next_random() % length;
+		}
+
+		for(i = 0; i < (int)length; i++)
+		{
+			if(data[i] != byte_value(first + i))
+			{
+				if(restarted_since(first + i))
+				{
+					wrong_restart++;
+				}
+				else
+				{
+					wrong++;
+				}
+			}
+		}
+		checked += length;
+		xbee_dma_rx_consume(&rx, length);
+	}
+}
+
+// RUNNING
+
+typedef struct
+{
+	const char *	name;
+	int						stall_chance;				// per thousand bytes
+	int						stall_length;				// the longest stall (in bytes)
+	int						restart_chance;			// per million bytes
+}
+sim_t;
+
+static void run(const sim_t * sim)
+{
+	int stall = 0;
+
+	xbee_dma_rx_init(&rx, buffer, BUFFER_SIZE);
+	memset(buffer, 0, sizeof(buffer));
+	dma_index = 0;
+	ndtr = BUFFER_SIZE;
+	written = 0;
+	num_restarts = 0;
+	checked = wrong = wrong_restart = interrupts = worst_lag = 0;
+
+	while(written < RUN_BYTES)
+	{
+		// a burst of bytes, then the line goes idle
+		int burst = 1 + next_random() % 100;
+		int i;
+
+		for(i = 0; i < burst; i++)
+		{
+			dma_write();
+
+			if(next_random() % 1000000 < (uint32_t)sim->restart_chance)
+			{
+				// a uart error (whatever was on the line at the time never gets to
+				// the buffer, so it doesn't count as written)
+				dma_restart();
+			}
+
+			// the rx thread gets a look in every so often (unless it's stalled)
+			if(stall > 0)
+			{
+				stall--;
+			}
+			else if(next_random() % 1000 < (uint32_t)sim->stall_chance)
+			{
+				stall = next_random() % sim->stall_length;
+			}
+			else if(next_random() % 16 == 0)
+			{
+				rx_thread(next_random() % 8);
+			}
+		}
+		interrupt();
+		if(stall == 0)
+		{
+			rx_thread(0);
+		}
+	}
+
+	// catch up at the end
+	interrupt();
+	rx_thread(0);
+
+	printf("%-16s %9u %8u %8u %8u %8u %8u %8u %8u %8u\n", sim->name, written, checked,
+		interrupts, rx.events, rx.overruns, wrong, num_restarts, wrong_restart, worst_lag);
+
+	if(rx.events != interrupts || rx.produced != written || rx.consumed != written)
+	{
+		printf("  %u events for %u interrupts, %u bytes produced and %u read for %u written\n",
+			rx.events, interrupts, rx.produced, rx.consumed, written);
+		errors++;
+	}
+	if(sim->stall_chance == 0 && (rx.overruns != 0 || checked != written))
+	{
+		printf("  %u overruns and %u of %u bytes read while keeping up\n", rx.overruns,
+			checked, written);
+		errors++;
+	}
+	if(sim->stall_chance != 0 && rx.overruns == 0)
+	{
+		printf("  no overruns counted\n");
+		errors++;
+	}
+	if(sim->restart_chance == 0 && wrong_restart != 0)
+	{
+		printf("  bytes lost to restarts with no restarts\n");
+		errors++;
+	}
+	if(sim->stall_chance == 0 && wrong != 0)
+	{
+		printf("  %u bytes read that the dma had overwritten while keeping up\n", wrong);
+		errors++;
+	}
+}
+
+int main(void)
+{
+	static const sim_t sims[] =
+	{
+		{"keeping up",				0, 0, 0},
+		{"falling behind",	 20, 4 * BUFFER_SIZE, 0},
+		{"restarts",					0, 0, 500},
+		{"both",						 20, 4 * BUFFER_SIZE, 500},
+	};
+	unsigned int i;
+
+	printf("%d byte buffer\n\n", BUFFER_SIZE);
+	printf("%-16s %9s %8s %8s %8s %8s %8s %8s %8s %8s\n", "", "written", "read", "irqs",
+		"events", "overruns", "missed", "restarts", "restart", "lag");
+	for(i = 0; i < sizeof(sims) / sizeof(sims[0]); i++)
+	{
+		run(&sims[i]);
+	}
+	printf("\nmissed: bytes read after the dma had overwritten them with no overrun "
+		"counted\n(the rx thread was less than a buffer behind where the interrupts "
+		"had seen the\ndma get to, but more than that behind the dma itself), restart: "
+		"bytes from before\na restart read after it had overwritten them, lag: the "
+		"furthest the rx thread got\nbehind the dma - the parser's checksum catches "
+		"the damaged frames either way\n");
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,396 @@
+/*
+ * escape_test.c
+ *
+ * the escaped api mode (AP=2) in the xbee packet parser
+ * (src/xbee_packet_parser.c), built once for each api mode:
+ *
+ * - test (AP=2 only): a corpus of frames is escaped with xbee_escape_frame and
+ *   parsed again, a byte at a time and in the bulk path split up at random
+ *   (so escapes get split across spans) - every frame has to come back out
+ *   as it went in. the corpus has frames made of nothing but characters that
+ *   need escaping, lengths and checksums that need escaping and frames cut
+ *   short by the next delimiter
+ * - bench: how fast the bulk path gets through a stream of io samples - the
+ *   AP=1 build parses it as it is and the AP=2 build parses it escaped (and
+ *   times escaping it too)
+ *
+ * usage: make && ./escape_test_ap1 && ./escape_test_ap2
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// include the parser
+#include "xbee_packet_parser.h"
+#include "itm_debug.h"
+#include "cmsis_os.h"
+
+// the largest data field in the corpus, how many random frames to add to it
+// and the size of the benchmark stream
+#define MAX_DATA				300
+#define RANDOM_FRAMES		2000
+#define BENCH_SIZE			(256 * 1024)
+#define BENCH_REPLAYS		20
+
+// what the rest of the firmware would provide
+uint32_t osKernelSysTick(void)
+{
+	return 0;
+}
+
+int itm_send(uint32_t channel, itm_event_t event, const uint32_t * words, uint32_t count)
+{
+	return 1;
+}
+
+static xbee_parser_t parser;
+static int errors = 0;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// the time now in nanoseconds
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// put the header and checksum round a data field - returns the frame length
+static int make_frame(uint8_t * frame, const uint8_t * data, int length)
+{
+	uint8_t sum = 0;
+	int i;
+
+	frame[0] = 0x7e;
+	frame[1] = length >> 8;
+	frame[2] = length & 0xFF;
+	for(i = 0; i < length; i++)
+	{
+		frame[3 + i] = data[i];
+		sum += data[i];
+	}
+	frame[3 + length] = 0xFF - sum;
+	return length + 4;
+}
+
+#if XBEE_API_MODE == 2
+
+// TEST
+
+// the characters that have to be escaped
+static const uint8_t specials[] = {0x7e, 0x7d, 0x11, 0x13};
+
+// the corpus (unescaped) and the escaped stream
+static uint8_t corpus[RANDOM_FRAMES + 64][MAX_DATA + 4];
+static int corpus_length[RANDOM_FRAMES + 64];
+static int corpus_count = 0;
+static uint8_t escaped[(RANDOM_FRAMES + 64) * (MAX_DATA + 4) * 2];
+static size_t escaped_length, corpus_bytes;
+
+static void add(const uint8_t * data, int length)
+{
+	corpus_length[corpus_count] = make_frame(corpus[corpus_count], data, length);
+	corpus_count++;
+}
+
+static void make_corpus(void)
+{
+	uint8_t data[MAX_DATA];
+	int i, n;
+
+	// nothing but characters that need escaping (each one on its own, and all
+	// of them mixed up)
+	for(n = 0; n < 4; n++)
+	{
+		memset(data, specials[n], 40);
+		data[0] = 0x90;
+		add(data, 40);
+	}
+	for(i = 0; i < MAX_DATA; i++)
+	{
+		data[i] = specials[i % 4];
+	}
+	add(data, MAX_DATA);
+
+	// lengths whose low byte needs escaping
+	for(n = 0; n < 4; n++)
+	{
+		for(i = 0; i < specials[n]; i++)
+		{
+			data[i] = next_random();
+		}
+		add(data, specials[n]);
+		for(i = 0; i < 0x100 + specials[n] && i < MAX_DATA; i++)
+		{
+			data[i] = next_random();
+		}
+		if(0x100 + specials[n] <= MAX_DATA)
+		{
+			add(data, 0x100 + specials[n]);
+		}
+	}
+
+	// checksums that need escaping (change the last data byte until it does)
+	for(n = 0; n < 4; n++)
+	{
+		uint8_t sum = 0;
+		for(i = 0; i < 19; i++)
+		{
+			data[i] = next_random();
+			sum += data[i];
+		}
+		data[19] = (uint8_t)(0xFF - specials[n] - sum);
+		add(data, 20);
+	}
+
+	// an empty data field, and one with just a frame type
+	add(data, 0);
+	data[0] = 0x8a;
+	add(data, 1);
+
+	// random frames, with about one byte in eight needing escaping
+	for(n = 0; n < RANDOM_FRAMES; n++)
+	{
+		int length = 1 + next_random() % MAX_DATA;
+		for(i = 0; i < length; i++)
+		{
+			data[i] = (next_random() % 8 == 0) ? specials[next_random() % 4] : next_random();
+		}
+		add(data, length);
+	}
+
+	// escape the lot
+	escaped_length = 0;
+	corpus_bytes = 0;
+	for(n = 0; n < corpus_count; n++)
+	{
+		corpus_bytes += corpus_length[n];
+		escaped_length += xbee_escape_frame(corpus[n], corpus_length[n], &escaped[escaped_length]);
+	}
+}
+
+// take the frames out of the parser and check them against the corpus
+static void check_frames(int * next, const char * how)
+{
+	xbee_frame_t frame;
+
+	while(xbee_get_frame(&parser, &frame))
+	{
+		const uint8_t * data = xbee_frame_data(&parser, &frame);
+		if(*next >= corpus_count)
+		{
+			printf("%s: more frames than went in\n", how);
+			errors++;
+		}
+		else if(frame.length != corpus_length[*next] ||
+			memcmp(data, corpus[*next], frame.length) != 0)
+		{
+			printf("%s: frame %d doesn't match (%d bytes, expected %d)\n", how, *next,
+				frame.length, corpus_length[*next]);
+			errors++;
+		}
+		(*next)++;
+		xbee_release_frame(&parser);
+	}
+}
+
+static void test_round_trip(int bulk)
+{
+	const char * how = bulk ? "bulk" : "per byte";
+	int next = 0;
+	size_t pos = 0;
+
+	init_parser(&parser);
+	while(pos < escaped_length)
+	{
+		if(bulk)
+		{
+			// a span of anything up to 64 bytes
+			size_t span = 1 + next_random() % 64;
+			if(span > escaped_length - pos)
+			{
+				span = escaped_length - pos;
+			}
+			size_t end = pos + span;
+			while(pos < end)
+			{
+				pos += xbee_parse_bytes(&parser, &escaped[pos], end - pos, NULL);
+				check_frames(&next, how);
+			}
+		}
+		else
+		{
+			xbee_parse_packet(&parser, escaped[pos++]);
+			check_frames(&next, how);
+		}
+	}
+
+	if(next != corpus_count || parser.stats.bad_checksums != 0 || parser.stats.dropped_bytes != 0)
+	{
+		printf("%s: %d of %d frames back, %u bad checksums, %u bytes dropped\n", how, next,
+			corpus_count, parser.stats.bad_checksums, parser.stats.dropped_bytes);
+		errors++;
+	}
+	printf("test: %s - %d frames (%zu bytes, %zu escaped) round tripped\n", how, next,
+		corpus_bytes, escaped_length);
+}
+
+// a frame cut short by the start of the next one loses just that frame
+static void test_cut_short(int bulk)
+{
+	static uint8_t stream[4 * (MAX_DATA + 4) * 2];
+	size_t length = 0;
+	int n;
+
+	// corpus frames 10 and 12, with half of 11 between them
+	length += xbee_escape_frame(corpus[10], corpus_length[10], &stream[length]);
+	length += xbee_escape_frame(corpus[11], corpus_length[11], &stream[length]) / 2;
+	length += xbee_escape_frame(corpus[12], corpus_length[12], &stream[length]);
+
+	init_parser(&parser);
+	if(bulk)
+	{
+		size_t pos = 0;
+		while(pos < length)
+		{
+			pos += xbee_parse_bytes(&parser, &stream[pos], length - pos, NULL);
+		}
+	}
+	else
+	{
+		size_t i;
+		for(i = 0; i < length; i++)
+		{
+			xbee_parse_packet(&parser, stream[i]);
+		}
+	}
+
+	// frames 10 and 12 come out and 11 doesn't
+	xbee_frame_t frame;
+	for(n = 10; n <= 12; n += 2)
+	{
+		if(!xbee_get_frame(&parser, &frame) || frame.length != corpus_length[n] ||
+			memcmp(xbee_frame_data(&parser, &frame), corpus[n], frame.length) != 0)
+		{
+			printf("%s: frame %d lost after a frame cut short\n", bulk ? "bulk" : "per byte", n);
+			errors++;
+		}
+		xbee_release_frame(&parser);
+	}
+	if(parser.stats.resyncs != 1)
+	{
+		printf("%s: %u resyncs after a frame cut short (expected 1)\n",
+			bulk ? "bulk" : "per byte", parser.stats.resyncs);
+		errors++;
+	}
+	printf("test: %s - frame cut short by the next delimiter, the frames either side "
+		"kept\n", bulk ? "bulk" : "per byte");
+}
+
+#endif
+
+// BENCHMARK
+
+static void bench(void)
+{
+	static uint8_t raw[BENCH_SIZE], stream[BENCH_SIZE * 2];
+	uint8_t data[22];
+	size_t raw_length = 0, length = 0;
+	uint32_t frames = 0;
+	int i, r;
+
+	// io samples (random, so the odd one needs escaping)
+	while(raw_length < BENCH_SIZE - 64)
+	{
+		data[0] = 0x92;
+		for(i = 1; i < 22; i++)
+		{
+			data[i] = next_random();
+		}
+		raw_length += make_frame(&raw[raw_length], data, 22);
+	}
+
+	// escape it (in escaped mode)
+	double start = now();
+#if XBEE_API_MODE == 2
+	for(r = 0; r < BENCH_REPLAYS; r++)
+	{
+		size_t pos = 0;
+		length = 0;
+		while(pos < raw_length)
+		{
+			int frame_length = 26;
+			length += xbee_escape_frame(&raw[pos], frame_length, &stream[length]);
+			pos += frame_length;
+		}
+	}
+#else
+	memcpy(stream, raw, raw_length);
+	length = raw_length;
+#endif
+	double escaping = (now() - start) / ((double)raw_length * BENCH_REPLAYS);
+
+	// parse it in 64 byte spans
+	start = now();
+	for(r = 0; r < BENCH_REPLAYS; r++)
+	{
+		size_t pos = 0;
+		init_parser(&parser);
+		while(pos < length)
+		{
+			size_t end = (length - pos > 64) ? pos + 64 : length;
+			while(pos < end)
+			{
+				xbee_frame_t frame;
+				pos += xbee_parse_bytes(&parser, &stream[pos], end - pos, NULL);
+				while(xbee_get_frame(&parser, &frame))
+				{
+					xbee_release_frame(&parser);
+					frames++;
+				}
+			}
+		}
+	}
+	double time = now() - start;
+
+	printf("bench: AP=%d - %zu bytes of frames sent as %zu, parsed at %.1f MB/s "
+		"(%.2f ns per frame byte, %.2f M frames/s)", XBEE_API_MODE, raw_length, length,
+		raw_length * BENCH_REPLAYS * 1e3 / time, time / ((double)raw_length * BENCH_REPLAYS),
+		frames * 1e3 / time);
+	if(XBEE_API_MODE == 2)
+	{
+		printf(", escaped at %.2f ns per byte", escaping);
+	}
+	printf("\n");
+}
+
+int main(void)
+{
+	printf("api mode %d\n", XBEE_API_MODE);
+
+#if XBEE_API_MODE == 2
+	make_corpus();
+	test_round_trip(0);
+	test_round_trip(1);
+	test_cut_short(0);
+	test_cut_short(1);
+#endif
+	bench();
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
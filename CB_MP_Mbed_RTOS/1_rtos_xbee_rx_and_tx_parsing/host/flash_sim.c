@@ -0,0 +1,205 @@
+/*
+ * flash_sim.c
+ *
+ * a nor flash kept in a file (mapped into memory, so the store can read it
+ * straight out like the memory mapped qspi flash)
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries and posix)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// include the flash simulator header
+#include "flash_sim.h"
+
+// what an erase counts as when working out when to cut the power
+#define ERASE_COST 64
+
+flash_sim_stats_t flash_sim_stats;
+
+static uint8_t * flash_data = NULL;
+static uint32_t flash_size, flash_block_size;
+static int powered = 1;
+static int cutting = 0;
+static uint32_t budget;
+static int cutting_erase = 0;
+static uint32_t erases_left, erase_keep;
+
+// use up some of what's left before the power goes - returns how much of it
+// we get to do (less than cost if the power goes part way through)
+static uint32_t spend(uint32_t cost)
+{
+	if(!cutting)
+	{
+		return cost;
+	}
+	if(budget >= cost)
+	{
+		budget -= cost;
+		return cost;
+	}
+	uint32_t done = budget;
+	budget = 0;
+	powered = 0;
+	cutting = 0;
+	flash_sim_stats.power_cuts++;
+	return done;
+}
+
+// FLASH FUNCTIONS
+
+static int sim_read(uint32_t address, void * data, uint32_t length)
+{
+	if(!powered || address + length > flash_size)
+	{
+		return -1;
+	}
+	memcpy(data, flash_data + address, length);
+	return 0;
+}
+
+// programming can only clear bits - if the power goes, the byte it was on
+// gets some of its bits
+static int sim_write(uint32_t address, const void * data, uint32_t length)
+{
+	const uint8_t * bytes = data;
+	uint32_t i, done;
+
+	if(!powered || address + length > flash_size)
+	{
+		return -1;
+	}
+	done = spend(length);
+	for(i = 0; i < done; i++)
+	{
+		flash_data[address + i] &= bytes[i];
+	}
+	flash_sim_stats.written += done;
+	if(done < length)
+	{
+		flash_data[address + done] &= bytes[done] | (uint8_t)rand();
+		return -1;
+	}
+	return 0;
+}
+
+// erasing sets the whole block to 0xff - if the power goes, some of the bits
+// get set and some don't
+static int sim_erase(uint32_t address)
+{
+	uint32_t i, block = address / flash_block_size;
+
+	if(!powered || address % flash_block_size != 0 || address >= flash_size)
+	{
+		return -1;
+	}
+	flash_sim_stats.erases[block]++;
+	if(cutting_erase && erases_left-- == 0)
+	{
+		for(i = erase_keep; i < flash_block_size; i++)
+		{
+			flash_data[address + i] |= (uint8_t)rand() & (uint8_t)rand();
+		}
+		powered = 0;
+		cutting_erase = 0;
+		flash_sim_stats.power_cuts++;
+		return -1;
+	}
+	if(spend(ERASE_COST) < ERASE_COST)
+	{
+		for(i = 0; i < flash_block_size; i++)
+		{
+			flash_data[address + i] |= (uint8_t)rand() & (uint8_t)rand();
+		}
+		return -1;
+	}
+	memset(flash_data + address, 0xFF, flash_block_size);
+	return 0;
+}
+
+// METHODS
+
+// open the flash file
+int flash_sim_open(const char * path, uint32_t block_size, uint16_t blocks,
+	config_flash_t * flash)
+{
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if(fd < 0)
+	{
+		return -1;
+	}
+
+	// a new file starts off erased
+	off_t size = lseek(fd, 0, SEEK_END);
+	flash_size = block_size * blocks;
+	flash_block_size = block_size;
+	if(size != flash_size && ftruncate(fd, flash_size) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	flash_data = mmap(NULL, flash_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(flash_data == MAP_FAILED)
+	{
+		flash_data = NULL;
+		return -1;
+	}
+	if(size != flash_size)
+	{
+		memset(flash_data, 0xFF, flash_size);
+	}
+
+	memset(&flash_sim_stats, 0, sizeof(flash_sim_stats));
+	powered = 1;
+	cutting = 0;
+	cutting_erase = 0;
+
+	flash->mapped = flash_data;
+	flash->block_size = block_size;
+	flash->blocks = blocks;
+	flash->read = sim_read;
+	flash->write = sim_write;
+	flash->erase = sim_erase;
+	return 0;
+}
+
+void flash_sim_close(void)
+{
+	if(flash_data != NULL)
+	{
+		munmap(flash_data, flash_size);
+		flash_data = NULL;
+	}
+}
+
+void flash_sim_wipe(void)
+{
+	memset(flash_data, 0xFF, flash_size);
+}
+
+// power cuts
+void flash_sim_cut_power(uint32_t after)
+{
+	budget = after;
+	cutting = 1;
+}
+
+void flash_sim_cut_power_in_erase(uint32_t after, uint32_t keep)
+{
+	erases_left = after;
+	erase_keep = (keep < flash_block_size) ? keep : flash_block_size;
+	cutting_erase = 1;
+}
+
+void flash_sim_power_on(void)
+{
+	powered = 1;
+	cutting = 0;
+	cutting_erase = 0;
+}
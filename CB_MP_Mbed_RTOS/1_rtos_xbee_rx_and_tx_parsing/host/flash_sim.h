@@ -0,0 +1,51 @@
+/*
+ * flash_sim.h
+ *
+ * a nor flash kept in a file, for running the config store on a pc - writes
+ * can only clear bits (like the real thing), erases set a whole block back to
+ * 0xff, and the power can be made to go part way through a write or erase
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __FLASH_SIM_H
+#define __FLASH_SIM_H
+
+// include the config store (for the flash functions)
+#include "config_store.h"
+
+// how much of the flash has been worn out
+typedef struct
+{
+	uint64_t	written;								// bytes programmed
+	uint32_t	erases[CONFIG_STORE_MAX_BLOCKS];
+	uint32_t	power_cuts;
+}
+flash_sim_stats_t;
+
+extern flash_sim_stats_t flash_sim_stats;
+
+// function prototypes
+
+// open (or make) the flash file and fill in the functions for the store to
+// use - returns 0 if it worked
+int  flash_sim_open(const char * path, uint32_t block_size, uint16_t blocks,
+	config_flash_t * flash);
+void flash_sim_close(void);
+
+// erase the whole thing
+void flash_sim_wipe(void);
+
+// lose power once this many more bytes have been programmed (an erase counts
+// as 64 bytes) - the write or erase it happens in is left half done, and
+// everything after that fails until the power comes back
+void flash_sim_cut_power(uint32_t after);
+void flash_sim_power_on(void);
+
+// lose power part way through an erase instead (once this many more erases
+// have finished) - the first keep bytes of the block are left as they were,
+// as if the erase hadn't got to them yet, and the rest is half erased
+void flash_sim_cut_power_in_erase(uint32_t after, uint32_t keep);
+
+#endif // FLASH_SIM_H
@@ -0,0 +1,251 @@
+/*
+ * flow_test.c
+ *
+ * the rts flow control thresholds (src/xbee_flow.c):
+ *
+ * - the thresholds that xbee_flow_init has to turn down, and a run through by
+ *   hand of when the radio gets stopped and started (only once each way per
+ *   crossing, and with the buffer over full after lost data)
+ * - a simulated radio streaming into the receive buffer one byte time at a
+ *   time - it carries on for up to RADIO_SKID bytes after rts is deasserted
+ *   (before it notices), and the rx thread reads at random rates and stalls
+ *   for longer than it takes to fill the buffer. this is run with the
+ *   firmware's two receive set ups - dma (looking at the buffer only at the
+ *   half way and end points and when the line goes idle) and the interrupt
+ *   ring (looking at every byte) - and no byte can be lost in either
+ *
+ * the sims are also run with start_free only just above stop_free, to show
+ * why it's kept well clear (rts goes up and down a few bytes at a time)
+ *
+ * usage: make && ./flow_test
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <string.h>
+
+// include the flow control thresholds
+#include "xbee_flow.h"
+
+// the firmware's buffers and thresholds (XBEE_RX_DMA_SIZE, XBEE_RX_RING_SIZE
+// and XBEE_RTS_STOP_FREE / XBEE_RTS_START_FREE for each in xbee.h)
+#define DMA_SIZE				256
+#define DMA_STOP_FREE		(DMA_SIZE / 2 + 16)
+#define DMA_START_FREE	(DMA_SIZE * 3 / 4)
+#define RING_SIZE				512
+#define RING_STOP_FREE	32
+#define RING_START_FREE	(RING_SIZE / 2)
+
+// the most bytes the radio sends after rts is deasserted, and how long each
+// sim runs for (in byte times)
+#define RADIO_SKID			16
+#define RUN_TIME				5000000
+
+static int errors = 0;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// check something is what it should be
+static void check(int value, int expected, const char * what)
+{
+	if(value != expected)
+	{
+		printf("%s: %d (not %d)\n", what, value, expected);
+		errors++;
+	}
+}
+
+// BY HAND
+
+static void test_init(void)
+{
+	xbee_flow_t flow;
+
+	check(xbee_flow_init(&flow, 256, 144, 144), 0, "start_free the same as stop_free");
+	check(xbee_flow_init(&flow, 256, 144, 100), 0, "start_free less than stop_free");
+	check(xbee_flow_init(&flow, 256, 144, 257), 0, "start_free more than the size");
+	check(xbee_flow_init(&flow, 256, 144, 256), 1, "start_free the size");
+	check(xbee_flow_init(&flow, 256, 0, 1), 1, "stop_free 0");
+
+	memset(&flow, 0xFF, sizeof(flow));
+	check(xbee_flow_init(&flow, 256, 144, 192), 1, "the dma thresholds");
+	check(flow.stopped, 0, "stopped after init");
+	check(flow.stops, 0, "stops after init");
+	check(flow.high_water, 0, "high water after init");
+}
+
+static void test_thresholds(void)
+{
+	xbee_flow_t flow;
+
+	// 256 bytes, stop with less than 144 free (more than 112 used) and start
+	// again with 192 free (64 used)
+	xbee_flow_init(&flow, 256, 144, 192);
+
+	check(xbee_flow_start(&flow, 0), 0, "start when running");
+	check(xbee_flow_stop(&flow, 112), 0, "stop at 144 free");
+	check(xbee_flow_stop(&flow, 113), 1, "stop at 143 free");
+	check(xbee_flow_stop(&flow, 200), 0, "stop again when stopped");
+	check(flow.stops, 1, "stops");
+	check(xbee_flow_start(&flow, 100), 0, "start at 156 free");
+	check(xbee_flow_start(&flow, 65), 0, "start at 191 free");
+	check(xbee_flow_start(&flow, 64), 1, "start at 192 free");
+	check(xbee_flow_start(&flow, 0), 0, "start again when running");
+	check(xbee_flow_stop(&flow, 64), 0, "stop in between");
+
+	// with bytes lost the count can go past the size
+	check(xbee_flow_stop(&flow, 300), 1, "stop over full");
+	check(xbee_flow_start(&flow, 300), 0, "start over full");
+	check(flow.stops, 2, "stops");
+	check(flow.high_water, 300, "high water");
+}
+
+// THE SIM
+
+typedef struct
+{
+	const char *	name;
+	uint32_t			size;
+	uint32_t			stop_free;
+	uint32_t			start_free;
+	int						every_byte;			// looks on every byte (or only with dma)
+	int						rx_rate;				// bytes the rx thread reads every 8 byte times (on
+																// average)
+}
+sim_t;
+
+static void run(const sim_t * sim)
+{
+	xbee_flow_t flow;
+	uint32_t received = 0, consumed = 0, lost = 0;
+	uint32_t skid = 0, stall = 0;
+	uint32_t rts_high = 0, rts_changes = 0;
+	int rts = 0, sent_last = 0;
+	uint32_t t;
+
+	if(!xbee_flow_init(&flow, sim->size, sim->stop_free, sim->start_free))
+	{
+		printf("%s: thresholds turned down\n", sim->name);
+		errors++;
+		return;
+	}
+
+	for(t = 0; t < RUN_TIME; t++)
+	{
+		// the radio sends a byte (unless rts has been high for long enough for
+		// it to notice) - and every so often it has nothing to send
+		int sending = 0;
+		if(next_random() % 64 != 0 && (!rts || skid > 0))
+		{
+			sending = 1;
+			if(rts)
+			{
+				skid--;
+			}
+		}
+
+		if(sending)
+		{
+			if(received - consumed >= sim->size)
+			{
+				lost++;
+			}
+			else
+			{
+				received++;
+			}
+		}
+
+		// the receive side looks at the buffer (on every byte, or at the dma's
+		// half way and end points and when the line goes idle)
+		int look = sim->every_byte ? sending :
+			(sending && received % (sim->size / 2) == 0) || (!sending && sent_last);
+		if(look && xbee_flow_stop(&flow, received - consumed + lost))
+		{
+			rts = 1;
+			rts_changes++;
+			skid = next_random() % (RADIO_SKID + 1);
+		}
+		sent_last = sending;
+		rts_high += rts;
+
+		// the rx thread reads what it can (unless it's stalled) and then sees if
+		// the radio can start again
+		if(stall > 0)
+		{
+			stall--;
+		}
+		else if(next_random() % 20000 == 0)
+		{
+			stall = next_random() % (4 * sim->size);
+		}
+		else if(next_random() % 8 == 0)
+		{
+			uint32_t n = next_random() % (2 * sim->rx_rate + 1);
+			if(n > received - consumed)
+			{
+				n = received - consumed;
+			}
+			consumed += n;
+			if(xbee_flow_start(&flow, received - consumed))
+			{
+				rts = 0;
+				rts_changes++;
+			}
+		}
+	}
+
+	printf("%-26s %5u %5u %5u %9u %6u %5.1f%% %8u %6u %5u\n", sim->name, sim->size,
+		sim->stop_free, sim->start_free, received, flow.stops, 100.0 * rts_high / RUN_TIME,
+		rts_changes, flow.high_water, lost);
+
+	if(lost != 0 || flow.high_water > sim->size)
+	{
+		errors++;
+	}
+	if(flow.stops == 0 || rts_changes < 2 * flow.stops - 1 || rts_changes > 2 * flow.stops)
+	{
+		printf("  %u stops, rts changed %u times\n", flow.stops, rts_changes);
+		errors++;
+	}
+}
+
+int main(void)
+{
+	static const sim_t sims[] =
+	{
+		{"dma, rx keeping up",					DMA_SIZE, DMA_STOP_FREE, DMA_START_FREE, 0, 16},
+		{"dma, rx too slow",						DMA_SIZE, DMA_STOP_FREE, DMA_START_FREE, 0, 6},
+		{"dma, no hysteresis",					DMA_SIZE, DMA_STOP_FREE, DMA_STOP_FREE + 1, 0, 6},
+		{"ring, rx keeping up",					RING_SIZE, RING_STOP_FREE, RING_START_FREE, 1, 16},
+		{"ring, rx too slow",						RING_SIZE, RING_STOP_FREE, RING_START_FREE, 1, 6},
+		{"ring, no hysteresis",					RING_SIZE, RING_STOP_FREE, RING_STOP_FREE + 1, 1, 6},
+	};
+	unsigned int i;
+
+	test_init();
+	test_thresholds();
+
+	printf("%-26s %5s %5s %5s %9s %6s %6s %8s %6s %5s\n", "", "size", "stop", "start",
+		"received", "stops", "held", "rts", "high", "lost");
+	for(i = 0; i < sizeof(sims) / sizeof(sims[0]); i++)
+	{
+		run(&sims[i]);
+	}
+	printf("\nstop, start: the free space rts is deasserted and asserted again at, held: "
+		"how\nmuch of the time the radio was held off, rts: how many times it changed, "
+		"high: the\nmost in the buffer when the receive side looked\n");
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
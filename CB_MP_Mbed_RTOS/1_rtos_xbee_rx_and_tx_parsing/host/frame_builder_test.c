@@ -0,0 +1,240 @@
+/*
+ * frame_builder_test.c
+ *
+ * a pc build of the xbee frame builder (src/xbee_frame_builder.c), checked
+ * against the frames main.c and the action thread used to send as hand
+ * checksummed arrays - the builder has to produce every one of them byte for
+ * byte, with the same arguments main.c now passes it
+ *
+ * the arrays are as they were before the builder replaced them (only the
+ * names are changed), so don't "fix" them here
+ *
+ * usage: make && ./frame_builder_test
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <string.h>
+
+// include the frame builder
+#include "xbee_frame_builder.h"
+
+static int errors = 0;
+static int checked = 0;
+
+// FIXTURES (the old arrays from main.c)
+
+// set up adc on dio 0 on all xbees connected to the WPAN - Light
+static const uint8_t init_adc_0[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x30, 0x02, 0x74};
+
+// set up adc on dio 1 on all xbees connected to the WPAN - Temp
+static const uint8_t init_adc_1[] = {0x7E, 0x00, 0x10, 0x17, 0x02, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x31, 0x02, 0x72};
+
+// set up adc on dio 2 on all xbees connected to the WPAN - Thresh Pot
+static const uint8_t init_adc_2[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x32, 0x02, 0x72};
+
+// set up Din on dio 3 on all xbees connected to the WPAN - PIR
+static const uint8_t init_dig_3[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x33, 0x03, 0x70};
+
+// set up Din on dio 4 on all xbees connected to the WPAN - Thresh button
+static const uint8_t init_dig_4[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x34, 0x03, 0x6F};
+
+static const uint8_t reset_ir_packet[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x52, 0x30, 0x1F};
+
+// sampling packet (and the one that corrects for drift)
+static const uint8_t ir_packet[] = {0x7E, 0x00, 0x11, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x52, 0x17, 0xFC, 0x3C};
+
+static const uint8_t ir_correction[] = {0x7E, 0x00, 0x11, 0x17, 0x01, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x52, 0x18, 0x06, 0x31};
+
+// sampling packets addressed to the two room nodes
+static const uint8_t ir_addr_0[] = {0x7E, 0x00, 0x11, 0x17, 0x01, 0x00, 0x13, 0xA2, 0x00,
+	0x41, 0x72, 0xFC, 0xC9, 0x79, 0x1A, 0x02, 0x49, 0x52, 0x17, 0x70, 0x03};
+
+static const uint8_t ir_addr_1[] = {0x7E, 0x00, 0x11, 0x17, 0x01, 0x00, 0x13, 0xA2, 0x00,
+	0x41, 0x5D, 0x55, 0x3B, 0xEB, 0x47, 0x02, 0x49, 0x52, 0x17, 0x70, 0xAE};
+
+// queried sampling
+static const uint8_t is_packet[] = {0x7E, 0x00, 0x0F, 0x17, 0x55, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x53, 0xFA};
+
+static const uint8_t my_packet[] = {0x7E, 0x00, 0x0F, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x02, 0x4D, 0x59, 0x43};
+
+static const uint8_t ic_packet[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x43, 0x10, 0x4E};
+
+// the action thread's template (SH filled in with the node's SL and MY, then
+// the pin, the state and the checksum)
+static const uint8_t hard_set_packet[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x13, 0xA2,
+	0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02, 0x44, 0x32, 0x04, 0x00};
+
+// HELPERS
+
+// what build_remote_at in main.c does - the parameter is the last
+// value_length bytes of value (big endian)
+static int build_remote_at(uint8_t * packet, int size, const xbee_address_t * dest,
+	uint8_t frame_id, const char * command, uint16_t value, int value_length)
+{
+	uint8_t param[2] = {value >> 8, value & 0xFF};
+	return xbee_build_remote_at(packet, size, frame_id, dest, XBEE_APPLY_CHANGES,
+		command, &param[2 - value_length], value_length);
+}
+
+static void compare(const char * what, const uint8_t * expected, int expected_length,
+	const uint8_t * built, int length)
+{
+	int i;
+
+	if(length == expected_length && memcmp(expected, built, length) == 0)
+	{
+		return;
+	}
+	errors++;
+	printf("%s doesn't match\n  expected:", what);
+	for(i = 0; i < expected_length; i++)
+	{
+		printf(" %02X", expected[i]);
+	}
+	printf("\n  built:   ");
+	for(i = 0; i < length; i++)
+	{
+		printf(" %02X", built[i]);
+	}
+	printf("\n");
+}
+
+#define CHECK_REMOTE_AT(fixture, dest, frame_id, command, value, value_length) do { \
+		uint8_t packet[64]; \
+		int length = build_remote_at(packet, sizeof(packet), dest, frame_id, command, \
+			value, value_length); \
+		compare(#fixture, fixture, sizeof(fixture), packet, length); \
+		checked++; \
+	} while(0)
+
+// TESTS
+
+// the configuration and sampling commands main.c sends
+static void test_main_packets(void)
+{
+	xbee_address_t broadcast, all_nodes, room_0, room_1;
+
+	xbee_address_init(&broadcast, XBEE_BROADCAST_64, XBEE_UNKNOWN_16);
+	xbee_address_init(&all_nodes, XBEE_BROADCAST_64, 0xFFFF);
+	xbee_address_init(&room_0, 0x0013A2004172FCC9ULL, 0x791A);
+	xbee_address_init(&room_1, 0x0013A200415D553BULL, 0xEB47);
+
+	CHECK_REMOTE_AT(init_adc_0, &broadcast, 0x01, "D0", 0x02, 1);
+	CHECK_REMOTE_AT(init_adc_1, &broadcast, 0x02, "D1", 0x02, 1);
+	CHECK_REMOTE_AT(init_adc_2, &broadcast, 0x01, "D2", 0x02, 1);
+	CHECK_REMOTE_AT(init_dig_3, &broadcast, 0x01, "D3", 0x03, 1);
+	CHECK_REMOTE_AT(init_dig_4, &broadcast, 0x01, "D4", 0x03, 1);
+	CHECK_REMOTE_AT(reset_ir_packet, &broadcast, 0x01, "IR", 0x30, 1);
+	CHECK_REMOTE_AT(ir_packet, &broadcast, 0x01, "IR", 6140, 2);
+	CHECK_REMOTE_AT(ir_correction, &broadcast, 0x01, "IR", 6150, 2);
+	CHECK_REMOTE_AT(ir_addr_0, &room_0, 0x01, "IR", 6000, 2);
+	CHECK_REMOTE_AT(ir_addr_1, &room_1, 0x01, "IR", 6000, 2);
+	CHECK_REMOTE_AT(is_packet, &broadcast, 0x55, "IS", 0, 0);
+	CHECK_REMOTE_AT(my_packet, &all_nodes, 0x01, "MY", 0, 0);
+	CHECK_REMOTE_AT(ic_packet, &broadcast, 0x01, "IC", 0x10, 1);
+	printf("main.c packets: %d checked\n", checked);
+}
+
+// the action thread's template, over a sweep of node addresses, pins and
+// states
+static void test_action_template(void)
+{
+	static const char * pins[] = {"D5", "P1", "D7"};
+	uint32_t sl;
+
+	checked = 0;
+	for(sl = 0x40000000; sl < 0x42000000; sl += 0x00012345)
+	{
+		uint16_t my = (uint16_t)(sl * 2654435761u >> 16);
+		xbee_address_t node;
+		int pin, state;
+
+		xbee_address_init(&node, 0x0013A20000000000ULL | sl, my);
+		for(pin = 0; pin < 3; pin++)
+		{
+			for(state = 0; state < 2; state++)
+			{
+				uint8_t old[20], packet[64];
+				uint16_t checksum = 0;
+				int i;
+
+				// the way the action thread used to do it
+				memcpy(old, hard_set_packet, sizeof(old));
+				old[9] = (sl >> 24) & 0xFF;
+				old[10] = (sl >> 16) & 0xFF;
+				old[11] = (sl >> 8) & 0xFF;
+				old[12] = sl & 0xFF;
+				old[13] = my >> 8;
+				old[14] = my & 0xFF;
+				old[16] = pins[pin][0];
+				old[17] = pins[pin][1];
+				old[18] = state ? XBEE_DIGITAL_HIGH : XBEE_DIGITAL_LOW;
+				for(i = 3; i < 19; i++)
+				{
+					checksum = checksum + old[i];
+				}
+				old[19] = 0xFF - (checksum & 0xFF);
+
+				int length = build_remote_at(packet, sizeof(packet), &node, 0x01, pins[pin],
+					old[18], 1);
+				compare("action thread template", old, sizeof(old), packet, length);
+				checked++;
+			}
+		}
+	}
+	printf("action thread template: %d checked\n", checked);
+}
+
+// building a frame a field at a time gives the same as the helpers, and a
+// frame that doesn't fit is refused
+static void test_builder(void)
+{
+	xbee_address_t broadcast;
+	xbee_frame_builder_t frame;
+	uint8_t packet[64];
+
+	xbee_address_init(&broadcast, XBEE_BROADCAST_64, XBEE_UNKNOWN_16);
+	xbee_frame_begin(&frame, packet, sizeof(packet), XBEE_REMOTE_AT_COMMAND);
+	xbee_frame_append_u8(&frame, 0x01);
+	xbee_frame_append_address(&frame, &broadcast);
+	xbee_frame_append_u8(&frame, XBEE_APPLY_CHANGES);
+	xbee_frame_append_bytes(&frame, (const uint8_t *)"IR", 2);
+	xbee_frame_append_u16(&frame, 6140);
+	compare("ir_packet (a field at a time)", ir_packet, sizeof(ir_packet), packet,
+		xbee_frame_end(&frame));
+
+	int length = build_remote_at(packet, sizeof(ir_packet) - 1, &broadcast, 0x01, "IR",
+		6140, 2);
+	if(length != 0)
+	{
+		printf("ir_packet built in a buffer one byte too small (length %d)\n", length);
+		errors++;
+	}
+	length = build_remote_at(packet, sizeof(ir_packet), &broadcast, 0x01, "IR", 6140, 2);
+	compare("ir_packet (exactly fitting buffer)", ir_packet, sizeof(ir_packet), packet, length);
+	printf("builder: fields and overflow checked\n");
+}
+
+int main(void)
+{
+	test_main_packets();
+	test_action_template();
+	test_builder();
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,313 @@
+/*
+ * frames_test.c
+ *
+ * a pc build of the xbee frame decoders (src/xbee_frames.c), run against
+ * frames captured from the radios - each frame has to decode to what we know
+ * is in it, and then every shorter version of it (as if it had been cut off)
+ * has to be turned away by that decoder's length check rather than read past
+ * its end
+ *
+ * each cut down frame is copied to the very end of a buffer from malloc, so
+ * building with -fsanitize=address catches a decoder that reads too far even
+ * if it gets the answer right
+ *
+ * usage: make && ./frames_test
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// include the frame decoders
+#include "xbee_frames.h"
+
+static int errors = 0;
+
+#define CHECK(condition, ...) do { \
+		if(!(condition)) \
+		{ \
+			printf("  "); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			errors++; \
+		} \
+	} while(0)
+
+// CAPTURED FRAMES
+
+// io sample from a router - two digital inputs and one analog input (AD1)
+static const uint8_t io_sample[] =
+{
+	0x7E, 0x00, 0x14, 0x92, 0x00, 0x13, 0xA2, 0x00, 0x40, 0x52, 0x2B, 0xAA, 0x7D, 0x84,
+	0x01, 0x01, 0x00, 0x1C, 0x02, 0x00, 0x14, 0x02, 0x25, 0xF5
+};
+
+// io sample with no digital inputs and all four analog inputs (the room
+// sensors)
+static const uint8_t io_sample_analog[] =
+{
+	0x7E, 0x00, 0x18, 0x92, 0x00, 0x13, 0xA2, 0x00, 0x41, 0x5B, 0x6E, 0x12, 0x3F, 0x21,
+	0x01, 0x01, 0x00, 0x00, 0x0F, 0x01, 0x9A, 0x02, 0x01, 0x00, 0x55, 0x03, 0xFF, 0x36
+};
+
+// io sample with just digital inputs
+static const uint8_t io_sample_digital[] =
+{
+	0x7E, 0x00, 0x12, 0x92, 0x00, 0x13, 0xA2, 0x00, 0x41, 0x5B, 0x6E, 0x12, 0x3F, 0x21,
+	0x01, 0x01, 0x0C, 0x00, 0x00, 0x08, 0x00, 0x26
+};
+
+// remote at response to SL
+static const uint8_t remote_at_response[] =
+{
+	0x7E, 0x00, 0x13, 0x97, 0x55, 0x00, 0x13, 0xA2, 0x00, 0x40, 0x52, 0x2B, 0xAA, 0x7D,
+	0x84, 0x53, 0x4C, 0x00, 0x40, 0x52, 0x2B, 0xAA, 0xF0
+};
+
+// remote at response to D1 (a write, so no data)
+static const uint8_t remote_at_ok[] =
+{
+	0x7E, 0x00, 0x0F, 0x97, 0x07, 0x00, 0x13, 0xA2, 0x00, 0x41, 0x5B, 0x6E, 0x12, 0x3F,
+	0x21, 0x44, 0x31, 0x00, 0xBB
+};
+
+// local at response to BD
+static const uint8_t at_response[] =
+{
+	0x7E, 0x00, 0x06, 0x88, 0x01, 0x42, 0x44, 0x00, 0x07, 0xE9
+};
+
+// transmit status
+static const uint8_t tx_status[] =
+{
+	0x7E, 0x00, 0x07, 0x8B, 0x01, 0x7D, 0x84, 0x00, 0x00, 0x01, 0x71
+};
+
+// something we don't decode (a modem status - coordinator started)
+static const uint8_t modem_status[] =
+{
+	0x7E, 0x00, 0x02, 0x8A, 0x06, 0x6F
+};
+
+// HANDLERS
+
+// the last frame handed to a handler (and how many have been)
+static union
+{
+	xbee_io_sample_t						io_sample;
+	xbee_remote_at_response_t		remote_at_response;
+	xbee_at_response_t					at_response;
+	xbee_tx_status_t						tx_status;
+	xbee_raw_frame_t						raw;
+}
+last;
+static int handled;
+
+// the data field of the last raw frame (the frame itself has gone by the time
+// we look)
+static uint8_t last_data[64];
+
+static void on_io_sample(const void * frame)
+{
+	last.io_sample = *(const xbee_io_sample_t *)frame;
+	handled++;
+}
+
+static void on_remote_at_response(const void * frame)
+{
+	last.remote_at_response = *(const xbee_remote_at_response_t *)frame;
+	handled++;
+}
+
+static void on_at_response(const void * frame)
+{
+	last.at_response = *(const xbee_at_response_t *)frame;
+	handled++;
+}
+
+static void on_tx_status(const void * frame)
+{
+	last.tx_status = *(const xbee_tx_status_t *)frame;
+	handled++;
+}
+
+static void on_raw(const void * frame)
+{
+	last.raw = *(const xbee_raw_frame_t *)frame;
+	memcpy(last_data, last.raw.data, last.raw.data_length);
+	handled++;
+}
+
+// DISPATCHING
+
+// dispatch a frame from the end of a buffer of just the right size
+static int dispatch(const uint8_t * frame, int length)
+{
+	uint8_t * copy = malloc(length > 0 ? length : 1);
+	memcpy(copy, frame, length);
+	handled = 0;
+	int result = xbee_dispatch_frame(copy, length);
+	free(copy);
+	return result;
+}
+
+// check a captured frame is complete (so we know the test is right)
+static void check_capture(const uint8_t * frame, int length, const char * what)
+{
+	uint8_t sum = 0;
+	int i;
+
+	for(i = 3; i < length; i++)
+	{
+		sum += frame[i];
+	}
+	if(((frame[1] << 8) | frame[2]) != length - 4 || sum != 0xFF)
+	{
+		printf("%s: the captured frame is wrong\n", what);
+		exit(1);
+	}
+}
+
+// every frame shorter than the decoder needs is turned away, and everything
+// from there up to the whole frame is decoded
+static void check_cut_down(const uint8_t * frame, int length, int shortest, const char * what)
+{
+	int n;
+
+	printf("%s\n", what);
+	check_capture(frame, length, what);
+	for(n = 0; n < length; n++)
+	{
+		int result = dispatch(frame, n);
+		if(n < shortest)
+		{
+			CHECK(result == -1 && handled == 0, "cut to %d bytes: got %d (expected -1)", n, result);
+		}
+		else
+		{
+			CHECK(result == 1 && handled == 1, "cut to %d bytes: got %d (expected 1)", n, result);
+		}
+	}
+
+	// and the whole frame is fine
+	int result = dispatch(frame, length);
+	CHECK(result == 1 && handled == 1, "whole frame: got %d (expected 1)", result);
+}
+
+// TESTS
+
+static void test_io_samples(void)
+{
+	// the header (13 bytes from the delimiter to the options), the sample count
+	// and the masks, the digital samples and an analog sample for AD1 - with
+	// the checksum on the end
+	check_cut_down(io_sample, sizeof(io_sample), sizeof(io_sample),
+		"io sample (digital and analog)");
+	CHECK(last.io_sample.source_64 == 0x0013A20040522BAAULL, "wrong 64 bit address");
+	CHECK(last.io_sample.source_16 == 0x7D84, "wrong 16 bit address");
+	CHECK(last.io_sample.digital_mask == 0x001C && last.io_sample.digital_samples == 0x0014,
+		"wrong digital samples");
+	CHECK(last.io_sample.analog_mask == 0x02 && last.io_sample.analog[1] == 0x0225 &&
+		last.io_sample.analog[0] == 0 && last.io_sample.analog[2] == 0,
+		"wrong analog samples");
+
+	// all four analog channels, the last one cut short (the mask says there's
+	// a sample but it isn't there)
+	check_cut_down(io_sample_analog, sizeof(io_sample_analog), sizeof(io_sample_analog),
+		"io sample (analog mask set, samples cut short)");
+	CHECK(last.io_sample.digital_mask == 0 && last.io_sample.digital_samples == 0,
+		"digital samples with no digital channels");
+	CHECK(last.io_sample.analog[0] == 0x019A && last.io_sample.analog[1] == 0x0201 &&
+		last.io_sample.analog[2] == 0x0055 && last.io_sample.analog[3] == 0x03FF,
+		"wrong analog samples");
+
+	check_cut_down(io_sample_digital, sizeof(io_sample_digital), sizeof(io_sample_digital),
+		"io sample (digital only)");
+	CHECK(last.io_sample.digital_samples == 0x0800 && last.io_sample.analog_mask == 0,
+		"wrong digital samples");
+}
+
+static void test_at_responses(void)
+{
+	// remote responses need everything up to the status - anything after that
+	// is data (so cutting it down just makes the data shorter)
+	check_cut_down(remote_at_response, sizeof(remote_at_response), 4 + 15,
+		"remote at response (SL)");
+	CHECK(last.remote_at_response.frame_id == 0x55 &&
+		last.remote_at_response.command[0] == 'S' && last.remote_at_response.command[1] == 'L',
+		"wrong frame id or command");
+	CHECK(last.remote_at_response.status == 0 && last.remote_at_response.data_length == 4,
+		"wrong status or data length (%d)", last.remote_at_response.data_length);
+
+	check_cut_down(remote_at_ok, sizeof(remote_at_ok), 4 + 15, "remote at response (D1)");
+	CHECK(last.remote_at_response.data_length == 0, "data in a response with none");
+
+	check_cut_down(at_response, sizeof(at_response), 4 + 5, "local at response (BD)");
+	CHECK(last.at_response.frame_id == 1 && last.at_response.data_length == 1,
+		"wrong frame id or data length");
+}
+
+static void test_tx_status(void)
+{
+	check_cut_down(tx_status, sizeof(tx_status), sizeof(tx_status), "transmit status");
+	CHECK(last.tx_status.dest_16 == 0x7D84 && last.tx_status.delivery_status == 0 &&
+		last.tx_status.discovery_status == 1, "wrong transmit status");
+}
+
+static void test_undecoded(void)
+{
+	// a frame type with no decoder gets the raw data field (as long as there's
+	// a frame type in it)
+	check_cut_down(modem_status, sizeof(modem_status), 5, "modem status (not decoded)");
+	CHECK(last.raw.frame_type == 0x8A && last.raw.data_length == 2 && last_data[1] == 0x06,
+		"wrong raw frame");
+
+	// and with no handler the frame isn't decoded at all (so a short one isn't
+	// an error either - unless there isn't even a frame type)
+	xbee_register_handler(XBEE_IO_SAMPLE, NULL);
+	printf("io sample with no handler\n");
+	CHECK(dispatch(io_sample, sizeof(io_sample)) == 0 && handled == 0, "io sample handled");
+	CHECK(dispatch(io_sample, 10) == 0, "short frame with no handler decoded");
+	CHECK(dispatch(io_sample, 4) == -1, "frame with no frame type not turned away");
+	xbee_register_handler(XBEE_IO_SAMPLE, on_io_sample);
+}
+
+static void test_is_response(void)
+{
+	// the data from an IS command is io sample data too
+	static const uint8_t data[] = {0x01, 0x00, 0x1C, 0x02, 0x00, 0x14, 0x02, 0x25};
+	xbee_io_sample_t sample;
+	int n;
+
+	printf("io data from an IS response\n");
+	for(n = 0; n <= (int)sizeof(data); n++)
+	{
+		uint8_t * copy = malloc(n > 0 ? n : 1);
+		memcpy(copy, data, n);
+		int result = xbee_decode_io_data(copy, n, &sample);
+		free(copy);
+		CHECK(result == (n == sizeof(data)), "%d bytes: got %d", n, result);
+	}
+	CHECK(sample.analog[1] == 0x0225, "wrong analog sample");
+}
+
+int main(void)
+{
+	xbee_register_handler(XBEE_IO_SAMPLE, on_io_sample);
+	xbee_register_handler(XBEE_REMOTE_AT_RESPONSE, on_remote_at_response);
+	xbee_register_handler(XBEE_LOCAL_AT_RESPONSE, on_at_response);
+	xbee_register_handler(XBEE_TX_STATUS, on_tx_status);
+	xbee_register_handler(0x8A, on_raw);
+
+	test_io_samples();
+	test_at_responses();
+	test_tx_status();
+	test_undecoded();
+	test_is_response();
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,422 @@
+/*
+ * log_ring_sim.c
+ *
+ * the vcom output ring buffer (src/log_ring.c) and what serial_write in
+ * src/vcom_serial.c does when it fills up:
+ *
+ * - model: random writes (some longer than the ring) and reads against a
+ *   plain list of bytes that does what log_ring.h says each policy should -
+ *   every return value, counter and byte read out has to match
+ * - vcom: the firmware's set up (a 2048 byte ring sent 64 bytes at a time
+ *   with dma at 9600 baud) with two threads printing lines and the odd big
+ *   dump, and an interrupt printing now and again, run with each policy.
+ *   every byte printed has to be sent, still waiting, or counted as dropped
+ *   or overwritten (once), threads must only be held up with LOG_RING_BLOCK,
+ *   and then they mustn't lose anything
+ *
+ * usage: make && ./log_ring_sim
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <string.h>
+
+// include the ring
+#include "log_ring.h"
+
+// the firmware's ring and chunk size (VCOM_LOG_SIZE and VCOM_LOG_CHUNK in
+// vcom_serial.h) and the vcom rate
+#define LOG_SIZE				2048
+#define LOG_CHUNK				64
+#define VCOM_BAUD				9600
+
+// the model test's ring size and how many operations it runs
+#define MODEL_SIZE			64
+#define MODEL_OPS				2000000
+
+// how long the vcom sim runs for (in ms)
+#define RUN_TIME				600000
+
+static const char * const policy_names[] = {"drop", "overwrite", "block"};
+
+static int errors = 0;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// the value of the nth byte written (so the bytes read out can be checked)
+static uint8_t byte_value(uint32_t n)
+{
+	return (uint8_t)((n * 2654435761u) >> 24);
+}
+
+// THE MODEL
+
+// what should be in the ring (oldest first, as positions in the stream)
+static uint32_t model[MODEL_SIZE];
+static uint32_t model_count;
+static log_ring_stats_t model_stats;
+
+static uint32_t model_write(log_ring_policy_t policy, uint32_t first, uint32_t length)
+{
+	uint32_t room = MODEL_SIZE - model_count;
+	uint32_t i;
+
+	if(length > room)
+	{
+		if(policy == LOG_RING_OVERWRITE)
+		{
+			// only the newest MODEL_SIZE bytes can be kept, and room is made for
+			// them by throwing away the oldest
+			uint32_t keep = (length > MODEL_SIZE) ? MODEL_SIZE : length;
+			uint32_t lose = keep - room;
+			model_stats.overwritten += (length - keep) + lose;
+			memmove(model, model + lose, (model_count - lose) * sizeof(model[0]));
+			model_count -= lose;
+			first += length - keep;
+			length = keep;
+		}
+		else
+		{
+			if(policy == LOG_RING_BLOCK)
+			{
+				model_stats.blocked++;
+			}
+			else
+			{
+				model_stats.dropped += length - room;
+			}
+			length = room;
+		}
+	}
+
+	for(i = 0; i < length; i++)
+	{
+		model[model_count++] = first + i;
+	}
+	model_stats.written += length;
+	if(model_count > model_stats.high_water)
+	{
+		model_stats.high_water = model_count;
+	}
+	return length;
+}
+
+static void run_model(log_ring_policy_t policy)
+{
+	static uint8_t buffer[MODEL_SIZE];
+	static uint8_t data[2 * MODEL_SIZE];
+	log_ring_t ring;
+	uint32_t stream = 0;
+	uint32_t n, i;
+	int problems = 0;
+
+	log_ring_init(&ring, buffer, sizeof(buffer), policy);
+	model_count = 0;
+	memset(&model_stats, 0, sizeof(model_stats));
+
+	for(n = 0; n < MODEL_OPS && problems < 10; n++)
+	{
+		uint32_t length = next_random() % (3 * MODEL_SIZE / 2 + 1);
+
+		if(next_random() % 2 == 0)
+		{
+			// write some
+			for(i = 0; i < length; i++)
+			{
+				data[i] = byte_value(stream + i);
+			}
+			uint32_t taken = log_ring_write(&ring, data, length);
+			uint32_t expected = model_write(policy, stream, length);
+			if(taken != expected)
+			{
+				printf("  %s: wrote %u and %u were taken (not %u)\n", policy_names[policy],
+					length, taken, expected);
+				problems++;
+			}
+
+			// (with LOG_RING_BLOCK the caller writes the rest later, so the stream
+			// carries on from what was taken)
+			stream += (policy == LOG_RING_BLOCK) ? taken : length;
+		}
+		else
+		{
+			// read some
+			uint32_t got = log_ring_read(&ring, data, length);
+			uint32_t expected = (length < model_count) ? length : model_count;
+			if(got != expected)
+			{
+				printf("  %s: read %u and got %u (not %u)\n", policy_names[policy], length, got,
+					expected);
+				problems++;
+			}
+			for(i = 0; i < got && i < expected; i++)
+			{
+				if(data[i] != byte_value(model[i]))
+				{
+					printf("  %s: read byte %u of the stream wrong\n", policy_names[policy],
+						model[i]);
+					problems++;
+					break;
+				}
+			}
+			memmove(model, model + expected, (model_count - expected) * sizeof(model[0]));
+			model_count -= expected;
+			model_stats.sent += expected;
+		}
+
+		if(log_ring_count(&ring) != model_count || memcmp(&ring.stats, &model_stats,
+			sizeof(model_stats)) != 0)
+		{
+			printf("  %s: the counters went wrong after %u operations\n", policy_names[policy],
+				n + 1);
+			problems++;
+		}
+	}
+
+	printf("%-10s %9u %9u %9u %9u %9u\n", policy_names[policy], ring.stats.written,
+		ring.stats.sent, ring.stats.dropped, ring.stats.overwritten, ring.stats.blocked);
+	errors += problems;
+}
+
+// THE VCOM SIM
+
+// the ring and the uart
+static uint8_t log_buffer[LOG_SIZE];
+static log_ring_t vcom_log;
+static uint8_t tx_chunk[LOG_CHUNK];
+static uint32_t tx_length;
+static uint32_t tx_done;						// when the chunk going out finishes (in us)
+
+// when each byte in the ring was printed (in the same place as the byte)
+static uint32_t printed_at[LOG_SIZE];
+
+static uint32_t now_us;
+static uint32_t worst_latency;
+
+// vcom_tx_kick - start the next chunk if the uart isn't busy
+static void tx_kick(void)
+{
+	if(tx_length == 0)
+	{
+		uint32_t tail = vcom_log.tail;
+		uint32_t i;
+
+		tx_length = log_ring_read(&vcom_log, tx_chunk, sizeof(tx_chunk));
+		if(tx_length > 0)
+		{
+			tx_done = now_us + (uint32_t)((uint64_t)tx_length * 10 * 1000000 / VCOM_BAUD);
+		}
+		for(i = 0; i < tx_length; i++)
+		{
+			uint32_t latency = now_us - printed_at[(tail + i) & (LOG_SIZE - 1)];
+			if(latency > worst_latency)
+			{
+				worst_latency = latency;
+			}
+		}
+	}
+}
+
+// vcom_tx_complete
+static void tx_complete(void)
+{
+	tx_length = 0;
+	tx_kick();
+}
+
+// a thread (or the interrupt) printing
+typedef struct
+{
+	const char *	name;
+	int						interrupt;
+	uint32_t			line;					// the length of each line
+	uint32_t			every;				// ms between lines (on average)
+	uint32_t			dump;					// and every so often a big dump of this many bytes
+	uint32_t			dump_every;		// (every this many ms)
+
+	// what it's in the middle of printing
+	uint32_t			left;
+	uint32_t			next;
+	uint32_t			next_dump;
+	uint32_t			started;			// when it started (in ms)
+
+	// what happened
+	uint32_t			printed;
+	uint32_t			waits;
+	uint32_t			worst_wait;		// the longest a line or dump took to print (in ms)
+}
+sim_printer_t;
+
+// serial_write for one character - returns 0 if the thread has to wait a ms
+// and try again
+static int serial_write(sim_printer_t * printer)
+{
+	uint32_t head = vcom_log.head;
+	int done = log_ring_putc(&vcom_log, 'x', !printer->interrupt);
+	if(vcom_log.head != head)
+	{
+		printed_at[head & (LOG_SIZE - 1)] = now_us;
+	}
+	tx_kick();
+	return done;
+}
+
+static void run_vcom(log_ring_policy_t policy)
+{
+	sim_printer_t printers[] =
+	{
+		{"rx thread",	0, 48, 120, 0, 0},
+		{"main",			0, 60, 250, 2500, 8000},
+		{"interrupt",	1, 34, 3000, 0, 0},
+	};
+	const int num_printers = sizeof(printers) / sizeof(printers[0]);
+	uint32_t offered = 0, interrupt_lost = 0;
+	uint32_t ms;
+	int i;
+
+	log_ring_init(&vcom_log, log_buffer, sizeof(log_buffer), policy);
+	tx_length = 0;
+	worst_latency = 0;
+
+	for(ms = 0; ms < RUN_TIME; ms++)
+	{
+		for(i = 0; i < num_printers; i++)
+		{
+			sim_printer_t * p = &printers[i];
+
+			// time for something new?
+			if(p->left == 0 && ms >= p->next)
+			{
+				p->started = ms;
+				p->next = ms + 1 + next_random() % (2 * p->every);
+				if(p->dump > 0 && ms >= p->next_dump)
+				{
+					p->left = p->dump;
+					p->next_dump = ms + p->dump_every;
+				}
+				else
+				{
+					p->left = p->line;
+				}
+			}
+
+			// print it (a character at a time, until it has to wait)
+			while(p->left > 0)
+			{
+				now_us = ms * 1000;
+				uint32_t dropped = vcom_log.stats.dropped;
+				if(!serial_write(p))
+				{
+					p->waits++;
+					break;
+				}
+				if(p->interrupt)
+				{
+					interrupt_lost += vcom_log.stats.dropped - dropped;
+				}
+				p->left--;
+				p->printed++;
+				offered++;
+				if(p->left == 0 && ms - p->started > p->worst_wait)
+				{
+					p->worst_wait = ms - p->started;
+				}
+			}
+		}
+
+		// the uart sends for a ms
+		now_us = ms * 1000;
+		while(tx_length > 0 && tx_done <= now_us + 1000)
+		{
+			now_us = tx_done;
+			tx_complete();
+		}
+	}
+
+	// let it all go out
+	while(tx_length > 0)
+	{
+		now_us = tx_done;
+		tx_complete();
+	}
+
+	const log_ring_stats_t * s = &vcom_log.stats;
+	printf("%-10s %8u %8u %8u %8u %8u %8u %6u %6u %6u %8.1f\n", policy_names[policy], offered,
+		s->sent, s->dropped, s->overwritten, interrupt_lost, printers[0].waits + printers[1].waits,
+		printers[0].worst_wait, printers[1].worst_wait, s->high_water, worst_latency / 1000.0);
+
+	// every byte printed is accounted for once
+	if(s->sent + log_ring_count(&vcom_log) + s->dropped + s->overwritten != offered ||
+		log_ring_count(&vcom_log) != 0)
+	{
+		printf("  %u printed, %u sent, %u dropped, %u overwritten\n", offered, s->sent,
+			s->dropped, s->overwritten);
+		errors++;
+	}
+
+	// only LOG_RING_BLOCK holds threads up (and then they don't lose anything)
+	if(policy != LOG_RING_BLOCK && (printers[0].waits != 0 || printers[1].waits != 0))
+	{
+		printf("  threads held up %u times\n", printers[0].waits + printers[1].waits);
+		errors++;
+	}
+	if(policy == LOG_RING_BLOCK && s->dropped != interrupt_lost)
+	{
+		printf("  threads lost %u bytes\n", s->dropped - interrupt_lost);
+		errors++;
+	}
+
+	// the interrupt never waits
+	if(printers[2].waits != 0)
+	{
+		printf("  the interrupt waited\n");
+		errors++;
+	}
+
+	// and the workload has to be more than the ring can take, or none of this
+	// has been tried
+	if(s->dropped + s->overwritten + s->blocked == 0)
+	{
+		printf("  the ring never filled up\n");
+		errors++;
+	}
+}
+
+int main(void)
+{
+	int policy;
+
+	printf("model (a %d byte ring, %d operations)\n\n", MODEL_SIZE, MODEL_OPS);
+	printf("%-10s %9s %9s %9s %9s %9s\n", "", "written", "sent", "dropped", "overwrit",
+		"blocked");
+	for(policy = LOG_RING_DROP; policy <= LOG_RING_BLOCK; policy++)
+	{
+		run_model((log_ring_policy_t)policy);
+	}
+
+	printf("\nvcom (a %d byte ring at %d baud, %d s)\n\n", LOG_SIZE, VCOM_BAUD,
+		RUN_TIME / 1000);
+	printf("%-10s %8s %8s %8s %8s %8s %8s %6s %6s %6s %8s\n", "", "printed", "sent",
+		"dropped", "overwrit", "irq lost", "waits", "rx", "main", "high", "latency");
+	for(policy = LOG_RING_DROP; policy <= LOG_RING_BLOCK; policy++)
+	{
+		run_vcom((log_ring_policy_t)policy);
+	}
+	printf("\nirq lost: bytes the interrupt printed that were thrown away, waits: ms the "
+		"threads\nwaited for room, rx, main: the longest each thread took to print a line "
+		"(or a\ndump) in ms, latency: the longest a byte took from being printed to going "
+		"out (ms)\n");
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
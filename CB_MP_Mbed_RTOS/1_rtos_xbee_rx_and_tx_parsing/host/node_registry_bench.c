@@ -0,0 +1,184 @@
+/*
+ * node_registry_bench.c
+ *
+ * a pc build of the node registry - checks it against a plain list of nodes
+ * (with nodes rejoining under new network addresses as we go) and then times
+ * the lookups at 2, 64 and 512 nodes, against the linear search the threads
+ * used to do
+ *
+ * usage: make && ./node_registry_bench
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// include the node registry
+#include "node_registry.h"
+
+// how many lookups to time
+#define LOOKUPS 4000000
+
+// the registry (and the plain list of addresses we check it against)
+static node_registry_t registry;
+static uint16_t my_list[NODE_REGISTRY_SIZE];
+static uint64_t serial_list[NODE_REGISTRY_SIZE];
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// the time now in nanoseconds
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// find a network address the old way
+static int linear_find(uint16_t my_address, int count)
+{
+	int i;
+	for(i = 0; i < count; i++)
+	{
+		if(my_list[i] == my_address)
+		{
+			break;
+		}
+	}
+	return i;
+}
+
+// a network address that nothing has yet (and isn't one of the special ones)
+static uint16_t unused_my(int count)
+{
+	while(1)
+	{
+		uint16_t my_address = next_random() & 0xFFFF;
+		if(my_address != 0 && my_address < NODE_UNKNOWN_MY &&
+			linear_find(my_address, count) == count)
+		{
+			return my_address;
+		}
+	}
+}
+
+// fill the registry with nodes, moving some of them to new addresses as we
+// go, and check every lookup agrees with the plain list
+static int fill(int count)
+{
+	int i, j, errors = 0;
+
+	node_registry_init(&registry);
+	for(i = 0; i < count; i++)
+	{
+		serial_list[i] = 0x0013A20000000000ULL | next_random();
+		my_list[i] = unused_my(i);
+		if(node_registry_add(&registry, serial_list[i], my_list[i]) != i)
+		{
+			errors++;
+		}
+
+		// every so often a node rejoins with a new address
+		if(i > 0 && (next_random() % 4) == 0)
+		{
+			j = next_random() % i;
+			my_list[j] = unused_my(i + 1);
+			if(node_registry_add(&registry, serial_list[j], my_list[j]) != j)
+			{
+				errors++;
+			}
+		}
+
+		for(j = 0; j <= i; j++)
+		{
+			if(node_registry_find_my(&registry, my_list[j]) != j ||
+				node_registry_find_serial(&registry, serial_list[j]) != j)
+			{
+				errors++;
+			}
+		}
+	}
+	if(node_registry_find_my(&registry, unused_my(count)) != NODE_NONE ||
+		node_registry_find_serial(&registry, 0x0013A200FFFFFFFFULL ^ next_random()) != NODE_NONE)
+	{
+		errors++;
+	}
+	return errors;
+}
+
+int main(void)
+{
+	static const int sizes[] = {2, 64, 512};
+	static uint16_t keys[1024];
+	int s, i;
+	volatile int sink = 0;
+
+	printf("%6s %12s %12s %12s %12s\n", "nodes", "hash (ns)", "probes", "linear (ns)",
+		"miss (ns)");
+	for(s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+	{
+		int count = sizes[s];
+		double start, hashed, linear, miss, probes;
+
+		if(count > NODE_REGISTRY_SIZE)
+		{
+			printf("%6d (bigger than NODE_REGISTRY_SIZE)\n", count);
+			continue;
+		}
+		if(fill(count) != 0)
+		{
+			printf("%6d lookups didn't match the list!\n", count);
+			return 1;
+		}
+
+		// look up the nodes in a random order (the same for both ways)
+		for(i = 0; i < 1024; i++)
+		{
+			keys[i] = my_list[next_random() % count];
+		}
+
+		registry.stats.lookups = 0;
+		registry.stats.probes = 0;
+		start = now();
+		for(i = 0; i < LOOKUPS; i++)
+		{
+			sink += node_registry_find_my(&registry, keys[i & 1023]);
+		}
+		hashed = (now() - start) / LOOKUPS;
+		probes = (double)registry.stats.probes / registry.stats.lookups;
+
+		start = now();
+		for(i = 0; i < LOOKUPS; i++)
+		{
+			sink += linear_find(keys[i & 1023], count);
+		}
+		linear = (now() - start) / LOOKUPS;
+
+		// and frames from nodes we don't know
+		for(i = 0; i < 1024; i++)
+		{
+			keys[i] = unused_my(count);
+		}
+		start = now();
+		for(i = 0; i < LOOKUPS; i++)
+		{
+			sink += node_registry_find_my(&registry, keys[i & 1023]);
+		}
+		miss = (now() - start) / LOOKUPS;
+
+		printf("%6d %12.1f %12.2f %12.1f %12.1f\n", count, hashed, probes, linear,
+			miss);
+	}
+	return 0;
+}
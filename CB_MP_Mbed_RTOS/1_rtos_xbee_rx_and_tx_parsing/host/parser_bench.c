@@ -0,0 +1,276 @@
+/*
+ * parser_bench.c
+ *
+ * a pc build of the xbee packet parser (src/xbee_packet_parser.c) - replays a
+ * recorded byte stream through it in the bursts the dma hands the rx thread,
+ * and reports the frames parsed per second and the bytes copied per frame,
+ * both reading frames in place (the frame descriptors) and copying each one
+ * out of the ring first (what get_packet used to do)
+ *
+ * the stream is either raw captures of the xbee uart given on the command
+ * line or, with no arguments, a stream made up of the traffic the
+ * coordinator sees (io samples from the rooms, remote at responses and
+ * transmit status frames, with a bit of line noise between them)
+ *
+ * usage: make && ./parser_bench [capture.bin ...]
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// include the parser
+#include "xbee_packet_parser.h"
+#include "itm_debug.h"
+#include "cmsis_os.h"
+
+// how big a made up stream is, how many times to replay it and how many bytes
+// the dma hands over at a time
+#define STREAM_SIZE		(256 * 1024)
+#define REPLAYS				20
+#define BURST_SIZE		64
+
+// what the rest of the firmware would provide
+uint32_t osKernelSysTick(void)
+{
+	return 0;
+}
+
+int itm_send(uint32_t channel, itm_event_t event, const uint32_t * words, uint32_t count)
+{
+	return 1;
+}
+
+// the stream being replayed
+static uint8_t * stream;
+static size_t stream_length;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// the time now in nanoseconds
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// STREAM
+
+// add a frame (with its header and checksum) to the end of the stream
+static void add_frame(const uint8_t * data, int length)
+{
+	uint8_t sum = 0;
+	int i;
+
+	stream[stream_length++] = 0x7e;
+	stream[stream_length++] = length >> 8;
+	stream[stream_length++] = length & 0xFF;
+	for(i = 0; i < length; i++)
+	{
+		stream[stream_length++] = data[i];
+		sum += data[i];
+	}
+	stream[stream_length++] = 0xFF - sum;
+}
+
+// make up a stream of what the coordinator sees
+static void make_stream(void)
+{
+	uint8_t data[64];
+	int i;
+
+	stream = malloc(STREAM_SIZE);
+	stream_length = 0;
+	while(stream_length < STREAM_SIZE - 128)
+	{
+		uint32_t r = next_random() % 16;
+		if(r < 10)
+		{
+			// an io sample (0x92) with two digital and two analog channels
+			data[0] = 0x92;
+			for(i = 1; i < 16; i++)
+			{
+				data[i] = next_random();
+			}
+			data[12] = 0x01;
+			data[13] = 0x00;
+			data[14] = 0x18;
+			data[15] = 0x03;
+			for(i = 16; i < 22; i++)
+			{
+				data[i] = next_random();
+			}
+			add_frame(data, 22);
+		}
+		else if(r < 13)
+		{
+			// a remote at command response (0x97)
+			data[0] = 0x97;
+			for(i = 1; i < 15; i++)
+			{
+				data[i] = next_random();
+			}
+			data[14] = 0x00;
+			add_frame(data, 15);
+		}
+		else if(r < 15)
+		{
+			// a transmit status (0x8B)
+			data[0] = 0x8b;
+			for(i = 1; i < 7; i++)
+			{
+				data[i] = next_random();
+			}
+			add_frame(data, 7);
+		}
+		else
+		{
+			// a few bytes of noise (from the radio being reset, say)
+			int noise = 1 + next_random() % 6;
+			for(i = 0; i < noise; i++)
+			{
+				stream[stream_length++] = next_random();
+			}
+		}
+	}
+}
+
+// read a capture in
+static void load_stream(int count, char ** files)
+{
+	int i;
+
+	stream = NULL;
+	stream_length = 0;
+	for(i = 0; i < count; i++)
+	{
+		FILE * f = fopen(files[i], "rb");
+		if(f == NULL)
+		{
+			perror(files[i]);
+			exit(1);
+		}
+		fseek(f, 0, SEEK_END);
+		long size = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		stream = realloc(stream, stream_length + size);
+		if(fread(stream + stream_length, 1, size, f) != (size_t)size)
+		{
+			perror(files[i]);
+			exit(1);
+		}
+		stream_length += size;
+		fclose(f);
+	}
+}
+
+// BENCHMARK
+
+// replay the stream, reading each frame in place or copying it out first -
+// returns the number of frames
+static uint32_t replay(xbee_parser_t * parser, int copy_out, uint64_t * copied,
+	uint32_t * check)
+{
+	static uint8_t packet[RING_SIZE];
+	uint32_t frames = 0;
+	int r;
+
+	init_parser(parser);
+	*copied = 0;
+	*check = 0;
+	for(r = 0; r < REPLAYS; r++)
+	{
+		size_t pos = 0;
+		while(pos < stream_length)
+		{
+			size_t burst = stream_length - pos;
+			if(burst > BURST_SIZE)
+			{
+				burst = BURST_SIZE;
+			}
+
+			// hand the burst to the parser, taking frames out as they fill the
+			// slots (like the rx thread does)
+			size_t done = 0;
+			while(done < burst)
+			{
+				int found;
+				done += xbee_parse_bytes(parser, &stream[pos + done], burst - done, &found);
+
+				xbee_frame_t frame;
+				while(xbee_get_frame(parser, &frame))
+				{
+					const uint8_t * data = xbee_frame_data(parser, &frame);
+
+					// the parser has copied the frame into the ring once
+					*copied += frame.length;
+					if(copy_out)
+					{
+						memcpy(packet, data, frame.length);
+						data = packet;
+						*copied += frame.length;
+					}
+
+					// look at the frame (so the reads aren't optimised away)
+					*check += data[3] + data[frame.length - 1];
+					xbee_release_frame(parser);
+					frames++;
+				}
+			}
+			pos += burst;
+		}
+	}
+	return frames;
+}
+
+static void bench(int copy_out)
+{
+	static xbee_parser_t parser;
+	xbee_parser_stats_t stats;
+	uint64_t copied;
+	uint32_t check;
+
+	double start = now();
+	uint32_t frames = replay(&parser, copy_out, &copied, &check);
+	double time = now() - start;
+
+	xbee_get_stats(&parser, &stats);
+	printf("%-24s %8u frames  %6.2f M frames/s  %5.1f bytes copied per frame "
+		"(%u bad checksums, %u bytes dropped)\n",
+		copy_out ? "copy out (get_packet):" : "in place (descriptors):",
+		frames, frames * 1e3 / time, (double)copied / frames, stats.bad_checksums,
+		stats.dropped_bytes);
+}
+
+int main(int argc, char ** argv)
+{
+	if(argc > 1)
+	{
+		load_stream(argc - 1, &argv[1]);
+	}
+	else
+	{
+		make_stream();
+	}
+	printf("stream: %zu bytes, replayed %d times in %d byte bursts\n", stream_length,
+		REPLAYS, BURST_SIZE);
+
+	bench(0);
+	bench(1);
+
+	free(stream);
+	return 0;
+}
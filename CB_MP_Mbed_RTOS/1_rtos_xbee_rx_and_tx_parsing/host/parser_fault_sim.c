@@ -0,0 +1,219 @@
+/*
+ * parser_fault_sim.c
+ *
+ * how well the xbee packet parser (src/xbee_packet_parser.c) recovers from a
+ * damaged byte stream - frames have bits flipped, get cut short (the rest of
+ * the frame never arrives) and have line noise between them, and we count
+ * how many of the frames that weren't damaged still come out of the parser
+ * (a bad frame that takes a good one down with it is what the resync is there
+ * to stop), and how many damaged frames get through
+ *
+ * each frame carries a sequence number, so what comes out of the parser can
+ * be matched up with what went in. the stream is parsed both a byte at a time
+ * and through the bulk path, at a range of fault rates
+ *
+ * usage: make && ./parser_fault_sim
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// include the parser
+#include "xbee_packet_parser.h"
+#include "itm_debug.h"
+#include "cmsis_os.h"
+
+// how many frames go through at each fault rate
+#define FRAMES		50000
+
+// what the rest of the firmware would provide
+uint32_t osKernelSysTick(void)
+{
+	return 0;
+}
+
+int itm_send(uint32_t channel, itm_event_t event, const uint32_t * words, uint32_t count)
+{
+	return 1;
+}
+
+// the frames as they were sent (each one at its own place in sent) and the
+// stream as it arrived
+static uint8_t sent[FRAMES][72];
+static uint8_t sent_length[FRAMES];
+static uint8_t damaged[FRAMES];
+static uint8_t seen[FRAMES];
+static uint8_t stream[FRAMES * 96];
+static size_t stream_length;
+
+static xbee_parser_t parser;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// a fault rate (as a number per thousand frames)
+typedef struct
+{
+	int flip;				// frames with a bit flipped
+	int cut;				// frames cut short
+	int noise;			// frames with a burst of noise in front of them
+}
+fault_rate_t;
+
+// make the stream, damaging frames as we go
+static void make_stream(const fault_rate_t * rate)
+{
+	int n, i;
+
+	stream_length = 0;
+	for(n = 0; n < FRAMES; n++)
+	{
+		uint8_t * frame = sent[n];
+		int data_length = 8 + next_random() % 56;
+		uint8_t sum = 0;
+
+		// an io sample sized frame, with the sequence number in it
+		frame[0] = 0x7e;
+		frame[1] = 0;
+		frame[2] = data_length;
+		frame[3] = 0x90;
+		frame[4] = n >> 24;
+		frame[5] = n >> 16;
+		frame[6] = n >> 8;
+		frame[7] = n;
+		for(i = 8; i < 3 + data_length; i++)
+		{
+			frame[i] = next_random();
+		}
+		for(i = 3; i < 3 + data_length; i++)
+		{
+			sum += frame[i];
+		}
+		frame[3 + data_length] = 0xFF - sum;
+		sent_length[n] = data_length + 4;
+		damaged[n] = 0;
+		seen[n] = 0;
+
+		// noise on the line before it (which can have a delimiter in it)
+		if(next_random() % 1000 < (uint32_t)rate->noise)
+		{
+			int noise = 1 + next_random() % 8;
+			for(i = 0; i < noise; i++)
+			{
+				stream[stream_length++] = next_random();
+			}
+		}
+
+		// the frame, with a bit flipped or cut short
+		uint8_t * out = &stream[stream_length];
+		int length = sent_length[n];
+		memcpy(out, frame, length);
+		if(next_random() % 1000 < (uint32_t)rate->flip)
+		{
+			out[next_random() % length] ^= 1 << (next_random() % 8);
+			damaged[n] = 1;
+		}
+		if(next_random() % 1000 < (uint32_t)rate->cut)
+		{
+			length = 1 + next_random() % (length - 1);
+			damaged[n] = 1;
+		}
+		stream_length += length;
+	}
+}
+
+// parse the stream and match up what comes out with what was sent
+static void run(const fault_rate_t * rate, int bulk)
+{
+	xbee_parser_stats_t stats;
+	xbee_frame_t frame;
+	uint32_t good = 0, good_out = 0, bad_out = 0;
+	size_t pos = 0;
+	int n;
+
+	init_parser(&parser);
+	while(pos < stream_length)
+	{
+		if(bulk)
+		{
+			size_t end = (stream_length - pos > 64) ? pos + 64 : stream_length;
+			pos += xbee_parse_bytes(&parser, &stream[pos], end - pos, NULL);
+		}
+		else
+		{
+			xbee_parse_packet(&parser, stream[pos++]);
+		}
+
+		while(xbee_get_frame(&parser, &frame))
+		{
+			const uint8_t * data = xbee_frame_data(&parser, &frame);
+			uint32_t seq = (frame.length >= 8) ?
+				(uint32_t)((data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7]) : FRAMES;
+			if(seq < FRAMES && frame.length == sent_length[seq] &&
+				memcmp(data, sent[seq], frame.length) == 0)
+			{
+				seen[seq] = 1;
+			}
+			else
+			{
+				// a damaged frame that passed its checksum (or a frame made up of
+				// noise that happened to)
+				bad_out++;
+			}
+			xbee_release_frame(&parser);
+		}
+	}
+
+	for(n = 0; n < FRAMES; n++)
+	{
+		good += !damaged[n];
+		good_out += !damaged[n] && seen[n];
+		seen[n] = 0;
+	}
+
+	xbee_get_stats(&parser, &stats);
+	printf("%5d %5d %5d  %-8s %6u %8.2f%% %8u %8u %8u %8u %10u\n", rate->flip, rate->cut,
+		rate->noise, bulk ? "bulk" : "per byte", FRAMES - good, 100.0 * good_out / good,
+		bad_out, stats.bad_checksums, stats.resyncs, stats.ring_full, stats.dropped_bytes);
+}
+
+int main(void)
+{
+	static const fault_rate_t rates[] =
+	{
+		{0, 0, 0},
+		{1, 0, 0},
+		{0, 1, 0},
+		{0, 0, 10},
+		{10, 10, 10},
+		{50, 50, 50},
+		{200, 200, 200},
+	};
+	unsigned int r;
+
+	printf("%d frames at each rate (faults per thousand frames)\n\n", FRAMES);
+	printf("%5s %5s %5s  %-8s %6s %9s %8s %8s %8s %8s %10s\n", "flip", "cut", "noise",
+		"path", "broken", "good out", "bad out", "checksum", "resyncs", "too long", "dropped");
+	for(r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+	{
+		make_stream(&rates[r]);
+		run(&rates[r], 0);
+		run(&rates[r], 1);
+	}
+	printf("\nbroken: frames damaged on the way, good out: the undamaged frames that "
+		"came out of\nthe parser, bad out: damaged frames (or noise) that passed "
+		"the checksum,\ntoo long: lengths (from noise or a flipped bit) too "
+		"long for the ring\n");
+	return 0;
+}
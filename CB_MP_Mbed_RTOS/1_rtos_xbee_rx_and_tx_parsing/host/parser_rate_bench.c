@@ -0,0 +1,168 @@
+/*
+ * parser_rate_bench.c
+ *
+ * compare the bulk path of the xbee packet parser (xbee_parse_bytes) with
+ * running the state machine a byte at a time (xbee_parse_packet) at the input
+ * rates of a 9600, 115200 and 921600 baud link
+ *
+ * at each rate the rx thread gets whatever has arrived in the last
+ * millisecond (one kernel tick) in one go - about 1, 12 and 92 bytes - so the
+ * slower the link the smaller the spans the bulk path gets to work on. for
+ * each rate this prints the time per byte both ways and the share of the cpu
+ * parsing would take to keep up (this is the pc's cpu, so it's the ratio
+ * between the two that counts)
+ *
+ * usage: make && ./parser_rate_bench
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// include the parser
+#include "xbee_packet_parser.h"
+#include "itm_debug.h"
+#include "cmsis_os.h"
+
+// how long the stream is and how many times to go through it
+#define STREAM_SIZE		(64 * 1024)
+#define REPLAYS				50
+
+// what the rest of the firmware would provide
+uint32_t osKernelSysTick(void)
+{
+	return 0;
+}
+
+int itm_send(uint32_t channel, itm_event_t event, const uint32_t * words, uint32_t count)
+{
+	return 1;
+}
+
+// the stream (io samples with a few bytes of noise between some of them)
+static uint8_t stream[STREAM_SIZE];
+static size_t stream_length;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// the time now in nanoseconds
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void make_stream(void)
+{
+	int i;
+
+	while(stream_length < STREAM_SIZE - 64)
+	{
+		uint8_t sum = 0;
+		stream[stream_length++] = 0x7e;
+		stream[stream_length++] = 0;
+		stream[stream_length++] = 22;
+		for(i = 0; i < 22; i++)
+		{
+			uint8_t c = (i == 0) ? 0x92 : next_random();
+			stream[stream_length++] = c;
+			sum += c;
+		}
+		stream[stream_length++] = 0xFF - sum;
+
+		if(next_random() % 8 == 0)
+		{
+			stream[stream_length++] = next_random() | 0x80;
+		}
+	}
+}
+
+// go through the stream in spans of a given size, a byte at a time or in bulk
+// - returns the time per byte (in ns)
+static double parse(size_t span, int bulk, uint32_t * frames)
+{
+	static xbee_parser_t parser;
+	xbee_frame_t frame;
+	int r;
+
+	init_parser(&parser);
+	*frames = 0;
+	double start = now();
+	for(r = 0; r < REPLAYS; r++)
+	{
+		size_t pos;
+		for(pos = 0; pos < stream_length; pos += span)
+		{
+			size_t n = (stream_length - pos < span) ? stream_length - pos : span;
+			size_t done = 0;
+			while(done < n)
+			{
+				if(bulk)
+				{
+					done += xbee_parse_bytes(&parser, &stream[pos + done], n - done, NULL);
+				}
+				else
+				{
+					xbee_parse_packet(&parser, stream[pos + done++]);
+				}
+
+				// the rx thread hands the frames on as they complete
+				while(xbee_get_frame(&parser, &frame))
+				{
+					xbee_release_frame(&parser);
+					(*frames)++;
+				}
+			}
+		}
+	}
+	return (now() - start) / ((double)stream_length * REPLAYS);
+}
+
+int main(void)
+{
+	static const uint32_t rates[] = {9600, 115200, 921600};
+	int i;
+
+	make_stream();
+	printf("stream: %zu bytes of io samples, parsed %d times\n", stream_length, REPLAYS);
+	printf("%8s %6s %14s %14s %8s %10s %10s\n", "baud", "span", "per byte ns", "bulk ns",
+		"speed up", "cpu (byte)", "cpu (bulk)");
+
+	for(i = 0; i < 3; i++)
+	{
+		// ten bits on the line for each byte, and one span each millisecond
+		double bytes_per_second = rates[i] / 10.0;
+		size_t span = (size_t)(bytes_per_second / 1000 + 0.5);
+		if(span == 0)
+		{
+			span = 1;
+		}
+
+		uint32_t frames_byte, frames_bulk;
+		double per_byte = parse(span, 0, &frames_byte);
+		double bulk = parse(span, 1, &frames_bulk);
+		if(frames_byte != frames_bulk)
+		{
+			printf("the two paths found different frames (%u and %u)\n", frames_byte,
+				frames_bulk);
+			return 1;
+		}
+
+		printf("%8u %6zu %14.2f %14.2f %7.2fx %9.4f%% %9.4f%%\n", rates[i], span, per_byte,
+			bulk, per_byte / bulk, per_byte * bytes_per_second / 1e7,
+			bulk * bytes_per_second / 1e7);
+	}
+	return 0;
+}
@@ -0,0 +1,366 @@
+/*
+ * parser_test.c
+ *
+ * regression vectors for where the xbee packet parser (src/xbee_packet_parser.c)
+ * puts frames in its ring buffer - each one is run through the state machine a
+ * byte at a time and through the bulk path:
+ *
+ * - a frame that ends exactly at the end of the ring (and the next one going
+ *   back to the start)
+ * - data fields longer than 255 bytes (so the length needs both bytes), and
+ *   one too long for the ring at all
+ * - a frame that has to wrap round to the start of the ring while other frames
+ *   are still waiting to be processed (and one that won't fit until they've
+ *   gone)
+ * - a stray delimiter whose "frame" fails its checksum but has real frames in
+ *   it (the rescan queues them, and every one has to be counted - even when
+ *   there are more than there are frame slots)
+ *
+ * usage: make && ./parser_test
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <string.h>
+
+// include the parser
+#include "xbee_packet_parser.h"
+#include "itm_debug.h"
+#include "cmsis_os.h"
+
+// what the rest of the firmware would provide
+uint32_t osKernelSysTick(void)
+{
+	return 0;
+}
+
+int itm_send(uint32_t channel, itm_event_t event, const uint32_t * words, uint32_t count)
+{
+	return 1;
+}
+
+static xbee_parser_t parser;
+static int bulk;
+static int reported;
+static int errors = 0;
+
+#define CHECK(condition, ...) do { \
+		if(!(condition)) \
+		{ \
+			printf("  %s: ", bulk ? "bulk" : "per byte"); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			errors++; \
+		} \
+	} while(0)
+
+// build a frame with a data field of a given length (filled from a seed, so
+// each frame is different) - returns the frame length
+static int make_frame(uint8_t * frame, int data_length, uint8_t seed)
+{
+	uint8_t sum = 0;
+	int i;
+
+	frame[0] = 0x7e;
+	frame[1] = data_length >> 8;
+	frame[2] = data_length & 0xFF;
+	for(i = 0; i < data_length; i++)
+	{
+		// keep delimiters out of the data so nothing resyncs on them
+		uint8_t c = (i == 0) ? 0x90 : (uint8_t)(seed + i * 7);
+		if(c == 0x7e)
+		{
+			c = 0x7f;
+		}
+		frame[3 + i] = c;
+		sum += c;
+	}
+	frame[3 + data_length] = 0xFF - sum;
+	return data_length + 4;
+}
+
+// give the parser some bytes - returns how many it took (and adds up how many
+// frames it said it completed)
+static size_t feed(const uint8_t * buf, size_t n)
+{
+	if(bulk)
+	{
+		int frames;
+		size_t taken = xbee_parse_bytes(&parser, buf, n, &frames);
+		reported += frames;
+		return taken;
+	}
+
+	// a byte at a time the parser can't hold anything back - a frame it has no
+	// room for is dropped
+	size_t i;
+	for(i = 0; i < n; i++)
+	{
+		reported += xbee_parse_packet(&parser, buf[i]);
+	}
+	return n;
+}
+
+// check the oldest waiting frame is the one we expect (and where we expect)
+static void check_frame(const uint8_t * expected, int length, int offset, const char * what)
+{
+	xbee_frame_t frame;
+
+	if(!xbee_get_frame(&parser, &frame))
+	{
+		CHECK(0, "%s: no frame waiting", what);
+		return;
+	}
+	CHECK(frame.length == length, "%s: length %d (expected %d)", what, frame.length, length);
+	CHECK(offset < 0 || frame.offset == offset, "%s: at %d (expected %d)", what,
+		frame.offset, offset);
+	CHECK(frame.offset + frame.length <= RING_SIZE, "%s: runs off the end of the ring", what);
+	CHECK(frame.length == length &&
+		memcmp(xbee_frame_data(&parser, &frame), expected, length) == 0,
+		"%s: contents don't match", what);
+}
+
+// VECTORS
+
+// a frame that finishes on the very last byte of the ring
+static void test_ring_end(void)
+{
+	static uint8_t first[32], last[RING_SIZE], next[32];
+	int first_length = make_frame(first, 20, 1);
+	int last_length = make_frame(last, RING_SIZE - first_length - 4, 2);
+	int next_length = make_frame(next, 6, 3);
+
+	// keep the first frame waiting so the ring doesn't start again from the
+	// beginning, then fill it to the end exactly
+	init_parser(&parser);
+	feed(first, first_length);
+	feed(last, last_length);
+	CHECK(parser.buffer.ring_head == RING_SIZE, "ring head at %d after the last frame",
+		parser.buffer.ring_head);
+	CHECK(parser.queue.num_frames == 2, "%d frames waiting (expected 2)",
+		parser.queue.num_frames);
+	check_frame(first, first_length, 0, "first frame");
+	xbee_release_frame(&parser);
+	check_frame(last, last_length, first_length, "frame at the end of the ring");
+
+	// the next one has to go back to the start (the frame at the end is still
+	// waiting)
+	CHECK(feed(next, next_length) == next_length, "next frame not taken");
+	xbee_release_frame(&parser);
+	check_frame(next, next_length, 0, "frame after the end of the ring");
+	xbee_release_frame(&parser);
+	CHECK(parser.stats.frames_ok == 3 && parser.stats.ring_full == 0,
+		"%u frames ok, %u dropped", parser.stats.frames_ok, parser.stats.ring_full);
+}
+
+// frames whose length needs both bytes of the length field
+static void test_long_frames(void)
+{
+	static uint8_t frame[RING_SIZE + 64], small[32];
+	static const int lengths[] = {256, 291, 0x2FF, RING_SIZE - 4};
+	int small_length = make_frame(small, 8, 9);
+	int i;
+
+	for(i = 0; i < 4; i++)
+	{
+		char what[32];
+		int length = make_frame(frame, lengths[i], i);
+		snprintf(what, sizeof(what), "%d byte data field", lengths[i]);
+
+		init_parser(&parser);
+		CHECK(feed(frame, length) == length, "%s: not all taken", what);
+		check_frame(frame, length, 0, what);
+		xbee_release_frame(&parser);
+	}
+
+	// one that's too big for the ring gets dropped - and the frame after it
+	// still gets through
+	int length = make_frame(frame, RING_SIZE - 3, 4);
+	init_parser(&parser);
+	feed(frame, length);
+	feed(small, small_length);
+	CHECK(parser.stats.ring_full == 1, "%u frames dropped (expected 1)",
+		parser.stats.ring_full);
+	check_frame(small, small_length, -1, "frame after one too big");
+}
+
+// a frame that wraps while others are waiting
+static void test_wrap_with_waiting(void)
+{
+	static uint8_t frames[5][RING_SIZE];
+	int lengths[5];
+	int i;
+
+	// three frames filling most of the ring (a, b and c) ...
+	lengths[0] = make_frame(frames[0], 300, 10);
+	lengths[1] = make_frame(frames[1], 300, 11);
+	lengths[2] = make_frame(frames[2], 300, 12);
+
+	// ... one that only fits at the start once a has gone (d) ...
+	lengths[3] = make_frame(frames[3], 200, 13);
+
+	// ... and one that won't fit anywhere until b has gone as well (e)
+	lengths[4] = make_frame(frames[4], 400, 14);
+
+	init_parser(&parser);
+	for(i = 0; i < 3; i++)
+	{
+		feed(frames[i], lengths[i]);
+	}
+	CHECK(parser.queue.num_frames == 3, "%d frames waiting (expected 3)",
+		parser.queue.num_frames);
+
+	// hand a out, then d should wrap round in front of b
+	check_frame(frames[0], lengths[0], 0, "frame a");
+	xbee_release_frame(&parser);
+	CHECK(feed(frames[3], lengths[3]) == lengths[3], "frame d not all taken");
+	CHECK(parser.queue.num_frames == 3, "%d frames waiting after d (expected 3)",
+		parser.queue.num_frames);
+
+	// e doesn't fit between d and b - the bulk path should hold it back (one
+	// byte at a time it just has to be dropped)
+	size_t taken = feed(frames[4], lengths[4]);
+	if(bulk)
+	{
+		CHECK(taken < (size_t)lengths[4], "frame e taken with no room for it");
+	}
+	else
+	{
+		CHECK(parser.stats.ring_full == 1, "frame e not dropped");
+	}
+
+	// nothing waiting has been touched
+	check_frame(frames[1], lengths[1], lengths[0], "frame b");
+	xbee_release_frame(&parser);
+	check_frame(frames[2], lengths[2], lengths[0] + lengths[1], "frame c");
+	xbee_release_frame(&parser);
+	check_frame(frames[3], lengths[3], 0, "frame d (wrapped)");
+
+	// with b and c gone the rest of e goes in behind d
+	if(bulk)
+	{
+		feed(&frames[4][taken], lengths[4] - taken);
+		xbee_release_frame(&parser);
+		check_frame(frames[4], lengths[4], lengths[3], "frame e");
+	}
+	xbee_release_frame(&parser);
+	CHECK(parser.queue.num_frames == 0, "%d frames left", parser.queue.num_frames);
+}
+
+// a stray delimiter whose length takes in some real frames - when its checksum
+// fails, the rescan queues the frames inside it (as many as there are slots
+// for) and the parser has to say how many it queued
+static void test_resync_count(void)
+{
+#if XBEE_API_MODE != 2
+	static uint8_t stream[RING_SIZE], inner[XBEE_FRAME_SLOTS + 1][32], after[32];
+	static const int counts[] = {3, XBEE_FRAME_SLOTS + 1};
+	int lengths[XBEE_FRAME_SLOTS + 1], offsets[XBEE_FRAME_SLOTS + 1];
+	int t, k;
+
+	for(t = 0; t < 2; t++)
+	{
+		int count = counts[t];
+		int queued = (count < XBEE_FRAME_SLOTS) ? count : XBEE_FRAME_SLOTS;
+		char what[48];
+		uint8_t sum = 0;
+		int pos = 3;
+		int i;
+
+		// the stray delimiter, the frames, a bit of padding and a checksum that
+		// doesn't add up
+		stream[0] = 0x7e;
+		for(k = 0; k < count; k++)
+		{
+			lengths[k] = make_frame(inner[k], 8 + k, 20 + k);
+			offsets[k] = pos;
+			memcpy(&stream[pos], inner[k], lengths[k]);
+			pos += lengths[k];
+		}
+		memset(&stream[pos], 0x11, 5);
+		pos += 5;
+		for(i = 3; i < pos; i++)
+		{
+			sum += stream[i];
+		}
+		stream[pos] = (0xFF - sum) ^ 0x01;
+		pos++;
+		stream[1] = (pos - 4) >> 8;
+		stream[2] = (pos - 4) & 0xFF;
+
+		// and a good frame after it
+		int after_length = make_frame(after, 6, 40);
+		memcpy(&stream[pos], after, after_length);
+		int total = pos + after_length;
+
+		init_parser(&parser);
+		reported = 0;
+		size_t taken = feed(stream, total);
+		snprintf(what, sizeof(what), "%d frames inside", count);
+		CHECK(parser.stats.bad_checksums == 1, "%s: %u bad checksums (expected 1)", what,
+			parser.stats.bad_checksums);
+
+		if(count < XBEE_FRAME_SLOTS)
+		{
+			// everything fits, including the frame after
+			CHECK(taken == (size_t)total, "%s: %d of %d bytes taken", what, (int)taken, total);
+			CHECK(reported == count + 1, "%s: %d frames reported (expected %d)", what,
+				reported, count + 1);
+		}
+		else
+		{
+			// the slots are full once the rescan is done - the bulk path stops there,
+			// and a byte at a time the frame after has to be dropped
+			CHECK(reported == queued, "%s: %d frames reported (expected %d)", what, reported,
+				queued);
+			if(bulk)
+			{
+				CHECK(taken == (size_t)pos, "%s: %d bytes taken (expected %d)", what, (int)taken,
+					pos);
+			}
+		}
+		CHECK(parser.stats.frames_ok == (uint32_t)reported, "%s: %u frames ok, %d reported",
+			what, parser.stats.frames_ok, reported);
+
+		for(k = 0; k < queued; k++)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "%s: frame %d", what, k);
+			check_frame(inner[k], lengths[k], offsets[k], name);
+			xbee_release_frame(&parser);
+		}
+		if(count < XBEE_FRAME_SLOTS || bulk)
+		{
+			if(taken < (size_t)total)
+			{
+				feed(&stream[taken], total - taken);
+			}
+			check_frame(after, after_length, -1, "frame after the stray delimiter");
+			xbee_release_frame(&parser);
+		}
+		CHECK(parser.queue.num_frames == 0, "%s: %d frames left", what,
+			parser.queue.num_frames);
+	}
+#endif
+}
+
+int main(void)
+{
+	for(bulk = 0; bulk < 2; bulk++)
+	{
+		printf("%s:\n", bulk ? "bulk (xbee_parse_bytes)" : "per byte (xbee_parse_packet)");
+		printf("  frame ending at the end of the ring\n");
+		test_ring_end();
+		printf("  data fields over 255 bytes\n");
+		test_long_frames();
+		printf("  frame wrapping with others waiting\n");
+		test_wrap_with_waiting();
+		printf("  frames found by a resync\n");
+		test_resync_count();
+	}
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,378 @@
+/*
+ * requests_sim.c
+ *
+ * run the request tracking (src/xbee_requests.c) against a simulated xbee
+ * that loses some of the frames we send it and some of the responses it sends
+ * back - requests are sent at random, the simulated xbee answers every copy
+ * of one that reaches it (so resends can get answered twice), the odd frame
+ * is held up for longer than the timeout (so answers turn up late) and the
+ * table is polled every 100 ms like the firmware's request timer does
+ *
+ * the clock is the firmware's: kernel sys ticks at 216 MHz, starting a few
+ * seconds before it wraps round, so the run goes through the wrap several
+ * times. every request has to finish exactly once - answered with the right
+ * latency, or timed out once it has been sent XBEE_REQUEST_RETRIES more times
+ * and all its timeouts have run out
+ *
+ * usage: make && ./requests_sim [loss to the xbee %] [loss from the xbee %]
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// include request tracking (and the frame builder for the requests)
+#include "xbee_requests.h"
+#include "xbee_frame_builder.h"
+
+// the firmware's clock and settings
+#define TICKS_PER_MS			216000u
+#define REQUEST_TIMEOUT		500						// ms
+#define CHECK_PERIOD			100						// ms between checks for overdue requests
+#define START_TICK				(0xFFFFFFFFu - 3000u * TICKS_PER_MS)
+
+// the simulation
+#define RUN_TIME					120000				// ms of requests (a bit over 6 wraps)
+#define REQUEST_CHANCE		2							// percent chance of a request each ms
+#define MIN_DELAY					10						// ms each way over the air
+#define MAX_DELAY					80
+#define SLOW_CHANCE				3							// percent of frames held up (a route being found)
+#define SLOW_DELAY				1500					// ... by up to this long
+#define ERROR_CHANCE			2							// percent of responses with a bad status
+#define MAX_REQUESTS			(RUN_TIME * REQUEST_CHANCE / 100 * 2)
+#define MAX_EVENTS				4096
+
+// a request as we sent it
+typedef struct
+{
+	uint64_t	first_sent;						// ms
+	uint8_t		frame_id;
+	uint8_t		sends;
+	uint8_t		done;
+	uint8_t		status;
+	uint8_t		length;
+	uint8_t		frame[32];
+}
+sim_request_t;
+
+// something on its way over the air - a request to the xbee (which it may
+// answer) or a response coming back
+typedef struct
+{
+	uint64_t					arrives;
+	uint8_t						response;
+	uint8_t						frame_id;
+	uint8_t						status;
+	sim_request_t *		request;				// what the copy that was answered was sent for
+}
+sim_event_t;
+
+static sim_request_t requests[MAX_REQUESTS];
+static int num_requests;
+static sim_request_t * by_id[256];				// the request tracking each frame id
+static sim_event_t events[MAX_EVENTS];
+static int num_events;
+
+static xbee_request_table_t table;
+static uint64_t now_ms;
+static int loss_out, loss_in;
+static int errors;
+
+// what happened (over one run)
+static uint32_t answered, timed_out, late_answers, stale_matches, untracked;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// the firmware's view of the time
+static uint32_t sys_tick(void)
+{
+	return (uint32_t)(START_TICK + now_ms * TICKS_PER_MS);
+}
+
+// how long a frame takes over the air
+static uint64_t air_time(void)
+{
+	uint64_t delay = MIN_DELAY + next_random() % (MAX_DELAY - MIN_DELAY);
+	if(next_random() % 100 < SLOW_CHANCE)
+	{
+		delay += next_random() % SLOW_DELAY;
+	}
+	return delay;
+}
+
+// put a frame on the air
+static void transmit(uint8_t frame_id, sim_request_t * request)
+{
+	if(num_events == MAX_EVENTS)
+	{
+		printf("too many frames in the air\n");
+		exit(1);
+	}
+	sim_event_t * event = &events[num_events++];
+	event->arrives = now_ms + air_time();
+	event->response = 0;
+	event->frame_id = frame_id;
+	event->request = request;
+}
+
+// THE FIRMWARE SIDE
+
+// a request finished (answered or given up on)
+static void on_complete(uint8_t frame_id, uint8_t status, uint32_t latency, void * context)
+{
+	sim_request_t * request = context;
+	uint64_t elapsed = now_ms - request->first_sent;
+
+	if(request->done)
+	{
+		printf("request %d (id %d) finished twice\n", (int)(request - requests), frame_id);
+		errors++;
+	}
+	request->done = 1;
+	request->status = status;
+	by_id[frame_id] = NULL;
+
+	// the latency comes from the wrapping clock, so it has to agree with ours
+	if(latency != (uint32_t)(elapsed * TICKS_PER_MS))
+	{
+		printf("request %d: latency %u ticks after %llu ms\n", (int)(request - requests),
+			latency, (unsigned long long)elapsed);
+		errors++;
+	}
+
+	if(status == XBEE_REQUEST_TIMED_OUT)
+	{
+		// sent once and resent for every retry, with every timeout run out (but
+		// not much later than the next check)
+		uint64_t total = 0;
+		int i;
+		for(i = 0; i <= XBEE_REQUEST_RETRIES; i++)
+		{
+			total += (uint64_t)REQUEST_TIMEOUT << i;
+		}
+		if(request->sends != XBEE_REQUEST_RETRIES + 1 || elapsed < total ||
+			elapsed > total + (XBEE_REQUEST_RETRIES + 1) * CHECK_PERIOD)
+		{
+			printf("request %d timed out after %d sends and %llu ms\n",
+				(int)(request - requests), request->sends, (unsigned long long)elapsed);
+			errors++;
+		}
+		timed_out++;
+	}
+	else
+	{
+		answered++;
+	}
+}
+
+// a resend from xbee_request_poll - it has to be the frame we first sent
+static void resend(uint8_t * frame, int length)
+{
+	sim_request_t * request = by_id[frame[4]];
+
+	if(request == NULL || length != request->length ||
+		memcmp(frame, request->frame, length) != 0)
+	{
+		printf("resent a frame that doesn't match its request (id %d)\n", frame[4]);
+		errors++;
+		return;
+	}
+	request->sends++;
+	transmit(frame[4], request);
+}
+
+// send a new request
+static void send_request(void)
+{
+	static const xbee_address_t * broadcast = NULL;
+	static xbee_address_t address;
+	sim_request_t * request = &requests[num_requests];
+	uint8_t frame[32];
+
+	if(broadcast == NULL)
+	{
+		xbee_address_init(&address, XBEE_BROADCAST_64, XBEE_UNKNOWN_16);
+		broadcast = &address;
+	}
+
+	int length = xbee_build_remote_at(frame, sizeof(frame), 0x01, broadcast,
+		XBEE_APPLY_CHANGES, "IS", NULL, 0);
+	uint8_t id = xbee_request_track(&table, frame, length, sys_tick(), on_complete, request);
+	if(id == 0)
+	{
+		// no free slot - the firmware sends it anyway, but nothing is waiting
+		untracked++;
+		return;
+	}
+
+	// the checksum has to have been patched along with the id
+	uint8_t sum = 0;
+	int i;
+	for(i = 3; i < length; i++)
+	{
+		sum += frame[i];
+	}
+	if(sum != 0xFF)
+	{
+		printf("bad checksum after tracking (id %d)\n", id);
+		errors++;
+	}
+
+	memset(request, 0, sizeof(*request));
+	request->first_sent = now_ms;
+	request->frame_id = id;
+	request->sends = 1;
+	request->length = length;
+	memcpy(request->frame, frame, length);
+	by_id[id] = request;
+	num_requests++;
+	transmit(id, request);
+}
+
+// THE XBEE SIDE
+
+// move everything that has arrived on to where it was going
+static void deliver(void)
+{
+	int i = 0;
+
+	while(i < num_events)
+	{
+		sim_event_t * event = &events[i];
+		if(event->arrives > now_ms)
+		{
+			i++;
+			continue;
+		}
+
+		if(!event->response)
+		{
+			// the xbee answers every copy that reaches it
+			if(next_random() % 100 >= (uint32_t)loss_out && next_random() % 100 >= (uint32_t)loss_in)
+			{
+				event->arrives = now_ms + air_time();
+				event->response = 1;
+				event->status = (next_random() % 100 < ERROR_CHANCE) ? 4 : 0;
+				continue;
+			}
+		}
+		else
+		{
+			// an answer to a request that has already finished can only match if
+			// its frame id has been handed out again since
+			int waiting = (by_id[event->frame_id] == event->request);
+			int matched = xbee_request_complete(&table, event->frame_id, event->status, sys_tick());
+			if(!waiting)
+			{
+				late_answers++;
+				if(matched)
+				{
+					stale_matches++;
+				}
+			}
+			else if(!matched)
+			{
+				printf("answer to request %d (id %d) not matched\n",
+					(int)(event->request - requests), event->frame_id);
+				errors++;
+			}
+		}
+
+		// gone (lost, or handed over)
+		events[i] = events[--num_events];
+	}
+}
+
+// RUNNING
+
+static void run(int out, int in)
+{
+	int i;
+
+	loss_out = out;
+	loss_in = in;
+	num_requests = 0;
+	num_events = 0;
+	now_ms = 0;
+	answered = timed_out = late_answers = stale_matches = untracked = 0;
+	memset(by_id, 0, sizeof(by_id));
+	xbee_requests_init(&table, REQUEST_TIMEOUT * TICKS_PER_MS);
+
+	// send requests for a while, then wait for them all to finish
+	while(now_ms < RUN_TIME || xbee_request_outstanding(&table) > 0 || num_events > 0)
+	{
+		if(now_ms < RUN_TIME && next_random() % 100 < REQUEST_CHANCE)
+		{
+			send_request();
+		}
+		deliver();
+
+		// the request timer
+		if(now_ms % CHECK_PERIOD == 0 && xbee_request_due(&table, sys_tick()))
+		{
+			xbee_request_poll(&table, sys_tick(), resend);
+		}
+		now_ms++;
+	}
+
+	for(i = 0; i < num_requests; i++)
+	{
+		if(!requests[i].done)
+		{
+			printf("request %d (id %d) never finished\n", i, requests[i].frame_id);
+			errors++;
+		}
+	}
+	// with nothing lost even the slowest answer comes back before the last
+	// timeout runs out (it may well have been resent by then)
+	if(out == 0 && in == 0 && timed_out != 0)
+	{
+		printf("%u timeouts with nothing lost\n", timed_out);
+		errors++;
+	}
+
+	xbee_request_stats_t * stats = &table.stats;
+	printf("%4d%% %4d%% %8u %8u %8u %8u %8u %8u %8u %10.1f %8.1f\n", out, in, stats->sent,
+		untracked, answered, timed_out, stats->retries, late_answers, stale_matches,
+		stats->completed ? (double)stats->latency_total / stats->completed / TICKS_PER_MS : 0,
+		(double)stats->latency_max / TICKS_PER_MS);
+}
+
+int main(int argc, char * argv[])
+{
+	static const int losses[][2] = {{0, 0}, {5, 5}, {20, 0}, {0, 20}, {20, 20}, {40, 40}};
+	unsigned int i;
+
+	printf("%u ms of requests, sys tick starting at 0x%08X (wraps every %.1f s)\n\n",
+		RUN_TIME, START_TICK, 4294967296.0 / TICKS_PER_MS / 1000);
+	printf("%5s %5s %8s %8s %8s %8s %8s %8s %8s %10s %8s\n", "out", "in", "tracked",
+		"untrack", "answered", "timedout", "retries", "late", "stale", "mean (ms)", "worst");
+	if(argc > 2)
+	{
+		run(atoi(argv[1]), atoi(argv[2]));
+	}
+	else
+	{
+		for(i = 0; i < sizeof(losses) / sizeof(losses[0]); i++)
+		{
+			run(losses[i][0], losses[i][1]);
+		}
+	}
+	printf("\nout, in: frames lost on the way to and from the xbee, late: answers that "
+		"turned up\nafter their request had finished, stale: ... that were matched to "
+		"a newer request\nthat had been given the same frame id\n");
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,20 @@
+/*
+ * cmsis_os.h
+ *
+ * the rtos calls the hardware independent modules make - there's no kernel
+ * here, so each program provides whichever of these it needs
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __CMSIS_OS_H
+#define __CMSIS_OS_H
+
+// include the standard integer types
+#include <stdint.h>
+
+// the kernel tick count (in the firmware this is the cycle counter)
+uint32_t osKernelSysTick(void);
+
+#endif // CMSIS_OS_H
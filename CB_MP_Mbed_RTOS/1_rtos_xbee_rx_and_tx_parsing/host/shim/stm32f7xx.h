@@ -0,0 +1,60 @@
+/*
+ * stm32f7xx.h
+ *
+ * what the hardware independent modules get from the device header, done in
+ * plain c so they can be built on a pc (the firmware gets the real one from
+ * the cmsis device library)
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __STM32F7XX_H
+#define __STM32F7XX_H
+
+// include the standard integer types
+#include <stdint.h>
+
+// armcc keywords - gcc can't pack a struct from where armcc takes __packed
+// (before the struct keyword), and nothing built here depends on the layout,
+// so it's left out
+#define __packed
+
+// a data memory barrier (a full barrier on the pc, so code that relies on it
+// can be run across threads)
+#define __DMB() __sync_synchronize()
+
+// an inline function (as the cmsis core headers spell it)
+#define __INLINE inline
+
+// there are no interrupts here, so holding them off does nothing
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { }
+static inline void __disable_irq(void) { }
+
+// the debug registers trace.c starts the cycle counter with - here they're
+// just variables, which a program that uses them has to define (and it can
+// move the cycle counter on itself)
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+	volatile uint32_t LAR;
+}
+DWT_Type;
+
+typedef struct
+{
+	volatile uint32_t DEMCR;
+}
+CoreDebug_Type;
+
+extern DWT_Type shim_dwt;
+extern CoreDebug_Type shim_core_debug;
+
+#define DWT													(&shim_dwt)
+#define CoreDebug										(&shim_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk			(1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk	(1UL << 24)
+
+#endif // STM32F7XX_H
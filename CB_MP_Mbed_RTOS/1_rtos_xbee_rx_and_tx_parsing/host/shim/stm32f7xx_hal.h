@@ -0,0 +1,45 @@
+/*
+ * stm32f7xx_hal.h
+ *
+ * the bits of the hal (and the uart registers) that the hardware independent
+ * modules use, so they can be built on a pc
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __STM32F7XX_HAL_H
+#define __STM32F7XX_HAL_H
+
+// include the device header (and stddef.h, which the hal brings in for NULL)
+#include "stm32f7xx.h"
+#include <stddef.h>
+
+// the uart registers we look at (a test can point these at a struct of its
+// own)
+typedef struct
+{
+	volatile uint32_t	ISR;
+	volatile uint32_t	ICR;
+}
+USART_TypeDef;
+
+// uart status and clear bits (the same values as the device header)
+#define USART_ISR_PE			0x00000001U
+#define USART_ISR_FE			0x00000002U
+#define USART_ISR_NE			0x00000004U
+#define USART_ISR_ORE			0x00000008U
+#define USART_ICR_PECF		0x00000001U
+#define USART_ICR_FECF		0x00000002U
+#define USART_ICR_NCF			0x00000004U
+#define USART_ICR_ORECF		0x00000008U
+
+// hal uart error codes
+#define HAL_UART_ERROR_NONE		0x00000000U
+#define HAL_UART_ERROR_PE			0x00000001U
+#define HAL_UART_ERROR_NE			0x00000002U
+#define HAL_UART_ERROR_FE			0x00000004U
+#define HAL_UART_ERROR_ORE		0x00000008U
+#define HAL_UART_ERROR_DMA		0x00000010U
+
+#endif // STM32F7XX_HAL_H
@@ -0,0 +1,298 @@
+/*
+ * spsc_ring_stress.c
+ *
+ * the lock free byte ring (src/spsc_ring.c) run across two threads - the
+ * producer thread stands in for the uart receive interrupt and the consumer
+ * for the rx thread, woken the same way the firmware does it (when the ring
+ * goes from empty to not empty, or a frame delimiter goes in)
+ *
+ * - stress: a long run of bytes, each one worked out from its place in the
+ *   stream, so the consumer can check nothing is lost, repeated or read
+ *   before it has been written (the consumer gives back random amounts of
+ *   each span, and the ring is small so it wraps and fills up all the time)
+ * - bench: the ring against a byte queue with a lock and a wait, which is
+ *   what going through an osMessageQ amounts to (one put and one get for
+ *   every byte)
+ *
+ * the shim's __DMB() is a full barrier, so the ring's barriers do the same
+ * job here as they do on the m7
+ *
+ * usage: make && ./spsc_ring_stress [megabytes]
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+
+// include the ring
+#include "spsc_ring.h"
+
+// the firmware's ring size (XBEE_RX_RING_SIZE) and how many bytes to send
+// (in megabytes) unless told otherwise
+#define RING_SIZE			512
+#define STREAM_MB			20
+
+// the ring and its buffer
+static spsc_ring_t ring SPSC_RING_ALIGN;
+static uint8_t ring_buffer[RING_SIZE];
+
+// how many bytes go through each run
+static uint32_t stream_bytes;
+
+// what the consumer found
+static uint32_t received, wrong, lost_wakeups;
+static uint32_t full;
+
+static int errors = 0;
+
+// the time now in nanoseconds
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// the value of the nth byte in the stream (with a delimiter every so often,
+// like there would be at the start of each frame)
+static uint8_t byte_value(uint32_t n)
+{
+	return (n % 37 == 0) ? 0x7E : (uint8_t)((n * 2654435761u) >> 24);
+}
+
+// SIGNALS (osSignalSet / osSignalWait - a flag that stays set until the
+// thread waiting for it wakes up)
+
+static pthread_mutex_t signal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t signal_cond = PTHREAD_COND_INITIALIZER;
+static int signal_flag;
+
+static void signal_set(void)
+{
+	pthread_mutex_lock(&signal_lock);
+	signal_flag = 1;
+	pthread_cond_signal(&signal_cond);
+	pthread_mutex_unlock(&signal_lock);
+}
+
+// wait for the signal - returns 0 if it doesn't come within a second
+static int signal_wait(void)
+{
+	struct timespec deadline;
+	int result = 1;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec++;
+	pthread_mutex_lock(&signal_lock);
+	while(!signal_flag && result)
+	{
+		if(pthread_cond_timedwait(&signal_cond, &signal_lock, &deadline) == ETIMEDOUT)
+		{
+			result = 0;
+		}
+	}
+	signal_flag = 0;
+	pthread_mutex_unlock(&signal_lock);
+	return result;
+}
+
+// THE RING
+
+// the uart receive interrupt (if the ring is full it drops the byte - here we
+// wait and try again, so every byte gets through and can be checked)
+static void * ring_producer(void * arg)
+{
+	uint32_t n;
+
+	for(n = 0; n < stream_bytes; n++)
+	{
+		uint8_t c = byte_value(n);
+		int waiting;
+		while((waiting = spsc_ring_put(&ring, c)) < 0)
+		{
+			full++;
+			sched_yield();
+		}
+		if(waiting == 0 || c == 0x7E)
+		{
+			signal_set();
+		}
+	}
+	return NULL;
+}
+
+// the rx thread - wait to be woken, then empty the ring (checking each byte
+// if asked to, and sometimes only taking part of a span)
+static void * ring_consumer(void * arg)
+{
+	int check = *(int *)arg;
+	uint32_t seed = 12345;
+
+	while(received < stream_bytes)
+	{
+		if(!signal_wait())
+		{
+			// nothing for a second - fine if the ring really is empty
+			if(spsc_ring_count(&ring) != 0)
+			{
+				lost_wakeups++;
+			}
+		}
+
+		const uint8_t * data;
+		size_t length;
+		while((length = spsc_ring_span(&ring, &data)) > 0)
+		{
+			if(check)
+			{
+				size_t i;
+
+				seed ^= seed << 13;
+				seed ^= seed >> 17;
+				seed ^= seed << 5;
+				if(seed % 4 == 0)
+				{
+					length = 1 + seed % length;
+				}
+				for(i = 0; i < length; i++)
+				{
+					wrong += (data[i] != byte_value(received + i));
+				}
+			}
+			received += length;
+			spsc_ring_consume(&ring, length);
+		}
+	}
+	return NULL;
+}
+
+// run the ring across two threads - returns the time it took
+static double run_ring(int check)
+{
+	pthread_t producer, consumer;
+
+	spsc_ring_init(&ring, ring_buffer, RING_SIZE);
+	received = wrong = lost_wakeups = full = 0;
+	signal_flag = 0;
+
+	double start = now();
+	pthread_create(&consumer, NULL, ring_consumer, &check);
+	pthread_create(&producer, NULL, ring_producer, NULL);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	return now() - start;
+}
+
+// THE MESSAGE QUEUE (a byte per message, with the queue's own lock and wait)
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t queue[RING_SIZE];
+static uint32_t queue_head, queue_tail;
+
+// osMessagePut with no timeout - returns 0 if the queue is full
+static int queue_put(uint32_t value)
+{
+	int result = 0;
+
+	pthread_mutex_lock(&queue_lock);
+	if(queue_head - queue_tail < RING_SIZE)
+	{
+		queue[queue_head++ % RING_SIZE] = value;
+		pthread_cond_signal(&queue_cond);
+		result = 1;
+	}
+	pthread_mutex_unlock(&queue_lock);
+	return result;
+}
+
+// osMessageGet waiting forever
+static uint32_t queue_get(void)
+{
+	pthread_mutex_lock(&queue_lock);
+	while(queue_head == queue_tail)
+	{
+		pthread_cond_wait(&queue_cond, &queue_lock);
+	}
+	uint32_t value = queue[queue_tail++ % RING_SIZE];
+	pthread_mutex_unlock(&queue_lock);
+	return value;
+}
+
+static void * queue_producer(void * arg)
+{
+	uint32_t n;
+
+	for(n = 0; n < stream_bytes; n++)
+	{
+		while(!queue_put(byte_value(n)))
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void * queue_consumer(void * arg)
+{
+	uint32_t n;
+
+	for(n = 0; n < stream_bytes; n++)
+	{
+		wrong += ((uint8_t)queue_get() != byte_value(n));
+	}
+	received = stream_bytes;
+	return NULL;
+}
+
+static double run_queue(void)
+{
+	pthread_t producer, consumer;
+
+	queue_head = queue_tail = 0;
+	received = wrong = 0;
+
+	double start = now();
+	pthread_create(&consumer, NULL, queue_consumer, NULL);
+	pthread_create(&producer, NULL, queue_producer, NULL);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	return now() - start;
+}
+
+int main(int argc, char * argv[])
+{
+	stream_bytes = (argc > 1 ? atoi(argv[1]) : STREAM_MB) * 1000000u;
+	printf("%u bytes through a %d byte ring\n\n", stream_bytes, RING_SIZE);
+
+	// stress
+	run_ring(1);
+	printf("stress: %u bytes received, %u wrong, %u times full, %u dropped, "
+		"%u lost wake ups\n", received, wrong, full, ring.dropped, lost_wakeups);
+	if(received != stream_bytes || wrong != 0 || lost_wakeups != 0 || ring.dropped != full ||
+		spsc_ring_count(&ring) != 0)
+	{
+		errors++;
+	}
+
+	// bench
+	double ring_time = run_ring(0);
+	double queue_time = run_queue();
+	if(wrong != 0)
+	{
+		printf("the message queue got %u bytes wrong\n", wrong);
+		errors++;
+	}
+	printf("bench: ring %.1f MB/s (%.1f ns a byte), message queue %.1f MB/s (%.1f ns a "
+		"byte), %.1fx\n", stream_bytes * 1e3 / ring_time, ring_time / stream_bytes,
+		stream_bytes * 1e3 / queue_time, queue_time / stream_bytes, queue_time / ring_time);
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,477 @@
+/*
+ * swo_capture.c
+ *
+ * make a synthetic swo capture - the raw itm packets a debug probe would pick
+ * up from print_debug and itm_send (src/itm_debug.c) - then split it up with
+ * tools/swo_demux.py and check each port's file is exactly what was sent:
+ *
+ * - console text on port 0 (a byte at a time, with lines cut short where the
+ *   itm fifo filled up) and binary records on the other ports (a word at a
+ *   time, with the cycle counter wrapping round)
+ * - records cut short part way through by a full fifo (the demuxer has to
+ *   find the next header and count the words it skipped)
+ * - records with no data words, and events the header doesn't know about
+ * - synchronisation, overflow, time stamp, extension and hardware source
+ *   (dwt) packets mixed in, which all have to be skipped
+ *
+ * the demuxer is run with python3, from the host directory. give "keep" as an
+ * argument to leave the capture (swo_capture.bin), the demuxed files (in
+ * swo_capture.out/) and what the demuxer printed (swo_capture.txt) behind to
+ * look at
+ *
+ * usage: make && ./swo_capture [keep]
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// include the port and event numbers
+#include "itm_debug.h"
+
+// how many records to send, how fast the cycle counter runs (swo_demux.py's
+// default) and where the files go
+#define RECORDS					4000
+#define CLOCK						216e6
+#define CAPTURE					"swo_capture.bin"
+#define OUT_DIR					"swo_capture.out"
+#define SUMMARY					"swo_capture.txt"
+#define DEMUXER					"python3 ../tools/swo_demux.py --header ../inc/itm_debug.h"
+
+// an event that isn't in itm_debug.h (the demuxer calls it event99)
+#define UNKNOWN_EVENT		99
+
+// the port names and the events (as the demuxer gets them from the header)
+static const char * const port_names[ITM_CHANNELS] =
+{
+	"console", "parser", "scheduler", "actuation", "metrics"
+};
+
+typedef struct
+{
+	uint32_t			event;
+	const char *	name;
+	uint32_t			port;
+}
+event_t;
+
+static const event_t events[] =
+{
+	{ITM_EV_BAD_CHECKSUM,	"bad_checksum",	ITM_CH_PARSER},
+	{ITM_EV_RESYNC,				"resync",				ITM_CH_PARSER},
+	{ITM_EV_REQUEST_DONE,	"request_done",	ITM_CH_SCHEDULER},
+	{ITM_EV_RETRY_DUE,		"retry_due",		ITM_CH_SCHEDULER},
+	{ITM_EV_FLUSH,				"flush",				ITM_CH_ACTUATION},
+	{ITM_EV_TX_QUEUE,			"tx_queue",			ITM_CH_METRICS},
+	{ITM_EV_VCOM_OUTPUT,	"vcom_output",	ITM_CH_METRICS},
+	{ITM_EV_UART_ERRORS,	"uart_errors",	ITM_CH_METRICS},
+	{ITM_EV_PARSER_STATS,	"parser_stats",	ITM_CH_METRICS},
+	{ITM_EV_RX_DMA,				"rx_dma",				ITM_CH_METRICS},
+	{ITM_EV_VCOM_ERRORS,	"vcom_errors",	ITM_CH_METRICS},
+};
+
+#define NUM_EVENTS (sizeof(events) / sizeof(events[0]))
+
+// what should come out for each port
+typedef struct
+{
+	char *		text;
+	size_t		length;
+	size_t		size;
+	uint32_t	records;
+	uint32_t	skipped;
+	uint32_t	last_stamp;
+	uint64_t	elapsed;
+	int				cut_short;						// the last record was cut short
+}
+port_t;
+
+static port_t ports[ITM_CHANNELS];
+
+// the capture, and the cycle counter
+static FILE * capture;
+static uint32_t cycles;
+static uint32_t overflows = 0;
+
+// leave the files behind
+static int keep = 0;
+
+static int errors = 0;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// add some text to what a port should give
+static void expect(port_t * port, const char * text, size_t length)
+{
+	if(port->length + length + 1 > port->size)
+	{
+		port->size = 2 * (port->length + length + 1);
+		port->text = realloc(port->text, port->size);
+	}
+	memcpy(port->text + port->length, text, length);
+	port->length += length;
+	port->text[port->length] = '\0';
+}
+
+// THE ITM PACKETS
+
+// a word that the demuxer would take for the header of an event it knows (it
+// can't tell one of these apart from a record header, so we don't send them
+// as data)
+static int looks_like_header(uint32_t word)
+{
+	unsigned int i;
+
+	if(word >> 24 != ITM_SYNC)
+	{
+		return 0;
+	}
+	for(i = 0; i < NUM_EVENTS; i++)
+	{
+		if((word & 0xFFFF) == events[i].event)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// the packets the itm and dwt put in between ours, which the demuxer has to
+// skip over
+static void other_packet(void)
+{
+	static const uint8_t sync[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x80};
+	uint8_t packet[8];
+	int length = 0;
+
+	switch(next_random() % 7)
+	{
+		case 0:
+			fwrite(sync, 1, sizeof(sync), capture);
+			return;
+		case 1:
+			// the itm lost some packets (this one doesn't lose any of ours - it's
+			// just counted)
+			packet[length++] = 0x70;
+			overflows++;
+			break;
+		case 2:
+			// a short local time stamp
+			packet[length++] = 0x10 * (1 + next_random() % 6);
+			break;
+		case 3:
+		{
+			// a long local time stamp (up to four continuation bytes)
+			int bytes = 1 + next_random() % 4;
+			packet[length++] = 0xC0 | (0x10 * (next_random() % 4));
+			while(bytes-- > 0)
+			{
+				packet[length++] = (next_random() & 0x7F) | (bytes ? 0x80 : 0);
+			}
+			break;
+		}
+		case 4:
+		{
+			// a global time stamp
+			int bytes = 4;
+			packet[length++] = 0x94;
+			while(bytes-- > 0)
+			{
+				packet[length++] = (next_random() & 0x7F) | (bytes ? 0x80 : 0);
+			}
+			break;
+		}
+		case 5:
+			// an extension packet
+			packet[length++] = 0x08;
+			break;
+		case 6:
+			// a dwt pc sample (a hardware source packet with a four byte payload)
+			packet[length++] = 0x17;
+			while(length < 5)
+			{
+				packet[length++] = next_random();
+			}
+			break;
+	}
+	fwrite(packet, 1, length, capture);
+}
+
+// a byte on a stimulus port (as ITM_Port8)
+static void send_byte(uint32_t channel, uint8_t byte)
+{
+	uint8_t packet[2] = {(channel << 3) | 1, byte};
+	fwrite(packet, 1, sizeof(packet), capture);
+}
+
+// a word on a stimulus port (as ITM_Port32)
+static void send_word(uint32_t channel, uint32_t word)
+{
+	uint8_t packet[5] = {(channel << 3) | 3, word, word >> 8, word >> 16, word >> 24};
+	fwrite(packet, 1, sizeof(packet), capture);
+}
+
+// WHAT GETS SENT
+
+// a line of console text (as print_debug, which drops the rest of the line if
+// the fifo fills up)
+static void send_text(void)
+{
+	char line[64];
+	int length = 4 + next_random() % 40;
+	int sent = length + 2;
+	int i;
+
+	for(i = 0; i < length; i++)
+	{
+		line[i] = ' ' + next_random() % 95;
+	}
+	line[length] = '\r';
+	line[length + 1] = '\n';
+	if(next_random() % 20 == 0)
+	{
+		sent = next_random() % (length + 2);
+	}
+
+	for(i = 0; i < sent; i++)
+	{
+		send_byte(ITM_CH_CONSOLE, line[i]);
+		if(next_random() % 16 == 0)
+		{
+			other_packet();
+		}
+	}
+	expect(&ports[ITM_CH_CONSOLE], line, sent);
+}
+
+// a record (as itm_send, which stops part way if the fifo fills up)
+static void send_record(void)
+{
+	const event_t * event = &events[next_random() % NUM_EVENTS];
+	port_t * port = &ports[event->port];
+	uint32_t words[8];
+	uint32_t count = next_random() % 7;
+	uint32_t number = event->event;
+	const char * name = event->name;
+	uint32_t sent, i;
+	char line[160];
+
+	// now and again an event the demuxer doesn't know (but not straight after a
+	// record that was cut short - it only looks for the next header amongst
+	// events it knows)
+	if(next_random() % 50 == 0 && !port->cut_short)
+	{
+		number = UNKNOWN_EVENT;
+		name = "event99";
+	}
+
+	// move the cycle counter on (not so far that it could wrap between two
+	// records on the same port)
+	do
+	{
+		cycles += 1 + next_random() % (1 << 22);
+	}
+	while(looks_like_header(cycles));
+
+	words[0] = (ITM_SYNC << 24) | (count << 16) | number;
+	words[1] = cycles;
+	for(i = 0; i < count; i++)
+	{
+		do
+		{
+			words[2 + i] = (next_random() % 3 == 0) ? next_random() : next_random() % 1000;
+		}
+		while(looks_like_header(words[2 + i]));
+	}
+
+	// sometimes the fifo fills up after the header and before the end
+	sent = count + 2;
+	if(next_random() % 30 == 0)
+	{
+		sent = 1 + next_random() % (count + 1);
+	}
+	for(i = 0; i < sent; i++)
+	{
+		send_word(event->port, words[i]);
+		if(next_random() % 8 == 0)
+		{
+			other_packet();
+		}
+	}
+
+	port->cut_short = (sent < count + 2);
+	if(port->cut_short)
+	{
+		port->skipped += sent;
+		return;
+	}
+
+	// the time stamps are from the first record on the port
+	if(port->records > 0)
+	{
+		port->elapsed += cycles - port->last_stamp;
+	}
+	port->last_stamp = cycles;
+	port->records++;
+
+	int used = sprintf(line, "%12.6f %-14s ", port->elapsed / CLOCK, name);
+	for(i = 0; i < count; i++)
+	{
+		used += sprintf(line + used, i ? " %u" : "%u", words[2 + i]);
+	}
+	line[used++] = '\n';
+	expect(port, line, used);
+}
+
+// CHECKING
+
+// read a whole file
+static char * read_file(const char * path, size_t * length)
+{
+	FILE * file = fopen(path, "rb");
+	char * data;
+
+	if(file == NULL)
+	{
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	*length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	data = malloc(*length + 1);
+	*length = fread(data, 1, *length, file);
+	data[*length] = '\0';
+	fclose(file);
+	return data;
+}
+
+// check a port's file, and that the demuxer said the right thing about it
+static void check_port(uint32_t channel, const char * summary)
+{
+	port_t * port = &ports[channel];
+	char path[64], line[128];
+	size_t length;
+	char * data;
+
+	snprintf(path, sizeof(path), OUT_DIR "/%s.txt", port_names[channel]);
+	data = read_file(path, &length);
+	if(data == NULL)
+	{
+		printf("%s: not written\n", path);
+		errors++;
+		return;
+	}
+
+	if(length != port->length || memcmp(data, port->text, length) != 0)
+	{
+		size_t i = 0;
+		while(i < length && i < port->length && data[i] == port->text[i])
+		{
+			i++;
+		}
+		printf("%s: differs at byte %u\n  demuxed:  %.50s\n  expected: %.50s\n", path,
+			(unsigned int)i, data + i, port->text + i);
+		errors++;
+	}
+	free(data);
+
+	if(channel == ITM_CH_CONSOLE)
+	{
+		snprintf(line, sizeof(line), "%s: %u characters\n", path, (unsigned int)port->length);
+	}
+	else
+	{
+		snprintf(line, sizeof(line), "%s: %u records (%u words skipped)\n", path,
+			port->records, port->skipped);
+	}
+	if(strstr(summary, line) == NULL)
+	{
+		printf("the demuxer didn't say: %s", line);
+		errors++;
+	}
+
+	printf("%-10s %8u %s, %u words skipped\n", port_names[channel],
+		channel == ITM_CH_CONSOLE ? (unsigned int)port->length : port->records,
+		channel == ITM_CH_CONSOLE ? "characters" : "records", port->skipped);
+	if(!keep)
+	{
+		remove(path);
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	char command[256], warning[64], * summary;
+	size_t length;
+	uint32_t channel;
+	int i;
+
+	keep = (argc > 1 && strcmp(argv[1], "keep") == 0);
+
+	// make the capture (starting with the cycle counter near to wrapping round)
+	capture = fopen(CAPTURE, "wb");
+	cycles = 0xFFFFFFFF - 50000000;
+	other_packet();
+	for(i = 0; i < RECORDS; i++)
+	{
+		if(next_random() % 4 == 0)
+		{
+			send_text();
+		}
+		send_record();
+		if(next_random() % 4 == 0)
+		{
+			other_packet();
+		}
+	}
+	fclose(capture);
+
+	// split it up
+	snprintf(command, sizeof(command), DEMUXER " --out " OUT_DIR " " CAPTURE
+		" > " SUMMARY " 2>&1");
+	if(system(command) != 0)
+	{
+		printf("the demuxer didn't run\n");
+		errors++;
+	}
+	summary = read_file(SUMMARY, &length);
+	if(summary == NULL)
+	{
+		summary = "";
+	}
+
+	for(channel = 0; channel < ITM_CHANNELS; channel++)
+	{
+		check_port(channel, summary);
+	}
+
+	// and it should have noticed the overflow packets
+	snprintf(warning, sizeof(warning), "overflowed %u times", overflows);
+	if(strstr(summary, warning) == NULL)
+	{
+		printf("the demuxer didn't say the itm %s\n", warning);
+		errors++;
+	}
+	printf("%u overflow packets, the cycle counter ended at %08X\n", overflows, cycles);
+
+	if(!keep)
+	{
+		remove(SUMMARY);
+		remove(OUT_DIR);
+		remove(CAPTURE);
+	}
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
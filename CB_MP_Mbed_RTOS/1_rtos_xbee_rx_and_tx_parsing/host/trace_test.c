@@ -0,0 +1,366 @@
+/*
+ * trace_test.c
+ *
+ * the binary trace log (src/trace.c) round tripped through the decoder
+ * (tools/trace_decode.py) - records with random arguments are written with
+ * the TRACE macros, and at a few points along the way the log is dumped (as
+ * raw binary and as intel hex), run through the decoder, and what comes out
+ * has to be exactly the text (and time stamps) the messages should give:
+ *
+ * - before the log has filled up
+ * - once the oldest records are being thrown away to make room
+ * - with the records wrapping round the end of the ring, the free running
+ *   word counts wrapping round 2^32, and the cycle counter wrapping round
+ *   (every few hundred records)
+ *
+ * the log is built small here (TRACE_SIZE is set in the makefile) so it wraps
+ * and throws records away often. the decoder is run with python3, from the
+ * host directory
+ *
+ * usage: make && ./trace_test
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// include the trace log
+#include "trace.h"
+
+// the cycle counter (see shim/stm32f7xx.h)
+DWT_Type shim_dwt;
+CoreDebug_Type shim_core_debug;
+
+// how many records to write, how fast the cycle counter runs and where the
+// dumps go
+#define RECORDS					5000
+#define CLOCK						216000000
+#define DUMP_BIN				"trace_test.bin"
+#define DUMP_HEX				"trace_test.hex"
+#define DECODER_ERRORS	"trace_test.err"
+#define DECODER					"python3 ../tools/trace_decode.py --table ../inc/trace_msgs.h "
+
+// the format strings (the same table the decoder reads)
+#define TRACE_MSG(name, format) format,
+static const char * const formats[TRACE_COUNT] =
+{
+	#include "trace_msgs.h"
+};
+#undef TRACE_MSG
+
+// what we wrote (the text each record should decode to, when it was written
+// and how many words it took up)
+typedef struct
+{
+	char			text[128];
+	uint32_t	stamp;
+	uint32_t	words;
+}
+record_t;
+
+static record_t written[RECORDS];
+static int num_written = 0;
+static int errors = 0;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// WRITING
+
+// write a record with random arguments, and keep the text it should decode to
+static void write_record(void)
+{
+	record_t * record = &written[num_written++];
+
+	// move the cycle counter on (up to a quarter of a second, so it wraps every
+	// few hundred records)
+	shim_dwt.CYCCNT += 1 + next_random() % (CLOCK / 4);
+	record->stamp = shim_dwt.CYCCNT;
+
+	switch(next_random() % 6)
+	{
+		case 0:
+		{
+			int node = next_random() % 512;
+			uint32_t serial = next_random();
+			TRACE(NODE_SL_ADDRESS, node, serial);
+			snprintf(record->text, sizeof(record->text), formats[TRACE_NODE_SL_ADDRESS],
+				node, serial);
+			record->words = 4;
+			break;
+		}
+		case 1:
+		{
+			char first = 'A' + next_random() % 26;
+			char second = 'A' + next_random() % 26;
+			uint8_t status = next_random();
+			TRACE(AT_FAILED, first, second, status);
+			snprintf(record->text, sizeof(record->text), formats[TRACE_AT_FAILED], first,
+				second, status);
+			record->words = 5;
+			break;
+		}
+		case 2:
+		{
+			// floats go through as their bits
+			float light = (next_random() % 100000) / 1000.0f;
+			float temp = -20.0f + (next_random() % 60000) / 1000.0f;
+			TRACE(SAMPLE_VALUES, TRACE_FLOAT(light), TRACE_FLOAT(temp));
+			snprintf(record->text, sizeof(record->text), formats[TRACE_SAMPLE_VALUES],
+				(double)light, (double)temp);
+			record->words = 4;
+			break;
+		}
+		case 3:
+			// no newline (the next message carries on the same line)
+			TRACE0(NEXT_AC);
+			snprintf(record->text, sizeof(record->text), "%s", formats[TRACE_NEXT_AC]);
+			record->words = 2;
+			break;
+		case 4:
+			TRACE0(SEND_LOCKED);
+			snprintf(record->text, sizeof(record->text), "%s", formats[TRACE_SEND_LOCKED]);
+			record->words = 2;
+			break;
+		case 5:
+		{
+			// signed arguments
+			int frames = (int)(next_random() % 2000) - 1000;
+			int nodes = next_random() % 256;
+			int resent = next_random() % 16;
+			TRACE(SENT_COMMANDS, frames, nodes, resent);
+			snprintf(record->text, sizeof(record->text), formats[TRACE_SENT_COMMANDS],
+				frames, nodes, resent);
+			record->words = 5;
+			break;
+		}
+	}
+}
+
+// the oldest record that should still be in the log (the log keeps as many of
+// the newest records as fit)
+static int oldest_kept(void)
+{
+	uint32_t words = 0;
+	int i;
+
+	for(i = num_written - 1; i >= 0; i--)
+	{
+		if(words + written[i].words > TRACE_SIZE)
+		{
+			break;
+		}
+		words += written[i].words;
+	}
+	return i + 1;
+}
+
+// DUMPING AND DECODING
+
+static void dump_binary(const char * path)
+{
+	FILE * file = fopen(path, "wb");
+	fwrite(&trace_log, sizeof(trace_log), 1, file);
+	fclose(file);
+}
+
+// an intel hex dump (as the uvision SAVE command writes it, at an address up
+// in ram)
+static void dump_hex(const char * path)
+{
+	const uint8_t * data = (const uint8_t *)&trace_log;
+	uint32_t address = 0x20010000;
+	uint32_t offset, i;
+	FILE * file = fopen(path, "w");
+
+	fprintf(file, ":02000004%04X%02X\n", address >> 16,
+		(uint8_t)(0x100 - (2 + 4 + (address >> 24) + ((address >> 16) & 0xFF))));
+	for(offset = 0; offset < sizeof(trace_log); offset += 16)
+	{
+		uint32_t length = sizeof(trace_log) - offset < 16 ? sizeof(trace_log) - offset : 16;
+		uint16_t low = (address + offset) & 0xFFFF;
+		uint8_t sum = length + (low >> 8) + (low & 0xFF);
+
+		fprintf(file, ":%02X%04X00", length, low);
+		for(i = 0; i < length; i++)
+		{
+			fprintf(file, "%02X", data[offset + i]);
+			sum += data[offset + i];
+		}
+		fprintf(file, "%02X\n", (uint8_t)(0x100 - sum));
+	}
+	fprintf(file, ":00000001FF\n");
+	fclose(file);
+}
+
+// what the decoder should print for the records still in the log (a time
+// stamp, in seconds since the oldest record, at the start of every line)
+static char * expected_output(int oldest)
+{
+	static char output[TRACE_SIZE * 160];
+	uint64_t elapsed = 0;
+	int line_start = 1;
+	size_t used = 0;
+	int i;
+
+	output[0] = '\0';
+	for(i = oldest; i < num_written; i++)
+	{
+		const char * text = written[i].text;
+		if(i > oldest)
+		{
+			elapsed += written[i].stamp - written[i - 1].stamp;
+		}
+		while(*text != '\0')
+		{
+			const char * end = strchr(text, '\n');
+			size_t length = end ? (size_t)(end - text) + 1 : strlen(text);
+			if(line_start)
+			{
+				used += sprintf(output + used, "[%12.6f] ", (double)elapsed / CLOCK);
+			}
+			memcpy(output + used, text, length);
+			used += length;
+			output[used] = '\0';
+			line_start = (text[length - 1] == '\n');
+			text += length;
+		}
+	}
+	if(!line_start)
+	{
+		strcpy(output + used, "\n");
+	}
+	return output;
+}
+
+// run the decoder on a dump and check what it prints
+static void check_decode(const char * dump, const char * expected, int kept)
+{
+	static char command[256], output[TRACE_SIZE * 160], summary[128];
+	size_t used = 0, n;
+	FILE * pipe;
+
+	snprintf(command, sizeof(command), DECODER "%s 2> " DECODER_ERRORS, dump);
+	pipe = popen(command, "r");
+	while(pipe != NULL && (n = fread(output + used, 1, sizeof(output) - 1 - used, pipe)) > 0)
+	{
+		used += n;
+	}
+	output[used] = '\0';
+	if(pipe == NULL || pclose(pipe) != 0)
+	{
+		printf("%d records, %s: the decoder didn't run\n", num_written, dump);
+		errors++;
+		return;
+	}
+
+	if(strcmp(output, expected) != 0)
+	{
+		const char * a = output;
+		const char * b = expected;
+		while(*a != '\0' && *a == *b)
+		{
+			a++;
+			b++;
+		}
+		printf("%d records, %s: decoded differently at byte %d\n", num_written, dump,
+			(int)(a - output));
+		printf("  decoded:  %.60s\n  expected: %.60s\n", a, b);
+		errors++;
+	}
+
+	// and it should say how many records it found
+	char line[128];
+	snprintf(line, sizeof(line), "%d records (%d written, %d overwritten)\n", kept,
+		num_written, num_written - kept);
+	FILE * file = fopen(DECODER_ERRORS, "r");
+	summary[0] = '\0';
+	while(file != NULL && fgets(summary, sizeof(summary), file) != NULL)
+	{
+		if(strstr(summary, "records (") != NULL)
+		{
+			break;
+		}
+	}
+	if(file != NULL)
+	{
+		fclose(file);
+	}
+	if(strcmp(summary, line) != 0)
+	{
+		printf("%d records, %s: decoder said %s", num_written, dump, summary);
+		errors++;
+	}
+}
+
+// check the log holds what it should, then round trip it through the decoder
+static void check(void)
+{
+	int oldest = oldest_kept();
+	int kept = num_written - oldest;
+	uint32_t words = 0;
+	int i;
+
+	for(i = oldest; i < num_written; i++)
+	{
+		words += written[i].words;
+	}
+	if(trace_log.records != num_written || trace_log.lost != oldest ||
+		trace_log.head - trace_log.first != words)
+	{
+		printf("%d records: log has %u written, %u lost, %u words (should be %d, %d, %u)\n",
+			num_written, trace_log.records, trace_log.lost, trace_log.head - trace_log.first,
+			num_written, oldest, words);
+		errors++;
+	}
+
+	const char * expected = expected_output(oldest);
+	dump_binary(DUMP_BIN);
+	check_decode(DUMP_BIN, expected, kept);
+	dump_hex(DUMP_HEX);
+	check_decode(DUMP_HEX, expected, kept);
+
+	printf("%5d records: %3d in the log (%4u words), head at %08X, cycle counter "
+		"at %08X\n", num_written, kept, words, trace_log.head, shim_dwt.CYCCNT);
+}
+
+int main(void)
+{
+	static const int checkpoints[] = {5, 40, 1000, 1001, 1002, 1003, 2500, RECORDS};
+	unsigned int next = 0;
+
+	trace_init(CLOCK);
+
+	// start the word counts just short of wrapping round, and the cycle counter
+	// at some random point
+	trace_log.head = trace_log.first = 0xFFFFFFFF - 3 * TRACE_SIZE;
+	shim_dwt.CYCCNT = next_random();
+
+	printf("a %d word log, %d records\n\n", TRACE_SIZE, RECORDS);
+	while(num_written < RECORDS)
+	{
+		write_record();
+		if(num_written == checkpoints[next])
+		{
+			check();
+			next++;
+		}
+	}
+
+	remove(DUMP_BIN);
+	remove(DUMP_HEX);
+	remove(DECODER_ERRORS);
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,452 @@
+/*
+ * tx_queue_sim.c
+ *
+ * the xbee transmit queue (src/xbee_tx_queue.c) with a simulated uart draining
+ * it at the link rate, fed by three threads the way xbee_tx_add in src/xbee.c
+ * feeds it - a thread that finds the queue full waits on the slot semaphore,
+ * which the completion interrupt gives a token back to each time a frame goes:
+ *
+ * - the action thread sends batches of remote at commands (copied into the
+ *   queue's own buffers)
+ * - a timer sends the prebuilt sampling packet from where it is (by reference,
+ *   falling back to a copy if the last one hasn't gone yet - like
+ *   send_prebuilt_frame in src/xbee_processing_thread.c)
+ * - a thread sends the odd local at command and waits for it to go
+ *
+ * every frame has to go out once, in the order it was queued, and with the
+ * bytes it had when it was queued (so a frame sent by reference mustn't be
+ * changed until its callback says it has gone)
+ *
+ * each link rate is run twice - with the semaphore (the waiting threads get the
+ * slots in the order they started waiting, as soon as the interrupt frees 
+ * them) and the way xbee_tx_add used to do it (holding the lock and trying 
+ * again every ms) - to show how long the threads wait to get a frame in
+ *
+ * usage: make && ./tx_queue_sim
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <string.h>
+
+// include the transmit queue
+#include "xbee_tx_queue.h"
+
+// the biggest frame (XBEE_MAX_TX_FRAME) and how long to run for
+#define MAX_FRAME				128
+#define RUN_TIME				120000					// ms
+#define STEPS_PER_MS		100							// the uart is stepped every 10 us
+
+// the threads
+#define ACTION_THREAD		0
+#define TIMER_THREAD		1
+#define AT_THREAD				2
+#define THREADS					3
+
+static const char * const thread_names[THREADS] = {"action", "timer", "at command"};
+
+// a thread trying to send a frame
+typedef struct
+{
+	int				waiting;					// has a frame to get into the queue
+	uint32_t	since;						// when it started trying (ms)
+	uint32_t	next;							// when it next has something to send (ms)
+	int				left;							// frames left in this batch
+	uint8_t		frame[MAX_FRAME];	// the frame it's sending
+	int				length;
+	int				by_reference;
+
+	// what happened to it
+	uint32_t	frames;
+	uint32_t	wait_total;
+	uint32_t	wait_max;
+}
+sim_thread_t;
+
+static sim_thread_t threads[THREADS];
+
+// the queue and the buffers frames get copied into (like xbee_tx_buffer)
+static xbee_tx_queue_t queue;
+static uint8_t buffers[XBEE_TX_QUEUE_DEPTH][MAX_FRAME];
+
+// the prebuilt sampling packet, and whether the uart is still sending it
+static uint8_t prebuilt[21];
+static volatile uint8_t prebuilt_in_flight;
+
+// what each frame in the queue should look like when it goes (oldest first)
+static uint8_t expected[XBEE_TX_QUEUE_DEPTH][MAX_FRAME];
+static int expected_length[XBEE_TX_QUEUE_DEPTH];
+static uint32_t expected_head, expected_tail;
+
+// the simulated uart - the frame going out and how many steps it has left
+static const xbee_tx_frame_t * sending;
+static uint32_t sending_steps;
+static uint32_t steps_per_byte;
+static uint32_t busy_steps;
+
+// the old way - the thread holding the lock while it waits for room
+static int lock_holder;
+static int polled;
+
+// the semaphore - its tokens, and the threads waiting on it (oldest first)
+static uint32_t tokens;
+static int waiters[THREADS];
+static int num_waiters;
+
+static uint32_t now_ms;
+static int errors = 0;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// THE UART
+
+static void uart_start(const xbee_tx_frame_t * frame)
+{
+	sending = frame;
+	sending_steps = frame->length * steps_per_byte;
+}
+
+// the dma has finished - check the frame was what was queued, then the
+// completion interrupt starts the next one
+static void uart_complete(void)
+{
+	uint32_t n = expected_tail++ % XBEE_TX_QUEUE_DEPTH;
+
+	if(sending->length != expected_length[n] ||
+		memcmp(sending->data, expected[n], sending->length) != 0)
+	{
+		printf("%u ms: frame %u went out different to how it was queued\n", now_ms,
+			expected_tail - 1);
+		errors++;
+	}
+
+	const xbee_tx_frame_t * next = xbee_tx_queue_complete(&queue);
+	sending = NULL;
+	if(next != NULL)
+	{
+		uart_start(next);
+	}
+	tokens++;
+}
+
+static void uart_step(void)
+{
+	if(sending != NULL)
+	{
+		busy_steps++;
+		if(--sending_steps == 0)
+		{
+			uart_complete();
+		}
+	}
+}
+
+// THE THREADS
+
+// the prebuilt frame has gone (called from the completion interrupt)
+static void prebuilt_sent(const uint8_t * frame, int length, void * context)
+{
+	*(volatile uint8_t *)context = 0;
+}
+
+// make a frame of a given length (with a header and checksum, and different
+// every time)
+static void make_frame(uint8_t * frame, int length)
+{
+	uint8_t sum = 0;
+	int i;
+
+	frame[0] = 0x7E;
+	frame[1] = 0;
+	frame[2] = length - 4;
+	for(i = 3; i < length - 1; i++)
+	{
+		frame[i] = next_random();
+		sum += frame[i];
+	}
+	frame[length - 1] = 0xFF - sum;
+}
+
+// give a thread its next frame to send, if it's time
+static void next_frame(sim_thread_t * thread, int id)
+{
+	if(thread->waiting || now_ms < thread->next)
+	{
+		return;
+	}
+
+	switch(id)
+	{
+		case ACTION_THREAD:
+			// a batch of remote at commands every 200 ms or so
+			if(thread->left == 0)
+			{
+				thread->left = 1 + next_random() % 24;
+			}
+			make_frame(thread->frame, 19 + next_random() % 2);
+			thread->length = thread->frame[2] + 4;
+			thread->by_reference = 0;
+			if(--thread->left == 0)
+			{
+				thread->next = now_ms + 150 + next_random() % 100;
+			}
+			break;
+
+		case TIMER_THREAD:
+			// the sampling packet every second (with a new frame id, as tracking it
+			// rewrites the frame id in place - unless it's still going out, in
+			// which case a copy is sent)
+			if(prebuilt_in_flight)
+			{
+				memcpy(thread->frame, prebuilt, sizeof(prebuilt));
+				thread->by_reference = 0;
+			}
+			else
+			{
+				uint8_t old_id = prebuilt[4];
+				prebuilt[4] = (old_id == 255) ? 1 : old_id + 1;
+				prebuilt[20] += old_id - prebuilt[4];
+				thread->by_reference = 1;
+			}
+			thread->length = sizeof(prebuilt);
+			thread->next = now_ms + 1000;
+			break;
+
+		case AT_THREAD:
+			// a local at command now and again
+			make_frame(thread->frame, 8 + next_random() % 4);
+			thread->length = thread->frame[2] + 4;
+			thread->by_reference = 0;
+			thread->next = now_ms + 50 + next_random() % 500;
+			break;
+	}
+	thread->waiting = 1;
+	thread->since = now_ms;
+}
+
+// put a thread's frame into a slot it has been given
+static void fill_slot(sim_thread_t * thread)
+{
+	xbee_tx_frame_t * slot = xbee_tx_queue_claim(&queue);
+
+	if(slot == NULL)
+	{
+		printf("%u ms: no room in the queue for a thread with a token\n", now_ms);
+		errors++;
+		return;
+	}
+
+	uint8_t * buffer = buffers[slot - queue.frames];
+	if(thread->by_reference)
+	{
+		slot->data = prebuilt;
+		slot->callback = prebuilt_sent;
+		slot->context = (void *)&prebuilt_in_flight;
+		prebuilt_in_flight = 1;
+	}
+	else
+	{
+		memcpy(buffer, thread->frame, thread->length);
+		slot->data = buffer;
+		slot->callback = NULL;
+		slot->context = NULL;
+	}
+	slot->length = thread->length;
+
+	uint32_t n = expected_head++ % XBEE_TX_QUEUE_DEPTH;
+	memcpy(expected[n], slot->data, slot->length);
+	expected_length[n] = slot->length;
+
+	xbee_tx_queue_commit(&queue);
+
+	// xbee_tx_kick (with the completion interrupt held off)
+	const xbee_tx_frame_t * frame = xbee_tx_queue_start(&queue);
+	if(frame != NULL)
+	{
+		uart_start(frame);
+	}
+
+	uint32_t wait = now_ms - thread->since;
+	thread->frames++;
+	thread->wait_total += wait;
+	if(wait > thread->wait_max)
+	{
+		thread->wait_max = wait;
+	}
+	thread->waiting = 0;
+}
+
+// a thread has a go at getting its frame into the queue (as xbee_tx_add)
+static void try_add(sim_thread_t * thread, int id)
+{
+	int i;
+
+	if(!thread->waiting)
+	{
+		return;
+	}
+
+	if(polled)
+	{
+		// hold the lock, and if there's no room try again in a ms
+		if(lock_holder >= 0 && lock_holder != id)
+		{
+			return;
+		}
+		lock_holder = id;
+		if(queue.head - queue.tail >= XBEE_TX_QUEUE_DEPTH)
+		{
+			queue.stats.full++;
+			return;
+		}
+		fill_slot(thread);
+		lock_holder = -1;
+		return;
+	}
+
+	// already waiting on the semaphore
+	for(i = 0; i < num_waiters; i++)
+	{
+		if(waiters[i] == id)
+		{
+			return;
+		}
+	}
+	if(tokens > 0 && num_waiters == 0)
+	{
+		tokens--;
+		fill_slot(thread);
+		return;
+	}
+	queue.stats.full++;
+	waiters[num_waiters++] = id;
+}
+
+// the interrupt has given tokens back - wake up the threads waiting for them
+static void wake_waiters(void)
+{
+	while(tokens > 0 && num_waiters > 0)
+	{
+		int id = waiters[0];
+		tokens--;
+		num_waiters--;
+		memmove(waiters, waiters + 1, num_waiters * sizeof(waiters[0]));
+		fill_slot(&threads[id]);
+	}
+}
+
+// RUNNING
+
+static void run(uint32_t baud, int poll)
+{
+	int i, step;
+
+	memset(threads, 0, sizeof(threads));
+	xbee_tx_queue_init(&queue);
+	make_frame(prebuilt, sizeof(prebuilt));
+	prebuilt_in_flight = 0;
+	expected_head = expected_tail = 0;
+	sending = NULL;
+	busy_steps = 0;
+	lock_holder = -1;
+	polled = poll;
+	tokens = XBEE_TX_QUEUE_DEPTH;
+	num_waiters = 0;
+
+	// ten bits a byte (a start bit, eight data bits and a stop bit)
+	steps_per_byte = (10 * 1000 * STEPS_PER_MS + baud / 2) / baud;
+
+	for(now_ms = 0; now_ms < RUN_TIME; now_ms++)
+	{
+		// the threads get a go once a ms, in a random order (but a thread
+		// waiting on the lock gets it as soon as it's let go, and one waiting on
+		// the semaphore gets a token as soon as the interrupt gives it back)
+		int first = next_random() % THREADS;
+		for(i = 0; i < THREADS; i++)
+		{
+			int id = (first + i) % THREADS;
+			next_frame(&threads[id], id);
+			try_add(&threads[id], id);
+		}
+		for(i = 0; i < THREADS; i++)
+		{
+			try_add(&threads[i], i);
+		}
+
+		for(step = 0; step < STEPS_PER_MS; step++)
+		{
+			uart_step();
+			if(!polled)
+			{
+				wake_waiters();
+			}
+		}
+	}
+
+	// let the queue empty
+	while(sending != NULL)
+	{
+		uart_step();
+	}
+
+	printf("%6u  %-9s %5.1f%% %6u %6u %7u %5u", baud, poll ? "polled" : "semaphore",
+		100.0 * busy_steps / ((double)RUN_TIME * STEPS_PER_MS), queue.stats.sent,
+		queue.stats.bytes, queue.stats.full, queue.stats.high_water);
+	for(i = 0; i < THREADS; i++)
+	{
+		printf("  %6.2f %5u", threads[i].frames ?
+			(double)threads[i].wait_total / threads[i].frames : 0.0, threads[i].wait_max);
+	}
+	printf("\n");
+
+	if(queue.stats.sent != queue.stats.queued || expected_tail != expected_head ||
+		xbee_tx_queue_depth(&queue) != 0 || prebuilt_in_flight ||
+		(!polled && tokens != XBEE_TX_QUEUE_DEPTH))
+	{
+		printf("  %u frames queued, %u sent\n", queue.stats.queued, queue.stats.sent);
+		errors++;
+	}
+}
+
+int main(void)
+{
+	static const uint32_t bauds[] = {9600, 115200, 230400};
+	unsigned int i;
+
+	printf("%u s of traffic, a %d frame queue\n\n", RUN_TIME / 1000, XBEE_TX_QUEUE_DEPTH);
+	printf("%6s  %-9s %6s %6s %6s %7s %5s", "baud", "waiting", "busy", "frames", "bytes",
+		"full", "high");
+	for(i = 0; i < THREADS; i++)
+	{
+		printf("  %12s", thread_names[i]);
+	}
+	printf("\n%43s", "");
+	for(i = 0; i < THREADS; i++)
+	{
+		printf("  %6s %5s", "mean", "worst");
+	}
+	printf("\n");
+
+	for(i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++)
+	{
+		run(bauds[i], 0);
+		run(bauds[i], 1);
+	}
+	printf("\nwaiting: on the slot semaphore, or polling every ms with the lock held, "
+		"busy: how\nmuch of the time the uart was sending, full: times a frame had to "
+		"wait for room\n(polled: each try), high: the most frames waiting, then how long "
+		"(in ms) each\nthread waited to get a frame in\n");
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,283 @@
+/*
+ * uart_errors_test.c
+ *
+ * the uart error counters (src/uart_errors.c) against a simulated uart -
+ * errors turn up on the line at random and set the status flags (which stay
+ * set until they're cleared, so two of the same error before the interrupt
+ * gets to them is one flag), then the uart interrupt does what
+ * USART1_IRQHandler and USART6_IRQHandler do:
+ *
+ * - uart_errors_clear looks at the flags, counts them and writes them to the
+ *   clear register (and nothing else - the receive and transmit flags have to
+ *   be left alone)
+ * - then the hal interrupt handler sees anything that came up since (it
+ *   clears those itself and the error callback counts them with
+ *   uart_errors_count, as vcom_uart_error does), and now and again a dma
+ *   error goes the same way
+ *
+ * every flag raised has to be counted once, under the right kind of error, by
+ * one path or the other
+ *
+ * usage: make && ./uart_errors_test
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <string.h>
+
+// include the error counters
+#include "uart_errors.h"
+
+// how many interrupts to run for
+#define RUN_INTERRUPTS		1000000
+
+// the receive and transmit flags (these aren't errors, so they mustn't be
+// cleared)
+#define USART_ISR_RXNE		0x00000020U
+#define USART_ISR_TC			0x00000040U
+
+// the kinds of error (the status flag, what to clear it with and the hal
+// error code for it)
+#define KINDS							4
+
+static const struct
+{
+	const char *	name;
+	uint32_t			isr;
+	uint32_t			icr;
+	uint32_t			code;
+}
+kinds[KINDS] =
+{
+	{"overrun",	USART_ISR_ORE,	USART_ICR_ORECF,	HAL_UART_ERROR_ORE},
+	{"framing",	USART_ISR_FE,		USART_ICR_FECF,		HAL_UART_ERROR_FE},
+	{"noise",		USART_ISR_NE,		USART_ICR_NCF,		HAL_UART_ERROR_NE},
+	{"parity",	USART_ISR_PE,		USART_ICR_PECF,		HAL_UART_ERROR_PE},
+};
+
+// the simulated uart and the counters
+static USART_TypeDef uart;
+static uart_error_stats_t stats;
+
+// the flags raised, and which path saw them
+static uint32_t raised[KINDS], by_check, by_hal, dma_errors;
+
+static int errors = 0;
+
+// a simple random number generator (so every run is the same)
+static uint32_t seed = 12345;
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// the counter for each kind of error
+static uint32_t stats_count(const uart_error_stats_t * s, int kind)
+{
+	switch(kind)
+	{
+		case 0:		return s->overrun;
+		case 1:		return s->framing;
+		case 2:		return s->noise;
+		default:	return s->parity;
+	}
+}
+
+// THE UART
+
+// errors on the line (each one has a 1 in 8 chance - the flag only goes up if
+// it isn't already)
+static void line_errors(void)
+{
+	int i;
+
+	for(i = 0; i < KINDS; i++)
+	{
+		if(next_random() % 8 == 0 && !(uart.ISR & kinds[i].isr))
+		{
+			uart.ISR |= kinds[i].isr;
+			raised[i]++;
+		}
+	}
+}
+
+// the hardware clears the flags written to the clear register
+static void uart_clear(void)
+{
+	uart.ISR &= ~uart.ICR;
+	uart.ICR = 0;
+}
+
+// THE INTERRUPT
+
+// the hal interrupt handler - it clears any errors it finds, and the error
+// callback counts them
+static void hal_irq(void)
+{
+	uint32_t error_code = HAL_UART_ERROR_NONE;
+	int i;
+
+	for(i = 0; i < KINDS; i++)
+	{
+		if(uart.ISR & kinds[i].isr)
+		{
+			uart.ICR = kinds[i].icr;
+			uart_clear();
+			error_code |= kinds[i].code;
+		}
+	}
+
+	// the dma error callback comes this way too
+	if(next_random() % 1000 == 0)
+	{
+		error_code |= HAL_UART_ERROR_DMA;
+		dma_errors++;
+	}
+
+	if(error_code != HAL_UART_ERROR_NONE)
+	{
+		uart_errors_count(&stats, error_code);
+		by_hal++;
+	}
+}
+
+// the uart interrupt
+static void uart_irq(void)
+{
+	uint32_t before = uart.ISR;
+	uint32_t expected_code = HAL_UART_ERROR_NONE;
+	uint32_t expected_clear = 0;
+	int i;
+
+	for(i = 0; i < KINDS; i++)
+	{
+		if(before & kinds[i].isr)
+		{
+			expected_code |= kinds[i].code;
+			expected_clear |= kinds[i].icr;
+		}
+	}
+
+	// count and clear the errors (the clear register is left with something in
+	// it that can't be a clear, so we can see if it's written when it shouldn't
+	// be)
+	uart.ICR = 0xFFFFFFFF;
+	uint32_t code = uart_errors_clear(&uart, &stats);
+
+	if(code != expected_code)
+	{
+		printf("flags %02X came back as error code %02X (not %02X)\n", before, code,
+			expected_code);
+		errors++;
+	}
+	if(expected_clear == 0 ? uart.ICR != 0xFFFFFFFF : uart.ICR != expected_clear)
+	{
+		printf("flags %02X were cleared with %08X (not %08X)\n", before, uart.ICR,
+			expected_clear);
+		errors++;
+	}
+	if(expected_clear != 0)
+	{
+		uart_clear();
+		by_check++;
+	}
+	else
+	{
+		uart.ICR = 0;
+	}
+	if((uart.ISR & (USART_ISR_RXNE | USART_ISR_TC)) != (before & (USART_ISR_RXNE | USART_ISR_TC)))
+	{
+		printf("the receive and transmit flags changed\n");
+		errors++;
+	}
+
+	// sometimes another error turns up before the hal gets to look
+	if(next_random() % 4 == 0)
+	{
+		line_errors();
+	}
+	hal_irq();
+}
+
+// RUNNING
+
+// every hal error code has to add one to the right counters and nothing else
+static void test_count(void)
+{
+	uint32_t code;
+	int i;
+
+	for(code = 0; code < 32; code++)
+	{
+		uart_error_stats_t s;
+		memset(&s, 0, sizeof(s));
+		uart_errors_count(&s, code);
+		uart_errors_count(&s, code);
+
+		for(i = 0; i < KINDS; i++)
+		{
+			if(stats_count(&s, i) != ((code & kinds[i].code) ? 2 : 0))
+			{
+				printf("error code %02X counted %u %s errors\n", code, stats_count(&s, i),
+					kinds[i].name);
+				errors++;
+			}
+		}
+		if(s.dma != ((code & HAL_UART_ERROR_DMA) ? 2 : 0))
+		{
+			printf("error code %02X counted %u dma errors\n", code, s.dma);
+			errors++;
+		}
+	}
+}
+
+int main(void)
+{
+	int i, n;
+
+	test_count();
+
+	for(n = 0; n < RUN_INTERRUPTS; n++)
+	{
+		// the receive and transmit flags come and go on their own
+		uart.ISR = (uart.ISR & ~(USART_ISR_RXNE | USART_ISR_TC)) |
+			(next_random() & (USART_ISR_RXNE | USART_ISR_TC));
+
+		// most of the time the interrupt is for something else
+		if(next_random() % 2 == 0)
+		{
+			line_errors();
+		}
+		uart_irq();
+	}
+
+	printf("%d interrupts, %u with errors cleared first, %u with errors left for the hal\n\n",
+		RUN_INTERRUPTS, by_check, by_hal);
+	printf("%-8s %8s %8s\n", "", "raised", "counted");
+	for(i = 0; i < KINDS; i++)
+	{
+		printf("%-8s %8u %8u\n", kinds[i].name, raised[i], stats_count(&stats, i));
+		if(stats_count(&stats, i) != raised[i])
+		{
+			errors++;
+		}
+	}
+	printf("%-8s %8u %8u\n", "dma", dma_errors, stats.dma);
+	if(stats.dma != dma_errors)
+	{
+		errors++;
+	}
+	if(uart.ISR & (USART_ISR_ORE | USART_ISR_FE | USART_ISR_NE | USART_ISR_PE))
+	{
+		printf("errors left uncleared\n");
+		errors++;
+	}
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * config_qspi.h
+ *
+ * keep the config store in the n25q128a qspi flash on the discovery board (in
+ * the top CONFIG_QSPI_BLOCKS 4k subsectors, well out of the way of anything
+ * else that might use it)
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __CONFIG_QSPI_H
+#define __CONFIG_QSPI_H
+
+// include the config store
+#include "config_store.h"
+
+// if we've not defined CONFIG_QSPI_BLOCKS elsewhere ...
+#ifndef CONFIG_QSPI_BLOCKS
+	// how many subsectors to spread the store over (64k)
+	#define CONFIG_QSPI_BLOCKS 16
+#endif
+
+// function prototypes
+
+// set up the qspi flash and read the store (while the flash is memory
+// mapped), then leave it ready for the store to write to - returns
+// CONFIG_STORE_OK or CONFIG_STORE_FLASH_ERROR
+int config_qspi_open(config_store_t * store);
+
+#endif // CONFIG_QSPI_H
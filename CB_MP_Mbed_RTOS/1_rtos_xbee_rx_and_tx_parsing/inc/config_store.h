@@ -0,0 +1,145 @@
+/*
+ * config_store.h
+ *
+ * keep settings in flash so they survive a reset - a small key / value store
+ * where every change is written as a new record on the end of a log, so flash
+ * is only ever programmed in one place at a time and each block gets erased
+ * about as often as every other one
+ *
+ * the log is spread over a few erase blocks. each block starts with a header
+ * holding a sequence number (so we know which order they were filled in), and
+ * is then filled with records - the key, the value and a crc over both. a
+ * record that was only half written when the power went fails its crc, and
+ * the block it's in is then left alone (new records go in the next block)
+ *
+ * at start up the whole log is read once (straight out of memory mapped flash)
+ * to build an index in ram of where the latest record for each key is - after
+ * that a get is one read and a put is one write. the blocks are filled in
+ * turn, always keeping one erased - when a new block is needed and there's
+ * only that one left, anything still wanted from the oldest block is copied
+ * into it and the oldest block is erased (so it becomes the spare). if the
+ * power goes part way through, the copy is thrown away and done again.
+ * config_store_maintain does this ahead of time when there's nothing else
+ * going on, so a put doesn't usually have to wait for an erase
+ *
+ * note: this doesn't touch the hardware (the flash is reached through the
+ * functions in config_flash_t) so it can be built on a pc too, and it doesn't
+ * do any locking - only one thread should use a store at once
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __CONFIG_STORE_H
+#define __CONFIG_STORE_H
+
+// include the standard integer types
+#include <stdint.h>
+
+// if we've not defined CONFIG_STORE_MAX_KEYS elsewhere ...
+#ifndef CONFIG_STORE_MAX_KEYS
+	// the most keys we can hold
+	#define CONFIG_STORE_MAX_KEYS 256
+#endif
+
+// if we've not defined CONFIG_STORE_MAX_BLOCKS elsewhere ...
+#ifndef CONFIG_STORE_MAX_BLOCKS
+	// the most erase blocks the log can be spread over
+	#define CONFIG_STORE_MAX_BLOCKS 32
+#endif
+
+// the biggest value we can store (in bytes)
+#define CONFIG_STORE_MAX_VALUE 64
+
+// the key an erased record has (so it can't be used)
+#define CONFIG_STORE_NO_KEY 0xFFFFFFFF
+
+// what the functions return (get returns the length of the value instead of
+// CONFIG_STORE_OK)
+#define CONFIG_STORE_OK           0
+#define CONFIG_STORE_NOT_FOUND   -1
+#define CONFIG_STORE_FULL        -2			// no room for another key, or the log is full
+#define CONFIG_STORE_BAD_VALUE   -3			// too big (or a bad key)
+#define CONFIG_STORE_FLASH_ERROR -4
+
+// how to reach the flash (addresses are from the start of the store, and each
+// function returns 0 if it worked) - mapped is only used by config_store_open,
+// so it can stop being valid once that has returned
+typedef struct
+{
+	const uint8_t *		mapped;
+	uint32_t					block_size;
+	uint16_t					blocks;
+	int								(*read)(uint32_t address, void * data, uint32_t length);
+	int								(*write)(uint32_t address, const void * data, uint32_t length);
+	int								(*erase)(uint32_t address);
+}
+config_flash_t;
+
+// where the latest record for a key is
+typedef struct
+{
+	uint32_t	key;
+	uint32_t	address;
+	uint16_t	length;
+}
+config_index_t;
+
+// counters for what the store has been up to
+typedef struct
+{
+	uint32_t	scanned;								// records read at start up
+	uint32_t	bad_records;						// records that failed their crc
+	uint32_t	puts;
+	uint32_t	written;								// bytes programmed (puts and copies)
+	uint32_t	copied;									// records moved out of blocks being erased
+	uint32_t	erases;
+}
+config_store_stats_t;
+
+// the store - index is kept sorted by key, so to go round all the keys just
+// go through index[0] to index[count - 1]
+typedef struct
+{
+	const config_flash_t *	flash;
+	uint16_t								count;
+	config_index_t					index[CONFIG_STORE_MAX_KEYS];
+	uint32_t								live;											// bytes of records still wanted
+
+	uint8_t									state[CONFIG_STORE_MAX_BLOCKS];
+	uint32_t								sequence[CONFIG_STORE_MAX_BLOCKS];
+	uint32_t								next_sequence;
+	uint16_t								head;											// the block being written
+	uint32_t								head_offset;							// where the next record goes in it
+
+	config_store_stats_t		stats;
+}
+config_store_t;
+
+// function prototypes
+
+// read the log and build the index - returns CONFIG_STORE_OK, or
+// CONFIG_STORE_BAD_VALUE if the flash is the wrong shape for the store
+int  config_store_open(config_store_t * store, const config_flash_t * flash);
+
+// copy the value for a key into value (up to size bytes) - returns its length
+// or CONFIG_STORE_NOT_FOUND
+int  config_store_get(config_store_t * store, uint32_t key, void * value, uint16_t size);
+
+// set (or remove) the value for a key
+int  config_store_put(config_store_t * store, uint32_t key, const void * value,
+	uint16_t length);
+int  config_store_delete(config_store_t * store, uint32_t key);
+
+// find the key whose value was written longest ago (for picking one to throw
+// away when the store is full - a value copied out of a block that was being
+// cleared out counts as written when it was copied) - returns CONFIG_STORE_OK
+// or CONFIG_STORE_NOT_FOUND if the store is empty
+int  config_store_oldest(config_store_t * store, uint32_t * key);
+
+// do a bit of tidying up (erase a block that needs it, or clear out the
+// oldest block when we're running short of erased ones) - returns 1 if it did
+// something (so there may be more to do), 0 if not, or an error
+int  config_store_maintain(config_store_t * store);
+
+#endif // CONFIG_STORE_H
@@ -4,19 +4,91 @@
  * print debugging information to the itm debug viewer in uvision
  *
  * we use this for debugging because it doesn't interfere with the uart output
- * on the virtual com port.  we can have debugging stuff go to the itm viewer 
+ * on the virtual com port.  we can have debugging stuff go to the itm viewer
  * and program output to the uart.
  *
+ * as well as the text on stimulus port 0, each part of the system can send
+ * binary records on a port of its own (so they can be traced separately) - a
+ * record is a header word (a sync byte, the number of data words and an event
+ * id), the cycle counter (started by trace_init), and then the data words.
+ * tools/swo_demux.py splits a captured swo stream back up into a file for each
+ * port.
+ *
+ * none of this ever waits for the itm - if its fifo is full (or the port isn't
+ * turned on) the text / record is thrown away and counted instead, so tracing
+ * doesn't change the timing of what we're tracing
+ *
  * author:    Alex Shenfield
  * date:      08/11/2017
  * purpose:   55-604481 embedded computer networks : lab 104
  */
- 
+
 // define to prevent recursive inclusion
 #ifndef __ITM_DEBUG_H
 #define __ITM_DEBUG_H
- 
-// simple debug helper function 
+
+// include the basic headers
+#include "stm32f7xx.h"
+
+// the stimulus port for each part of the system (the ports have to be turned
+// on in the debugger's trace settings - 0x1F for all of them)
+#define ITM_CH_CONSOLE      0
+#define ITM_CH_PARSER       1
+#define ITM_CH_SCHEDULER    2
+#define ITM_CH_ACTUATION    3
+#define ITM_CH_METRICS      4
+#define ITM_CHANNELS        5
+
+// the top byte of every record header
+#define ITM_SYNC 0xA5
+
+// the events (the numbers are what the decoder sees, so don't reuse them)
+typedef enum
+{
+	// parser - a frame failed its checksum (length, checksum, sum) and the
+	// parser threw away a part frame (bytes dropped)
+	ITM_EV_BAD_CHECKSUM = 1,
+	ITM_EV_RESYNC = 2,
+
+	// scheduler - a command was answered or given up on (frame id, status,
+	// latency in kernel ticks) and the request timer found some that need
+	// resending (1)
+	ITM_EV_REQUEST_DONE = 16,
+	ITM_EV_RETRY_DUE = 17,
+
+	// actuation - a batch went out (frames, nodes, frames resent)
+	ITM_EV_FLUSH = 32,
+
+	// metrics - the transmit queue (waiting, high water, full), the vcom
+	// output (high water, dropped, overwritten), the uart 6 errors (overrun,
+	// framing, noise), the parser (bad checksums, resyncs, bytes dropped), the
+	// dma receive buffer (interrupts, overruns) and the uart 1 errors (overrun,
+	// framing, noise, dma)
+	ITM_EV_TX_QUEUE = 48,
+	ITM_EV_VCOM_OUTPUT = 49,
+	ITM_EV_UART_ERRORS = 50,
+	ITM_EV_PARSER_STATS = 51,
+	ITM_EV_RX_DMA = 52,
+	ITM_EV_VCOM_ERRORS = 53
+}
+itm_event_t;
+
+// simple debug helper function
 void print_debug(char* s, int length);
- 
+
+// send a record on one of the ports - returns 0 if it (or any of it) had to
+// be thrown away
+int  itm_send(uint32_t channel, itm_event_t event, const uint32_t * words,
+	uint32_t count);
+
+// the number of records (or for the console, characters) thrown away on a
+// port
+uint32_t itm_dropped(uint32_t channel);
+
+// send a record with the data words given as arguments
+#define ITM_SEND(channel, event, ...) do { \
+		const uint32_t itm_words[] = {__VA_ARGS__}; \
+		itm_send(channel, event, itm_words, sizeof(itm_words) / sizeof(uint32_t)); \
+	} while(0)
+
 #endif // ITM_DEBUG_H
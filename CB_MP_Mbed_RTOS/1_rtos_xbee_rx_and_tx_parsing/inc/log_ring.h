@@ -0,0 +1,94 @@
+/*
+ * log_ring.h
+ *
+ * a ring buffer of text waiting to go out of a uart - printf appends to it and
+ * the uart takes it out a chunk at a time (into a buffer of its own, which it
+ * sends with dma), so printing doesn't hold the calling thread up while the
+ * characters go out
+ *
+ * the ring has no locking of its own - several threads (and the uart
+ * interrupt) use it, so every call has to be made with interrupts held off
+ *
+ * when there isn't room for everything, what happens depends on the policy:
+ *
+ *   LOG_RING_DROP      - throw away the new text that doesn't fit
+ *   LOG_RING_OVERWRITE - throw away the oldest text to make room
+ *   LOG_RING_BLOCK     - take what fits and leave the caller to wait for room
+ *                        and try again with the rest
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __LOG_RING_H
+#define __LOG_RING_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+
+// what to do when the ring is full
+typedef enum
+{
+	LOG_RING_DROP,
+	LOG_RING_OVERWRITE,
+	LOG_RING_BLOCK
+}
+log_ring_policy_t;
+
+// what has been through the ring (in bytes - apart from blocked, which is the
+// number of times a write had to wait for room)
+typedef struct
+{
+	uint32_t	written;
+	uint32_t	sent;
+	uint32_t	dropped;
+	uint32_t	overwritten;
+	uint32_t	blocked;
+	uint32_t	high_water;
+}
+log_ring_stats_t;
+
+// the ring - head and tail are free running counters
+typedef struct
+{
+	uint8_t *						buffer;
+	uint32_t						size;
+	log_ring_policy_t		policy;
+
+	uint32_t						head;
+	uint32_t						tail;
+
+	log_ring_stats_t		stats;
+}
+log_ring_t;
+
+//
+// global methods:
+//
+
+// set up the ring (size must be a power of two)
+void     log_ring_init(log_ring_t * ring, uint8_t * buffer, uint32_t size,
+	log_ring_policy_t policy);
+
+// add text to the ring - returns how much of it was taken (with LOG_RING_BLOCK
+// this can be less than length, and the caller should wait and then write the
+// rest)
+uint32_t log_ring_write(log_ring_t * ring, const uint8_t * data, uint32_t length);
+
+// throw away text we couldn't wait to write (e.g. with LOG_RING_BLOCK from an
+// interrupt)
+void     log_ring_discard(log_ring_t * ring, uint32_t length);
+
+// add a character for a caller printing a character at a time - returns 0 if
+// the caller should wait for room and try again (only with LOG_RING_BLOCK, and
+// only if it can wait - otherwise the character is thrown away) or 1 if it's
+// been dealt with
+int      log_ring_putc(log_ring_t * ring, uint8_t c, int can_wait);
+
+// take up to length bytes out of the ring to send - returns how many
+uint32_t log_ring_read(log_ring_t * ring, uint8_t * data, uint32_t length);
+
+// the number of bytes in the ring
+uint32_t log_ring_count(const log_ring_t * ring);
+
+#endif // LOG_RING_H
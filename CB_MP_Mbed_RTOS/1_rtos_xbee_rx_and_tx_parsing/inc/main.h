@@ -16,13 +16,16 @@
 #include "stm32f7xx_hal.h"
 #include "cmsis_os.h"
 
+// include the xbee frame builder (for the xbee address type)
+#include "xbee_frame_builder.h"
+
 // set up our mailbox
 
 // mail data structure
 typedef struct 
 {
-	uint8_t 	isCommand;
-	uint32_t	slAddress;
+	uint8_t 	isCommand;				// 0 = set outputs, 1 = IS, 2 = resend requests, 3 = ND sweep
+	xbee_address_t	address;		// where to send the commands
 	uint16_t	myAddress;
   uint8_t		lightState;
 	uint8_t		acState;
@@ -31,7 +34,7 @@ typedef struct
 mail_t;
 
 typedef struct{
-	uint8_t 	addrArrayElem;
+	uint16_t 	addrArrayElem;		// node id (from the node registry)
 	uint32_t	slAddress;
 	uint16_t	myAddress;
 	uint8_t		pirVal;
@@ -40,15 +43,29 @@ typedef struct{
 } proc_mail;
 
 typedef struct{
-	uint8_t		addrArrayElem;
+	uint16_t	addrArrayElem;		// node id
 	uint16_t	adcVal;
 } thresh_over_mail;
 
 typedef struct{
 	
-	uint8_t		addrArrayElem;
+	uint16_t	addrArrayElem;		// node id
 	float			temperature;
 	float			light;
 }	display_mail;
 
+// a room's settings, as they're saved in flash (keyed by the node's SL)
+#define SAVED_LIGHT_OVERRIDE		0x01
+#define SAVED_HEATING_OVERRIDE	0x02
+#define SAVED_AC_OVERRIDE				0x04
+
+typedef struct{
+	uint64_t	serial;
+	uint16_t	myAddress;
+	uint8_t		upperHeatThreshold;
+	uint8_t		lowerHeatThreshold;
+	uint8_t		lightThreshold;
+	uint8_t		overrides;				// the SAVED_..._OVERRIDE bits
+} room_config_t;
+
 #endif // MAIN_H
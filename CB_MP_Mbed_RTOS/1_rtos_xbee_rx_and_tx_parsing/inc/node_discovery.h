@@ -0,0 +1,86 @@
+/*
+ * node_discovery.h
+ *
+ * find out which nodes are on the network (and notice when they go away) so
+ * nodes can join at any time without restarting the coordinator
+ *
+ * nodes are learnt from:
+ * - the source addresses in every frame they send us (io samples, remote at
+ *   responses) - a node we've not seen before is added straight away
+ * - node discover (ND) sweeps - the coordinator xbee sends one at command
+ *   response for each node that answers, so we ask every so often to catch
+ *   nodes that haven't sent us anything yet
+ *
+ * a node we don't hear from at all for the expiry time is removed (and its id
+ * handed out again later)
+ *
+ * note: this just keeps the books (times are in whatever units the caller
+ * uses, as long as the period and expiry are in the same units) - sending the
+ * ND command and locking are up to the caller, and only the thread that owns
+ * the node registry should call it
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __NODE_DISCOVERY_H
+#define __NODE_DISCOVERY_H
+
+// include the node registry
+#include "node_registry.h"
+
+// what happened to a node we heard from
+#define NODE_HEARD_KNOWN    0					// nothing new
+#define NODE_HEARD_NEW      1					// we've not seen it before (or since it expired)
+#define NODE_HEARD_MOVED    2					// it has a new network address
+
+// counters for what discovery has been up to
+typedef struct
+{
+	uint32_t	learnt;									// nodes added from the frames they sent
+	uint32_t	discovered;							// nodes added from ND responses
+	uint32_t	moved;									// nodes with a new network address
+	uint32_t	expired;
+	uint32_t	sweeps;
+	uint32_t	bad_responses;					// ND responses too short to use
+	uint32_t	ignored;								// frames from addresses that can't be a node
+	uint32_t	full;										// nodes that didn't fit in the registry
+}
+node_discovery_stats_t;
+
+// the discovery state
+typedef struct
+{
+	node_registry_t *				registry;
+	uint32_t								period;							// time between ND sweeps
+	uint32_t								expiry;							// how long a node can be quiet for
+	uint32_t								next_sweep;
+	uint32_t								last_heard[NODE_REGISTRY_SIZE];
+	node_discovery_stats_t	stats;
+}
+node_discovery_t;
+
+// function prototypes
+
+// set up discovery (the first sweep is due straight away)
+void      node_discovery_init(node_discovery_t * discovery, node_registry_t * registry,
+	uint32_t period, uint32_t expiry, uint32_t now);
+
+// we've had a frame from a node - returns its id (adding it if it's new) or
+// NODE_NONE, and sets change to one of the NODE_HEARD values
+node_id_t node_discovery_heard(node_discovery_t * discovery, uint64_t serial,
+	uint16_t my_address, uint32_t now, int * change);
+
+// we've had an ND response (the data from the at command response, which
+// starts with the node's MY, SH and SL)
+node_id_t node_discovery_nd_response(node_discovery_t * discovery, const uint8_t * data,
+	uint16_t length, uint32_t now, int * change);
+
+// is it time for another ND sweep (if so the next one is scheduled)
+int       node_discovery_sweep_due(node_discovery_t * discovery, uint32_t now);
+
+// remove a node we've not heard from for too long - returns its id, or
+// NODE_NONE if there aren't any (so call it until it returns NODE_NONE)
+node_id_t node_discovery_expire(node_discovery_t * discovery, uint32_t now);
+
+#endif // NODE_DISCOVERY_H
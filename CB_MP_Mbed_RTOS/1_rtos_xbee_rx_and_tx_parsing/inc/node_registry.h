@@ -0,0 +1,100 @@
+/*
+ * node_registry.h
+ *
+ * keep track of the xbee nodes (rooms) we know about, so a frame can be
+ * matched to its node by either of its addresses - the 16 bit network (MY)
+ * address that most frames carry, or the 64 bit serial number that never
+ * changes
+ *
+ * each node gets a small id (0 up to NODE_REGISTRY_SIZE - 1) when it is first
+ * added, which stays the same until the node is removed, so the rest of the
+ * program can keep its own per node state in plain arrays indexed by it (the
+ * ids of removed nodes get handed out again, so that state needs resetting
+ * when a node is added). the two addresses are looked up in open addressed
+ * hash tables (linear probing) that are twice the size of the registry, so a
+ * lookup is usually one or two probes however many nodes there are
+ *
+ * note: this doesn't do any locking - only one thread should add nodes, and
+ * everyone else should stick to the ids it hands out
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __NODE_REGISTRY_H
+#define __NODE_REGISTRY_H
+
+// include the standard integer types (this doesn't touch the hardware, so it
+// can be built on a pc too)
+#include <stdint.h>
+
+// if we've not defined NODE_REGISTRY_SIZE elsewhere ...
+#ifndef NODE_REGISTRY_SIZE
+	// the most nodes we can keep track of
+	#define NODE_REGISTRY_SIZE 256
+#endif
+
+// if we've not defined NODE_REGISTRY_HASH_SIZE elsewhere ...
+#ifndef NODE_REGISTRY_HASH_SIZE
+	// the number of slots in each hash table (this has to be a power of two, and
+	// at least twice NODE_REGISTRY_SIZE)
+	#define NODE_REGISTRY_HASH_SIZE 512
+#endif
+
+// what the lookups return for a node we don't know
+#define NODE_NONE 0xFFFF
+
+// a node's network address when we don't know it (this is what the xbee uses
+// too) - nodes with this address can only be found by their serial number
+#define NODE_UNKNOWN_MY 0xFFFE
+
+// a node id
+typedef uint16_t node_id_t;
+
+// counters for how the lookups are going
+typedef struct
+{
+	uint32_t	lookups;
+	uint32_t	misses;
+	uint32_t	probes;					// slots looked at (so probes / lookups is the average)
+	uint32_t	full;						// nodes we couldn't add
+	uint32_t	moved;					// nodes that came back with a new network address
+	uint32_t	removed;
+}
+node_registry_stats_t;
+
+// the registry (the addresses are kept as separate arrays, indexed by node id,
+// and the hash tables hold the node id plus one, so 0 is an empty slot) -
+// count is how many ids have ever been handed out, so to go round all the
+// nodes check in_use for each id below count
+typedef struct
+{
+	uint16_t								count;
+	uint16_t								free_count;
+	uint16_t								free_ids[NODE_REGISTRY_SIZE];
+	uint8_t									in_use[NODE_REGISTRY_SIZE];
+	uint16_t								by_my[NODE_REGISTRY_HASH_SIZE];
+	uint16_t								by_serial[NODE_REGISTRY_HASH_SIZE];
+	uint16_t								my_address[NODE_REGISTRY_SIZE];
+	uint64_t								serial[NODE_REGISTRY_SIZE];
+	node_registry_stats_t		stats;
+}
+node_registry_t;
+
+// function prototypes
+void      node_registry_init(node_registry_t * registry);
+
+// add a node (or if we already know its serial number, update its network
+// address) - returns its id, or NODE_NONE if the registry is full
+node_id_t node_registry_add(node_registry_t * registry, uint64_t serial,
+	uint16_t my_address);
+
+// find a node by its network address or serial number (NODE_NONE if we don't
+// know it)
+node_id_t node_registry_find_my(node_registry_t * registry, uint16_t my_address);
+node_id_t node_registry_find_serial(node_registry_t * registry, uint64_t serial);
+
+// forget a node (its id can then be given to a new node)
+void      node_registry_remove(node_registry_t * registry, node_id_t id);
+
+#endif // NODE_REGISTRY_H
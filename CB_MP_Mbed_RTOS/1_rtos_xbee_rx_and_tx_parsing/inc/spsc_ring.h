@@ -0,0 +1,78 @@
+/*
+ * spsc_ring.h
+ *
+ * a lock free ring buffer of bytes for passing data from one producer (e.g.
+ * an interrupt handler) to one consumer (e.g. a thread) without any kernel
+ * calls or critical sections
+ *
+ * the producer only ever writes the head and the consumer only ever writes the
+ * tail, and both are free running counters (so the ring is empty when they are
+ * equal and full when they are a whole buffer apart). they sit on separate 32
+ * byte cache lines so the two sides don't fight over the same line
+ *
+ * the consumer reads the data in place, as contiguous spans, and then gives
+ * the space back
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __SPSC_RING_H
+#define __SPSC_RING_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+#include <stddef.h>
+
+// the cache line size on the cortex-m7
+#define SPSC_RING_LINE 32
+
+// if we've not defined SPSC_RING_BARRIER elsewhere ...
+#ifndef SPSC_RING_BARRIER
+	// make sure the data is written (or read) before the other side sees the
+	// counter move
+	#define SPSC_RING_BARRIER() __DMB()
+#endif
+
+// the ring (declare it with SPSC_RING_ALIGN so the counters really do start on
+// a cache line boundary)
+typedef struct
+{
+	// written by the producer
+	volatile uint32_t	head;
+	uint32_t					dropped;
+	uint8_t						pad_head[SPSC_RING_LINE - 2 * sizeof(uint32_t)];
+
+	// written by the consumer
+	volatile uint32_t	tail;
+	uint8_t						pad_tail[SPSC_RING_LINE - sizeof(uint32_t)];
+
+	// set up once and then only read
+	uint8_t *					buffer;
+	uint32_t					size;
+}
+spsc_ring_t;
+
+#define SPSC_RING_ALIGN __attribute__((aligned(SPSC_RING_LINE)))
+
+//
+// global methods:
+//
+
+// set up the ring (size must be a power of two)
+void     spsc_ring_init(spsc_ring_t * ring, uint8_t * buffer, uint32_t size);
+
+// producer side - add a byte, returning how many bytes were already waiting
+// (so 0 means the ring has just gone from empty to non-empty) or -1 if the
+// ring is full and the byte was dropped
+int      spsc_ring_put(spsc_ring_t * ring, uint8_t byte);
+
+// consumer side - get the next contiguous span of bytes (returns the length)
+// and then give it back once it has been dealt with
+size_t   spsc_ring_span(spsc_ring_t * ring, const uint8_t ** data);
+void     spsc_ring_consume(spsc_ring_t * ring, size_t length);
+
+// the number of bytes waiting (either side can call this)
+uint32_t spsc_ring_count(const spsc_ring_t * ring);
+
+#endif // SPSC_RING_H
@@ -0,0 +1,131 @@
+/*
+ * trace.h
+ *
+ * a binary trace log for the busy threads - instead of formatting a message
+ * and waiting for it to go out of the uart, TRACE just records the message
+ * id (from trace_msgs.h), a time stamp and the raw arguments in a ring buffer
+ * in ram. that takes a few dozen cycles, and the formatting is done later on
+ * the pc (by tools/trace_decode.py, from a memory dump of trace_log)
+ *
+ * e.g.
+ *
+ *   TRACE(SAMPLE_VALUES, TRACE_FLOAT(light), TRACE_FLOAT(temp));
+ *   TRACE0(OVERRIDE_ENABLED);
+ *
+ * each record is a header word (a sync byte, the number of arguments and the
+ * message id), the cycle counter when it was written, and then the arguments.
+ * when the ring fills up the oldest records are thrown away to make room, so
+ * the log always holds the most recent history
+ *
+ * with TRACE_LOG set to 0 the messages are printed straight away with printf
+ * instead (using the same format strings)
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __TRACE_H
+#define __TRACE_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+
+// if we've not defined TRACE_LOG elsewhere ...
+#ifndef TRACE_LOG
+	// record the trace messages in the ram log (set this to 0 to print them)
+	#define TRACE_LOG 1
+#endif
+
+// if we've not defined TRACE_SIZE elsewhere ...
+#ifndef TRACE_SIZE
+	// the size of the log in 32 bit words (this has to be a power of two)
+	#define TRACE_SIZE 1024
+#endif
+
+// the message ids
+#define TRACE_MSG(name, format) TRACE_##name,
+typedef enum
+{
+	#include "trace_msgs.h"
+	TRACE_COUNT
+}
+trace_id_t;
+#undef TRACE_MSG
+
+// what's at the start of the log (so the decoder can tell it has found it, and
+// that it has the same message table)
+#define TRACE_MAGIC 0x31435254
+
+// the top byte of every record header
+#define TRACE_SYNC 0xA5
+
+// the ram log (this is what gets dumped for the decoder)
+typedef struct
+{
+	uint32_t					magic;
+	uint32_t					size;
+	uint32_t					messages;
+	uint32_t					clock;
+
+	// free running word counts - where the next record goes, and where the
+	// oldest record still in the log starts
+	volatile uint32_t	head;
+	volatile uint32_t	first;
+
+	// how many records have been written, and how many of them have since been
+	// overwritten
+	uint32_t					records;
+	uint32_t					lost;
+
+	uint32_t					words[TRACE_SIZE];
+}
+trace_log_t;
+
+extern trace_log_t trace_log;
+
+//
+// global methods:
+//
+
+// start the cycle counter (that the records are time stamped with)
+void trace_init(uint32_t clock);
+
+// add a record to the log
+void trace_write(trace_id_t id, const uint32_t * args, uint32_t count);
+
+// pass a float as a trace argument (without converting it to an integer)
+static __INLINE uint32_t trace_float(float value)
+{
+	union { float f; uint32_t u; } bits;
+	bits.f = value;
+	return bits.u;
+}
+
+#if TRACE_LOG
+
+	// record a message with some arguments (anything that fits in 32 bits)
+	#define TRACE(id, ...) do { \
+			const uint32_t trace_args[] = {__VA_ARGS__}; \
+			trace_write(TRACE_##id, trace_args, sizeof(trace_args) / sizeof(uint32_t)); \
+		} while(0)
+
+	// and one without any
+	#define TRACE0(id) trace_write(TRACE_##id, 0, 0)
+
+	#define TRACE_FLOAT(value) trace_float(value)
+
+#else
+
+	#include <stdio.h>
+
+	// the format strings (only needed when we're printing the messages here)
+	extern const char * const trace_formats[TRACE_COUNT];
+
+	#define TRACE(id, ...) printf(trace_formats[TRACE_##id], __VA_ARGS__)
+	#define TRACE0(id) printf("%s", trace_formats[TRACE_##id])
+
+	#define TRACE_FLOAT(value) ((double)(value))
+
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,107 @@
+/*
+ * trace_msgs.h
+ *
+ * the table of trace messages - each one has a name (which becomes its id, in
+ * the order they appear here) and a printf style format string, which only
+ * the decoder (tools/trace_decode.py) ever sees
+ *
+ * the decoder reads this file to find out what each id means, so add new
+ * messages at the end and keep to one TRACE_MSG per line. the arguments are
+ * all recorded as 32 bit words - use %d / %u / %x / %c for integers and %f
+ * for floats (passed with TRACE_FLOAT)
+ *
+ * note: there's no include guard - this gets included once for each thing we
+ * build from the table, with TRACE_MSG defined differently each time
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// xbee rx thread
+TRACE_MSG(UART6_RESYNC,           "UART 6 error, resynchronising (ORE %u, FE %u, NE %u)\n")
+TRACE_MSG(PACKET_RECEIVED,        ">> packet received @ %u s\r\n")
+TRACE_MSG(SHORT_FRAME,            "short frame (type %02X, %d bytes) ignored\n")
+TRACE_MSG(SENDING_IS,             "sending IS packet when mutex free\n")
+TRACE_MSG(NODE_SL_ADDRESS,        "Node %d SL Address = %08X\n")
+TRACE_MSG(NODE_MY_ADDRESS,        "Node %d Network Address = %04X\n")
+TRACE_MSG(IS_NO_POT,              "IS response from %04X has no pot sample\n")
+TRACE_MSG(AT_FAILED,              "AT %c%c failed (status %02X)\n")
+TRACE_MSG(TX_FAILED,              "TX to %04X failed (status %02X)\n")
+TRACE_MSG(REQUEST_UNANSWERED,     "!!Request %02X was never answered!!\n")
+TRACE_MSG(REQUEST_FAILED,         "Request %02X failed (status %02X)\n")
+
+// action thread
+TRACE_MSG(SEND_LOCKED,            "Mutex grabbed for sending \n")
+TRACE_MSG(SENT_COMMANDS,          "Sent %d commands to %d nodes (%d resent), mutex released from sending func\n")
+TRACE_MSG(TX_QUEUE_STATS,         "TX queue: %u waiting, high water %u, %u full\n")
+TRACE_MSG(VCOM_STATS,             "VCOM output: high water %u, %u dropped, %u overwritten, %u blocked\n")
+TRACE_MSG(RX_FLOW_STATS,          "RX buffer: high water %u, xbee held off %u times\n")
+
+// process ir thread
+TRACE_MSG(SAMPLE_NODE,            "Node address: %02X\n")
+TRACE_MSG(SAMPLE_TIME,            "Time: %u s\n")
+TRACE_MSG(SAMPLE_PIR,             "Current PIR:%d, Prev PIR:%d\n")
+TRACE_MSG(SAMPLE_VALUES,          "Light: %f, Temp: %f\n")
+TRACE_MSG(INTRUDER_ALERT,         "!!intruder Alert!!\r\n")
+TRACE_MSG(ROOM_OCCUPIED,          "The room is occupied ")
+TRACE_MSG(ROOM_ENTERED,           "Someone has entered the room ")
+TRACE_MSG(ROOM_VACANT,            "The room is vacant ")
+TRACE_MSG(ROOM_LEFT,              "Someone has left or is idle in the room ")
+TRACE_MSG(NO_CHANGE,              "and nothing has changed.\n")
+TRACE_MSG(LIGHT_LOW_ON,           "and the light is too low so turning the lights on.\n")
+TRACE_MSG(LIGHT_HIGH_OFF,         "and the light is too high so turning the lights off\n")
+TRACE_MSG(LIGHT_HIGH_STAY_OFF,    "light is too high so don't need to turn the lights on.\n")
+TRACE_MSG(LIGHTS_OFF,             "so turning lights off.\n")
+TRACE_MSG(LIGHTS_ALREADY_OFF,     "and the lights are already off.\n")
+TRACE_MSG(OVERRIDE_ENABLED,       "override enabled\n")
+TRACE_MSG(TEMP_LOW_HEAT_ON,       "and the temp is too low so turning the heating on.\n")
+TRACE_MSG(TEMP_LOW_SWAP_TO_HEAT,  "and the temp is too low so turning the AC off and the heating on.\n")
+TRACE_MSG(TEMP_HIGH_AC_ON,        "and the temp is too high so turning the AC on.\n")
+TRACE_MSG(TEMP_HIGH_SWAP_TO_AC,   "and the temp is too high so turning the heating off and the AC on.\n")
+TRACE_MSG(TEMP_FINE_HEAT_OFF,     "and the temp is fine so turning the heating off.\n")
+TRACE_MSG(TEMP_FINE_AC_OFF,       "and the temp is fine so turning the AC off.\n")
+TRACE_MSG(HEAT_OFF,               "so turning the heating off.\n")
+TRACE_MSG(AC_OFF,                 "so turning the AC off.\n")
+TRACE_MSG(END_OF_SAMPLE,          "\n")
+
+// thresh over thread
+TRACE_MSG(SETTING_FOR,            "Setting for %02X\n")
+TRACE_MSG(SECOND_PRESS,           "Button presed a second time.\n")
+TRACE_MSG(LIGHT_THRESHOLD,        "light threshold set to %f\n")
+TRACE_MSG(HEAT_THRESHOLD,         "Heating threshold set to %f\n")
+TRACE_MSG(AC_THRESHOLD_ADJUSTED,  "AC threshold auto adjusted to %f\n")
+TRACE_MSG(AC_THRESHOLD,           "AC threshold set to %f\n")
+TRACE_MSG(HEAT_THRESHOLD_ADJUSTED,"heating threshold auto adjusted to %f\n")
+TRACE_MSG(FIRST_PRESS,            "Button presed once, Next press will set ")
+TRACE_MSG(NEXT_LIGHT,             "light ")
+TRACE_MSG(NEXT_HEATING,           "heating ")
+TRACE_MSG(NEXT_AC,                "AC ")
+TRACE_MSG(BASED_ON_POT,           "based on potentiometer value\n")
+TRACE_MSG(LIGHT_OVERRIDE,         "Light override ")
+TRACE_MSG(HEATING_OVERRIDE,       "Heating ")
+TRACE_MSG(AC_OVERRIDE,            "AC ")
+TRACE_MSG(OVERRIDE_ON,            "on\n")
+TRACE_MSG(OVERRIDE_OFF,           "off\n")
+TRACE_MSG(SELECTOR,               "Selector for %02X set to ")
+TRACE_MSG(SELECTED_LIGHT,         "light\n")
+TRACE_MSG(SELECTED_HEATING,       "heating\n")
+TRACE_MSG(SELECTED_AC,            "AC\n")
+
+// node registry
+TRACE_MSG(UNKNOWN_NODE,           "Frame from %04X (SL %08X) isn't from a node, ignored\n")
+TRACE_MSG(NODE_TABLE_FULL,        "Node table full, %08X not added\n")
+TRACE_MSG(NODE_EXPIRED,           "Node %d (SL %08X) not heard from, forgotten\n")
+TRACE_MSG(ND_SWEEP,               "Node discover sweep sent\n")
+
+// saved settings
+TRACE_MSG(ROOM_RESTORED,          "Node %d (SL %08X) settings restored from flash\n")
+TRACE_MSG(ROOM_NOT_SAVED,         "Node %d settings not saved, the queue is full\n")
+TRACE_MSG(ROOM_SAVE_FAILED,       "Couldn't save the settings for SL %08X (error %d)\n")
+TRACE_MSG(ROOM_FORGOTTEN,         "Forgot the saved settings for SL %08X to make room\n")
+TRACE_MSG(CONFIG_TIDY_FAILED,     "Couldn't tidy up the config store (error %d)\n")
+
+// parser
+TRACE_MSG(PARSER_STATS,           "Parser: %u bad checksums, %u resyncs, %u bytes dropped\n")
+TRACE_MSG(RX_DMA_STATS,           "Rx dma: %u interrupts, %u overruns\n")
+
+// vcom
+TRACE_MSG(VCOM_UART_ERRORS,       "VCOM uart errors: ORE %u, FE %u, NE %u, dma %u\n")
@@ -0,0 +1,40 @@
+/*
+ * uart_errors.h
+ *
+ * count the receive errors on a uart (overruns, framing errors, noise and 
+ * parity errors) and clear them, so reception can carry on instead of 
+ * stopping until the board is reset
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __UART_ERRORS_H
+#define __UART_ERRORS_H
+
+// include the basic headers for the hal drivers
+#include "stm32f7xx_hal.h"
+
+// the number of each kind of error we've seen
+typedef struct
+{
+	uint32_t	overrun;		// a byte arrived before the last one was read (so it's lost)
+	uint32_t	framing;		// a byte without a proper stop bit
+	uint32_t	noise;			// noise on the line while a byte was arriving
+	uint32_t	parity;			// a byte with the wrong parity
+	uint32_t	dma;				// the dma stream reported an error
+}
+uart_error_stats_t;
+
+//
+// global methods:
+//
+
+// count the errors in a hal error code (HAL_UART_ERROR_xxx bits)
+void     uart_errors_count(uart_error_stats_t * stats, uint32_t error_code);
+
+// check the uart for errors, count them and clear them - returns the errors
+// found (as HAL_UART_ERROR_xxx bits, so 0 if there weren't any)
+uint32_t uart_errors_clear(USART_TypeDef * uart, uart_error_stats_t * stats);
+
+#endif // UART_ERRORS_H
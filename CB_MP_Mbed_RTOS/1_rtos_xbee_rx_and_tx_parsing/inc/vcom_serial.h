@@ -9,24 +9,77 @@
  * (i.e. the usb st-link connection).
  *
  * this version of vocn_serial.h is rtos aware.
+ *
+ * with VCOM_TX_DMA set, printf doesn't wait for the characters to go out - it
+ * just puts them in a ring buffer, and the uart sends them from there in the
+ * background using dma.
  * 
  * author:    Alex Shenfield
  * date:      08/10/2017
  * purpose:   55-604481 embedded computer networks : lab 104
  */
 
+// define to prevent recursive inclusion
+#ifndef __VCOM_SERIAL_H
+#define __VCOM_SERIAL_H
+
 // include the basic headers for the hal drivers
 #include "stm32f7xx_hal.h"
 
 // include the standard c io library
 #include <stdio.h>
 
+// include the uart error counters and the output ring buffer
+#include "uart_errors.h"
+#include "log_ring.h"
+
 // define the virtual com port gpio pins
 #define VCP_RX_Pin        GPIO_PIN_7
 #define VCP_RX_GPIO_Port  GPIOB
 #define VCP_TX_Pin        GPIO_PIN_9
 #define VCP_TX_GPIO_Port  GPIOA
 
+// if we've not defined VCOM_TX_DMA elsewhere ...
+#ifndef VCOM_TX_DMA
+	// buffer the output and send it in the background using dma - set this to 0
+	// to send each character as it is printed (and wait for it to go) instead
+	#define VCOM_TX_DMA 1
+#endif
+
+// if we've not defined VCOM_LOG_SIZE elsewhere ...
+#ifndef VCOM_LOG_SIZE
+	// the size of the output ring buffer (this has to be a power of two)
+	#define VCOM_LOG_SIZE 2048
+#endif
+
+// if we've not defined VCOM_LOG_CHUNK elsewhere ...
+#ifndef VCOM_LOG_CHUNK
+	// the most we send in one dma transfer
+	#define VCOM_LOG_CHUNK 64
+#endif
+
+// if we've not defined VCOM_LOG_POLICY elsewhere ...
+#ifndef VCOM_LOG_POLICY
+	// what to do when the output ring buffer is full (see log_ring.h) - by 
+	// default we throw the new text away rather than hold the thread up
+	#define VCOM_LOG_POLICY LOG_RING_DROP
+#endif
+
 // declare the serial initialisation method
 void init_uart(uint32_t baud_rate);
 int serial_write(int ch);
+
+// deal with (and count) errors on the vcom uart - the check is called from the
+// uart interrupt, and vcom_uart_error from the shared hal uart error callback
+void vcom_check_errors(void);
+void vcom_uart_error(UART_HandleTypeDef * huart);
+void vcom_get_uart_errors(uart_error_stats_t * stats);
+
+// a dma transfer has finished - this is called from the shared hal uart
+// transmit complete callback
+void vcom_tx_complete(UART_HandleTypeDef * huart);
+
+// get the output ring buffer counters
+void vcom_get_log_stats(log_ring_stats_t * stats);
+
+#endif // VCOM_SERIAL_H
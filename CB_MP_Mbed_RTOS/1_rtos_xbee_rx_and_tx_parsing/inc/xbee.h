@@ -23,17 +23,157 @@
 // include the standard c io library
 #include <stdio.h>
 
+// include the transmit queue and the uart error counters (for the callback 
+// and counter types)
+#include "xbee_tx_queue.h"
+#include "uart_errors.h"
+
 // define the virtual com port gpio pins
 #define XBEE_RX_Pin        GPIO_PIN_6
 #define XBEE_RX_GPIO_Port  GPIOC
 #define XBEE_TX_Pin        GPIO_PIN_7
 #define XBEE_TX_GPIO_Port  GPIOC
 
+// if we've not defined XBEE_FLOW_CONTROL elsewhere ...
+#ifndef XBEE_FLOW_CONTROL
+	// use rts / cts flow control on the xbee link (this needs two more wires to
+	// the xbee - DIO6/RTS and DIO7/CTS - so it's off by default)
+	#define XBEE_FLOW_CONTROL 0
+#endif
+
+// define the flow control gpio pins - cts is handled by the uart (PG13 is the
+// only usart 6 cts pin that isn't used by the sdram - it goes to the ethernet
+// phy too, but we don't use that), but we drive rts ourselves so it can go on 
+// any gpio pin (PH6 is D6 on the arduino header)
+#define XBEE_CTS_Pin       GPIO_PIN_13
+#define XBEE_CTS_GPIO_Port GPIOG
+#define XBEE_RTS_Pin       GPIO_PIN_6
+#define XBEE_RTS_GPIO_Port GPIOH
+
+// if we've not defined XBEE_MAX_TX_FRAME elsewhere ...
+#ifndef XBEE_MAX_TX_FRAME
+	// the biggest frame we expect to send (before any escaping)
+	#define XBEE_MAX_TX_FRAME 128
+#endif
+
+// if we've not defined XBEE_RX_DMA elsewhere ...
+#ifndef XBEE_RX_DMA
+	// receive into a circular buffer using dma (and let the rx thread know when
+	// a burst of data has arrived) - set this to 0 to take an interrupt for
+	// every byte instead
+	#define XBEE_RX_DMA 1
+#endif
+
+// if we've not defined XBEE_RX_DMA_SIZE elsewhere ...
+#ifndef XBEE_RX_DMA_SIZE
+	// the size of the dma receive buffer (this has to be a power of two)
+	#define XBEE_RX_DMA_SIZE 256
+#endif
+
+// if we've not defined XBEE_RX_RING_SIZE elsewhere ...
+#ifndef XBEE_RX_RING_SIZE
+	// the size of the ring the receive interrupt puts characters in when we're
+	// not using dma (this has to be a power of two)
+	#define XBEE_RX_RING_SIZE 512
+#endif
+
+// if we've not defined XBEE_RTS_STOP_FREE elsewhere ...
+#ifndef XBEE_RTS_STOP_FREE
+	// stop the xbee sending (deassert rts) when there's less than this much room
+	// left in the receive buffer - with dma we only look at the half way and end
+	// points (and when the line goes idle), so there has to be room for another 
+	// half a buffer to arrive before we next look
+	//
+	// note: this means that during a long unbroken burst the xbee can get held 
+	// up for a moment at each half buffer even if the rx thread is keeping up - 
+	// that costs a bit of throughput, but no data
+	#if XBEE_RX_DMA
+		#define XBEE_RTS_STOP_FREE (XBEE_RX_DMA_SIZE / 2 + 16)
+	#else
+		#define XBEE_RTS_STOP_FREE 32
+	#endif
+#endif
+
+// if we've not defined XBEE_RTS_START_FREE elsewhere ...
+#ifndef XBEE_RTS_START_FREE
+	// let it start again (assert rts) once the rx thread has got the free space
+	// back up to this
+	#if XBEE_RX_DMA
+		#define XBEE_RTS_START_FREE (XBEE_RX_DMA_SIZE * 3 / 4)
+	#else
+		#define XBEE_RTS_START_FREE (XBEE_RX_RING_SIZE / 2)
+	#endif
+#endif
+
+// the signal the rx thread gets when there is new data to read
+#define XBEE_RX_SIGNAL 0x01
+
+// if we've not defined XBEE_TX_DMA elsewhere ...
+#ifndef XBEE_TX_DMA
+	// queue frames up and send them using dma, so sending a frame doesn't hold
+	// the calling thread up - set this to 0 to send them a character at a time
+	// (and wait until they've gone) instead
+	#define XBEE_TX_DMA 1
+#endif
+
+// if we've not defined XBEE_SET_BAUD_TIMEOUT elsewhere ...
+#ifndef XBEE_SET_BAUD_TIMEOUT
+	// how long to wait for what's being sent to go out before changing the rate
+	// (in ms - a full transmit queue takes about a second at 9600 baud)
+	#define XBEE_SET_BAUD_TIMEOUT 2000
+#endif
+
 // declare the serial initialisation method and the data transmission method
+// (with XBEE_TX_DMA this returns once the frame is queued, but if the queue is
+// full it blocks until the uart has made room - so don't call it holding a
+// lock that the rx thread needs)
 void init_xbee(uint32_t baud_rate);
 int  send_xbee(volatile uint8_t* s, int length);
 
+// change the uart rate (once anything waiting to go out has gone - returns -1,
+// and leaves the rate as it was, if that takes longer than 
+// XBEE_SET_BAUD_TIMEOUT) and count the bytes that have gone across the link 
+// (both ways)
+int      xbee_set_baud(uint32_t baud_rate);
+uint32_t xbee_link_bytes(void);
+
+// queue a frame without copying it (the frame has to stay put until the 
+// callback is called - from the uart interrupt - to say it has gone, and this
+// blocks like send_xbee when the queue is full), and get the state of the
+// transmit queue (see xbee_tx_queue.h)
+int  xbee_queue_frame(const uint8_t * frame, int length, xbee_tx_callback callback,
+	void * context);
+void xbee_tx_get_stats(xbee_tx_stats_t * stats, uint32_t * depth);
+
 // enable the uart / xbee rx interrupt
 void enable_rx_interrupt(void);
 
+// get at the data that has been received (the rx thread calls these when it
+// gets XBEE_RX_SIGNAL)
+size_t xbee_rx_span(const uint8_t ** data);
+void   xbee_rx_consume(size_t length);
+
+// when xbee_rx_span stops short because some bytes were lost, this returns 1
+// (once) to say the parser needs to resync
+int    xbee_rx_error(void);
+
+// get the number of times the xbee has been told to stop sending (because the
+// receive buffer was getting full) and the most that has been in the buffer
+void   xbee_get_flow_stats(uint32_t * stops, uint32_t * high_water);
+
+// get the number of times the receive dma has been checked on (from the 
+// interrupts) and the number of times the rx thread fell so far behind it that
+// data was overwritten (both 0 when not receiving with dma)
+void   xbee_get_dma_stats(uint32_t * events, uint32_t * overruns);
+
+// check for (and clear) uart receive errors - call this from the uart 
+// interrupt before handing it to the hal
+void   xbee_rx_check_errors(void);
+void   xbee_get_uart_errors(uart_error_stats_t * stats);
+
+#if XBEE_RX_DMA
+// the handler for the idle line interrupt
+void   xbee_rx_idle(void);
+#endif
+
 #endif // XBEE_H
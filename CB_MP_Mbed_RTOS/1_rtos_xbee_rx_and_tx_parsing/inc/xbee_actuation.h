@@ -0,0 +1,104 @@
+/*
+ * xbee_actuation.h
+ *
+ * collect up the output changes (light, heater and ac) for each node and send
+ * them as a batch - every change for a node goes as a queued remote at command
+ * (no apply changes option and no response) apart from the last one, which
+ * applies the whole lot at once
+ *
+ * changes for the same node that turn up in the same scheduling window are
+ * merged (the latest state for each output wins), so each node gets at most
+ * one command per output and only one response comes back per node
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __XBEE_ACTUATION_H
+#define __XBEE_ACTUATION_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+
+// include the frame builder (for the address type)
+#include "xbee_frame_builder.h"
+
+// if we've not defined XBEE_ACTUATION_BATCHING elsewhere ...
+#ifndef XBEE_ACTUATION_BATCHING
+	// batch the output changes up - set this to 0 to send every change as its
+	// own remote at command (with apply changes set) as soon as it turns up
+	#define XBEE_ACTUATION_BATCHING 1
+#endif
+
+// if we've not defined XBEE_ACTUATION_WINDOW elsewhere ...
+#ifndef XBEE_ACTUATION_WINDOW
+	// how long (in ms) to wait for more changes before sending a batch
+	#define XBEE_ACTUATION_WINDOW 20
+#endif
+
+// if we've not defined XBEE_ACTUATION_NODES elsewhere ...
+#ifndef XBEE_ACTUATION_NODES
+	// the number of different nodes we can have changes waiting for
+	#define XBEE_ACTUATION_NODES 8
+#endif
+
+// the outputs on each node
+typedef enum
+{
+	OUTPUT_LIGHT,
+	OUTPUT_HEATER,
+	OUTPUT_AC,
+	NUM_OUTPUTS
+}
+xbee_output;
+
+// output states (the same as in the mail)
+#define OUTPUT_OFF				0
+#define OUTPUT_ON					1
+#define OUTPUT_NO_CHANGE	2
+
+// everything waiting to be sent to one node
+typedef struct
+{
+	xbee_address_t	address;
+	uint16_t				my_address;
+	uint8_t					state[NUM_OUTPUTS];
+	uint8_t					sample;					// send an IS command as well
+}
+xbee_actuation_t;
+
+// counters so we can see what batching is doing
+typedef struct
+{
+	uint32_t	requests;					// changes added
+	uint32_t	merged;						// ... that went in with changes already waiting
+	uint32_t	superseded;				// output changes replaced before they were sent
+	uint32_t	batches;					// times the batch was sent
+	uint32_t	frames;						// remote at commands sent
+	uint32_t	applies;					// ... of which applied changes
+	uint32_t	bytes;						// bytes sent
+	uint32_t	full;							// changes dropped because there was no room
+}
+xbee_actuation_stats_t;
+
+// the changes waiting to be sent
+typedef struct
+{
+	xbee_actuation_t				pending[XBEE_ACTUATION_NODES];
+	int											num_pending;
+	xbee_actuation_stats_t	stats;
+}
+xbee_actuation_batch_t;
+
+// the function used to send each frame
+typedef void (*xbee_actuation_send)(uint8_t * frame, int length);
+
+//
+// global methods:
+//
+void xbee_actuation_init(xbee_actuation_batch_t * batch);
+int  xbee_actuation_add(xbee_actuation_batch_t * batch, const xbee_address_t * address,
+	uint16_t my_address, const uint8_t state[NUM_OUTPUTS], uint8_t sample);
+int  xbee_actuation_flush(xbee_actuation_batch_t * batch, xbee_actuation_send send);
+
+#endif // XBEE_ACTUATION_H
@@ -0,0 +1,116 @@
+/*
+ * xbee_baud.h
+ *
+ * find the coordinator xbee (whatever rate its uart happens to be running at)
+ * and move the link up to the fastest rate it will do
+ *
+ * we ask the radio for its BD setting to check it's there, then set BD to 
+ * each of the rates we want to try (fastest first) - the radio answers at the
+ * old rate and then switches, so we switch too and check it's still there. if
+ * it isn't we go looking for it at the rates it could be running at, and if 
+ * it can't be found at all we go back to the rate we started at
+ *
+ * the new rate isn't written to the radio's flash (no WR), so if the radio is
+ * reset it comes back at its saved rate - and if just this end is reset, the
+ * scan finds the radio at whatever rate it was left at
+ *
+ * note: the uart and the at commands are reached through the functions in 
+ * xbee_baud_ops_t, so none of this knows about the hal or the rtos
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __XBEE_BAUD_H
+#define __XBEE_BAUD_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+
+// if we've not defined XBEE_BAUD_TIMEOUT elsewhere ...
+#ifndef XBEE_BAUD_TIMEOUT
+	// how long to wait for the radio to answer an at command (in ms)
+	#define XBEE_BAUD_TIMEOUT 200
+#endif
+
+// if we've not defined XBEE_BAUD_PROBES elsewhere ...
+#ifndef XBEE_BAUD_PROBES
+	// how many times to ask before deciding the radio isn't at a given rate
+	#define XBEE_BAUD_PROBES 2
+#endif
+
+// if we've not defined XBEE_BAUD_SETTLE elsewhere ...
+#ifndef XBEE_BAUD_SETTLE
+	// how long to give the radio to switch rates (in ms)
+	#define XBEE_BAUD_SETTLE 20
+#endif
+
+// if we've not defined XBEE_BAUD_MEASURE_COMMANDS elsewhere ...
+#ifndef XBEE_BAUD_MEASURE_COMMANDS
+	// how many at commands to send when measuring the link throughput
+	#define XBEE_BAUD_MEASURE_COMMANDS 20
+#endif
+
+// the functions used to drive the uart and the radio
+typedef struct
+{
+	// switch our end of the link to a new rate - returns 0, or -1 if it couldn't
+	// (in which case it's still at the old rate)
+	int      (*set_baud)(uint32_t baud_rate);
+
+	// send a local at command and wait for the answer - returns the status from
+	// the response (0 is ok) or -1 if nothing came back in time
+	int      (*at_command)(const char * command, const uint8_t * param, int length,
+		uint32_t timeout);
+
+	// wait for a while (in ms)
+	void     (*delay)(uint32_t ms);
+
+	// a free running clock (and how many of its ticks there are to a ms)
+	uint32_t (*time)(void);
+	uint32_t ticks_per_ms;
+
+	// the total number of bytes that have gone across the link (both ways)
+	uint32_t (*bytes)(void);
+}
+xbee_baud_ops_t;
+
+// what happened
+typedef struct
+{
+	uint32_t	baud_rate;			// the rate we ended up at
+	uint32_t	found_at;				// the rate the radio was found at first (0 if never)
+	uint32_t	probes;					// at commands sent looking for the radio
+	uint32_t	scans;					// times we had to go looking for it
+	uint32_t	refused;				// rates the radio wouldn't take
+	uint32_t	failed;					// rates the radio took but we couldn't talk at (or
+														// couldn't switch to ourselves)
+	uint32_t	throughput;			// bytes per second measured at the final rate
+}
+xbee_baud_result_t;
+
+//
+// global methods:
+//
+
+// the BD setting for a rate (or -1 if the xbee doesn't do that rate)
+int xbee_baud_code(uint32_t baud_rate);
+
+// look for the radio at the rate we think it's at, and then at all the others
+// it could be at - returns the rate it was found at (and leaves our end at that
+// rate) or 0 if it wasn't found
+uint32_t xbee_baud_find(const xbee_baud_ops_t * ops, uint32_t baud_rate,
+	xbee_baud_result_t * result);
+
+// find the radio and switch to the fastest of the target rates (given fastest
+// first) that works - returns 0 if the radio was found (even if it stayed at
+// the rate it was at) or -1 if it wasn't (in which case we are back at the rate
+// we started at)
+int xbee_baud_negotiate(const xbee_baud_ops_t * ops, uint32_t baud_rate,
+	const uint32_t * targets, int num_targets, xbee_baud_result_t * result);
+
+// measure how many bytes a second we actually get across the link by sending
+// a string of at commands
+uint32_t xbee_baud_measure(const xbee_baud_ops_t * ops, int commands);
+
+#endif // XBEE_BAUD_H
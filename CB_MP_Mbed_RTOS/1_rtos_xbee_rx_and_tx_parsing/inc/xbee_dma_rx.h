@@ -0,0 +1,84 @@
+/*
+ * xbee_dma_rx.h
+ *
+ * keep track of the bytes that the dma controller has written into the xbee
+ * uart's circular receive buffer, and hand them out to the rx thread as spans
+ * of contiguous bytes
+ *
+ * the interrupt side (the idle line interrupt and the dma half / full
+ * transfer interrupts) just records how far the dma has got - the rx thread
+ * then reads everything between where it got to last time and there straight
+ * out of the dma buffer
+ *
+ * note: the interrupts come at least every half buffer, so the dma can never
+ * get more than a whole buffer ahead between two of them - if the rx thread
+ * falls more than a buffer behind then the data has been overwritten, so we
+ * throw it away and count an overrun. that is a buffer behind where the
+ * interrupts last saw the dma, which can be up to half a buffer behind the
+ * dma itself, so bytes more than half a buffer behind can get overwritten
+ * before the overrun shows up (flow control stops the xbee well before that)
+ *
+ * if the dma has to be restarted (after an error) it starts again from the
+ * beginning of the buffer, so the bytes after that point are found at a 
+ * different offset in the buffer to the ones before it (and any bytes from 
+ * before it that haven't been read yet may get overwritten - but bytes have
+ * just been lost there anyway, so the parser has to resync at that point)
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __XBEE_DMA_RX_H
+#define __XBEE_DMA_RX_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+#include <stddef.h>
+
+// the state of the circular receive buffer
+typedef struct
+{
+	const uint8_t *		buffer;
+	uint16_t					size;
+
+	// updated from the interrupts - where the dma had got to last time we looked,
+	// the total number of bytes it has written and the number of times we've
+	// looked
+	volatile uint16_t	dma_position;
+	volatile uint32_t	produced;
+	volatile uint32_t	events;
+
+	// where in the buffer the byte count maps to (before and after the last
+	// time the dma was restarted)
+	volatile uint16_t	offset;
+	volatile uint16_t	old_offset;
+	volatile uint32_t	restarted_at;
+
+	// updated by the rx thread
+	uint32_t					consumed;
+	uint32_t					overruns;
+}
+xbee_dma_rx_t;
+
+//
+// global methods:
+//
+
+// set up the buffer (size must be a power of two)
+void   xbee_dma_rx_init(xbee_dma_rx_t * rx, const uint8_t * buffer, uint16_t size);
+
+// call from the interrupts with the dma's remaining transfer count (NDTR) -
+// returns the number of new bytes
+size_t xbee_dma_rx_update(xbee_dma_rx_t * rx, uint16_t remaining);
+
+// call when the dma has been stopped (after calling xbee_dma_rx_update with its
+// final transfer count) and is about to be started again from the beginning 
+// of the buffer
+void   xbee_dma_rx_restart(xbee_dma_rx_t * rx);
+
+// get the next contiguous span of received bytes (returns the length) and then
+// give it back once it has been dealt with
+size_t xbee_dma_rx_span(xbee_dma_rx_t * rx, const uint8_t ** data);
+void   xbee_dma_rx_consume(xbee_dma_rx_t * rx, size_t length);
+
+#endif // XBEE_DMA_RX_H
@@ -0,0 +1,66 @@
+/*
+ * xbee_flow.h
+ *
+ * decide when to tell the xbee to stop sending (by deasserting rts) and when
+ * to let it start again, from how much room there is left in the software
+ * receive buffer
+ *
+ * the uart's own rts output only deasserts when the receive data register is
+ * full, which is no help when it's the rx thread that has fallen behind - so
+ * instead we drive rts ourselves and stop the radio while there's still some
+ * room left (for the bytes it sends before it notices, and for however many
+ * bytes can arrive before we next look). it's only let go again once the rx
+ * thread has freed up a good chunk more than that, so rts doesn't flap up and
+ * down a byte at a time
+ *
+ * the receive side (the uart / dma interrupts) calls xbee_flow_stop and the rx
+ * thread calls xbee_flow_start (with interrupts held off, as both of them
+ * change the state)
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __XBEE_FLOW_H
+#define __XBEE_FLOW_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+
+// the flow control state
+typedef struct
+{
+	// the size of the receive buffer, and the free space to stop the radio at
+	// and to start it again at
+	uint32_t					size;
+	uint32_t					stop_free;
+	uint32_t					start_free;
+
+	// is the radio stopped at the moment
+	volatile uint8_t	stopped;
+
+	// how many times we've stopped the radio, and the most the buffer has had in
+	// it when we looked
+	uint32_t					stops;
+	uint32_t					high_water;
+}
+xbee_flow_t;
+
+//
+// global methods:
+//
+
+// set up the thresholds (start_free has to be more than stop_free and no more
+// than size) - returns 0 if they don't make sense
+int xbee_flow_init(xbee_flow_t * flow, uint32_t size, uint32_t stop_free,
+	uint32_t start_free);
+
+// call from the receive side with the number of bytes in the buffer - returns 1
+// if the radio should be stopped now (i.e. rts deasserted)
+int xbee_flow_stop(xbee_flow_t * flow, uint32_t used);
+
+// call from the rx thread after giving bytes back - returns 1 if the radio can
+// be started again now (i.e. rts asserted)
+int xbee_flow_start(xbee_flow_t * flow, uint32_t used);
+
+#endif // XBEE_FLOW_H
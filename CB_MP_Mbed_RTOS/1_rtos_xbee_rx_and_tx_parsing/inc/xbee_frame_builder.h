@@ -0,0 +1,86 @@
+/*
+ * xbee_frame_builder.h
+ *
+ * build xbee api frames straight into a transmit buffer - the checksum is kept
+ * up to date as each field is appended, so finishing a frame off is just a
+ * case of filling in the length and the checksum byte
+ *
+ * destination addresses are kept ready to send (along with their contribution
+ * to the checksum), so sending a command to a node we already know about only
+ * costs a copy and a few additions
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __XBEE_FRAME_BUILDER_H
+#define __XBEE_FRAME_BUILDER_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+
+// api frame types we know how to build
+#define XBEE_LOCAL_AT_COMMAND			0x08
+#define XBEE_TX_REQUEST						0x10
+#define XBEE_REMOTE_AT_COMMAND		0x17
+
+// remote at command options
+#define XBEE_APPLY_CHANGES				0x02
+
+// digital io pin settings (for D0 - D12 and P0 - P2)
+#define XBEE_DIGITAL_LOW					0x04
+#define XBEE_DIGITAL_HIGH					0x05
+
+// special addresses
+#define XBEE_BROADCAST_64					0x000000000000FFFFULL
+#define XBEE_COORDINATOR_64				0x0000000000000000ULL
+#define XBEE_UNKNOWN_16						0xFFFE
+
+// a destination address (64 bit address then 16 bit network address, both big
+// endian, exactly as they go in the frame) and the sum of its bytes
+typedef struct
+{
+	uint8_t		bytes[10];
+	uint8_t		sum;
+}
+xbee_address_t;
+
+// a frame that is being built
+typedef struct
+{
+	uint8_t *	buffer;
+	uint16_t	size;
+	uint16_t	length;				// bytes written so far (including the header)
+	uint8_t		sum;					// running checksum of the data field
+	uint8_t		overflow;			// set if anything didn't fit
+}
+xbee_frame_builder_t;
+
+//
+// global methods:
+//
+
+// set up a destination address
+void xbee_address_init(xbee_address_t * address, uint64_t address_64, uint16_t address_16);
+
+// build a frame a field at a time (xbee_frame_end returns the length of the
+// finished frame, or 0 if it didn't fit in the buffer)
+void xbee_frame_begin(xbee_frame_builder_t * frame, uint8_t * buffer, int size, uint8_t frame_type);
+void xbee_frame_append_u8(xbee_frame_builder_t * frame, uint8_t value);
+void xbee_frame_append_u16(xbee_frame_builder_t * frame, uint16_t value);
+void xbee_frame_append_u32(xbee_frame_builder_t * frame, uint32_t value);
+void xbee_frame_append_bytes(xbee_frame_builder_t * frame, const uint8_t * data, int length);
+void xbee_frame_append_address(xbee_frame_builder_t * frame, const xbee_address_t * address);
+int  xbee_frame_end(xbee_frame_builder_t * frame);
+
+// build complete frames (these return the frame length, or 0 if it didn't fit)
+int  xbee_build_remote_at(uint8_t * buffer, int size, uint8_t frame_id,
+	const xbee_address_t * dest, uint8_t options, const char * command,
+	const uint8_t * param, int param_length);
+int  xbee_build_local_at(uint8_t * buffer, int size, uint8_t frame_id,
+	const char * command, const uint8_t * param, int param_length);
+int  xbee_build_tx_request(uint8_t * buffer, int size, uint8_t frame_id,
+	const xbee_address_t * dest, uint8_t radius, uint8_t options,
+	const uint8_t * data, int length);
+
+#endif // XBEE_FRAME_BUILDER_H
@@ -0,0 +1,105 @@
+/*
+ * xbee_frames.h
+ *
+ * decode complete xbee api frames into typed structures and pass them on to
+ * whichever handler has been registered for that frame type.
+ *
+ * each decoder checks the frame is long enough before it reads anything, so a
+ * short (or truncated) frame is rejected rather than being read past the end
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __XBEE_FRAMES_H
+#define __XBEE_FRAMES_H
+
+// include the basic headers for the hal drivers (for __packed)
+#include "stm32f7xx_hal.h"
+
+// api frame types we know how to decode
+#define XBEE_LOCAL_AT_RESPONSE		0x88
+#define XBEE_TX_STATUS						0x8B
+#define XBEE_IO_SAMPLE						0x92
+#define XBEE_REMOTE_AT_RESPONSE		0x97
+
+// the number of analog inputs (AD0 - AD3) that can be in an io sample
+#define XBEE_NUM_ANALOG						4
+
+// io data sample rx indicator (0x92) - the io sample part is also used for
+// the data returned by an IS command
+typedef __packed struct
+{
+	uint8_t		frame_type;
+	uint64_t	source_64;
+	uint16_t	source_16;
+	uint8_t		options;
+	uint8_t		num_samples;
+	uint16_t	digital_mask;
+	uint8_t		analog_mask;
+	uint16_t	digital_samples;								// only valid if digital_mask != 0
+	uint16_t	analog[XBEE_NUM_ANALOG];				// indexed by channel (see analog_mask)
+}
+xbee_io_sample_t;
+
+// remote at command response (0x97)
+typedef __packed struct
+{
+	uint8_t		frame_type;
+	uint8_t		frame_id;
+	uint64_t	source_64;
+	uint16_t	source_16;
+	uint8_t		command[2];
+	uint8_t		status;
+	const uint8_t * data;											// points into the received frame
+	uint16_t	data_length;
+}
+xbee_remote_at_response_t;
+
+// local at command response (0x88)
+typedef __packed struct
+{
+	uint8_t		frame_type;
+	uint8_t		frame_id;
+	uint8_t		command[2];
+	uint8_t		status;
+	const uint8_t * data;											// points into the received frame
+	uint16_t	data_length;
+}
+xbee_at_response_t;
+
+// zigbee transmit status (0x8B)
+typedef __packed struct
+{
+	uint8_t		frame_type;
+	uint8_t		frame_id;
+	uint16_t	dest_16;
+	uint8_t		retry_count;
+	uint8_t		delivery_status;
+	uint8_t		discovery_status;
+}
+xbee_tx_status_t;
+
+// any other frame type is passed to its handler undecoded
+typedef struct
+{
+	uint8_t		frame_type;
+	const uint8_t * data;											// the whole frame data field
+	uint16_t	data_length;
+}
+xbee_raw_frame_t;
+
+// frame handlers get a pointer to the decoded structure for their frame type
+// (e.g. an xbee_io_sample_t for XBEE_IO_SAMPLE)
+typedef void (*xbee_frame_handler)(const void * frame);
+
+//
+// global methods:
+//
+void xbee_register_handler(uint8_t frame_type, xbee_frame_handler handler);
+int  xbee_dispatch_frame(const uint8_t * packet, int length);
+
+// decode the io sample data returned by an io sample frame or an IS command
+int  xbee_decode_io_data(const uint8_t * data, int length, xbee_io_sample_t * sample);
+
+#endif // XBEE_FRAMES_H
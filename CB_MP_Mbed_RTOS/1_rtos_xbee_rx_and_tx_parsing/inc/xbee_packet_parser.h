@@ -4,6 +4,15 @@
  * this is where we take the data stream from the xbee and actually extract the
  * data into packets (using the xbee state machine)
  *
+ * completed frames are kept in place in the ring buffer and handed out as
+ * frame descriptors - consumers read the frame directly out of the ring and
+ * then release it, so several frames can be waiting to be processed without
+ * copying any of them
+ *
+ * if a frame fails its checksum the parser rescans the bytes after its
+ * delimiter for the next 0x7E and carries on from there (so a stray delimiter
+ * or a corrupted length doesn't take the real frame down with it)
+ *
  * author:		Alex Shenfield
  * date:			10/11/2017
  */
@@ -14,6 +23,7 @@
 
 // include the basic headers
 #include "stm32f7xx.h"
+#include <stddef.h>
 
 // if we've not defined RING_SIZE elsewhere ...
 #ifndef RING_SIZE
@@ -22,8 +32,31 @@
 	#define RING_SIZE 1024
 #endif
 
+// note: the whole frame (delimiter, length, data field and checksum) has to fit
+// in the ring buffer, so the largest frame we can accept is RING_SIZE bytes
+
+// if we've not defined XBEE_API_MODE elsewhere ...
+#ifndef XBEE_API_MODE
+	// use api mode 1 (AP=1) - set this to 2 if the radios are configured for
+	// escaped api mode (AP=2), where any 0x7E, 0x7D, 0x11 or 0x13 in the frame is
+	// sent as 0x7D followed by the byte xor-ed with 0x20 (this stops a stray
+	// 0x7E in a payload from looking like the start of a new frame)
+	#define XBEE_API_MODE 1
+#endif
+
+// if we've not defined XBEE_FRAME_SLOTS elsewhere ...
+#ifndef XBEE_FRAME_SLOTS
+	// the number of completed frames that can be waiting in the ring buffer at
+	// once (again, keep this a power of two)
+	#define XBEE_FRAME_SLOTS 8
+#endif
+
 // define a uart buffer type that implements a ring buffer implementation
 // of a fifo queue to store sent and received data
+//
+// note: each frame is stored contiguously (if a frame won't fit before the end
+// of the buffer it is started again at the beginning) so that consumers can
+// read it through a plain pointer
 typedef struct
 {
 	uint8_t		data[RING_SIZE];
@@ -33,6 +66,38 @@ typedef struct
 } 
 buffer_typedef;
 
+// descriptor for a completed xbee api frame held in the ring buffer
+typedef struct
+{
+	uint16_t	offset;				// offset of the 0x7E delimiter in the ring buffer
+	uint16_t	length;				// length of the whole frame (delimiter to checksum)
+	uint8_t		frame_type;		// api frame type (e.g. 0x92 for an io sample)
+	uint32_t	timestamp;		// kernel systick when the frame was completed
+}
+xbee_frame_t;
+
+// queue of frame descriptors (oldest frame at frame_tail)
+typedef struct
+{
+	xbee_frame_t	frames[XBEE_FRAME_SLOTS];
+	uint8_t				frame_head;
+	uint8_t				frame_tail;
+	uint8_t				num_frames;
+}
+frame_queue_typedef;
+
+// counters for everything the parser has had to throw away (or recover)
+typedef struct
+{
+	uint32_t	frames_ok;				// frames that passed the checksum
+	uint32_t	bad_checksums;		// frames (or resync candidates) that failed it
+	uint32_t	resyncs;					// times we restarted from a delimiter found part way
+														// through a frame
+	uint32_t	dropped_bytes;		// bytes that weren't part of any good frame
+	uint32_t	ring_full;				// frames dropped because there wasn't room for them
+}
+xbee_parser_stats_t;
+
 // states for the xbee parser
 typedef enum state
 {
@@ -45,13 +110,56 @@ typedef enum state
 } 
 parse_state;
 
-// 
+// everything the parser needs to keep track of for one radio (so we can have
+// one of these for each xbee we're talking to)
+//
+// note: a parser should only ever be used from one thread at a time - none of
+// this is touched from an interrupt, so nothing in here needs to be volatile
+typedef struct
+{
+	// the state machine, the number of data field bytes still to come and the
+	// running checksum of the data field
+	parse_state		state;
+	int						remain;
+	uint32_t			sum;
+
+	// in escaped api mode (AP=2) this is the value to xor the next byte with
+	// (0x20 straight after an 0x7D escape character and 0 otherwise)
+	uint8_t				escape;
+
+	// hold on to the frame header until we know how long the frame is (and so
+	// where in the ring buffer it is going to go)
+	uint8_t				header[3];
+	uint16_t			frame_start;
+	uint16_t			frame_length;
+
+	// the ring buffer, the queue of completed frames in it and the statistics
+	buffer_typedef				buffer;
+	frame_queue_typedef		queue;
+	xbee_parser_stats_t		stats;
+}
+xbee_parser_t;
+
+//
 // global methods:
 //
-void init_parser(void);
-int  xbee_parse_packet(uint8_t c);
-void get_packet(uint8_t * packet_buffer);
+void init_parser(xbee_parser_t * parser);
+int  xbee_parse_packet(xbee_parser_t * parser, uint8_t c);
+size_t xbee_parse_bytes(xbee_parser_t * parser, const uint8_t * buf, size_t n, int * frames);
+void xbee_get_stats(const xbee_parser_t * parser, xbee_parser_stats_t * stats);
+
+// throw away any frame we're part way through and wait for the next delimiter
+// (e.g. when the uart tells us it has lost some bytes)
+void xbee_parser_resync(xbee_parser_t * parser);
 void xbee_send_packet(uint8_t * packet, int length);
 
-#endif // XBEE_PARSER_H
+// escape a frame for sending in api mode 2 (out needs to have room for twice
+// the frame length)
+int  xbee_escape_frame(const uint8_t * frame, int length, uint8_t * out);
+
+// zero copy frame access
+int  xbee_get_frame(const xbee_parser_t * parser, xbee_frame_t * frame);
+const uint8_t * xbee_frame_data(const xbee_parser_t * parser, const xbee_frame_t * frame);
+void xbee_release_frame(xbee_parser_t * parser);
 
+#endif // XBEE_PARSER_H
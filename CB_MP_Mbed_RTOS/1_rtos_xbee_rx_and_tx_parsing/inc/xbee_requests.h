@@ -0,0 +1,114 @@
+/*
+ * xbee_requests.h
+ *
+ * keep track of the frames we've sent that the xbee should answer (at
+ * commands, remote at commands and transmit requests) so we can tell when a
+ * command has been lost and send it again
+ *
+ * each request is given the next frame id (1 - 255, rolling over) and goes in
+ * the slot picked out by the bottom bits of that id, so matching a response
+ * to its request is just a table lookup. anything that isn't answered by its
+ * deadline is resent (with the timeout doubling each time) until we run out
+ * of retries
+ *
+ * note: this doesn't do any locking (or know about the rtos) - times are in
+ * whatever units the caller passes in, as long as they are the same units as
+ * the timeout
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __XBEE_REQUESTS_H
+#define __XBEE_REQUESTS_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+
+// if we've not defined XBEE_REQUEST_SLOTS elsewhere ...
+#ifndef XBEE_REQUEST_SLOTS
+	// the number of requests that can be waiting for a response (this has to be
+	// a power of two)
+	#define XBEE_REQUEST_SLOTS 16
+#endif
+
+// if we've not defined XBEE_REQUEST_RETRIES elsewhere ...
+#ifndef XBEE_REQUEST_RETRIES
+	// the number of times to resend a request before giving up on it
+	#define XBEE_REQUEST_RETRIES 3
+#endif
+
+// if we've not defined XBEE_REQUEST_MAX_FRAME elsewhere ...
+#ifndef XBEE_REQUEST_MAX_FRAME
+	// the longest frame we keep a copy of for resending (anything longer is sent
+	// but not tracked)
+	#define XBEE_REQUEST_MAX_FRAME 32
+#endif
+
+// the status a request completes with if it is never answered
+#define XBEE_REQUEST_TIMED_OUT 0xFF
+
+// called when a request is answered (status is the status from the response,
+// so 0 is ok) or when we give up on it (status is XBEE_REQUEST_TIMED_OUT)
+typedef void (*xbee_request_callback)(uint8_t frame_id, uint8_t status, uint32_t latency,
+	void * context);
+
+// the function used to (re)send a frame
+typedef void (*xbee_request_send)(uint8_t * frame, int length);
+
+// a request waiting for a response
+typedef struct
+{
+	uint8_t									in_use;
+	uint8_t									frame_id;
+	uint8_t									retries;
+	uint8_t									length;
+	uint32_t								sent;							// when it was first sent
+	uint32_t								deadline;					// when to give up waiting (this time)
+	xbee_request_callback		callback;
+	void *									context;
+	uint8_t									frame[XBEE_REQUEST_MAX_FRAME];
+}
+xbee_request_t;
+
+// counters for everything that happens to the requests
+typedef struct
+{
+	uint32_t	sent;							// requests tracked
+	uint32_t	completed;				// requests answered (whatever the status)
+	uint32_t	errors;						// ... with a non-zero status
+	uint32_t	retries;					// frames resent
+	uint32_t	timeouts;					// requests we gave up on
+	uint32_t	cancelled;				// requests the caller stopped waiting for
+	uint32_t	unmatched;				// responses that didn't match anything
+	uint32_t	full;							// requests sent untracked (no free slot or too long)
+	uint64_t	latency_total;		// sum of the latencies of answered requests (in sys
+										// ticks a 32 bit sum is gone in a few hundred)
+	uint32_t	latency_max;			// and the worst one
+}
+xbee_request_stats_t;
+
+// the table of outstanding requests
+typedef struct
+{
+	xbee_request_t				slots[XBEE_REQUEST_SLOTS];
+	uint8_t								next_id;
+	uint32_t							timeout;
+	xbee_request_stats_t	stats;
+}
+xbee_request_table_t;
+
+//
+// global methods:
+//
+void    xbee_requests_init(xbee_request_table_t * table, uint32_t timeout);
+uint8_t xbee_request_track(xbee_request_table_t * table, uint8_t * frame, int length,
+	uint32_t now, xbee_request_callback callback, void * context);
+int     xbee_request_complete(xbee_request_table_t * table, uint8_t frame_id,
+	uint8_t status, uint32_t now);
+void    xbee_request_cancel(xbee_request_table_t * table, uint8_t frame_id);
+int     xbee_request_due(const xbee_request_table_t * table, uint32_t now);
+int     xbee_request_poll(xbee_request_table_t * table, uint32_t now, xbee_request_send send);
+int     xbee_request_outstanding(const xbee_request_table_t * table);
+
+#endif // XBEE_REQUESTS_H
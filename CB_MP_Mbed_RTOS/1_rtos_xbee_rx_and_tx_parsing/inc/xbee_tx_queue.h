@@ -0,0 +1,95 @@
+/*
+ * xbee_tx_queue.h
+ *
+ * a queue of frames waiting to go out of the xbee uart - threads add whole 
+ * frames and carry on, and the uart (dma) completion interrupt sends them one
+ * after another
+ *
+ * the frames are held by reference, so whatever is in the queue has to stay
+ * put until its callback says it has been sent. adding frames is done by the
+ * threads (which have to take turns - this doesn't do any locking) and 
+ * sending them is done by the interrupt, so the only thing the two sides 
+ * share is the busy flag - starting the uart from a thread has to be done
+ * with the completion interrupt held off
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __XBEE_TX_QUEUE_H
+#define __XBEE_TX_QUEUE_H
+
+// include the basic headers
+#include "stm32f7xx.h"
+#include <stddef.h>
+
+// if we've not defined XBEE_TX_QUEUE_DEPTH elsewhere ...
+#ifndef XBEE_TX_QUEUE_DEPTH
+	// the number of frames that can be waiting to go out (this has to be a 
+	// power of two)
+	#define XBEE_TX_QUEUE_DEPTH 8
+#endif
+
+// if we've not defined XBEE_TX_QUEUE_BARRIER elsewhere ...
+#ifndef XBEE_TX_QUEUE_BARRIER
+	// make sure a frame is filled in before the interrupt can see it
+	#define XBEE_TX_QUEUE_BARRIER() __DMB()
+#endif
+
+// called (from the interrupt) once a frame has gone
+typedef void (*xbee_tx_callback)(const uint8_t * frame, int length, void * context);
+
+// a frame waiting to go out
+typedef struct
+{
+	const uint8_t *		data;
+	uint16_t					length;
+	xbee_tx_callback	callback;
+	void *						context;
+}
+xbee_tx_frame_t;
+
+// counters for the queue
+typedef struct
+{
+	uint32_t	queued;				// frames added
+	uint32_t	sent;					// frames sent
+	uint32_t	bytes;				// bytes sent
+	uint32_t	full;					// times a frame had to wait for room
+	uint32_t	high_water;		// the most frames there have been waiting at once
+}
+xbee_tx_stats_t;
+
+// the queue
+typedef struct
+{
+	xbee_tx_frame_t		frames[XBEE_TX_QUEUE_DEPTH];
+	volatile uint32_t	head;		// moved on by the threads
+	volatile uint32_t	tail;		// moved on by the interrupt
+	volatile uint8_t	busy;		// a frame is on its way out
+	xbee_tx_stats_t		stats;
+}
+xbee_tx_queue_t;
+
+//
+// global methods:
+//
+
+// empty the queue
+void xbee_tx_queue_init(xbee_tx_queue_t * queue);
+
+// thread side - get the next free slot (or NULL if the queue is full), fill it
+// in and then commit it (which hands it to the interrupt)
+xbee_tx_frame_t *       xbee_tx_queue_claim(xbee_tx_queue_t * queue);
+void                    xbee_tx_queue_commit(xbee_tx_queue_t * queue);
+
+// interrupt side - get the frame to send if the uart is idle (or NULL if it's
+// busy or there is nothing to send), and when it has gone, finish it off and
+// get the next one
+const xbee_tx_frame_t * xbee_tx_queue_start(xbee_tx_queue_t * queue);
+const xbee_tx_frame_t * xbee_tx_queue_complete(xbee_tx_queue_t * queue);
+
+// the number of frames waiting (including the one being sent)
+uint32_t                xbee_tx_queue_depth(const xbee_tx_queue_t * queue);
+
+#endif // XBEE_TX_QUEUE_H
@@ -0,0 +1,70 @@
+/*
+ * config_qspi.c
+ *
+ * the config store in the qspi flash
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the qspi flash driver (from the discovery board bsp)
+#include "stm32746g_discovery_qspi.h"
+
+// include the config store header
+#include "config_qspi.h"
+
+// where the store starts in the flash (the top of it)
+#define CONFIG_QSPI_BASE (N25Q128A_FLASH_SIZE - CONFIG_QSPI_BLOCKS * N25Q128A_SUBSECTOR_SIZE)
+
+// the bsp's qspi handle (we need it to get back out of memory mapped mode)
+extern QSPI_HandleTypeDef QSPIHandle;
+
+// FLASH ACCESS
+
+static int qspi_read(uint32_t address, void * data, uint32_t length)
+{
+	return BSP_QSPI_Read(data, CONFIG_QSPI_BASE + address, length) != QSPI_OK;
+}
+
+static int qspi_write(uint32_t address, const void * data, uint32_t length)
+{
+	return BSP_QSPI_Write((uint8_t *)data, CONFIG_QSPI_BASE + address, length) != QSPI_OK;
+}
+
+static int qspi_erase(uint32_t address)
+{
+	return BSP_QSPI_Erase_Block(CONFIG_QSPI_BASE + address) != QSPI_OK;
+}
+
+// the store's view of the flash (mapped is where the store appears while the
+// flash is memory mapped)
+static const config_flash_t config_qspi_flash =
+{
+	(const uint8_t *)(QSPI_BASE + CONFIG_QSPI_BASE),
+	N25Q128A_SUBSECTOR_SIZE,
+	CONFIG_QSPI_BLOCKS,
+	qspi_read,
+	qspi_write,
+	qspi_erase
+};
+
+// METHODS
+
+// set up the flash and read the store
+int config_qspi_open(config_store_t * store)
+{
+	if(BSP_QSPI_Init() != QSPI_OK || BSP_QSPI_EnableMemoryMappedMode() != QSPI_OK)
+	{
+		return CONFIG_STORE_FLASH_ERROR;
+	}
+
+	// reading the whole log straight out of memory is a lot quicker than a
+	// command per record
+	int result = config_store_open(store, &config_qspi_flash);
+
+	// and then back to sending commands, so we can write to it
+	if(HAL_QSPI_Abort(&QSPIHandle) != HAL_OK)
+	{
+		return CONFIG_STORE_FLASH_ERROR;
+	}
+	return result;
+}
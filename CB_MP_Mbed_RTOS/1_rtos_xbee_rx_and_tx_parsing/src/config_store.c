@@ -0,0 +1,692 @@
+/*
+ * config_store.c
+ *
+ * a log structured key / value store for settings that have to survive a
+ * reset
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stddef.h>
+#include <string.h>
+
+// include the config store header
+#include "config_store.h"
+
+// what a block can be doing
+#define BLOCK_ERASED  0
+#define BLOCK_USED    1
+#define BLOCK_DIRTY   2						// has something in it we can't use (needs erasing)
+
+// the block we're writing to before the first block is opened
+#define NO_BLOCK      0xFFFF
+
+// the header at the start of each block that's in use - copied is left as
+// 0xffffffff while the records from the oldest block are being copied in,
+// and cleared once they all are (so we can tell if the power went part way
+// through)
+#define BLOCK_MAGIC   0x31474643			// "CFG1"
+#define COPY_DONE     0x00000000
+typedef struct
+{
+	uint32_t	magic;
+	uint32_t	sequence;
+	uint32_t	crc;										// of the magic number and sequence number
+	uint32_t	copied;
+}
+block_header_t;
+
+// the header at the start of each record (followed by the value, padded out
+// to a multiple of four bytes) - the crc covers the first eight bytes and the
+// value
+#define RECORD_VALUE    0xFF
+#define RECORD_DELETED  0xFE
+typedef struct
+{
+	uint32_t	key;
+	uint16_t	length;
+	uint8_t		flags;
+	uint8_t		spare;
+	uint32_t	crc;
+}
+record_header_t;
+
+#define RECORD_CRC_BYTES 8
+
+// CRC
+
+// the usual crc32 (the one zip and ethernet use), a bit at a time - it's only
+// run over a few bytes per record, and a table would cost a kilobyte of flash
+static uint32_t crc32_update(uint32_t crc, const void * data, uint32_t length)
+{
+	const uint8_t * bytes = data;
+	int bit;
+
+	while(length--)
+	{
+		crc ^= *bytes++;
+		for(bit = 0; bit < 8; bit++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+	return crc;
+}
+
+static uint32_t block_crc(const block_header_t * header)
+{
+	return ~crc32_update(0xFFFFFFFF, header, 8);
+}
+
+static uint32_t record_crc(const record_header_t * header, const void * value)
+{
+	uint32_t crc = crc32_update(0xFFFFFFFF, header, RECORD_CRC_BYTES);
+	return ~crc32_update(crc, value, header->length);
+}
+
+// HELPER FUNCTIONS
+
+// how much flash a record takes up
+static uint32_t record_size(uint16_t length)
+{
+	return sizeof(record_header_t) + ((length + 3) & ~3);
+}
+
+// check a piece of (memory mapped) flash is all erased
+static int all_erased(const uint8_t * data, uint32_t length)
+{
+	while(length--)
+	{
+		if(*data++ != 0xFF)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// the bytes of records a block can hold
+static uint32_t usable(const config_store_t * store)
+{
+	return store->flash->block_size - sizeof(block_header_t);
+}
+
+// the most bytes of records we'll keep - one block is always kept erased, and
+// one more block's worth has to be free so clearing out old blocks always
+// gets somewhere
+static uint32_t capacity(const config_store_t * store)
+{
+	return (store->flash->blocks - 2) * usable(store);
+}
+
+static uint16_t count_blocks(const config_store_t * store, uint8_t state)
+{
+	uint16_t i, count = 0;
+	for(i = 0; i < store->flash->blocks; i++)
+	{
+		count += (store->state[i] == state);
+	}
+	return count;
+}
+
+// the block that was filled first (not counting the one we're writing to)
+static uint16_t oldest_block(const config_store_t * store)
+{
+	uint16_t i, oldest = NO_BLOCK;
+	for(i = 0; i < store->flash->blocks; i++)
+	{
+		if(store->state[i] == BLOCK_USED && i != store->head &&
+			(oldest == NO_BLOCK || (int32_t)(store->sequence[i] - store->sequence[oldest]) < 0))
+		{
+			oldest = i;
+		}
+	}
+	return oldest;
+}
+
+// whether the record at one address was written before the one at another
+// (going by the blocks' sequence numbers, then where they are in the block)
+static int written_before(const config_store_t * store, uint32_t first, uint32_t second)
+{
+	uint32_t block_size = store->flash->block_size;
+	int32_t age = (int32_t)(store->sequence[first / block_size] -
+		store->sequence[second / block_size]);
+	return (age != 0) ? (age < 0) : (first < second);
+}
+
+// bytes of records in a block that are still wanted
+static uint32_t live_in_block(const config_store_t * store, uint16_t block)
+{
+	uint32_t start = block * store->flash->block_size;
+	uint32_t end = start + store->flash->block_size;
+	uint32_t live = 0;
+	uint16_t i;
+
+	for(i = 0; i < store->count; i++)
+	{
+		if(store->index[i].address >= start && store->index[i].address < end)
+		{
+			live += record_size(store->index[i].length);
+		}
+	}
+	return live;
+}
+
+// INDEX
+
+// find a key in the index - returns where it is, or (-1 - where it should go)
+// if it isn't there
+static int index_find(const config_store_t * store, uint32_t key)
+{
+	int low = 0, high = store->count - 1;
+	while(low <= high)
+	{
+		int middle = (low + high) / 2;
+		if(store->index[middle].key == key)
+		{
+			return middle;
+		}
+		if(store->index[middle].key < key)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+	}
+	return -1 - low;
+}
+
+// point a key at a new record (adding it if we need to)
+static int index_set(config_store_t * store, uint32_t key, uint32_t address,
+	uint16_t length)
+{
+	int i = index_find(store, key);
+	if(i >= 0)
+	{
+		store->live -= record_size(store->index[i].length);
+	}
+	else
+	{
+		if(store->count == CONFIG_STORE_MAX_KEYS)
+		{
+			return CONFIG_STORE_FULL;
+		}
+		i = -1 - i;
+		memmove(&store->index[i + 1], &store->index[i],
+			(store->count - i) * sizeof(config_index_t));
+		store->count++;
+		store->index[i].key = key;
+	}
+	store->index[i].address = address;
+	store->index[i].length = length;
+	store->live += record_size(length);
+	return CONFIG_STORE_OK;
+}
+
+static void index_remove(config_store_t * store, uint32_t key)
+{
+	int i = index_find(store, key);
+	if(i >= 0)
+	{
+		store->live -= record_size(store->index[i].length);
+		store->count--;
+		memmove(&store->index[i], &store->index[i + 1],
+			(store->count - i) * sizeof(config_index_t));
+	}
+}
+
+// READING THE LOG
+
+// go through the records in a block (straight out of memory mapped flash) and
+// put them in the index - returns where the next record can go, or the end of
+// the block if it has something in it we don't trust (a record that was being
+// written when the power went)
+static uint32_t replay_block(config_store_t * store, uint16_t block)
+{
+	uint32_t block_size = store->flash->block_size;
+	const uint8_t * base = store->flash->mapped + block * block_size;
+	uint32_t offset = sizeof(block_header_t);
+	record_header_t header;
+
+	while(offset + sizeof(record_header_t) <= block_size)
+	{
+		memcpy(&header, base + offset, sizeof(record_header_t));
+
+		// the end of the log (as long as the power didn't go part way through
+		// writing the next record)
+		if(all_erased((const uint8_t *)&header, sizeof(record_header_t)))
+		{
+			return all_erased(base + offset, block_size - offset) ? offset : block_size;
+		}
+
+		if(header.key == CONFIG_STORE_NO_KEY || header.length > CONFIG_STORE_MAX_VALUE ||
+			offset + record_size(header.length) > block_size ||
+			record_crc(&header, base + offset + sizeof(record_header_t)) != header.crc)
+		{
+			store->stats.bad_records++;
+			return block_size;
+		}
+
+		store->stats.scanned++;
+		if(header.flags == RECORD_DELETED)
+		{
+			index_remove(store, header.key);
+		}
+		else
+		{
+			index_set(store, header.key, block * block_size + offset, header.length);
+		}
+		offset += record_size(header.length);
+	}
+	return block_size;
+}
+
+// WRITING THE LOG
+
+// erase a block
+static int erase_block(config_store_t * store, uint16_t block)
+{
+	const config_flash_t * flash = store->flash;
+
+	store->state[block] = BLOCK_DIRTY;
+	store->stats.erases++;
+	if(flash->erase(block * flash->block_size) != 0)
+	{
+		return CONFIG_STORE_FLASH_ERROR;
+	}
+	store->state[block] = BLOCK_ERASED;
+	return CONFIG_STORE_OK;
+}
+
+// start writing to the next erased block (going round the blocks in turn, so
+// they all get erased about as often)
+static int open_block(config_store_t * store, uint32_t copied)
+{
+	const config_flash_t * flash = store->flash;
+	uint16_t i, block;
+	block_header_t header;
+
+	block = (store->head == NO_BLOCK) ? 0 : store->head + 1;
+	for(i = 0; i < flash->blocks; i++, block++)
+	{
+		block %= flash->blocks;
+		if(store->state[block] == BLOCK_ERASED)
+		{
+			break;
+		}
+	}
+	if(i == flash->blocks)
+	{
+		return CONFIG_STORE_FULL;
+	}
+
+	header.magic = BLOCK_MAGIC;
+	header.sequence = store->next_sequence++;
+	header.crc = block_crc(&header);
+	header.copied = copied;
+
+	store->state[block] = BLOCK_USED;
+	store->sequence[block] = header.sequence;
+	store->head = block;
+	store->head_offset = flash->block_size;
+	if(flash->write(block * flash->block_size, &header, sizeof(header)) != 0)
+	{
+		store->state[block] = BLOCK_DIRTY;
+		return CONFIG_STORE_FLASH_ERROR;
+	}
+	store->head_offset = sizeof(block_header_t);
+	return CONFIG_STORE_OK;
+}
+
+// write a record (header and value together) on the end of the log, noting
+// where it went
+static int append(config_store_t * store, const void * record, uint32_t size,
+	uint32_t * address)
+{
+	const config_flash_t * flash = store->flash;
+
+	*address = store->head * flash->block_size + store->head_offset;
+	store->stats.written += size;
+
+	// if the write fails we don't know how much of it went in, so don't put
+	// anything else after it
+	if(flash->write(*address, record, size) != 0)
+	{
+		store->head_offset = flash->block_size;
+		return CONFIG_STORE_FLASH_ERROR;
+	}
+	store->head_offset += size;
+	return CONFIG_STORE_OK;
+}
+
+// move on to a new block when we're down to the last erased one - the records
+// that are still wanted from the oldest block are copied into it, and then the
+// oldest block is erased (anything else in it is an old value, or a delete
+// that nothing older needs any more). if the power goes part way through, the
+// copy is thrown away and done again next time
+static int copy_oldest(config_store_t * store)
+{
+	const config_flash_t * flash = store->flash;
+	uint16_t block = oldest_block(store);
+	uint32_t offset = sizeof(block_header_t);
+	uint32_t record[(sizeof(record_header_t) + CONFIG_STORE_MAX_VALUE) / 4];
+	record_header_t * header = (record_header_t *)record;
+	uint32_t done = COPY_DONE;
+	int result;
+
+	if(block == NO_BLOCK)
+	{
+		return CONFIG_STORE_FULL;
+	}
+	result = open_block(store, 0xFFFFFFFF);
+	if(result != CONFIG_STORE_OK)
+	{
+		return result;
+	}
+
+	while(offset + sizeof(record_header_t) <= flash->block_size)
+	{
+		uint32_t address = block * flash->block_size + offset;
+		if(flash->read(address, header, sizeof(record_header_t)) != 0)
+		{
+			return CONFIG_STORE_FLASH_ERROR;
+		}
+		if(header->key == CONFIG_STORE_NO_KEY || header->length > CONFIG_STORE_MAX_VALUE ||
+			offset + record_size(header->length) > flash->block_size)
+		{
+			break;
+		}
+
+		// only copy it if it's the latest record for its key (the crc was
+		// checked when the log was read)
+		int i = index_find(store, header->key);
+		if(i >= 0 && store->index[i].address == address)
+		{
+			uint32_t size = record_size(header->length);
+			if(flash->read(address, record, size) != 0 ||
+				append(store, record, size, &store->index[i].address) != CONFIG_STORE_OK)
+			{
+				// leave the key pointing at the old copy
+				store->index[i].address = address;
+				return CONFIG_STORE_FLASH_ERROR;
+			}
+			store->stats.copied++;
+		}
+		offset += record_size(header->length);
+	}
+
+	if(flash->write(store->head * flash->block_size + offsetof(block_header_t, copied), &done, sizeof(done)) != 0)
+	{
+		return CONFIG_STORE_FLASH_ERROR;
+	}
+	return erase_block(store, block);
+}
+
+// erase any blocks we couldn't use
+static int erase_dirty(config_store_t * store)
+{
+	uint16_t i;
+	for(i = 0; i < store->flash->blocks; i++)
+	{
+		if(store->state[i] == BLOCK_DIRTY && erase_block(store, i) != CONFIG_STORE_OK)
+		{
+			return CONFIG_STORE_FLASH_ERROR;
+		}
+	}
+	return CONFIG_STORE_OK;
+}
+
+// make sure there's room to add a record on the end of the log
+static int make_room(config_store_t * store, uint32_t size)
+{
+	const config_flash_t * flash = store->flash;
+	uint16_t tries;
+	int result = erase_dirty(store);
+
+	// every block might need clearing out once before we find one with enough
+	// to throw away
+	for(tries = 0; result == CONFIG_STORE_OK && tries <= flash->blocks; tries++)
+	{
+		if(store->head != NO_BLOCK && store->head_offset + size <= flash->block_size)
+		{
+			return CONFIG_STORE_OK;
+		}
+		if(count_blocks(store, BLOCK_ERASED) > 1)
+		{
+			result = open_block(store, COPY_DONE);
+		}
+		else
+		{
+			result = copy_oldest(store);
+		}
+	}
+	return (result == CONFIG_STORE_OK) ? CONFIG_STORE_FULL : result;
+}
+
+// write a value or a delete
+static int write_record(config_store_t * store, uint32_t key, uint8_t flags,
+	const void * value, uint16_t length)
+{
+	uint32_t record[(sizeof(record_header_t) + CONFIG_STORE_MAX_VALUE) / 4];
+	record_header_t * header = (record_header_t *)record;
+	uint32_t size = record_size(length);
+	uint32_t address;
+
+	header->key = key;
+	header->length = length;
+	header->flags = flags;
+	header->spare = 0xFF;
+	header->crc = record_crc(header, value);
+	memset((uint8_t *)record + sizeof(record_header_t), 0xFF, size - sizeof(record_header_t));
+	if(length > 0)
+	{
+		memcpy((uint8_t *)record + sizeof(record_header_t), value, length);
+	}
+
+	int result = make_room(store, size);
+	if(result == CONFIG_STORE_OK)
+	{
+		result = append(store, record, size, &address);
+	}
+	if(result != CONFIG_STORE_OK)
+	{
+		return result;
+	}
+
+	store->stats.puts++;
+	if(flags == RECORD_DELETED)
+	{
+		index_remove(store, key);
+		return CONFIG_STORE_OK;
+	}
+	return index_set(store, key, address, length);
+}
+
+// METHODS
+
+// read the log and build the index
+int config_store_open(config_store_t * store, const config_flash_t * flash)
+{
+	uint16_t order[CONFIG_STORE_MAX_BLOCKS];
+	uint16_t i, j, used = 0;
+	block_header_t header;
+
+	if(flash->blocks < 3 || flash->blocks > CONFIG_STORE_MAX_BLOCKS ||
+		flash->block_size < sizeof(block_header_t) + record_size(CONFIG_STORE_MAX_VALUE) ||
+		flash->block_size % 4 != 0)
+	{
+		return CONFIG_STORE_BAD_VALUE;
+	}
+
+	memset(store, 0, sizeof(config_store_t));
+	store->flash = flash;
+	store->head = NO_BLOCK;
+	store->next_sequence = 1;
+
+	// sort out which blocks are in use (keeping them in the order they were
+	// filled in) and which are erased
+	for(i = 0; i < flash->blocks; i++)
+	{
+		const uint8_t * block = flash->mapped + i * flash->block_size;
+		memcpy(&header, block, sizeof(header));
+
+		if(header.magic == BLOCK_MAGIC && header.crc == block_crc(&header))
+		{
+			store->state[i] = BLOCK_USED;
+			store->sequence[i] = header.sequence;
+			for(j = used++; j > 0 && (int32_t)(store->sequence[order[j - 1]] - header.sequence) > 0; j--)
+			{
+				order[j] = order[j - 1];
+			}
+			order[j] = i;
+		}
+		else
+		{
+			store->state[i] = all_erased(block, flash->block_size) ? BLOCK_ERASED : BLOCK_DIRTY;
+		}
+	}
+
+	if(used > 0)
+	{
+		store->next_sequence = store->sequence[order[used - 1]] + 1;
+
+		// if the power went while the oldest block was being copied, everything
+		// in the copy is still in the oldest block - so just throw the copy away
+		// (it gets done again when we next need a block)
+		memcpy(&header, flash->mapped + order[used - 1] * flash->block_size, sizeof(header));
+		if(header.copied != COPY_DONE)
+		{
+			store->state[order[--used]] = BLOCK_DIRTY;
+		}
+	}
+
+	// no erased blocks at all means the power went after a copy had finished
+	// but before the block it was copied from had been erased (or part way
+	// through erasing it, with its header still there) - everything wanted from
+	// it is in the newest block, and what's left of it can't be trusted, so
+	// don't read it (it gets erased again when we next need a block)
+	if(used > 1 && count_blocks(store, BLOCK_ERASED) == 0 &&
+		count_blocks(store, BLOCK_DIRTY) == 0)
+	{
+		store->state[order[0]] = BLOCK_DIRTY;
+		memmove(&order[0], &order[1], --used * sizeof(order[0]));
+	}
+
+	// then replay them oldest first, so the index ends up pointing at the newest
+	// record for each key - carrying on from the end of the newest one
+	for(i = 0; i < used; i++)
+	{
+		store->head = order[i];
+		store->head_offset = replay_block(store, order[i]);
+	}
+	return CONFIG_STORE_OK;
+}
+
+// look up a value
+int config_store_get(config_store_t * store, uint32_t key, void * value, uint16_t size)
+{
+	int i = index_find(store, key);
+	if(i < 0)
+	{
+		return CONFIG_STORE_NOT_FOUND;
+	}
+
+	uint16_t length = store->index[i].length;
+	if(store->flash->read(store->index[i].address + sizeof(record_header_t), value,
+		(length < size) ? length : size) != 0)
+	{
+		return CONFIG_STORE_FLASH_ERROR;
+	}
+	return length;
+}
+
+// set a value
+int config_store_put(config_store_t * store, uint32_t key, const void * value,
+	uint16_t length)
+{
+	if(key == CONFIG_STORE_NO_KEY || length > CONFIG_STORE_MAX_VALUE)
+	{
+		return CONFIG_STORE_BAD_VALUE;
+	}
+
+	// make sure it'll fit before writing anything (so a full store is left as
+	// it was)
+	int i = index_find(store, key);
+	if(i < 0 && store->count == CONFIG_STORE_MAX_KEYS)
+	{
+		return CONFIG_STORE_FULL;
+	}
+	uint32_t live = store->live + record_size(length) -
+		((i >= 0) ? record_size(store->index[i].length) : 0);
+	if(live > capacity(store))
+	{
+		return CONFIG_STORE_FULL;
+	}
+
+	return write_record(store, key, RECORD_VALUE, value, length);
+}
+
+// remove a value
+int config_store_delete(config_store_t * store, uint32_t key)
+{
+	if(index_find(store, key) < 0)
+	{
+		return CONFIG_STORE_NOT_FOUND;
+	}
+	return write_record(store, key, RECORD_DELETED, NULL, 0);
+}
+
+// find the key that was written longest ago
+int config_store_oldest(config_store_t * store, uint32_t * key)
+{
+	int i, oldest = -1;
+
+	for(i = 0; i < store->count; i++)
+	{
+		if(oldest < 0 || written_before(store, store->index[i].address,
+			store->index[oldest].address))
+		{
+			oldest = i;
+		}
+	}
+	if(oldest < 0)
+	{
+		return CONFIG_STORE_NOT_FOUND;
+	}
+	*key = store->index[oldest].key;
+	return CONFIG_STORE_OK;
+}
+
+// tidy up a bit
+int config_store_maintain(config_store_t * store)
+{
+	uint16_t i;
+
+	// erase a block we couldn't use
+	for(i = 0; i < store->flash->blocks; i++)
+	{
+		if(store->state[i] == BLOCK_DIRTY)
+		{
+			int result = erase_block(store, i);
+			return (result == CONFIG_STORE_OK) ? 1 : result;
+		}
+	}
+
+	// if the next put might need to clear out the oldest block (we're down to
+	// the last erased block and the one we're writing is nearly full) do it
+	// now, so the put doesn't have to wait for the erase - as long as enough of
+	// the oldest block can be thrown away to leave room for a few puts
+	// (otherwise we'd mostly just be moving the same records round)
+	uint16_t oldest = oldest_block(store);
+	if(store->head != NO_BLOCK && count_blocks(store, BLOCK_ERASED) == 1 &&
+		store->flash->block_size - store->head_offset < usable(store) / 4 &&
+		oldest != NO_BLOCK && live_in_block(store, oldest) <= usable(store) * 3 / 4)
+	{
+		int result = copy_oldest(store);
+		return (result == CONFIG_STORE_OK) ? 1 : result;
+	}
+	return 0;
+}
@@ -4,7 +4,7 @@
  * print debugging information to the itm debug viewer in uvision
  *
  * we use this for debugging because it doesn't interfere with the uart output
- * on the virtual com port.  we can have debugging stuff go to the itm viewer 
+ * on the virtual com port.  we can have debugging stuff go to the itm viewer
  * and program output to the uart.
  *
  * author:    Alex Shenfield
@@ -13,33 +13,90 @@
  */
 
 #include "stm32f7xx_hal.h"
+#include "itm_debug.h"
 
 // define the ITM ports
 #define ITM_Port8(n)	(*((volatile uint8_t *)(0xE0000000+4*n)))
+#define ITM_Port32(n)	(*((volatile uint32_t *)(0xE0000000+4*n)))
 
 // define ITM trace enable register (TER) and trace control register (TCR)
 #define ITM_TER       (*((volatile uint32_t *)0xE0000E00))
 #define ITM_TCR       (*((volatile uint32_t *)0xE0000E80))
 
-// debugging output
+// the records (or characters) we've had to throw away on each port
+static uint32_t itm_lost[ITM_CHANNELS];
+
+// is a port turned on
+static int itm_enabled(uint32_t channel)
+{
+	return (ITM_TCR & ITM_TCR_ITMENA_Msk) && (ITM_TER & (1UL << channel));
+}
+
+// debugging output (if the itm can't keep up then the rest of the line is
+// dropped rather than waiting for it)
 void print_debug(char* s, int length)
 {
 	// check the itm port is enabled ...
-	if((ITM_TCR & ITM_TCR_ITMENA_Msk) && (ITM_TER & (1UL << 0)))
+	if(itm_enabled(ITM_CH_CONSOLE))
 	{
 		// iterate over the length of the string character by character
 		int i = 0;
-		for(i = 0; i < length; i++)
+		for(i = 0; i < length + 2; i++)
+		{
+			// put the character on the ITM viewer (followed by a carriage return
+			// and new line)
+			if(ITM_Port8(ITM_CH_CONSOLE) == 0)
+			{
+				itm_lost[ITM_CH_CONSOLE] += length + 2 - i;
+				return;
+			}
+			ITM_Port8(ITM_CH_CONSOLE) = (i < length) ? (uint8_t)(s[i]) :
+				((i == length) ? 0x0D : 0x0A);
+		}
+	}
+}
+
+// send a record a word at a time (holding the interrupts off, so records from
+// different threads don't get mixed up) - if the fifo fills up part way
+// through, the decoder finds the start of the next record from its header
+int itm_send(uint32_t channel, itm_event_t event, const uint32_t * words,
+	uint32_t count)
+{
+	int sent = 0;
+	uint32_t i;
+
+	if(channel >= ITM_CHANNELS || count > 0xFF || !itm_enabled(channel))
+	{
+		return 0;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(ITM_Port32(channel) != 0)
+	{
+		ITM_Port32(channel) = (ITM_SYNC << 24) | (count << 16) | (event & 0xFFFF);
+		for(i = 0; i <= count; i++)
 		{
-			// put the character on the ITM viewer
-			while(ITM_Port8(0) == 0);
-			ITM_Port8(0) = (uint8_t)(s[i]);
+			if(ITM_Port32(channel) == 0)
+			{
+				break;
+			}
+			ITM_Port32(channel) = (i == 0) ? DWT->CYCCNT : words[i - 1];
 		}
-		
-		// do a new line and carriage return
-		while(ITM_Port8(0) == 0);
-		ITM_Port8(0) = 0x0D;
-		while(ITM_Port8(0) == 0);
-		ITM_Port8(0) = 0x0A;
+		sent = (i > count);
 	}
+	if(!sent)
+	{
+		itm_lost[channel]++;
+	}
+
+	__set_PRIMASK(primask);
+	return sent;
+}
+
+// get the number of records thrown away on a port
+uint32_t itm_dropped(uint32_t channel)
+{
+	return (channel < ITM_CHANNELS) ? itm_lost[channel] : 0;
 }
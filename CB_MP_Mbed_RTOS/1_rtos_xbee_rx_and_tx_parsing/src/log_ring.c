@@ -0,0 +1,130 @@
+/*
+ * log_ring.c
+ *
+ * a ring buffer of text waiting to go out of a uart (with a choice of what to
+ * do when it fills up)
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include "log_ring.h"
+
+#include <string.h>
+
+// METHODS
+
+// set up the ring
+void log_ring_init(log_ring_t * ring, uint8_t * buffer, uint32_t size,
+	log_ring_policy_t policy)
+{
+	ring->buffer = buffer;
+	ring->size = size;
+	ring->policy = policy;
+	ring->head = 0;
+	ring->tail = 0;
+	memset(&ring->stats, 0, sizeof(ring->stats));
+}
+
+// the number of bytes in the ring
+uint32_t log_ring_count(const log_ring_t * ring)
+{
+	return ring->head - ring->tail;
+}
+
+// add text to the ring (making room for it first if we're allowed to)
+uint32_t log_ring_write(log_ring_t * ring, const uint8_t * data, uint32_t length)
+{
+	uint32_t room = ring->size - log_ring_count(ring);
+
+	if(length > room)
+	{
+		if(ring->policy == LOG_RING_OVERWRITE)
+		{
+			// throw away the oldest text (and if there's more new text than will
+			// fit in the whole ring, the start of that too)
+			if(length > ring->size)
+			{
+				ring->stats.overwritten += length - ring->size;
+				data += length - ring->size;
+				length = ring->size;
+			}
+			ring->stats.overwritten += length - room;
+			ring->tail += length - room;
+		}
+		else if(ring->policy == LOG_RING_BLOCK)
+		{
+			// take what fits and let the caller wait for the rest
+			ring->stats.blocked++;
+			length = room;
+		}
+		else
+		{
+			ring->stats.dropped += length - room;
+			length = room;
+		}
+	}
+
+	// copy it in (in two goes if it wraps round the end of the buffer)
+	uint32_t start = ring->head & (ring->size - 1);
+	uint32_t first = ring->size - start;
+	if(first > length)
+	{
+		first = length;
+	}
+	memcpy(&ring->buffer[start], data, first);
+	memcpy(ring->buffer, data + first, length - first);
+
+	ring->head += length;
+	ring->stats.written += length;
+	if(log_ring_count(ring) > ring->stats.high_water)
+	{
+		ring->stats.high_water = log_ring_count(ring);
+	}
+	return length;
+}
+
+// count text we've had to throw away
+void log_ring_discard(log_ring_t * ring, uint32_t length)
+{
+	ring->stats.dropped += length;
+}
+
+// add a character (and decide whether the caller has to wait) - with
+// LOG_RING_DROP and LOG_RING_OVERWRITE the write has already dealt with a full
+// ring, so there's never anything to wait for
+int log_ring_putc(log_ring_t * ring, uint8_t c, int can_wait)
+{
+	if(log_ring_write(ring, &c, 1) > 0 || ring->policy != LOG_RING_BLOCK)
+	{
+		return 1;
+	}
+	if(!can_wait)
+	{
+		log_ring_discard(ring, 1);
+		return 1;
+	}
+	return 0;
+}
+
+// take the oldest text out of the ring
+uint32_t log_ring_read(log_ring_t * ring, uint8_t * data, uint32_t length)
+{
+	if(length > log_ring_count(ring))
+	{
+		length = log_ring_count(ring);
+	}
+
+	uint32_t start = ring->tail & (ring->size - 1);
+	uint32_t first = ring->size - start;
+	if(first > length)
+	{
+		first = length;
+	}
+	memcpy(data, &ring->buffer[start], first);
+	memcpy(data + first, ring->buffer, length - first);
+
+	ring->tail += length;
+	ring->stats.sent += length;
+	return length;
+}
@@ -19,9 +19,12 @@
 
 // include the xbee tx and rx functionality
 #include "xbee.h"
+#include "xbee_frame_builder.h"
+#include "xbee_baud.h"
 
-// include the itm debugging
+// include the itm debugging and the binary trace log
 #include "itm_debug.h"
+#include "trace.h"
 
 // include data proc thread
 #include "data_processing.h"
@@ -43,6 +46,15 @@ extern uint64_t systemUptime, uptimeCorrection;
 // Declare Threads Here!!
 extern int init_xbee_threads(void);
 
+// send a frame (keeping track of it until it is answered), and send one that
+// stays put without copying it
+extern void send_frame(uint8_t *frame, int length);
+extern void send_prebuilt_frame(uint8_t *frame, int length, volatile uint8_t *in_flight);
+
+// send a local at command and wait for the answer
+extern int xbee_at_command(const char *command, const uint8_t *param, int length, 
+	uint32_t timeout);
+
 //Include Mutex
 extern osMutexId(xbee_rx_lock_id);
 
@@ -60,55 +72,31 @@ void HAL_Delay(__IO uint32_t Delay)
 
 
 
-// set up adc on dio 0 on all xbees connected to the WPAN - Light
-uint8_t init_adc_0[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x30, 0x02, 0x74};
-
-// set up adc on dio 1 on all xbees connected to the WPAN - Temp
-uint8_t init_adc_1[] = {0x7E, 0x00, 0x10, 0x17, 0x02, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x31, 0x02, 0x72};
-
-// set up adc on dio 2 on all xbees connected to the WPAN - Thresh Pot	
-uint8_t init_adc_2[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x32, 0x02, 0x72};
-	
-//set up Din on dio 3 on all xbees connected to the WPAN - PIR
-uint8_t init_dig_3[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x33, 0x03, 0x70};	
-
-//set up Din on dio 3 on all xbees connected to the WPAN - Thresh button	
-uint8_t init_dig_4[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x44, 0x34, 0x03, 0x6F};
+// every xbee connected to the WPAN (the configuration commands are broadcast)
+xbee_address_t broadcast;
 
-	//7E 00 10 17 01 00 00 00 00 00 00 FF FF FF FE 02 49 52 30 1F
-uint8_t reset_ir_packet[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x52, 0x30, 0x1F};
-	
-//Sampling packet with freq set to 6s
-uint8_t ir_packet[]  = {0x7E, 0x00, 0x11, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x52, 0x17, 0xFC, 0x3C};
+// sampling packet with freq set to 6s, and the one we use to correct the 
+// timing (these get built at start up and resent from the timers)
+uint8_t ir_packet[21];
+uint8_t ir_correction[21];
+int ir_packet_length, ir_correction_length;
 
-uint8_t ir_correction[] = {0x7E, 0x00, 0x11, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x52, 0x18, 0x06, 0x31};	
-	
-//Sampling pakcet with freq set to 6s
-uint8_t ir_addr_0[] = {0x7E, 0x00, 0x11, 0x17, 0x01, 0x00, 0x13, 0xA2, 0x00, 
-	0x41, 0x72, 0xFC, 0xC9, 0x79, 0x1A, 0x02, 0x49, 0x52, 0x17, 0x70, 0x03};	
+// set while the uart is still sending them
+volatile uint8_t ir_packet_in_flight, ir_correction_in_flight;
 
-uint8_t ir_addr_1[] = {0x7E, 0x00, 0x11, 0x17, 0x01, 0x00, 0x13, 0xA2, 0x00, 
-	0x41, 0x5D, 0x55, 0x3B, 0xEB, 0x47, 0x02, 0x49, 0x52, 0x17, 0x70, 0xAE};
+// build and send remote at commands
+static int build_remote_at(uint8_t * packet, int size, const xbee_address_t * dest,
+	uint8_t frame_id, const char * command, uint16_t value, int value_length);
+static void send_remote_at(const xbee_address_t * dest, uint8_t frame_id,
+	const char * command, uint16_t value, int value_length);
 
-// packet to do queried sampling (note - analog / digital ios must be 
-// configured before this is sent or we will get an error status)
-uint8_t is_packet[]  = {0x7E, 0x00, 0x0F, 0x17, 0x55, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x53, 0xFA};
-	
-uint8_t my_packet[] = {0x7E, 0x00, 0x0F, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x02, 0x4D, 0x59, 0x43};	
+// the rates to try running the xbee link at (fastest first) - if the radio 
+// won't do any of them we stay at 9600
+static const uint32_t xbee_baud_targets[] = {230400, 115200};
 
-uint8_t ic_packet[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFE, 0x02, 0x49, 0x43, 0x10, 0x4E};
-	
+// find the coordinator xbee and speed up the link to it
+static void negotiate_baud(void);
+static void baud_delay(uint32_t ms);
 	
 uint8_t flagOnce = 1;	
 // CODE	
@@ -124,6 +112,9 @@ int main()
 	HAL_Init();
 	init_sysclk_216MHz();
 	
+	// start the clock the trace log is time stamped with
+	trace_init(SystemCoreClock);
+	
 	// note also that we need to set the correct core clock in the rtx_conf_cm.c
 	// file (OS_CLOCK) which we can do using the configuration wizard
 	
@@ -139,31 +130,51 @@ int main()
 	print_debug("initialising xbee thread", 24);
 	init_xbee_threads();
 	
+	// speed the link to the coordinator xbee up as far as it will go
+	negotiate_baud();
+	
+#if XBEE_FLOW_CONTROL
+	// the coordinator xbee's cts output is on by default, but it ignores rts 
+	// unless we tell it not to
+	uint8_t rts_flow = 1;
+	if(xbee_at_command("D6", &rts_flow, 1, 200) != 0){
+		printf("!!coordinator xbee didn't turn on rts flow control!!\n");
+	}
+#endif
+	
+	// build the sampling packets
+	xbee_address_init(&broadcast, XBEE_BROADCAST_64, XBEE_UNKNOWN_16);
+	ir_packet_length = build_remote_at(ir_packet, sizeof(ir_packet), &broadcast, 
+		0x01, "IR", 6140, 2);
+	ir_correction_length = build_remote_at(ir_correction, sizeof(ir_correction), 
+		&broadcast, 0x01, "IR", 6150, 2);
+	
 	// wait for the coordinator xbee to settle down, and then send the 
 	// configuration packets
 	print_debug("sending configuration packets", 29);
 	osDelay(1000);
-	send_xbee(init_adc_0, 20);
+	send_remote_at(&broadcast, 0x01, "D0", 0x02, 1);		// adc on dio 0 - Light
 	osDelay(1000);
-	send_xbee(init_adc_1, 20);
+	send_remote_at(&broadcast, 0x02, "D1", 0x02, 1);		// adc on dio 1 - Temp
 	osDelay(1000);
-	send_xbee(init_adc_2, 20);
+	send_remote_at(&broadcast, 0x01, "D2", 0x02, 1);		// adc on dio 2 - Thresh Pot
 	osDelay(1000);
-	send_xbee(init_dig_3, 20);
+	send_remote_at(&broadcast, 0x01, "D3", 0x03, 1);		// din on dio 3 - PIR
 	osDelay(1000);
-	send_xbee(init_dig_4, 20);
+	send_remote_at(&broadcast, 0x01, "D4", 0x03, 1);		// din on dio 4 - Thresh button
 	osDelay(1000);
 	print_debug("... done!", 9);
 	
 
-	//Setup Addressing for nodes
+	//Setup Addressing for nodes (ask for MY - this one goes to 16 bit address
+	//FFFF - and then set up change detection on dio 4)
 	osDelay(1000);
-	send_xbee(my_packet, 19);
+	xbee_address_t all_nodes;
+	xbee_address_init(&all_nodes, XBEE_BROADCAST_64, 0xFFFF);
+	send_remote_at(&all_nodes, 0x01, "MY", 0, 0);
 	osDelay(1000);
-	send_xbee(ic_packet, 20);
+	send_remote_at(&broadcast, 0x01, "IC", 0x10, 1);
 	osDelay(1000);
-	//Change to itterate through
-	//send_xbee(ir_packet, 21); 
 	//Start Timer
 	osKernelStart();
 	//Create timer for correction
@@ -180,10 +191,7 @@ int main()
 	}
 
 	osDelay(500);
-	send_xbee(ir_packet, 21); 
-	//send_xbee(ir_addr_0, 21);
-	//osDelay(500);
-	//send_xbee(ir_addr_1, 21);
+	send_prebuilt_frame(ir_packet, ir_packet_length, &ir_packet_in_flight); 
 	
 	// start everything running
 	
@@ -228,12 +236,65 @@ void lock_for_receive(void const *arg){
 void correct_timing(void const *arg){
 	static uint8_t i = 0;
 	if (i == 0){
-		send_xbee(ir_correction, 21);
+		send_prebuilt_frame(ir_correction, ir_correction_length, &ir_correction_in_flight);
 	}
 	else{
-		send_xbee(ir_packet, 21);
+		send_prebuilt_frame(ir_packet, ir_packet_length, &ir_packet_in_flight);
 	}
 	printf("!!!Correcting sampling timing!!!\n");
 	osTimerStop(correctTimerId);
 	flagOnce = 1;
 }
+
+// find the coordinator xbee (at whatever rate it's running at) and switch to 
+// the fastest rate we can both do
+static void negotiate_baud(void)
+{
+	xbee_baud_ops_t ops;
+	ops.set_baud = xbee_set_baud;
+	ops.at_command = xbee_at_command;
+	ops.delay = baud_delay;
+	ops.time = osKernelSysTick;
+	ops.ticks_per_ms = osKernelSysTickMicroSec(1000);
+	ops.bytes = xbee_link_bytes;
+	
+	xbee_baud_result_t result;
+	int status = xbee_baud_negotiate(&ops, 9600, xbee_baud_targets, 
+		sizeof(xbee_baud_targets) / sizeof(xbee_baud_targets[0]), &result);
+	
+	if(status < 0){
+		printf("!!coordinator xbee not found (%u probes) - staying at %u baud!!\n",
+			result.probes, result.baud_rate);
+	}
+	else{
+		printf("xbee link at %u baud (found at %u, %u probes, %u refused, %u failed), %u bytes/s\n",
+			result.baud_rate, result.found_at, result.probes, result.refused, result.failed,
+			result.throughput);
+	}
+}
+
+static void baud_delay(uint32_t ms)
+{
+	osDelay(ms);
+}
+
+// build a remote at command (with apply changes set) where the parameter is
+// value_length bytes of value (big endian)
+static int build_remote_at(uint8_t * packet, int size, const xbee_address_t * dest,
+	uint8_t frame_id, const char * command, uint16_t value, int value_length)
+{
+	uint8_t param[2] = {value >> 8, value & 0xFF};
+	return xbee_build_remote_at(packet, size, frame_id, dest, XBEE_APPLY_CHANGES,
+		command, &param[2 - value_length], value_length);
+}
+
+// build a remote at command and send it (giving it a frame id of its own so
+// we can tell if it goes missing)
+static void send_remote_at(const xbee_address_t * dest, uint8_t frame_id,
+	const char * command, uint16_t value, int value_length)
+{
+	uint8_t packet[XBEE_MAX_TX_FRAME];
+	int length = build_remote_at(packet, sizeof(packet), dest, frame_id, command,
+		value, value_length);
+	send_frame(packet, length);
+}
@@ -0,0 +1,166 @@
+/*
+ * node_discovery.c
+ *
+ * learn the nodes on the network from the frames they send and from node
+ * discover sweeps, and forget the ones that go quiet
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <string.h>
+
+// include the node discovery header
+#include "node_discovery.h"
+
+// the 64 bit addresses that can't belong to a node (the coordinator and the
+// broadcast address)
+#define SERIAL_COORDINATOR 0x0000000000000000ULL
+#define SERIAL_BROADCAST   0x000000000000FFFFULL
+
+// the bytes at the start of an ND response we need (MY, SH and SL)
+#define ND_MIN_LENGTH 10
+
+// METHODS
+
+// set up discovery
+void node_discovery_init(node_discovery_t * discovery, node_registry_t * registry,
+	uint32_t period, uint32_t expiry, uint32_t now)
+{
+	uint32_t i;
+
+	discovery->registry = registry;
+	discovery->period = period;
+	discovery->expiry = expiry;
+	discovery->next_sweep = now;
+	for(i = 0; i < NODE_REGISTRY_SIZE; i++)
+	{
+		discovery->last_heard[i] = now;
+	}
+	memset(&discovery->stats, 0, sizeof(node_discovery_stats_t));
+}
+
+// add a node (or update its network address) and note when we heard it
+static node_id_t node_discovery_add(node_discovery_t * discovery, uint64_t serial,
+	uint16_t my_address, uint32_t now, int * change)
+{
+	node_registry_t * registry = discovery->registry;
+	node_id_t id = node_registry_find_serial(registry, serial);
+
+	*change = NODE_HEARD_KNOWN;
+	if(id == NODE_NONE)
+	{
+		*change = NODE_HEARD_NEW;
+	}
+	else if(registry->my_address[id] != my_address)
+	{
+		*change = NODE_HEARD_MOVED;
+		discovery->stats.moved++;
+	}
+
+	id = node_registry_add(registry, serial, my_address);
+	if(id == NODE_NONE)
+	{
+		discovery->stats.full++;
+		*change = NODE_HEARD_KNOWN;
+		return NODE_NONE;
+	}
+	discovery->last_heard[id] = now;
+	return id;
+}
+
+// we've had a frame from a node
+node_id_t node_discovery_heard(node_discovery_t * discovery, uint64_t serial,
+	uint16_t my_address, uint32_t now, int * change)
+{
+	node_registry_t * registry = discovery->registry;
+
+	// the usual case - a node we know, with the address we know it by
+	node_id_t id = node_registry_find_my(registry, my_address);
+	if(id != NODE_NONE && registry->serial[id] == serial)
+	{
+		discovery->last_heard[id] = now;
+		*change = NODE_HEARD_KNOWN;
+		return id;
+	}
+
+	if(serial == SERIAL_COORDINATOR || serial == SERIAL_BROADCAST)
+	{
+		discovery->stats.ignored++;
+		*change = NODE_HEARD_KNOWN;
+		return NODE_NONE;
+	}
+
+	// otherwise it's new, or its network address has changed (either way the
+	// serial number is what counts)
+	id = node_discovery_add(discovery, serial, my_address, now, change);
+	if(*change == NODE_HEARD_NEW)
+	{
+		discovery->stats.learnt++;
+	}
+	return id;
+}
+
+// we've had an ND response
+node_id_t node_discovery_nd_response(node_discovery_t * discovery, const uint8_t * data,
+	uint16_t length, uint32_t now, int * change)
+{
+	uint64_t serial = 0;
+	int i;
+
+	*change = NODE_HEARD_KNOWN;
+	if(length < ND_MIN_LENGTH)
+	{
+		discovery->stats.bad_responses++;
+		return NODE_NONE;
+	}
+
+	// MY then SH and SL (all big endian)
+	uint16_t my_address = (data[0] << 8) | data[1];
+	for(i = 2; i < ND_MIN_LENGTH; i++)
+	{
+		serial = (serial << 8) | data[i];
+	}
+	if(serial == SERIAL_COORDINATOR || serial == SERIAL_BROADCAST)
+	{
+		discovery->stats.ignored++;
+		return NODE_NONE;
+	}
+
+	node_id_t id = node_discovery_add(discovery, serial, my_address, now, change);
+	if(*change == NODE_HEARD_NEW)
+	{
+		discovery->stats.discovered++;
+	}
+	return id;
+}
+
+// is it time for another sweep
+int node_discovery_sweep_due(node_discovery_t * discovery, uint32_t now)
+{
+	if((int32_t)(now - discovery->next_sweep) < 0)
+	{
+		return 0;
+	}
+	discovery->next_sweep = now + discovery->period;
+	discovery->stats.sweeps++;
+	return 1;
+}
+
+// remove a node that's been quiet for too long
+node_id_t node_discovery_expire(node_discovery_t * discovery, uint32_t now)
+{
+	node_registry_t * registry = discovery->registry;
+	node_id_t id;
+
+	for(id = 0; id < registry->count; id++)
+	{
+		if(registry->in_use[id] && now - discovery->last_heard[id] > discovery->expiry)
+		{
+			node_registry_remove(registry, id);
+			discovery->stats.expired++;
+			return id;
+		}
+	}
+	return NODE_NONE;
+}
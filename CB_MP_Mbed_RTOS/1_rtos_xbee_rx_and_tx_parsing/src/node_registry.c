@@ -0,0 +1,242 @@
+/*
+ * node_registry.c
+ *
+ * keep track of the xbee nodes we know about, looked up by their network
+ * address or serial number
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <string.h>
+
+// include the node registry header
+#include "node_registry.h"
+
+#if NODE_REGISTRY_HASH_SIZE < 2 * NODE_REGISTRY_SIZE || \
+	(NODE_REGISTRY_HASH_SIZE & (NODE_REGISTRY_HASH_SIZE - 1)) != 0
+	#error "NODE_REGISTRY_HASH_SIZE must be a power of two, at least twice NODE_REGISTRY_SIZE"
+#endif
+
+#define HASH_MASK (NODE_REGISTRY_HASH_SIZE - 1)
+
+// HASH FUNCTIONS
+
+// the network addresses are handed out more or less at random, but spread
+// them about anyway (fibonacci hashing - the top bits of the product)
+static __inline uint32_t hash_my(uint16_t my_address)
+{
+	return ((uint32_t)(my_address * 2654435761UL) >> 16) & HASH_MASK;
+}
+
+// the serial numbers all start with the same manufacturer prefix, so fold the
+// two halves together before hashing
+static __inline uint32_t hash_serial(uint64_t serial)
+{
+	uint32_t folded = (uint32_t)serial ^ (uint32_t)(serial >> 32);
+	return ((uint32_t)(folded * 2654435761UL) >> 16) & HASH_MASK;
+}
+
+// where a node's entry belongs in one of the tables
+static uint32_t home_slot(const node_registry_t * registry, const uint16_t * table,
+	node_id_t id)
+{
+	return (table == registry->by_my) ? hash_my(registry->my_address[id]) :
+		hash_serial(registry->serial[id]);
+}
+
+// take an entry out of a table, shuffling any later entries in the same run
+// back to fill the gap (so the lookups never need to skip over deleted slots)
+static void remove_slot(const node_registry_t * registry, uint16_t * table,
+	uint32_t slot)
+{
+	uint32_t next = slot;
+	while(1)
+	{
+		next = (next + 1) & HASH_MASK;
+		if(table[next] == 0)
+		{
+			break;
+		}
+
+		// an entry can move back to the gap as long as that isn't before where
+		// it belongs
+		uint32_t home = home_slot(registry, table, table[next] - 1);
+		if(((next - home) & HASH_MASK) >= ((next - slot) & HASH_MASK))
+		{
+			table[slot] = table[next];
+			slot = next;
+		}
+	}
+	table[slot] = 0;
+}
+
+// find the slot holding a network address (or -1 if it isn't there)
+static int find_my_slot(node_registry_t * registry, uint16_t my_address)
+{
+	uint32_t slot = hash_my(my_address);
+	while(registry->by_my[slot] != 0)
+	{
+		registry->stats.probes++;
+		if(registry->my_address[registry->by_my[slot] - 1] == my_address)
+		{
+			return slot;
+		}
+		slot = (slot + 1) & HASH_MASK;
+	}
+	return -1;
+}
+
+// put a node's network address in the table (taking it off any other node
+// that still had it - the old node must have left the network)
+static void add_my(node_registry_t * registry, node_id_t id)
+{
+	uint16_t my_address = registry->my_address[id];
+	uint32_t slot;
+
+	if(my_address == NODE_UNKNOWN_MY)
+	{
+		return;
+	}
+
+	int old = find_my_slot(registry, my_address);
+	if(old >= 0)
+	{
+		registry->my_address[registry->by_my[old] - 1] = NODE_UNKNOWN_MY;
+		remove_slot(registry, registry->by_my, old);
+	}
+
+	slot = hash_my(my_address);
+	while(registry->by_my[slot] != 0)
+	{
+		slot = (slot + 1) & HASH_MASK;
+	}
+	registry->by_my[slot] = id + 1;
+}
+
+// METHODS
+
+// empty the registry
+void node_registry_init(node_registry_t * registry)
+{
+	memset(registry, 0, sizeof(node_registry_t));
+}
+
+// add a node, or update its network address if we know it already
+node_id_t node_registry_add(node_registry_t * registry, uint64_t serial,
+	uint16_t my_address)
+{
+	node_id_t id = node_registry_find_serial(registry, serial);
+
+	// a node we know - if it's got a new network address then move it
+	if(id != NODE_NONE)
+	{
+		if(registry->my_address[id] != my_address)
+		{
+			int old = find_my_slot(registry, registry->my_address[id]);
+			if(old >= 0)
+			{
+				remove_slot(registry, registry->by_my, old);
+			}
+			registry->my_address[id] = my_address;
+			add_my(registry, id);
+			registry->stats.moved++;
+		}
+		return id;
+	}
+
+	// a new node (reusing the id of one that's been removed if we can)
+	if(registry->free_count > 0)
+	{
+		id = registry->free_ids[--registry->free_count];
+	}
+	else if(registry->count < NODE_REGISTRY_SIZE)
+	{
+		id = registry->count++;
+	}
+	else
+	{
+		registry->stats.full++;
+		return NODE_NONE;
+	}
+	registry->in_use[id] = 1;
+	registry->serial[id] = serial;
+	registry->my_address[id] = my_address;
+
+	uint32_t slot = hash_serial(serial);
+	while(registry->by_serial[slot] != 0)
+	{
+		slot = (slot + 1) & HASH_MASK;
+	}
+	registry->by_serial[slot] = id + 1;
+	add_my(registry, id);
+
+	return id;
+}
+
+// find a node by its network address
+node_id_t node_registry_find_my(node_registry_t * registry, uint16_t my_address)
+{
+	registry->stats.lookups++;
+	int slot = (my_address == NODE_UNKNOWN_MY) ? -1 :
+		find_my_slot(registry, my_address);
+	if(slot < 0)
+	{
+		registry->stats.misses++;
+		return NODE_NONE;
+	}
+	return registry->by_my[slot] - 1;
+}
+
+// find a node by its serial number
+node_id_t node_registry_find_serial(node_registry_t * registry, uint64_t serial)
+{
+	uint32_t slot = hash_serial(serial);
+
+	registry->stats.lookups++;
+	while(registry->by_serial[slot] != 0)
+	{
+		node_id_t id = registry->by_serial[slot] - 1;
+		registry->stats.probes++;
+		if(registry->serial[id] == serial)
+		{
+			return id;
+		}
+		slot = (slot + 1) & HASH_MASK;
+	}
+	registry->stats.misses++;
+	return NODE_NONE;
+}
+
+// forget a node
+void node_registry_remove(node_registry_t * registry, node_id_t id)
+{
+	uint32_t slot;
+
+	if(id >= registry->count || !registry->in_use[id])
+	{
+		return;
+	}
+
+	int old = find_my_slot(registry, registry->my_address[id]);
+	if(old >= 0 && registry->by_my[old] == id + 1)
+	{
+		remove_slot(registry, registry->by_my, old);
+	}
+
+	slot = hash_serial(registry->serial[id]);
+	while(registry->by_serial[slot] != 0)
+	{
+		if(registry->by_serial[slot] == id + 1)
+		{
+			remove_slot(registry, registry->by_serial, slot);
+			break;
+		}
+		slot = (slot + 1) & HASH_MASK;
+	}
+
+	registry->in_use[id] = 0;
+	registry->my_address[id] = NODE_UNKNOWN_MY;
+	registry->free_ids[registry->free_count++] = id;
+	registry->stats.removed++;
+}
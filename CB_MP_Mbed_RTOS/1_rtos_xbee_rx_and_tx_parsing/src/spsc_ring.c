@@ -0,0 +1,80 @@
+/*
+ * spsc_ring.c
+ *
+ * a lock free single producer / single consumer ring buffer of bytes
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include "spsc_ring.h"
+
+// METHODS
+
+// set up the ring - the size has to be a power of two so the counters can
+// wrap round cleanly
+void spsc_ring_init(spsc_ring_t * ring, uint8_t * buffer, uint32_t size)
+{
+	ring->head = 0;
+	ring->dropped = 0;
+	ring->tail = 0;
+	ring->buffer = buffer;
+	ring->size = size;
+}
+
+// add a byte (producer only)
+int spsc_ring_put(spsc_ring_t * ring, uint8_t byte)
+{
+	uint32_t head = ring->head;
+	uint32_t waiting = head - ring->tail;
+
+	if(waiting >= ring->size)
+	{
+		ring->dropped++;
+		return -1;
+	}
+
+	// write the byte before moving the head on, so the consumer never sees the
+	// head past a byte that isn't there yet
+	ring->buffer[head & (ring->size - 1)] = byte;
+	SPSC_RING_BARRIER();
+	ring->head = head + 1;
+
+	return (int)waiting;
+}
+
+// get the next contiguous span of bytes (consumer only) - this stops at the end
+// of the buffer, so when the data wraps round it takes two calls to get it all
+size_t spsc_ring_span(spsc_ring_t * ring, const uint8_t ** data)
+{
+	uint32_t tail = ring->tail;
+	uint32_t waiting = ring->head - tail;
+
+	// read the head before reading the bytes it covers
+	SPSC_RING_BARRIER();
+
+	uint32_t start = tail & (ring->size - 1);
+	size_t length = waiting;
+	if(start + length > ring->size)
+	{
+		length = ring->size - start;
+	}
+
+	*data = &ring->buffer[start];
+	return length;
+}
+
+// give back a span (or part of one) once it has been dealt with (consumer 
+// only)
+void spsc_ring_consume(spsc_ring_t * ring, size_t length)
+{
+	// finish reading the bytes before the producer can reuse the space
+	SPSC_RING_BARRIER();
+	ring->tail += length;
+}
+
+// the number of bytes waiting
+uint32_t spsc_ring_count(const spsc_ring_t * ring)
+{
+	return ring->head - ring->tail;
+}
@@ -13,6 +13,11 @@
 #include "stm32f7xx_hal.h"
 #include "stm32f7xx_it.h"
 
+// include the xbee uart configuration (for XBEE_RX_DMA) and the vcom uart
+// configuration (for VCOM_TX_DMA)
+#include "xbee.h"
+#include "vcom_serial.h"
+
 // GENERIC HARD FAULT HANDLER
 
 // forward declarations for hardfault handler utility functions
@@ -260,9 +265,66 @@ extern UART_HandleTypeDef xbee_handle;
 // interrupt handler for uart 6
 void USART6_IRQHandler(void)
 {
+  // count and clear any receive errors first, so the hal doesn't stop 
+  // receiving because of them
+  xbee_rx_check_errors();
+  
+#if XBEE_RX_DMA
+  // the hal uart interrupt handler doesn't deal with the idle line interrupt, 
+  // so check for it first (this tells us a burst of data has finished)
+  if(__HAL_UART_GET_IT(&xbee_handle, UART_IT_IDLE) != RESET &&
+     __HAL_UART_GET_IT_SOURCE(&xbee_handle, UART_IT_IDLE) != RESET)
+  {
+    __HAL_UART_CLEAR_IDLEFLAG(&xbee_handle);
+    xbee_rx_idle();
+  }
+#endif
+
   // so under the stm32f7xx hal setup, we pass off the uart interrupt to the hal
   // uart interrupt request handler for processing - this then triggers the 
   // rx / tx callbacks defined elsewhere
   HAL_UART_IRQHandler(&xbee_handle);
 }
 
+#if XBEE_RX_DMA
+// interrupt handler for the uart 6 receive dma stream (the hal dma handler 
+// calls the uart half / full transfer callbacks)
+void DMA2_Stream1_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(xbee_handle.hdmarx);
+}
+#endif
+
+#if XBEE_TX_DMA
+// interrupt handler for the uart 6 transmit dma stream (once the dma has 
+// finished the hal waits for the uart's transmit complete interrupt before it
+// calls the uart transmit complete callback)
+void DMA2_Stream6_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(xbee_handle.hdmatx);
+}
+#endif
+
+// VCOM INTERRUPT HANDLERS
+
+// the uart handle structure is defined elsewhere (in this case in 
+// vcom_serial.c)
+extern UART_HandleTypeDef uart_handle;
+
+// interrupt handler for uart 1 (this counts and clears errors on the line, and
+// with VCOM_TX_DMA the hal needs it to see the end of each dma transfer)
+void USART1_IRQHandler(void)
+{
+  vcom_check_errors();
+  HAL_UART_IRQHandler(&uart_handle);
+}
+
+#if VCOM_TX_DMA
+
+// interrupt handler for the uart 1 transmit dma stream
+void DMA2_Stream7_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(uart_handle.hdmatx);
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * trace.c
+ *
+ * record trace messages (an id, a time stamp and the raw arguments) in a ring
+ * buffer in ram, for formatting later on the pc
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include "trace.h"
+
+// GLOBAL DECLARATIONS (FOR THIS MODULE)
+
+// the log (set up here, so it's ready to use before trace_init is called)
+trace_log_t trace_log = {TRACE_MAGIC, TRACE_SIZE, TRACE_COUNT};
+
+#if !TRACE_LOG
+// the format strings (only needed when the messages are printed here)
+#define TRACE_MSG(name, format) format,
+const char * const trace_formats[TRACE_COUNT] =
+{
+	#include "trace_msgs.h"
+};
+#undef TRACE_MSG
+#endif
+
+// METHODS
+
+// start the dwt cycle counter going (the records are time stamped with it, so
+// the decoder needs to know how fast it runs)
+void trace_init(uint32_t clock)
+{
+	trace_log.clock = clock;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->LAR = 0xC5ACCE55;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// add a record to the log (throwing the oldest records away if there isn't
+// room) - the interrupts are held off while we do, as every thread shares the
+// log
+void trace_write(trace_id_t id, const uint32_t * args, uint32_t count)
+{
+	uint32_t length = count + 2;
+	uint32_t mask = TRACE_SIZE - 1;
+	uint32_t i;
+
+	if(count > 0xFF || length > TRACE_SIZE)
+	{
+		return;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t head = trace_log.head;
+	uint32_t first = trace_log.first;
+	while(head + length - first > TRACE_SIZE)
+	{
+		first += ((trace_log.words[first & mask] >> 16) & 0xFF) + 2;
+		trace_log.lost++;
+	}
+	trace_log.first = first;
+
+	trace_log.words[head & mask] = (TRACE_SYNC << 24) | (count << 16) | id;
+	trace_log.words[(head + 1) & mask] = DWT->CYCCNT;
+	for(i = 0; i < count; i++)
+	{
+		trace_log.words[(head + 2 + i) & mask] = args[i];
+	}
+	trace_log.head = head + length;
+	trace_log.records++;
+
+	__set_PRIMASK(primask);
+}
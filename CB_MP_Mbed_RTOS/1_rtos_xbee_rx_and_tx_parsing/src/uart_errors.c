@@ -0,0 +1,60 @@
+/*
+ * uart_errors.c
+ *
+ * count and clear the receive errors on a uart
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include "uart_errors.h"
+
+// METHODS
+
+// count the errors in a hal error code
+void uart_errors_count(uart_error_stats_t * stats, uint32_t error_code)
+{
+	stats->overrun += (error_code & HAL_UART_ERROR_ORE) ? 1 : 0;
+	stats->framing += (error_code & HAL_UART_ERROR_FE) ? 1 : 0;
+	stats->noise   += (error_code & HAL_UART_ERROR_NE) ? 1 : 0;
+	stats->parity  += (error_code & HAL_UART_ERROR_PE) ? 1 : 0;
+	stats->dma     += (error_code & HAL_UART_ERROR_DMA) ? 1 : 0;
+}
+
+// check the uart's status register for errors (call this from the uart 
+// interrupt before the hal gets to see them - once they are cleared the hal
+// just carries on receiving instead of aborting the transfer)
+uint32_t uart_errors_clear(USART_TypeDef * uart, uart_error_stats_t * stats)
+{
+	uint32_t isr = uart->ISR;
+	uint32_t error_code = HAL_UART_ERROR_NONE;
+	uint32_t clear = 0;
+
+	if(isr & USART_ISR_ORE)
+	{
+		error_code |= HAL_UART_ERROR_ORE;
+		clear |= USART_ICR_ORECF;
+	}
+	if(isr & USART_ISR_FE)
+	{
+		error_code |= HAL_UART_ERROR_FE;
+		clear |= USART_ICR_FECF;
+	}
+	if(isr & USART_ISR_NE)
+	{
+		error_code |= HAL_UART_ERROR_NE;
+		clear |= USART_ICR_NCF;
+	}
+	if(isr & USART_ISR_PE)
+	{
+		error_code |= HAL_UART_ERROR_PE;
+		clear |= USART_ICR_PECF;
+	}
+
+	if(clear != 0)
+	{
+		uart->ICR = clear;
+		uart_errors_count(stats, error_code);
+	}
+	return error_code;
+}
@@ -5,8 +5,16 @@
  * in this case we are not implementing interrupts at all - just using the 
  * uart to output status messages.
  *
+ * (the uart interrupt is on all the same, so errors on the line get counted 
+ * and cleared - see vcom_check_errors)
+ *
  * the stm32f7 board allows us to send messages over the virtual com port 
  * (i.e. the usb st-link connection).
+ *
+ * with VCOM_TX_DMA set the output goes into a ring buffer, and the uart takes
+ * it out a chunk at a time and sends it with dma (starting the next chunk from
+ * the transmit complete interrupt) - the uart interrupts run at the lowest 
+ * priority, as it doesn't matter if the output gets held up a bit
  * 
  * author:    Alex Shenfield
  * date:      06/11/2017
@@ -15,6 +23,9 @@
 
 // include the relevant header files
 #include "vcom_serial.h"
+#include "cmsis_os.h"
+
+#include <string.h>
 
 // retarget printf for ease of debugging
 #define PUTCHAR_PROTOTYPE int fputc(int ch, FILE *f)
@@ -29,6 +40,20 @@ void configure_hardware_uart(void);
 // get an instance of the uart handle
 UART_HandleTypeDef uart_handle;
 
+// the errors we've seen on the uart
+static uart_error_stats_t vcom_uart_errors;
+
+#if VCOM_TX_DMA
+// dma handle for the uart 1 transmitter (dma 2, stream 7, channel 4)
+DMA_HandleTypeDef vcom_dma_tx_handle;
+
+// the text waiting to go out, and the chunk of it the dma is sending
+static uint8_t vcom_log_buffer[VCOM_LOG_SIZE];
+static log_ring_t vcom_log;
+static uint8_t vcom_tx_chunk[VCOM_LOG_CHUNK];
+static volatile uint8_t vcom_tx_busy = 0;
+#endif
+
 // METHODS
 
 // uart initialisation
@@ -49,6 +74,17 @@ void init_uart(uint32_t baud_rate)
   
   // initialise the uart
   HAL_UART_Init(&uart_handle);  
+  
+  // turn on the receive and error interrupts - nothing reads this uart, so the
+  // hal just throws away anything typed into the terminal, but we get to count
+  // framing errors, noise and overruns
+  __HAL_UART_ENABLE_IT(&uart_handle, UART_IT_RXNE);
+  __HAL_UART_ENABLE_IT(&uart_handle, UART_IT_ERR);
+  
+#if VCOM_TX_DMA
+  // set up the output ring buffer
+  log_ring_init(&vcom_log, vcom_log_buffer, sizeof(vcom_log_buffer), VCOM_LOG_POLICY);
+#endif
 }
 
 // for the gpio set up stuff we need to look at the alternate function mapping
@@ -82,8 +118,108 @@ void configure_hardware_uart(void)
   gpio_init_structure.Speed     = GPIO_SPEED_FREQ_LOW;
   gpio_init_structure.Alternate = GPIO_AF7_USART1;
   HAL_GPIO_Init(VCP_RX_GPIO_Port, &gpio_init_structure); 
+  
+#if VCOM_TX_DMA
+  // configure the dma stream for the transmitter (this sends one chunk at a
+  // time)
+  __HAL_RCC_DMA2_CLK_ENABLE();
+  
+  vcom_dma_tx_handle.Instance                 = DMA2_Stream7;
+  vcom_dma_tx_handle.Init.Channel             = DMA_CHANNEL_4;
+  vcom_dma_tx_handle.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+  vcom_dma_tx_handle.Init.PeriphInc           = DMA_PINC_DISABLE;
+  vcom_dma_tx_handle.Init.MemInc              = DMA_MINC_ENABLE;
+  vcom_dma_tx_handle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  vcom_dma_tx_handle.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  vcom_dma_tx_handle.Init.Mode                = DMA_NORMAL;
+  vcom_dma_tx_handle.Init.Priority            = DMA_PRIORITY_LOW;
+  vcom_dma_tx_handle.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  HAL_DMA_Init(&vcom_dma_tx_handle);
+  __HAL_LINKDMA(&uart_handle, hdmatx, vcom_dma_tx_handle);
+  
+  // set up the nested vector interrupt controller for the dma (at the lowest 
+  // priority)
+  HAL_NVIC_SetPriority(DMA2_Stream7_IRQn, 15, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+#endif
+  
+  // and for the uart (again at the lowest priority)
+  HAL_NVIC_SetPriority(USART1_IRQn, 15, 0);
+  HAL_NVIC_EnableIRQ(USART1_IRQn);
+}
+
+#if VCOM_TX_DMA
+
+// OUTPUT RING BUFFER
+
+// start sending the next chunk if the uart isn't already busy (this has to be
+// called with interrupts held off)
+static void vcom_tx_kick(void)
+{
+  if(!vcom_tx_busy)
+  {
+    uint32_t length = log_ring_read(&vcom_log, vcom_tx_chunk, sizeof(vcom_tx_chunk));
+    if(length > 0)
+    {
+      vcom_tx_busy = 1;
+      HAL_UART_Transmit_DMA(&uart_handle, vcom_tx_chunk, length);
+    }
+  }
+}
+
+// LOW LEVEL IO
+
+// put a character in the output ring buffer (the interrupts are held off while
+// we do, as every thread that prints shares the ring with the uart interrupt - 
+// and then put back how they were, as we might be printing from an interrupt
+// or with them already held off)
+int serial_write(int ch)
+{
+  // if the ring is full (and we've been told to wait for room) then wait - we 
+  // can't wait in an interrupt (or with the interrupts held off) though, so 
+  // then it just gets dropped
+  uint32_t primask = __get_PRIMASK();
+  int can_wait = (__get_IPSR() == 0 && primask == 0);
+  
+  for(;;)
+  {
+    __disable_irq();
+    int done = log_ring_putc(&vcom_log, (uint8_t)ch, can_wait);
+    vcom_tx_kick();
+    __set_PRIMASK(primask);
+    
+    if(done)
+    {
+      break;
+    }
+    osDelay(1);
+  }
+  
+  // return the character
+  return ch;
+}
+
+// a chunk has gone - send the next one
+void vcom_tx_complete(UART_HandleTypeDef * huart)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  vcom_tx_busy = 0;
+  vcom_tx_kick();
+  __set_PRIMASK(primask);
+}
+
+// get a copy of the output ring buffer counters
+void vcom_get_log_stats(log_ring_stats_t * stats)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  *stats = vcom_log.stats;
+  __set_PRIMASK(primask);
 }
 
+#else
+
 // LOW LEVEL IO
 
 // put a character onto "the wire"
@@ -96,6 +232,53 @@ int serial_write(int ch)
   return ch;
 }
 
+// nothing is sent with dma
+void vcom_tx_complete(UART_HandleTypeDef * huart)
+{
+}
+
+// and nothing is buffered
+void vcom_get_log_stats(log_ring_stats_t * stats)
+{
+  memset(stats, 0, sizeof(*stats));
+}
+
+#endif
+
+// UART ERRORS
+
+// check uart 1 for errors and clear them (this is called from the uart 
+// interrupt before the hal interrupt handler gets to see them - otherwise the
+// hal treats an overrun as a failed reception and turns the error interrupt
+// off)
+void vcom_check_errors(void)
+{
+  uart_errors_clear(uart_handle.Instance, &vcom_uart_errors);
+}
+
+// count the errors the hal has found (it has already cleared them - this is
+// anything that came up after vcom_check_errors looked, and dma errors) - we don't
+// receive anything on this uart, so there's nothing to start up again (but if
+// a dma error stopped a chunk going out then we give up on it and move on)
+void vcom_uart_error(UART_HandleTypeDef * huart)
+{
+  uart_errors_count(&vcom_uart_errors, huart->ErrorCode);
+  huart->ErrorCode = HAL_UART_ERROR_NONE;
+  
+#if VCOM_TX_DMA
+  if(huart->gState == HAL_UART_STATE_READY && vcom_tx_busy)
+  {
+    vcom_tx_complete(huart);
+  }
+#endif
+}
+
+// get a copy of the error counters
+void vcom_get_uart_errors(uart_error_stats_t * stats)
+{
+  *stats = vcom_uart_errors;
+}
+
 // RETARGET PRINTF FOR MICROLIB
 
 // implementation of putchar to retarget printf (we use putchar_protype here
@@ -5,8 +5,22 @@
  * case).
  *
  * this version of xbee.c is both rtos aware and interrupt aware. it reads 
- * data from the uart using interrupts and sends them to a separate thread via
- * a message queue.
+ * data from the uart using interrupts and passes them to a separate thread 
+ * through a lock free ring buffer (waking the thread up when the ring stops
+ * being empty or the start of a frame arrives).
+ *
+ * alternatively (with XBEE_RX_DMA set) the uart receives into a circular 
+ * buffer using dma and the rx thread is signalled whenever the line goes idle
+ * or the dma gets half way through (or to the end of) the buffer - so we get
+ * an interrupt per burst of data rather than one for every byte
+ *
+ * frames are sent the same way (with XBEE_TX_DMA set) - send_xbee copies the
+ * frame into the transmit queue and returns straight away, and the uart sends
+ * everything in the queue back to back using dma
+ *
+ * with XBEE_FLOW_CONTROL set the xbee is told to stop sending (by taking rts
+ * high) while the receive buffer is nearly full, and the uart waits for cts
+ * before sending anything to it
  * 
  * author:    Alex Shenfield
  * date:      08/11/2017
@@ -18,23 +32,109 @@
 #include "cmsis_os.h"
 
 #include "itm_debug.h"
+
+// include the packet parser (for the api mode and frame escaping)
+#include "xbee_packet_parser.h"
+
+// include the dma receive buffer handling and the interrupt receive ring
+#include "xbee_dma_rx.h"
+#include "spsc_ring.h"
+
+// include the flow control thresholds
+#include "xbee_flow.h"
+
+// include the transmit queue
+#include "xbee_tx_queue.h"
+
+// include the uart error counting (and the vcom port, whose errors end up in
+// the same callback)
+#include "uart_errors.h"
+#include "vcom_serial.h"
+
+#include <string.h>
   
 // FUNCTION PROTOTYPES
 
 // configure the hardware part of the uart (e.g. gpio pins and clocks)
 void configure_hardware_xbee(void);
+
+#if XBEE_FLOW_CONTROL
+// stop the xbee sending when the receive buffer is getting full, and let it go
+// again when the rx thread has caught up
+static void xbee_rts_check_stop(void);
+static void xbee_rts_check_start(void);
+#endif
   
 // GLOBAL DECLARATIONS (FOR THIS MODULE)
 
 // get an instance of the uart handle
 UART_HandleTypeDef xbee_handle;
+
+#if XBEE_RX_DMA
+// dma handle for the uart 6 receiver (dma 2, stream 1, channel 5)
+DMA_HandleTypeDef xbee_dma_rx_handle;
+
+// the circular buffer the dma writes into and where we've got to in it
+//
+// note: the d-cache isn't turned on in this project - if it ever is, this 
+// buffer needs to go in non-cacheable memory (e.g. the dtcm)
+static uint8_t xbee_rx_buffer[XBEE_RX_DMA_SIZE];
+static xbee_dma_rx_t xbee_rx;
+#else
 uint8_t c;
 
+// the ring the receive interrupt passes characters to the rx thread through
+static uint8_t xbee_rx_buffer[XBEE_RX_RING_SIZE];
+static spsc_ring_t xbee_rx SPSC_RING_ALIGN;
+#endif
+
+// the receive errors on uart 6, and where in the received data the last one
+// happened (so the rx thread can tell the parser to resync at that point)
+static uart_error_stats_t xbee_uart_errors;
+static volatile uint32_t xbee_rx_error_mark;
+static volatile uint8_t xbee_rx_error_pending = 0;
+
+#if XBEE_FLOW_CONTROL
+// when to stop and start the xbee sending to us
+static xbee_flow_t xbee_flow;
+#endif
+
+#if XBEE_TX_DMA
+// dma handle for the uart 6 transmitter (dma 2, stream 6, channel 5)
+DMA_HandleTypeDef xbee_dma_tx_handle;
+
+// the frames waiting to go out, and somewhere to keep copies of them (in 
+// escaped api mode the frames always have to be copied, as we send the escaped
+// version)
+#if XBEE_API_MODE == 2
+	#define XBEE_TX_SLOT_SIZE (2 * XBEE_MAX_TX_FRAME)
+#else
+	#define XBEE_TX_SLOT_SIZE XBEE_MAX_TX_FRAME
+#endif
+static xbee_tx_queue_t xbee_tx;
+static uint8_t xbee_tx_buffer[XBEE_TX_QUEUE_DEPTH][XBEE_TX_SLOT_SIZE];
+#else
+// the frames and bytes we've sent
+static uint32_t xbee_tx_frames = 0;
+static uint32_t xbee_tx_bytes = 0;
+#endif
+
 // RTOS DEFINE
 
-// the message queue we are using to pass characters around is defined 
-// elsewhere (in this case in the xbee_processing_thread.c file)
-extern osMessageQId msg_q;
+#if XBEE_TX_DMA
+// only one thread at a time can add frames to the transmit queue
+osMutexDef(xbee_tx_lock);
+osMutexId  xbee_tx_lock_id;
+
+// a token for each free slot in the transmit queue (the transmit complete 
+// interrupt gives one back each time a frame has gone)
+osSemaphoreDef(xbee_tx_slots);
+osSemaphoreId xbee_tx_slots_id;
+#endif
+
+// the rx thread gets a signal when there is new data (the thread is defined
+// elsewhere - in this case in the xbee_processing_thread.c file)
+extern osThreadId tid_xbee_rx_thread;
 
 // METHODS
 
@@ -51,11 +151,23 @@ void init_xbee(uint32_t baud_rate)
   xbee_handle.Init.WordLength   = UART_WORDLENGTH_8B;
   xbee_handle.Init.StopBits     = UART_STOPBITS_1;
   xbee_handle.Init.Parity       = UART_PARITY_NONE;
+#if XBEE_FLOW_CONTROL
+  // the uart only handles cts (we do rts ourselves)
+  xbee_handle.Init.HwFlowCtl    = UART_HWCONTROL_CTS;
+#else
   xbee_handle.Init.HwFlowCtl    = UART_HWCONTROL_NONE;
+#endif
   xbee_handle.Init.Mode         = UART_MODE_TX_RX;
   
   // initialise the uart
   HAL_UART_Init(&xbee_handle);  
+  
+#if XBEE_TX_DMA
+  // set up the transmit queue
+  xbee_tx_queue_init(&xbee_tx);
+  xbee_tx_lock_id = osMutexCreate(osMutex(xbee_tx_lock));
+  xbee_tx_slots_id = osSemaphoreCreate(osSemaphore(xbee_tx_slots), XBEE_TX_QUEUE_DEPTH);
+#endif
 }
 
 // for the gpio set up stuff we need to look at the alternate function mapping
@@ -93,11 +205,185 @@ void configure_hardware_xbee(void)
   gpio_init_structure.Alternate = GPIO_AF8_USART6;
   HAL_GPIO_Init(XBEE_RX_GPIO_Port, &gpio_init_structure);  
   
+#if XBEE_FLOW_CONTROL
+  // configure the flow control pins - cts (PG13) goes to the uart and rts 
+  // (PH6) is a normal output, which starts off high (i.e. telling the xbee not 
+  // to send anything) until we're ready to receive
+  __HAL_RCC_GPIOG_CLK_ENABLE();
+  __HAL_RCC_GPIOH_CLK_ENABLE();
+  
+  gpio_init_structure.Pin       = XBEE_CTS_Pin;
+  gpio_init_structure.Mode      = GPIO_MODE_AF_PP;
+  gpio_init_structure.Pull      = GPIO_PULLUP;
+  gpio_init_structure.Speed     = GPIO_SPEED_FREQ_LOW;
+  gpio_init_structure.Alternate = GPIO_AF8_USART6;
+  HAL_GPIO_Init(XBEE_CTS_GPIO_Port, &gpio_init_structure);
+  
+  HAL_GPIO_WritePin(XBEE_RTS_GPIO_Port, XBEE_RTS_Pin, GPIO_PIN_SET);
+  gpio_init_structure.Pin       = XBEE_RTS_Pin;
+  gpio_init_structure.Mode      = GPIO_MODE_OUTPUT_PP;
+  gpio_init_structure.Pull      = GPIO_NOPULL;
+  gpio_init_structure.Speed     = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(XBEE_RTS_GPIO_Port, &gpio_init_structure);
+  
+#endif
   // set up the nested vector interrupt controller
   HAL_NVIC_SetPriority(USART6_IRQn, 0, 1);
   HAL_NVIC_EnableIRQ(USART6_IRQn);
+  
+#if XBEE_RX_DMA
+  // configure the dma stream for the receiver - this runs in circular mode, 
+  // so it just keeps going round the buffer
+  __HAL_RCC_DMA2_CLK_ENABLE();
+  
+  xbee_dma_rx_handle.Instance                 = DMA2_Stream1;
+  xbee_dma_rx_handle.Init.Channel             = DMA_CHANNEL_5;
+  xbee_dma_rx_handle.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+  xbee_dma_rx_handle.Init.PeriphInc           = DMA_PINC_DISABLE;
+  xbee_dma_rx_handle.Init.MemInc              = DMA_MINC_ENABLE;
+  xbee_dma_rx_handle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  xbee_dma_rx_handle.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  xbee_dma_rx_handle.Init.Mode                = DMA_CIRCULAR;
+  xbee_dma_rx_handle.Init.Priority            = DMA_PRIORITY_HIGH;
+  xbee_dma_rx_handle.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  HAL_DMA_Init(&xbee_dma_rx_handle);
+  __HAL_LINKDMA(&xbee_handle, hdmarx, xbee_dma_rx_handle);
+  
+  HAL_NVIC_SetPriority(DMA2_Stream1_IRQn, 0, 1);
+  HAL_NVIC_EnableIRQ(DMA2_Stream1_IRQn);
+#endif
+
+#if XBEE_TX_DMA
+  // configure the dma stream for the transmitter (this sends one frame at a 
+  // time)
+  __HAL_RCC_DMA2_CLK_ENABLE();
+  
+  xbee_dma_tx_handle.Instance                 = DMA2_Stream6;
+  xbee_dma_tx_handle.Init.Channel             = DMA_CHANNEL_5;
+  xbee_dma_tx_handle.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+  xbee_dma_tx_handle.Init.PeriphInc           = DMA_PINC_DISABLE;
+  xbee_dma_tx_handle.Init.MemInc              = DMA_MINC_ENABLE;
+  xbee_dma_tx_handle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  xbee_dma_tx_handle.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  xbee_dma_tx_handle.Init.Mode                = DMA_NORMAL;
+  xbee_dma_tx_handle.Init.Priority            = DMA_PRIORITY_MEDIUM;
+  xbee_dma_tx_handle.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  HAL_DMA_Init(&xbee_dma_tx_handle);
+  __HAL_LINKDMA(&xbee_handle, hdmatx, xbee_dma_tx_handle);
+  
+  HAL_NVIC_SetPriority(DMA2_Stream6_IRQn, 0, 1);
+  HAL_NVIC_EnableIRQ(DMA2_Stream6_IRQn);
+#endif
+}
+
+#if XBEE_TX_DMA
+
+// XBEE TRANSMIT QUEUE
+
+// start sending the next frame if the uart isn't already busy (the completion
+// interrupt is held off while we check, so we can't both start a frame)
+static void xbee_tx_kick(void)
+{
+  __disable_irq();
+  const xbee_tx_frame_t * frame = xbee_tx_queue_start(&xbee_tx);
+  if(frame != NULL)
+  {
+    HAL_UART_Transmit_DMA(&xbee_handle, (uint8_t *)frame->data, frame->length);
+  }
+  __enable_irq();
 }
 
+// give back the slot of a frame that has gone and start the next one (called
+// from the interrupts)
+static void xbee_tx_next(UART_HandleTypeDef * huart)
+{
+  const xbee_tx_frame_t * frame = xbee_tx_queue_complete(&xbee_tx);
+  osSemaphoreRelease(xbee_tx_slots_id);
+  if(frame != NULL)
+  {
+    HAL_UART_Transmit_DMA(huart, (uint8_t *)frame->data, frame->length);
+  }
+}
+
+// add a frame to the transmit queue (copying or escaping it into the queue's 
+// own buffer if copy is set) - if the queue is full, wait for there to be room
+//
+// note: this blocks on the slot semaphore until the uart has sent enough to
+// free a slot (without holding the lock, so the threads waiting get the slots
+// in turn as the interrupt gives them back - see host/tx_queue_sim.c)
+static int xbee_tx_add(const uint8_t * frame, int length, int copy, 
+  xbee_tx_callback callback, void * context)
+{
+  xbee_tx_frame_t * slot;
+  int waited = 0;
+  
+  if(length > XBEE_MAX_TX_FRAME)
+  {
+    return 0;
+  }
+  
+  // get a slot (a token means there is one, so the claim can't fail)
+  if(osSemaphoreWait(xbee_tx_slots_id, 0) <= 0)
+  {
+    waited = 1;
+    osSemaphoreWait(xbee_tx_slots_id, osWaitForever);
+  }
+  
+  osMutexWait(xbee_tx_lock_id, osWaitForever);
+  if(waited)
+  {
+    xbee_tx.stats.full++;
+  }
+  slot = xbee_tx_queue_claim(&xbee_tx);
+  
+  uint8_t * buffer = xbee_tx_buffer[slot - xbee_tx.frames];
+#if XBEE_API_MODE == 2
+  // in escaped api mode we always send an escaped copy
+  slot->length = xbee_escape_frame(frame, length, buffer);
+  slot->data = buffer;
+#else
+  if(copy)
+  {
+    memcpy(buffer, frame, length);
+    frame = buffer;
+  }
+  slot->length = length;
+  slot->data = frame;
+#endif
+  slot->callback = callback;
+  slot->context = context;
+  xbee_tx_queue_commit(&xbee_tx);
+  osMutexRelease(xbee_tx_lock_id);
+  
+  xbee_tx_kick();
+  return length;
+}
+
+// XBEE TRANSMIT
+
+// send a frame on the xbee uart - the frame is copied, so this returns as soon
+// as it has been queued up
+int send_xbee(volatile uint8_t* s, int length)
+{	
+  return xbee_tx_add((const uint8_t *)s, length, 1, NULL, NULL);
+}
+
+// queue a frame without copying it
+int xbee_queue_frame(const uint8_t * frame, int length, xbee_tx_callback callback,
+  void * context)
+{
+  return xbee_tx_add(frame, length, 0, callback, context);
+}
+
+// get the transmit queue counters (and how many frames are waiting)
+void xbee_tx_get_stats(xbee_tx_stats_t * stats, uint32_t * depth)
+{
+  *stats = xbee_tx.stats;
+  *depth = xbee_tx_queue_depth(&xbee_tx);
+}
+
+#else
+
 // LOW LEVEL IO
 
 // put a character onto "the wire"
@@ -116,14 +402,55 @@ int xbee_write(int ch)
 int send_xbee(volatile uint8_t* s, int length)
 {	
   int i = 0;
-	for(i = 0; i < length; i++)
+	int n = length;
+	
+#if XBEE_API_MODE == 2
+	// in escaped api mode we escape the whole frame in one pass first and then 
+	// send the escaped version
+	uint8_t escaped[2 * XBEE_MAX_TX_FRAME];
+	if(length > XBEE_MAX_TX_FRAME)
+	{
+		return 0;
+	}
+	n = xbee_escape_frame((const uint8_t *)s, length, escaped);
+	s = escaped;
+#endif
+	
+	for(i = 0; i < n; i++)
 	{		
 		// put the character on the wire
 		xbee_write(s[i]);
 	}	
+	xbee_tx_frames++;
+	xbee_tx_bytes += n;
 	return length;
 }
 
+// without the queue the frame has gone by the time we return, so just call 
+// the callback straight away
+int xbee_queue_frame(const uint8_t * frame, int length, xbee_tx_callback callback,
+  void * context)
+{
+  int sent = send_xbee((volatile uint8_t *)frame, length);
+  if(sent > 0 && callback != NULL)
+  {
+    callback(frame, length, context);
+  }
+  return sent;
+}
+
+// there's no queue, so nothing is ever waiting (but we still count what's been
+// sent)
+void xbee_tx_get_stats(xbee_tx_stats_t * stats, uint32_t * depth)
+{
+  memset(stats, 0, sizeof(*stats));
+  stats->sent = xbee_tx_frames;
+  stats->bytes = xbee_tx_bytes;
+  *depth = 0;
+}
+
+#endif
+
 // XBEE RECEIVE
 
 // ENABLE THE RX INTERRUPT FOR XBEE UART
@@ -131,19 +458,374 @@ int send_xbee(volatile uint8_t* s, int length)
 // uart 6 rx interrupt enable ...
 void enable_rx_interrupt(void)
 { 
+#if XBEE_RX_DMA
+  // start the dma going round the buffer and enable the idle line interrupt
+  xbee_dma_rx_init(&xbee_rx, xbee_rx_buffer, sizeof(xbee_rx_buffer));
+  HAL_UART_Receive_DMA(&xbee_handle, xbee_rx_buffer, sizeof(xbee_rx_buffer));
+  __HAL_UART_CLEAR_IDLEFLAG(&xbee_handle);
+  __HAL_UART_ENABLE_IT(&xbee_handle, UART_IT_IDLE);
+#else
   // enable receive interrupt (single character at a time)
+  spsc_ring_init(&xbee_rx, xbee_rx_buffer, sizeof(xbee_rx_buffer));
+  HAL_UART_Receive_IT(&xbee_handle, &c, 1);
+#endif
+  
+#if XBEE_FLOW_CONTROL
+  // we're ready to receive, so let the xbee start sending
+  xbee_flow_init(&xbee_flow, sizeof(xbee_rx_buffer), XBEE_RTS_STOP_FREE, 
+    XBEE_RTS_START_FREE);
+  HAL_GPIO_WritePin(XBEE_RTS_GPIO_Port, XBEE_RTS_Pin, GPIO_PIN_RESET);
+#endif
+}
+
+#if XBEE_RX_DMA
+
+// DMA RECEIVE BUFFER
+
+// record how far the dma has got and wake the rx thread up if there is 
+// anything new (called from the interrupts)
+static void xbee_rx_event(void)
+{
+  if(xbee_dma_rx_update(&xbee_rx, __HAL_DMA_GET_COUNTER(xbee_handle.hdmarx)) > 0)
+  {
+#if XBEE_FLOW_CONTROL
+    xbee_rts_check_stop();
+#endif
+    osSignalSet(tid_xbee_rx_thread, XBEE_RX_SIGNAL);
+  }
+}
+
+// the line has gone idle (so that's the end of a burst of data)
+void xbee_rx_idle(void)
+{
+  xbee_rx_event();
+}
+
+// the dma was stopped by an error - start it again (from the beginning of the
+// buffer)
+static void xbee_rx_restart(void)
+{
+  xbee_dma_rx_restart(&xbee_rx);
+  HAL_UART_Receive_DMA(&xbee_handle, xbee_rx_buffer, sizeof(xbee_rx_buffer));
+  __HAL_UART_CLEAR_IDLEFLAG(&xbee_handle);
+  __HAL_UART_ENABLE_IT(&xbee_handle, UART_IT_IDLE);
+}
+
+// get at the received data
+static size_t rx_span(const uint8_t ** data)
+{
+  return xbee_dma_rx_span(&xbee_rx, data);
+}
+
+static void rx_consume(size_t length)
+{
+  xbee_dma_rx_consume(&xbee_rx, length);
+}
+
+// the total number of bytes received and read so far
+static uint32_t rx_received(void)
+{
+  return xbee_rx.produced;
+}
+
+static uint32_t rx_consumed(void)
+{
+  return xbee_rx.consumed;
+}
+
+#else
+
+// INTERRUPT RECEIVE RING
+
+// reception was stopped by an error - start it again
+static void xbee_rx_restart(void)
+{
   HAL_UART_Receive_IT(&xbee_handle, &c, 1);
 }
 
+// get at the received data
+static size_t rx_span(const uint8_t ** data)
+{
+  return spsc_ring_span(&xbee_rx, data);
+}
+
+static void rx_consume(size_t length)
+{
+  spsc_ring_consume(&xbee_rx, length);
+}
+
+// the total number of bytes received and read so far
+static uint32_t rx_received(void)
+{
+  return xbee_rx.head;
+}
+
+static uint32_t rx_consumed(void)
+{
+  return xbee_rx.tail;
+}
+
+#endif
+
+// RECEIVED DATA
+
+// get the next span of received data (the rx thread calls this until it 
+// returns 0, giving each span back as it goes) - if there has been an error 
+// then this stops at the point it happened, until the rx thread has picked it
+// up with xbee_rx_error
+size_t xbee_rx_span(const uint8_t ** data)
+{
+  size_t length = rx_span(data);
+  if(xbee_rx_error_pending)
+  {
+    uint32_t before_error = xbee_rx_error_mark - rx_consumed();
+    if((int32_t)before_error >= 0 && length > before_error)
+    {
+      length = before_error;
+    }
+  }
+  return length;
+}
+
+void xbee_rx_consume(size_t length)
+{
+  rx_consume(length);
+#if XBEE_FLOW_CONTROL
+  xbee_rts_check_start();
+#endif
+}
+
+// has the rx thread got to the point where bytes were lost (so it's time to 
+// resync the parser)
+int xbee_rx_error(void)
+{
+  if(xbee_rx_error_pending && (int32_t)(rx_consumed() - xbee_rx_error_mark) >= 0)
+  {
+    xbee_rx_error_pending = 0;
+    return 1;
+  }
+  return 0;
+}
+
+// get the flow control counters
+void xbee_get_flow_stats(uint32_t * stops, uint32_t * high_water)
+{
+#if XBEE_FLOW_CONTROL
+  *stops = xbee_flow.stops;
+  *high_water = xbee_flow.high_water;
+#else
+  *stops = 0;
+  *high_water = 0;
+#endif
+}
+
+// get the dma receive counters
+void xbee_get_dma_stats(uint32_t * events, uint32_t * overruns)
+{
+#if XBEE_RX_DMA
+  *events = xbee_rx.events;
+  *overruns = xbee_rx.overruns;
+#else
+  *events = 0;
+  *overruns = 0;
+#endif
+}
+
+// get a copy of the uart error counters
+void xbee_get_uart_errors(uart_error_stats_t * stats)
+{
+  *stats = xbee_uart_errors;
+}
+
+#if XBEE_FLOW_CONTROL
+
+// FLOW CONTROL
+
+// tell the xbee to stop sending (rts high) if the receive buffer is getting 
+// full (called from the interrupts)
+static void xbee_rts_check_stop(void)
+{
+  if(xbee_flow_stop(&xbee_flow, rx_received() - rx_consumed()))
+  {
+    HAL_GPIO_WritePin(XBEE_RTS_GPIO_Port, XBEE_RTS_Pin, GPIO_PIN_SET);
+  }
+}
+
+// let it start again (rts low) once the rx thread has made enough room - the
+// interrupts are held off while we do this, so they can't stop it in between
+// us checking and starting it
+static void xbee_rts_check_start(void)
+{
+  __disable_irq();
+  if(xbee_flow_start(&xbee_flow, rx_received() - rx_consumed()))
+  {
+    HAL_GPIO_WritePin(XBEE_RTS_GPIO_Port, XBEE_RTS_Pin, GPIO_PIN_RESET);
+  }
+  __enable_irq();
+}
+
+#endif
+
+// LINK RATE
+
+// change the rate of the uart without stopping reception (so we don't go
+// through HAL_UART_Init, which would reset the receiver state) - uart 6 is
+// clocked from apb2, which is what it comes out of reset as
+int xbee_set_baud(uint32_t baud_rate)
+{
+  uint32_t start = osKernelSysTick();
+  uint32_t timeout = osKernelSysTickMicroSec(XBEE_SET_BAUD_TIMEOUT * 1000);
+  
+#if XBEE_TX_DMA
+  // let anything that's waiting go out at the old rate
+  while(xbee_tx_queue_depth(&xbee_tx) > 0)
+  {
+    if(osKernelSysTick() - start > timeout)
+    {
+      return -1;
+    }
+    osDelay(1);
+  }
+#endif
+
+  // and the last byte of it (if the uart is stuck - e.g. with cts held off by
+  // the radio - then give up and leave the rate alone)
+  while(__HAL_UART_GET_FLAG(&xbee_handle, UART_FLAG_TC) == RESET)
+  {
+    if(osKernelSysTick() - start > timeout)
+    {
+      return -1;
+    }
+  }
+  
+  xbee_handle.Init.BaudRate = baud_rate;
+  __HAL_UART_DISABLE(&xbee_handle);
+  xbee_handle.Instance->BRR = UART_DIV_SAMPLING16(HAL_RCC_GetPCLK2Freq(), baud_rate);
+  __HAL_UART_ENABLE(&xbee_handle);
+  return 0;
+}
+
+// the number of bytes that have gone across the link so far
+uint32_t xbee_link_bytes(void)
+{
+  xbee_tx_stats_t stats;
+  uint32_t depth;
+  xbee_tx_get_stats(&stats, &depth);
+  return stats.bytes + rx_received();
+}
+
+// UART ERRORS
+
+// remember where we'd got to in the received data when an error happened and
+// wake up the rx thread (called from the interrupts)
+static void xbee_rx_mark_error(void)
+{
+#if XBEE_RX_DMA
+  xbee_dma_rx_update(&xbee_rx, __HAL_DMA_GET_COUNTER(xbee_handle.hdmarx));
+#endif
+  xbee_rx_error_mark = rx_received();
+  xbee_rx_error_pending = 1;
+  osSignalSet(tid_xbee_rx_thread, XBEE_RX_SIGNAL);
+}
+
+// check uart 6 for receive errors and clear them (this is called from the 
+// uart interrupt before the hal interrupt handler gets to see them - otherwise
+// an overrun or any error during dma reception makes the hal stop receiving)
+void xbee_rx_check_errors(void)
+{
+  if(uart_errors_clear(xbee_handle.Instance, &xbee_uart_errors) != HAL_UART_ERROR_NONE)
+  {
+    xbee_rx_mark_error();
+  }
+}
+
 // UART IRQ CALLBACKS
 
+// something has gone wrong on a uart that the hal couldn't carry on from (the
+// error callback is shared by all the uarts, so check which one it was)
+void HAL_UART_ErrorCallback(UART_HandleTypeDef * huart)
+{
+  if(huart->Instance == USART6)
+  {
+    uart_errors_count(&xbee_uart_errors, huart->ErrorCode);
+    xbee_rx_mark_error();
+    
+    // if the hal has stopped receiving then start it again
+    if(huart->RxState == HAL_UART_STATE_READY)
+    {
+      xbee_rx_restart();
+    }
+    
+#if XBEE_TX_DMA
+    // and if a dma error stopped a frame going out then give up on it and move
+    // on to the next one
+    if(huart->gState == HAL_UART_STATE_READY && xbee_tx.busy)
+    {
+      xbee_tx_next(huart);
+    }
+#endif
+  }
+  else if(huart->Instance == USART1)
+  {
+    vcom_uart_error(huart);
+  }
+}
+
+// a frame has gone - send the next one (the transmit complete callback is 
+// shared by all the uarts, so check which one it was)
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef * huart)
+{
+#if XBEE_TX_DMA
+  if(huart->Instance == USART6)
+  {
+    xbee_tx_next(huart);
+  }
+#endif
+  if(huart->Instance == USART1)
+  {
+    vcom_tx_complete(huart);
+  }
+}
+
+#if XBEE_RX_DMA
+
+// the dma is half way through the buffer
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef * huart)
+{
+  if(huart->Instance == USART6)
+  {
+    xbee_rx_event();
+  }
+}
+
+// the dma has got to the end of the buffer (and gone back to the start)
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef * huart)
+{
+  if(huart->Instance == USART6)
+  {
+    xbee_rx_event();
+  }
+}
+
+#else
+
 // uart receive callback
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef * xbee_handle)
 { 
-  // stuff characters into the message queue (and return immediately - as this
-  // is basically an isr ...)
-  osMessagePut(msg_q, c, 0);
+  // stuff characters into the ring (and return immediately - as this is 
+  // basically an isr ...) - the rx thread only needs waking if the ring was
+  // empty (otherwise it hasn't finished with it yet) or a new frame is starting
+  if(spsc_ring_put(&xbee_rx, c) == 0 || c == 0x7E)
+  {
+    osSignalSet(tid_xbee_rx_thread, XBEE_RX_SIGNAL);
+  }
+  
+#if XBEE_FLOW_CONTROL
+  xbee_rts_check_stop();
+#endif
   
   // enable the interrupt again ...
   HAL_UART_Receive_IT(xbee_handle, &c, 1);  
 }
+
+#endif
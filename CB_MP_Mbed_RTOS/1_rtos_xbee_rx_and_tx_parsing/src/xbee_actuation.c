@@ -0,0 +1,153 @@
+/*
+ * xbee_actuation.c
+ *
+ * collect up the output changes for each node and send them as a batch of
+ * queued remote at commands (with a single apply at the end)
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include <string.h>
+#include "xbee_actuation.h"
+
+// the at command for each output (Light = D5, Heater = P1 (DIO11), AC = D7)
+static const char * const output_pins[NUM_OUTPUTS] =
+{
+	[OUTPUT_LIGHT]	= "D5",
+	[OUTPUT_HEATER]	= "P1",
+	[OUTPUT_AC]			= "D7",
+};
+
+// METHODS
+
+// empty the batch and reset the counters
+void xbee_actuation_init(xbee_actuation_batch_t * batch)
+{
+	memset(batch, 0, sizeof(*batch));
+}
+
+// add some changes for a node (merging them with anything already waiting for
+// that node) - returns 0 if there isn't room for another node
+int xbee_actuation_add(xbee_actuation_batch_t * batch, const xbee_address_t * address,
+	uint16_t my_address, const uint8_t state[NUM_OUTPUTS], uint8_t sample)
+{
+	int i;
+	xbee_actuation_t * node = NULL;
+
+	// look for changes already waiting for this node
+	for(i = 0; i < batch->num_pending; i++)
+	{
+		if(memcmp(batch->pending[i].address.bytes, address->bytes, 10) == 0)
+		{
+			node = &batch->pending[i];
+			batch->stats.merged++;
+			break;
+		}
+	}
+
+	// otherwise start a new entry
+	if(node == NULL)
+	{
+		if(batch->num_pending == XBEE_ACTUATION_NODES)
+		{
+			batch->stats.full++;
+			return 0;
+		}
+		node = &batch->pending[batch->num_pending++];
+		node->address = *address;
+		node->my_address = my_address;
+		node->sample = 0;
+		for(i = 0; i < NUM_OUTPUTS; i++)
+		{
+			node->state[i] = OUTPUT_NO_CHANGE;
+		}
+	}
+
+	// the latest state for each output wins
+	for(i = 0; i < NUM_OUTPUTS; i++)
+	{
+		if(state[i] != OUTPUT_NO_CHANGE)
+		{
+			if(node->state[i] != OUTPUT_NO_CHANGE)
+			{
+				batch->stats.superseded++;
+			}
+			node->state[i] = state[i];
+		}
+	}
+	node->sample |= sample;
+
+	batch->stats.requests++;
+	return 1;
+}
+
+// send everything that is waiting and empty the batch - returns the number of
+// frames sent
+int xbee_actuation_flush(xbee_actuation_batch_t * batch, xbee_actuation_send send)
+{
+	int i, j;
+	int frames = 0;
+	uint8_t packet[20];
+
+	for(i = 0; i < batch->num_pending; i++)
+	{
+		xbee_actuation_t * node = &batch->pending[i];
+
+		// find the last output that is changing (that's the one that applies the
+		// changes)
+		int last = -1;
+		for(j = 0; j < NUM_OUTPUTS; j++)
+		{
+			if(node->state[j] != OUTPUT_NO_CHANGE)
+			{
+				last = j;
+			}
+		}
+
+		for(j = 0; j <= last; j++)
+		{
+			if(node->state[j] == OUTPUT_NO_CHANGE)
+			{
+				continue;
+			}
+
+			uint8_t value = (node->state[j] == OUTPUT_OFF) ? XBEE_DIGITAL_LOW : XBEE_DIGITAL_HIGH;
+
+#if XBEE_ACTUATION_BATCHING
+			// queue everything up to the last change (frame id 0 means the node
+			// doesn't send a response), then apply them all in one go
+			uint8_t apply = (j == last);
+#else
+			uint8_t apply = 1;
+#endif
+			int length = xbee_build_remote_at(packet, sizeof(packet), apply ? 0x01 : 0x00,
+				&node->address, apply ? XBEE_APPLY_CHANGES : 0, output_pins[j], &value, 1);
+			send(packet, length);
+
+			frames++;
+			batch->stats.frames++;
+			batch->stats.applies += apply;
+			batch->stats.bytes += length;
+		}
+
+		// sampling requests go after the output changes
+		if(node->sample)
+		{
+			int length = xbee_build_remote_at(packet, sizeof(packet), 0x01,
+				&node->address, XBEE_APPLY_CHANGES, "IS", NULL, 0);
+			send(packet, length);
+
+			frames++;
+			batch->stats.frames++;
+			batch->stats.bytes += length;
+		}
+	}
+
+	if(batch->num_pending > 0)
+	{
+		batch->stats.batches++;
+	}
+	batch->num_pending = 0;
+	return frames;
+}
@@ -0,0 +1,177 @@
+/*
+ * xbee_baud.c
+ *
+ * find the coordinator xbee and move the link up to the fastest rate it will
+ * do
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include <string.h>
+#include "xbee_baud.h"
+
+// the rates the xbee can run at (the index is the BD setting)
+static const uint32_t xbee_rates[] =
+{
+	1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400
+};
+
+#define NUM_RATES ((int)(sizeof(xbee_rates) / sizeof(xbee_rates[0])))
+
+// the order to look for the radio in (the factory default first, then the 
+// rates we might have left it at)
+static const uint32_t scan_rates[] =
+{
+	9600, 115200, 230400, 57600, 38400, 19200
+};
+
+#define NUM_SCAN_RATES ((int)(sizeof(scan_rates) / sizeof(scan_rates[0])))
+
+// METHODS
+
+// the BD setting for a rate
+int xbee_baud_code(uint32_t baud_rate)
+{
+	int i;
+	for(i = 0; i < NUM_RATES; i++)
+	{
+		if(xbee_rates[i] == baud_rate)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+// switch to a rate and see if the radio answers (if we can't switch then we
+// can't tell - asking at the old rate might find a radio that isn't there)
+static int probe(const xbee_baud_ops_t * ops, uint32_t baud_rate, xbee_baud_result_t * result)
+{
+	int i;
+
+	if(ops->set_baud(baud_rate) != 0)
+	{
+		return 0;
+	}
+	ops->delay(XBEE_BAUD_SETTLE);
+	for(i = 0; i < XBEE_BAUD_PROBES; i++)
+	{
+		result->probes++;
+		if(ops->at_command("BD", NULL, 0, XBEE_BAUD_TIMEOUT) == 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// look for the radio at the rate we think it's at and then at the others
+uint32_t xbee_baud_find(const xbee_baud_ops_t * ops, uint32_t baud_rate,
+	xbee_baud_result_t * result)
+{
+	int i;
+
+	if(probe(ops, baud_rate, result))
+	{
+		return baud_rate;
+	}
+
+	result->scans++;
+	for(i = 0; i < NUM_SCAN_RATES; i++)
+	{
+		if(scan_rates[i] != baud_rate && probe(ops, scan_rates[i], result))
+		{
+			return scan_rates[i];
+		}
+	}
+	return 0;
+}
+
+// find the radio and switch to the fastest target rate that works
+int xbee_baud_negotiate(const xbee_baud_ops_t * ops, uint32_t baud_rate,
+	const uint32_t * targets, int num_targets, xbee_baud_result_t * result)
+{
+	int i;
+
+	memset(result, 0, sizeof(*result));
+
+	// find the radio first (if it's not there, go back to where we started and
+	// leave it at that)
+	uint32_t current = xbee_baud_find(ops, baud_rate, result);
+	result->found_at = current;
+	if(current == 0)
+	{
+		ops->set_baud(baud_rate);
+		result->baud_rate = baud_rate;
+		return -1;
+	}
+
+	for(i = 0; i < num_targets; i++)
+	{
+		// no point going slower than we already are
+		if(targets[i] <= current)
+		{
+			break;
+		}
+
+		int code = xbee_baud_code(targets[i]);
+		if(code < 0)
+		{
+			result->refused++;
+			continue;
+		}
+
+		// ask the radio to change (it answers at the old rate, and a radio that
+		// doesn't do this rate says so)
+		uint8_t param = (uint8_t)code;
+		if(ops->at_command("BD", &param, 1, XBEE_BAUD_TIMEOUT) != 0)
+		{
+			result->refused++;
+			continue;
+		}
+
+		// follow it and check we can still talk to it
+		if(probe(ops, targets[i], result))
+		{
+			current = targets[i];
+			break;
+		}
+
+		// if we can't then go and find it again (it may not have switched, or it
+		// may have switched and not be able to keep up) and try the next rate down
+		result->failed++;
+		current = xbee_baud_find(ops, current, result);
+		if(current == 0)
+		{
+			ops->set_baud(baud_rate);
+			result->baud_rate = baud_rate;
+			return -1;
+		}
+		if(current == targets[i])
+		{
+			break;
+		}
+	}
+
+	result->baud_rate = current;
+	result->throughput = xbee_baud_measure(ops, XBEE_BAUD_MEASURE_COMMANDS);
+	return 0;
+}
+
+// measure the link throughput (in bytes a second, counting both ways)
+uint32_t xbee_baud_measure(const xbee_baud_ops_t * ops, int commands)
+{
+	int i;
+	uint32_t start = ops->time();
+	uint32_t bytes = ops->bytes();
+
+	for(i = 0; i < commands; i++)
+	{
+		ops->at_command("BD", NULL, 0, XBEE_BAUD_TIMEOUT);
+	}
+
+	uint32_t ms = (ops->time() - start) / ops->ticks_per_ms;
+	bytes = ops->bytes() - bytes;
+	return (ms > 0) ? (uint32_t)((uint64_t)bytes * 1000 / ms) : 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * xbee_dma_rx.c
+ *
+ * keep track of the bytes that the dma controller has written into the xbee
+ * uart's circular receive buffer and hand them out as contiguous spans
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include "xbee_dma_rx.h"
+
+// METHODS
+
+// set up the buffer (the dma starts at the beginning of it) - the size has to
+// be a power of two so the byte counts can wrap round cleanly
+void xbee_dma_rx_init(xbee_dma_rx_t * rx, const uint8_t * buffer, uint16_t size)
+{
+	rx->buffer = buffer;
+	rx->size = size;
+	rx->dma_position = 0;
+	rx->produced = 0;
+	rx->events = 0;
+	rx->offset = 0;
+	rx->old_offset = 0;
+	rx->restarted_at = 0;
+	rx->consumed = 0;
+	rx->overruns = 0;
+}
+
+// work out how far the dma has got from its remaining transfer count (this
+// counts down from the buffer size and reloads when it gets to 0)
+size_t xbee_dma_rx_update(xbee_dma_rx_t * rx, uint16_t remaining)
+{
+	uint16_t position = rx->size - remaining;
+	if(position == rx->size)
+	{
+		position = 0;
+	}
+
+	// how many bytes have been written since last time (allowing for the dma
+	// wrapping round to the start of the buffer)
+	size_t count = (position >= rx->dma_position) ?
+		(size_t)(position - rx->dma_position) :
+		(size_t)(rx->size - rx->dma_position + position);
+
+	rx->dma_position = position;
+	rx->produced += count;
+	rx->events++;
+	return count;
+}
+
+// the dma is starting again at the beginning of the buffer, so from here on
+// the byte count maps to a different place in the buffer
+//
+// note: the bytes from before the restart are still read from where they are,
+// but if the dma is restarted twice before the rx thread has caught up with 
+// the first one then the oldest of them are read from the wrong place (the 
+// parser's checksum will catch this)
+void xbee_dma_rx_restart(xbee_dma_rx_t * rx)
+{
+	rx->old_offset = rx->offset;
+	rx->restarted_at = rx->produced;
+	rx->offset = (uint16_t)(0 - rx->produced) & (rx->size - 1);
+	rx->dma_position = 0;
+}
+
+// get the next contiguous span of received bytes - this stops at the end of
+// the buffer, so when the data wraps round it takes two calls to get it all
+size_t xbee_dma_rx_span(xbee_dma_rx_t * rx, const uint8_t ** data)
+{
+	uint32_t produced = rx->produced;
+	uint32_t available = produced - rx->consumed;
+
+	// if we've fallen more than a buffer behind then what we haven't read yet
+	// has been overwritten, so skip to the newest data
+	if(available > rx->size)
+	{
+		rx->overruns++;
+		rx->consumed = produced;
+		return 0;
+	}
+
+	// stop at the point the dma was restarted (if it's somewhere in the bytes 
+	// we've still got to read)
+	uint16_t offset = rx->offset;
+	uint32_t before_restart = rx->restarted_at - rx->consumed;
+	if(before_restart > 0 && before_restart <= available)
+	{
+		available = before_restart;
+		offset = rx->old_offset;
+	}
+
+	uint16_t start = (rx->consumed + offset) & (rx->size - 1);
+	size_t length = available;
+	if(start + length > rx->size)
+	{
+		length = rx->size - start;
+	}
+
+	*data = &rx->buffer[start];
+	return length;
+}
+
+// give back a span (or part of one) once it has been dealt with
+void xbee_dma_rx_consume(xbee_dma_rx_t * rx, size_t length)
+{
+	rx->consumed += length;
+}
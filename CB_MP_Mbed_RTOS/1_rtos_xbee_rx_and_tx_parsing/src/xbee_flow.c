@@ -0,0 +1,62 @@
+/*
+ * xbee_flow.c
+ *
+ * decide when to stop and start the xbee sending to us from how much room is
+ * left in the receive buffer
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include "xbee_flow.h"
+
+// METHODS
+
+// set up the thresholds (the radio starts off running)
+int xbee_flow_init(xbee_flow_t * flow, uint32_t size, uint32_t stop_free,
+	uint32_t start_free)
+{
+	if(start_free <= stop_free || start_free > size)
+	{
+		return 0;
+	}
+
+	flow->size = size;
+	flow->stop_free = stop_free;
+	flow->start_free = start_free;
+	flow->stopped = 0;
+	flow->stops = 0;
+	flow->high_water = 0;
+	return 1;
+}
+
+// stop the radio once the free space drops below the stop threshold
+int xbee_flow_stop(xbee_flow_t * flow, uint32_t used)
+{
+	if(used > flow->high_water)
+	{
+		flow->high_water = used;
+	}
+
+	// (if we've already lost data then used can be more than the size)
+	uint32_t free = (used < flow->size) ? flow->size - used : 0;
+	if(!flow->stopped && free < flow->stop_free)
+	{
+		flow->stopped = 1;
+		flow->stops++;
+		return 1;
+	}
+	return 0;
+}
+
+// start it again once the free space has got back up to the start threshold
+int xbee_flow_start(xbee_flow_t * flow, uint32_t used)
+{
+	uint32_t free = (used < flow->size) ? flow->size - used : 0;
+	if(flow->stopped && free >= flow->start_free)
+	{
+		flow->stopped = 0;
+		return 1;
+	}
+	return 0;
+}
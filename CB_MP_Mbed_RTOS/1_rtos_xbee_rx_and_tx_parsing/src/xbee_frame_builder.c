@@ -0,0 +1,173 @@
+/*
+ * xbee_frame_builder.c
+ *
+ * build xbee api frames straight into a transmit buffer, keeping the checksum
+ * up to date as each field is appended
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include "xbee_frame_builder.h"
+
+// METHODS
+
+// set up a destination address - the bytes are stored in the order they go in
+// the frame, and we add them up now so we don't have to every time we send
+void xbee_address_init(xbee_address_t * address, uint64_t address_64, uint16_t address_16)
+{
+	int i;
+	uint8_t sum = 0;
+
+	for(i = 0; i < 8; i++)
+	{
+		address->bytes[i] = (address_64 >> (56 - (i * 8))) & 0xFF;
+	}
+	address->bytes[8] = (address_16 >> 8) & 0xFF;
+	address->bytes[9] = address_16 & 0xFF;
+
+	for(i = 0; i < 10; i++)
+	{
+		sum += address->bytes[i];
+	}
+	address->sum = sum;
+}
+
+// start a new frame (the delimiter and length get filled in at the end)
+void xbee_frame_begin(xbee_frame_builder_t * frame, uint8_t * buffer, int size, uint8_t frame_type)
+{
+	frame->buffer = buffer;
+	frame->size = size;
+	frame->length = 3;
+	frame->sum = 0;
+	frame->overflow = (size < 5);
+
+	xbee_frame_append_u8(frame, frame_type);
+}
+
+// append a byte to the data field (we always keep the last byte of the buffer
+// free for the checksum)
+void xbee_frame_append_u8(xbee_frame_builder_t * frame, uint8_t value)
+{
+	if(frame->length + 1 >= frame->size)
+	{
+		frame->overflow = 1;
+		return;
+	}
+	frame->buffer[frame->length++] = value;
+	frame->sum += value;
+}
+
+// multi-byte fields are big endian
+void xbee_frame_append_u16(xbee_frame_builder_t * frame, uint16_t value)
+{
+	xbee_frame_append_u8(frame, value >> 8);
+	xbee_frame_append_u8(frame, value);
+}
+
+void xbee_frame_append_u32(xbee_frame_builder_t * frame, uint32_t value)
+{
+	xbee_frame_append_u16(frame, value >> 16);
+	xbee_frame_append_u16(frame, value);
+}
+
+void xbee_frame_append_bytes(xbee_frame_builder_t * frame, const uint8_t * data, int length)
+{
+	int i;
+
+	if(frame->length + length >= frame->size)
+	{
+		frame->overflow = 1;
+		return;
+	}
+	for(i = 0; i < length; i++)
+	{
+		frame->buffer[frame->length++] = data[i];
+		frame->sum += data[i];
+	}
+}
+
+// append a destination address (using the sum we worked out when the address
+// was set up)
+void xbee_frame_append_address(xbee_frame_builder_t * frame, const xbee_address_t * address)
+{
+	int i;
+
+	if(frame->length + 10 >= frame->size)
+	{
+		frame->overflow = 1;
+		return;
+	}
+	for(i = 0; i < 10; i++)
+	{
+		frame->buffer[frame->length++] = address->bytes[i];
+	}
+	frame->sum += address->sum;
+}
+
+// finish the frame off - fill in the delimiter, the length and the checksum
+// and return the length of the whole frame (or 0 if it didn't fit)
+int xbee_frame_end(xbee_frame_builder_t * frame)
+{
+	if(frame->overflow)
+	{
+		return 0;
+	}
+
+	uint16_t data_length = frame->length - 3;
+	frame->buffer[0] = 0x7E;
+	frame->buffer[1] = data_length >> 8;
+	frame->buffer[2] = data_length & 0xFF;
+	frame->buffer[frame->length] = 0xFF - frame->sum;
+
+	return frame->length + 1;
+}
+
+// FRAME TYPES
+
+// remote at command request (0x17)
+int xbee_build_remote_at(uint8_t * buffer, int size, uint8_t frame_id,
+	const xbee_address_t * dest, uint8_t options, const char * command,
+	const uint8_t * param, int param_length)
+{
+	xbee_frame_builder_t frame;
+
+	xbee_frame_begin(&frame, buffer, size, XBEE_REMOTE_AT_COMMAND);
+	xbee_frame_append_u8(&frame, frame_id);
+	xbee_frame_append_address(&frame, dest);
+	xbee_frame_append_u8(&frame, options);
+	xbee_frame_append_u8(&frame, command[0]);
+	xbee_frame_append_u8(&frame, command[1]);
+	xbee_frame_append_bytes(&frame, param, param_length);
+	return xbee_frame_end(&frame);
+}
+
+// local at command (0x08)
+int xbee_build_local_at(uint8_t * buffer, int size, uint8_t frame_id,
+	const char * command, const uint8_t * param, int param_length)
+{
+	xbee_frame_builder_t frame;
+
+	xbee_frame_begin(&frame, buffer, size, XBEE_LOCAL_AT_COMMAND);
+	xbee_frame_append_u8(&frame, frame_id);
+	xbee_frame_append_u8(&frame, command[0]);
+	xbee_frame_append_u8(&frame, command[1]);
+	xbee_frame_append_bytes(&frame, param, param_length);
+	return xbee_frame_end(&frame);
+}
+
+// zigbee transmit request (0x10)
+int xbee_build_tx_request(uint8_t * buffer, int size, uint8_t frame_id,
+	const xbee_address_t * dest, uint8_t radius, uint8_t options,
+	const uint8_t * data, int length)
+{
+	xbee_frame_builder_t frame;
+
+	xbee_frame_begin(&frame, buffer, size, XBEE_TX_REQUEST);
+	xbee_frame_append_u8(&frame, frame_id);
+	xbee_frame_append_address(&frame, dest);
+	xbee_frame_append_u8(&frame, radius);
+	xbee_frame_append_u8(&frame, options);
+	xbee_frame_append_bytes(&frame, data, length);
+	return xbee_frame_end(&frame);
+}
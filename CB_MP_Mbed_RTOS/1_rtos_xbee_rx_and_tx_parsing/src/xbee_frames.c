@@ -0,0 +1,237 @@
+/*
+ * xbee_frames.c
+ *
+ * decode complete xbee api frames into typed structures and pass them on to
+ * whichever handler has been registered for that frame type.
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include "xbee_frames.h"
+
+// frame decoders - these take the frame data field (i.e. starting at the frame
+// type byte) and return 0 if it is too short to be a valid frame
+typedef int (*xbee_frame_decoder)(const uint8_t * data, int length, void * frame);
+
+static int decode_io_sample(const uint8_t * data, int length, void * frame);
+static int decode_remote_at_response(const uint8_t * data, int length, void * frame);
+static int decode_at_response(const uint8_t * data, int length, void * frame);
+static int decode_tx_status(const uint8_t * data, int length, void * frame);
+
+// GLOBAL DECLARATIONS (FOR THIS MODULE)
+
+// one decoder and one handler for each frame type (so dispatching a frame is
+// just a table lookup)
+static const xbee_frame_decoder decoders[256] =
+{
+	[XBEE_LOCAL_AT_RESPONSE]	= decode_at_response,
+	[XBEE_TX_STATUS]					= decode_tx_status,
+	[XBEE_IO_SAMPLE]					= decode_io_sample,
+	[XBEE_REMOTE_AT_RESPONSE]	= decode_remote_at_response,
+};
+static xbee_frame_handler handlers[256];
+
+// METHODS
+
+// register a handler for a frame type (or pass NULL to remove it)
+void xbee_register_handler(uint8_t frame_type, xbee_frame_handler handler)
+{
+	handlers[frame_type] = handler;
+}
+
+// decode a complete frame (from the 0x7E delimiter to the checksum) and pass
+// it to the handler for its frame type - returns 1 if the frame was handled,
+// 0 if nothing is registered for it and -1 if the frame was too short
+int xbee_dispatch_frame(const uint8_t * packet, int length)
+{
+	// we need at least the delimiter, length, frame type and checksum
+	if(length < 5)
+	{
+		return -1;
+	}
+
+	const uint8_t * data = &packet[3];
+	int data_length = length - 4;
+	uint8_t frame_type = data[0];
+
+	xbee_frame_handler handler = handlers[frame_type];
+	if(handler == NULL)
+	{
+		return 0;
+	}
+
+	// decode into whichever structure this frame type uses
+	union
+	{
+		xbee_io_sample_t						io_sample;
+		xbee_remote_at_response_t		remote_at_response;
+		xbee_at_response_t					at_response;
+		xbee_tx_status_t						tx_status;
+		xbee_raw_frame_t						raw;
+	}
+	frame;
+
+	xbee_frame_decoder decoder = decoders[frame_type];
+	if(decoder != NULL)
+	{
+		if(!decoder(data, data_length, &frame))
+		{
+			return -1;
+		}
+	}
+	else
+	{
+		frame.raw.frame_type = frame_type;
+		frame.raw.data = data;
+		frame.raw.data_length = data_length;
+	}
+
+	handler(&frame);
+	return 1;
+}
+
+// FIELD HELPERS
+
+// xbee fields are big endian
+static uint16_t get_u16(const uint8_t * data)
+{
+	return (data[0] << 8) | data[1];
+}
+
+static uint64_t get_u64(const uint8_t * data)
+{
+	uint64_t value = 0;
+	int i;
+	for(i = 0; i < 8; i++)
+	{
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+// DECODERS
+
+// decode io sample data (number of samples, digital and analog channel masks,
+// then the digital samples and an analog sample for each enabled channel)
+int xbee_decode_io_data(const uint8_t * data, int length, xbee_io_sample_t * sample)
+{
+	int i;
+	int offset = 4;
+
+	if(length < 4)
+	{
+		return 0;
+	}
+
+	sample->num_samples = data[0];
+	sample->digital_mask = get_u16(&data[1]);
+	sample->analog_mask = data[3];
+
+	// digital samples are only included if there are any digital channels
+	sample->digital_samples = 0;
+	if(sample->digital_mask != 0)
+	{
+		if(length < offset + 2)
+		{
+			return 0;
+		}
+		sample->digital_samples = get_u16(&data[offset]);
+		offset += 2;
+	}
+
+	// followed by one sample for each analog channel that is enabled
+	for(i = 0; i < XBEE_NUM_ANALOG; i++)
+	{
+		sample->analog[i] = 0;
+		if(sample->analog_mask & (1 << i))
+		{
+			if(length < offset + 2)
+			{
+				return 0;
+			}
+			sample->analog[i] = get_u16(&data[offset]);
+			offset += 2;
+		}
+	}
+	return 1;
+}
+
+// io data sample rx indicator
+static int decode_io_sample(const uint8_t * data, int length, void * frame)
+{
+	xbee_io_sample_t * sample = frame;
+
+	// frame type, 64 bit address, 16 bit address and options come first
+	if(length < 12)
+	{
+		return 0;
+	}
+
+	sample->frame_type = data[0];
+	sample->source_64 = get_u64(&data[1]);
+	sample->source_16 = get_u16(&data[9]);
+	sample->options = data[11];
+	return xbee_decode_io_data(&data[12], length - 12, sample);
+}
+
+// remote at command response
+static int decode_remote_at_response(const uint8_t * data, int length, void * frame)
+{
+	xbee_remote_at_response_t * response = frame;
+
+	if(length < 15)
+	{
+		return 0;
+	}
+
+	response->frame_type = data[0];
+	response->frame_id = data[1];
+	response->source_64 = get_u64(&data[2]);
+	response->source_16 = get_u16(&data[10]);
+	response->command[0] = data[12];
+	response->command[1] = data[13];
+	response->status = data[14];
+	response->data = &data[15];
+	response->data_length = length - 15;
+	return 1;
+}
+
+// local at command response
+static int decode_at_response(const uint8_t * data, int length, void * frame)
+{
+	xbee_at_response_t * response = frame;
+
+	if(length < 5)
+	{
+		return 0;
+	}
+
+	response->frame_type = data[0];
+	response->frame_id = data[1];
+	response->command[0] = data[2];
+	response->command[1] = data[3];
+	response->status = data[4];
+	response->data = &data[5];
+	response->data_length = length - 5;
+	return 1;
+}
+
+// transmit status
+static int decode_tx_status(const uint8_t * data, int length, void * frame)
+{
+	xbee_tx_status_t * status = frame;
+
+	if(length < 7)
+	{
+		return 0;
+	}
+
+	status->frame_type = data[0];
+	status->frame_id = data[1];
+	status->dest_16 = get_u16(&data[2]);
+	status->retry_count = data[4];
+	status->delivery_status = data[5];
+	status->discovery_status = data[6];
+	return 1;
+}
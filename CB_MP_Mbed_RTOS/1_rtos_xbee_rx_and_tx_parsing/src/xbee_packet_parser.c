@@ -11,166 +11,654 @@
 #include "xbee_packet_parser.h"
 #include "xbee.h"
 
+// include the rtos api (for the frame timestamps)
+#include "cmsis_os.h"
+
 // include stdio for sprintf
 #include <stdio.h>
 #include "itm_debug.h"
 
+// in escaped api mode the delimiter and escape characters can't be used as
+// they are when they turn up
+#if XBEE_API_MODE == 2
+	#define XBEE_ESCAPE_CHAR(c) ((c) == 0x7e || (c) == 0x7d)
+#else
+	#define XBEE_ESCAPE_CHAR(c) 0
+#endif
+
 // XBEE METHODS
 
-// calculate the xbee packet checksum
-int validate_packet(void);
+// check the xbee packet checksum
+static int validate_packet(const xbee_parser_t * parser, uint8_t checksum);
+
+// reserve space in the ring buffer for a frame of a given length
+static int allocate_frame(xbee_parser_t * parser, int length);
+
+// find the next api frame delimiter in a block of received data
+static size_t find_delimiter(const uint8_t * buf, size_t n);
 
-// initialise the parser state machine and the niumber of elements to parse
-static parse_state state;
-static int xbee_remain;
+// add a completed frame to the queue of frames for the consumer
+static void queue_frame(xbee_parser_t * parser, uint16_t start, uint16_t length);
 
-// initialise a buffer
-volatile buffer_typedef xbee_buffer = {{0}, 0, 0, 0};
+// look for a good frame in what's left of a corrupted one (only in api mode 1
+// - with escaping a delimiter can't turn up inside a frame)
+#if XBEE_API_MODE != 2
+static int resync(xbee_parser_t * parser, uint16_t start, uint16_t length);
+#endif
+
+// note: all the parser state lives in the xbee_parser_t that gets passed in
+// (one for each radio), so nothing in here is shared between radios
 
 // initialise the parser
-void init_parser(void)
+void init_parser(xbee_parser_t * parser)
 {
-	state = INIT;
-	xbee_remain = 0;
+	parser->state = INIT;
+	parser->remain = 0;
+	parser->sum = 0;
+	parser->escape = 0;
+
+	parser->buffer.ring_head = 0;
+	parser->buffer.ring_tail = 0;
+	parser->buffer.num_bytes = 0;
+
+	parser->queue.frame_head = 0;
+	parser->queue.frame_tail = 0;
+	parser->queue.num_frames = 0;
+
+	parser->stats.frames_ok = 0;
+	parser->stats.bad_checksums = 0;
+	parser->stats.resyncs = 0;
+	parser->stats.dropped_bytes = 0;
+	parser->stats.ring_full = 0;
+}
+
+// get a copy of the parser statistics
+void xbee_get_stats(const xbee_parser_t * parser, xbee_parser_stats_t * stats)
+{
+	*stats = parser->stats;
 }
 
-// parse an xbee api packet
-int xbee_parse_packet(uint8_t c)
+// drop whatever we've got of the current frame and go back to looking for the
+// start of the next one
+void xbee_parser_resync(xbee_parser_t * parser)
+{
+	uint32_t dropped;
+	if(parser->state == DATAFIELD || parser->state == CHECKSUM)
+	{
+		dropped = parser->buffer.ring_head - parser->frame_start;
+		parser->buffer.ring_head = parser->frame_start;
+	}
+	else if(parser->state == PACKETLENGTH_HI || parser->state == PACKETLENGTH_LO)
+	{
+		dropped = (parser->state == PACKETLENGTH_HI) ? 1 : 2;
+	}
+	else
+	{
+		// nothing to throw away
+		return;
+	}
+	parser->stats.dropped_bytes += dropped;
+	ITM_SEND(ITM_CH_PARSER, ITM_EV_RESYNC, dropped);
+
+	parser->state = INIT;
+	parser->remain = 0;
+	parser->escape = 0;
+	parser->stats.resyncs++;
+}
+
+// parse an xbee api packet - returns the number of frames this byte completed
+// (more than one if a bad checksum made us rescan the frame and we found some
+// in it)
+int xbee_parse_packet(xbee_parser_t * parser, uint8_t c)
 {
 	// debugging code to diagnose packet reception problems ...
 	//char buf[5];
 	//sprintf(buf, "%02X ", c);
 	//print_debug(buf, 3);
-	
-	// whilst there is data in the rx buffer and the xbee buffer isn't full ...
-	while((xbee_buffer.num_bytes < RING_SIZE))
+
+#if XBEE_API_MODE == 2
+	// in escaped mode a delimiter always means the start of a new frame (even
+	// if we are part way through one - in which case that frame is lost), and
+	// an escape character means we need to xor the next byte with 0x20
+	if(c == 0x7e)
 	{
-		// check if it is an api frame header
-		if(state == INIT && c == 0x7e)
-		{			
-			// add data to the buffer
-			xbee_buffer.data[xbee_buffer.ring_head] = c;
-			xbee_buffer.ring_head = (xbee_buffer.ring_head + 1) % RING_SIZE;
-			xbee_buffer.num_bytes++;
+		if(parser->state == DATAFIELD || parser->state == CHECKSUM)
+		{
+			parser->buffer.ring_head = parser->frame_start;
+			parser->stats.dropped_bytes += parser->frame_length;
+			parser->stats.resyncs++;
+		}
+		parser->state = INIT;
+		parser->escape = 0;
+	}
+	else if(c == 0x7d)
+	{
+		parser->escape = 0x20;
+		return 0;
+	}
+	c ^= parser->escape;
+	parser->escape = 0;
+#endif
 
-			state = PACKETLENGTH_HI;
+	switch(parser->state)
+	{
+		// check if it is an api frame header
+		case INIT:
+			if(c == 0x7e)
+			{
+				parser->header[0] = c;
+				parser->state = PACKETLENGTH_HI;
+			}
+			else
+			{
+				parser->stats.dropped_bytes++;
+			}
 			break;
-		}
 
 		// read high byte of data field length
-		if(state == PACKETLENGTH_HI)
-		{			
-			// add data to the buffer
-			xbee_buffer.data[xbee_buffer.ring_head] = c;
-			xbee_buffer.ring_head = (xbee_buffer.ring_head + 1) % RING_SIZE;
-			xbee_buffer.num_bytes++;
-
-			xbee_remain += c * 10;
-
-			state = PACKETLENGTH_LO;
+		case PACKETLENGTH_HI:
+			parser->header[1] = c;
+			parser->remain = c << 8;
+			parser->state = PACKETLENGTH_LO;
 			break;
-		}
 
 		// read low byte of data field length
-		if(state == PACKETLENGTH_LO)
-		{			
-			// add data to the buffer
-			xbee_buffer.data[xbee_buffer.ring_head] = c;
-			xbee_buffer.ring_head = (xbee_buffer.ring_head + 1) % RING_SIZE;
-			xbee_buffer.num_bytes++;
+		case PACKETLENGTH_LO:
+			parser->header[2] = c;
+			parser->remain |= c;
+			parser->sum = 0;
+
+			// find somewhere to put the frame (if there isn't room because the
+			// consumer hasn't released enough frames then drop it)
+			if(!allocate_frame(parser, parser->remain + 4))
+			{
+				parser->stats.ring_full++;
+				parser->remain = 0;
+				parser->state = INIT;
+				break;
+			}
 
-			xbee_remain += c;
+			// add the header to the buffer
+			parser->buffer.data[parser->frame_start]     = parser->header[0];
+			parser->buffer.data[parser->frame_start + 1] = parser->header[1];
+			parser->buffer.data[parser->frame_start + 2] = parser->header[2];
+			parser->buffer.ring_head = parser->frame_start + 3;
 
-			state = DATAFIELD;
+			parser->state = (parser->remain > 0) ? DATAFIELD : CHECKSUM;
 			break;
-		}
 
 		// read datafield
-		if(state == DATAFIELD && xbee_remain > 0)
-		{			
+		case DATAFIELD:
 			// add data to the buffer
-			xbee_buffer.data[xbee_buffer.ring_head] = c;
-			xbee_buffer.ring_head = (xbee_buffer.ring_head + 1) % RING_SIZE;
-			xbee_buffer.num_bytes++;
-			xbee_remain--;
+			parser->buffer.data[parser->buffer.ring_head++] = c;
+			parser->sum += c;
+			parser->remain--;
 
 			// if we've read all the data field, move on to the checksum
-			if(xbee_remain == 0)
+			if(parser->remain == 0)
 			{
-				state = CHECKSUM;
+				parser->state = CHECKSUM;
 			}
 			break;
-		}
 
 		// read checksum
-		if(state == CHECKSUM)
-		{
+		case CHECKSUM:
 			// add data to the buffer
-			xbee_buffer.data[xbee_buffer.ring_head] = c;
-			xbee_buffer.ring_head = (xbee_buffer.ring_head + 1) % RING_SIZE;
-			xbee_buffer.num_bytes++;
+			parser->buffer.data[parser->buffer.ring_head++] = c;
+			parser->state = COMPLETE;
+			break;
 
-			state = COMPLETE;
+		default:
+			break;
+	}
+
+	// if the xbee packet is done then queue it up for the consumer ...
+	if(parser->state == COMPLETE)
+	{
+		// set the state to INIT ready to parse the next packet
+		parser->state = INIT;
+
+		// verify packet
+		uint8_t checksum = parser->buffer.data[parser->frame_start + parser->frame_length - 1];
+		if(!validate_packet(parser, checksum))
+		{
+			parser->stats.bad_checksums++;
+			ITM_SEND(ITM_CH_PARSER, ITM_EV_BAD_CHECKSUM, parser->frame_length, checksum, 
+				parser->sum & 0xFF);
+
+#if XBEE_API_MODE == 2
+			// in escaped mode a real delimiter can't be hiding in the frame, so
+			// just give the space back and wait for the next one
+			parser->buffer.ring_head = parser->frame_start;
+			parser->stats.dropped_bytes += parser->frame_length;
+			return 0;
+#else
+			// otherwise the delimiter we started from may have been a stray 0x7E
+			// (or the length may have been corrupted) and the real frame starts
+			// somewhere in the bytes we've already read - so go and look for it
+			return resync(parser, parser->frame_start, parser->frame_length);
+#endif
 		}
 
-		// if the xbee packet is done then print it ...
-		if(state == COMPLETE)
+		queue_frame(parser, parser->frame_start, parser->frame_length);
+		return 1;
+	}
+	return 0;
+}
+
+// parse a whole block of received bytes at once - this skips over garbage
+// between frames a word at a time and copies the data field of each frame
+// into the ring buffer in one go (rather than running the state machine for
+// every byte)
+//
+// returns the number of bytes consumed - this is less than n if all the frame
+// slots fill up (or there isn't room for the next frame until some are given
+// back), in which case the caller should process (and release) some frames and
+// then call again with the rest of the data
+size_t xbee_parse_bytes(xbee_parser_t * parser, const uint8_t * buf, size_t n, int * frames)
+{
+	size_t i = 0;
+	int completed = 0;
+
+	while(i < n)
+	{
+		// skip anything that isn't the start of a frame
+		if(parser->state == INIT)
 		{
-			// verify packet
-			if(!validate_packet())
+			size_t skip = find_delimiter(&buf[i], n - i);
+			parser->stats.dropped_bytes += skip;
+			i += skip;
+			if(i == n)
 			{
-				// if things have gone wrong, dump the packet to the itm terminal to 
-				// help diagnose the problem
-				print_debug("CORRUPTED  ", 11);
-				while(xbee_buffer.num_bytes > 0)
-				{
-					// get char from xbee buffer
-					uint8_t c = xbee_buffer.data[xbee_buffer.ring_tail];
-					xbee_buffer.ring_tail = (xbee_buffer.ring_tail + 1) % RING_SIZE;
-					xbee_buffer.num_bytes--;
-
-					char buf[5];
-					sprintf(buf, "%02X ", c);
-					print_debug(buf, 3);
-				}
-				state = INIT;
-				return 0;
+				break;
+			}
+		}
+
+		// once we know how long the data field is we can copy as much of it as
+		// we've got in one go (adding it to the checksum as we go)
+		if(parser->state == DATAFIELD)
+		{
+			uint8_t * dest = &parser->buffer.data[parser->buffer.ring_head];
+			uint32_t sum = parser->sum;
+
+#if XBEE_API_MODE == 2
+			// undo the escaping as we copy - an escape character is written out
+			// too but then gets overwritten by the byte after it (this keeps the
+			// loop free of branches apart from the check for a delimiter, which
+			// means the frame has been cut short and we need to resync)
+			int remain = parser->remain;
+			uint8_t escape = parser->escape;
+			while(remain > 0 && i < n && buf[i] != 0x7e)
+			{
+				uint8_t c = buf[i++];
+				uint8_t is_escape = (c == 0x7d);
+				c ^= escape;
+				*dest = c;
+				dest += !is_escape;
+				sum += is_escape ? 0 : c;
+				remain -= !is_escape;
+				escape = is_escape ? 0x20 : 0;
+			}
+			parser->escape = escape;
+			parser->buffer.ring_head += parser->remain - remain;
+			parser->remain = remain;
+#else
+			// (remain is never negative once we're in the data field)
+			size_t chunk = n - i;
+			if(chunk > (size_t)parser->remain)
+			{
+				chunk = parser->remain;
+			}
+
+			size_t j;
+			for(j = 0; j < chunk; j++)
+			{
+				dest[j] = buf[i + j];
+				sum += buf[i + j];
+			}
+			parser->buffer.ring_head += chunk;
+			parser->remain -= chunk;
+			i += chunk;
+#endif
+			parser->sum = sum;
+
+			if(parser->remain == 0)
+			{
+				parser->state = CHECKSUM;
+			}
+
+			// carry on unless we stopped at a delimiter (which the state machine
+			// below needs to see)
+			if(parser->state == CHECKSUM || i == n)
+			{
+				continue;
+			}
+		}
+
+		// if frames we've already handed out are in the way of the next one then
+		// stop here (rather than dropping it) and let the caller release them
+		if(parser->state == PACKETLENGTH_LO && parser->queue.num_frames > 0 &&
+			!XBEE_ESCAPE_CHAR(buf[i]) &&
+			!allocate_frame(parser, (parser->remain | (buf[i] ^ parser->escape)) + 4))
+		{
+			break;
+		}
+
+		// everything else (the header and the checksum) goes through the state
+		// machine a byte at a time
+		int queued = xbee_parse_packet(parser, buf[i++]);
+		if(queued > 0)
+		{
+			completed += queued;
+
+			// stop if there's nowhere left to put another frame
+			if(parser->queue.num_frames >= XBEE_FRAME_SLOTS)
+			{
+				break;
 			}
-			
-			// set the state to INIT ready to parse the next packet
-			state = INIT;
-			return xbee_buffer.num_bytes;
-			/*!RELEASE MUTEX HERE?!*/
 		}
 	}
-	return 0;
+
+	if(frames != NULL)
+	{
+		*frames = completed;
+	}
+	return i;
 }
 
-// validate an xbee packet by calculating the checksum and comparing it to the
-// one that the xbee sends
-int validate_packet(void)
+// find the offset of the next 0x7E in a block of data (or n if there isn't
+// one) - we check a whole word at a time once the pointer is aligned
+static size_t find_delimiter(const uint8_t * buf, size_t n)
 {
-	int i;
-	int sum = 0;
-	for(i = 3; i < (xbee_buffer.num_bytes - 1); i++)
+	size_t i = 0;
+
+	// get to a word boundary
+	while(i < n && (((uintptr_t)&buf[i]) & 0x3) != 0)
+	{
+		if(buf[i] == 0x7e)
+		{
+			return i;
+		}
+		i++;
+	}
+
+	// check four bytes at a time (xor-ing with 0x7E7E7E7E turns any delimiter
+	// into a zero byte, which the usual bit trick then picks out)
+	while(i + 4 <= n)
+	{
+		uint32_t word = *((const uint32_t *)&buf[i]) ^ 0x7e7e7e7e;
+		if(((word - 0x01010101) & ~word & 0x80808080) != 0)
+		{
+			break;
+		}
+		i += 4;
+	}
+
+	// and finish off byte by byte
+	while(i < n && buf[i] != 0x7e)
 	{
-		sum += xbee_buffer.data[(xbee_buffer.ring_tail + i) % RING_SIZE];
+		i++;
+	}
+	return i;
+}
+
+// add a completed frame to the queue
+static void queue_frame(xbee_parser_t * parser, uint16_t start, uint16_t length)
+{
+	// fill in the frame descriptor
+	xbee_frame_t * frame = &parser->queue.frames[parser->queue.frame_head];
+	frame->offset = start;
+	frame->length = length;
+	frame->frame_type = (length > 4) ? parser->buffer.data[start + 3] : 0;
+	frame->timestamp = osKernelSysTick();
+
+	// and add it to the queue
+	parser->queue.frame_head = (parser->queue.frame_head + 1) % XBEE_FRAME_SLOTS;
+	parser->queue.num_frames++;
+	parser->buffer.num_bytes += length;
+	parser->stats.frames_ok++;
+}
+
+// recover from a bad checksum by rescanning the bytes of the bad frame (after
+// its delimiter) for the next 0x7E and parsing again from there - anything we
+// find is already in the ring buffer, so frames are queued where they are and
+// a frame that runs past the bytes we've got just carries on being parsed as
+// normal
+//
+// returns the number of good frames found (and queued)
+#if XBEE_API_MODE != 2
+static int resync(xbee_parser_t * parser, uint16_t start, uint16_t length)
+{
+	const uint8_t * data = parser->buffer.data;
+	uint16_t end = start + length;
+	uint16_t pos = start + 1;
+	uint16_t keep = start;
+	int found = 0;
+
+	// if this frame was put at the start of the buffer to get round frames that
+	// are still waiting then it can only grow up to the oldest of them
+	uint16_t limit = RING_SIZE;
+	if(parser->queue.num_frames > 0 && start < parser->buffer.ring_tail)
+	{
+		limit = parser->buffer.ring_tail - 1;
+	}
+
+	// the delimiter we started from is lost
+	parser->stats.dropped_bytes++;
+
+	while(pos < end)
+	{
+		// skip to the next candidate delimiter
+		uint16_t p = pos + find_delimiter(&data[pos], end - pos);
+		parser->stats.dropped_bytes += p - pos;
+		if(p == end)
+		{
+			break;
+		}
+		parser->stats.resyncs++;
+
+		// if we've not got the whole header yet then pick up from where it gets
+		// to (there's nothing else in the buffer that we need to keep)
+		if(end - p < 3)
+		{
+			parser->header[0] = data[p];
+			parser->state = PACKETLENGTH_HI;
+			if(end - p == 2)
+			{
+				parser->header[1] = data[p + 1];
+				parser->remain = data[p + 1] << 8;
+				parser->state = PACKETLENGTH_LO;
+			}
+			parser->buffer.ring_head = keep;
+			return found;
+		}
+
+		// otherwise the frame has to fit where it is
+		int frame_len = ((data[p + 1] << 8) | data[p + 2]) + 4;
+		if(p + frame_len > limit || parser->queue.num_frames == XBEE_FRAME_SLOTS)
+		{
+			parser->stats.dropped_bytes++;
+			pos = p + 1;
+			continue;
+		}
+
+		// add up as much of the data field as we've got
+		uint16_t data_end = (p + frame_len - 1 < end) ? p + frame_len - 1 : end;
+		uint32_t sum = 0;
+		uint16_t j;
+		for(j = p + 3; j < data_end; j++)
+		{
+			sum += data[j];
+		}
+
+		// if the frame runs on past the end of the bad one then carry on parsing
+		// it from the bytes that are still to come
+		if(p + frame_len > end)
+		{
+			parser->frame_start = p;
+			parser->frame_length = frame_len;
+			parser->sum = sum;
+			parser->remain = (frame_len - 4) - (end - p - 3);
+			parser->state = (parser->remain > 0) ? DATAFIELD : CHECKSUM;
+			parser->buffer.ring_head = end;
+			return found;
+		}
+
+		// otherwise we've got all of it, so check it
+		if((0xFF - (sum & 0xFF)) == data[p + frame_len - 1])
+		{
+			queue_frame(parser, p, frame_len);
+			found++;
+			keep = p + frame_len;
+			pos = keep;
+		}
+		else
+		{
+			parser->stats.bad_checksums++;
+			parser->stats.dropped_bytes++;
+			pos = p + 1;
+		}
 	}
-	return ((0xFF - (sum & 0xFF)) == xbee_buffer.data[xbee_buffer.ring_head - 1]);
+
+	// nothing else worth keeping, so give the rest of the space back
+	parser->buffer.ring_head = keep;
+	parser->state = INIT;
+	return found;
 }
+#endif
 
-// get the xbee frame in a packet buffer
-void get_packet(uint8_t * packet_buffer)
+// reserve a contiguous region of the ring buffer for a frame - returns 0 if
+// there is no room
+static int allocate_frame(xbee_parser_t * parser, int length)
 {
-	int i = 0;
-	while(xbee_buffer.num_bytes > 0)
+	// we also need a free frame descriptor
+	if(length > RING_SIZE || parser->queue.num_frames == XBEE_FRAME_SLOTS)
 	{
-		// get char from xbee buffer
-		uint8_t c = xbee_buffer.data[xbee_buffer.ring_tail];
-		xbee_buffer.ring_tail = (xbee_buffer.ring_tail + 1) % RING_SIZE;
-		xbee_buffer.num_bytes--;
+		return 0;
+	}
+
+	// if nothing is waiting to be consumed then just start from the beginning
+	// of the buffer again
+	if(parser->queue.num_frames == 0)
+	{
+		parser->buffer.ring_head = 0;
+		parser->buffer.ring_tail = 0;
+	}
 
-		// write into packet buffer
-		packet_buffer[i++] = c;
+	if(parser->buffer.ring_head >= parser->buffer.ring_tail)
+	{
+		// free space is from the head to the end of the buffer and from the start
+		// of the buffer up to the tail
+		if(parser->buffer.ring_head + length <= RING_SIZE)
+		{
+			parser->frame_start = parser->buffer.ring_head;
+		}
+		else if(length < parser->buffer.ring_tail)
+		{
+			parser->frame_start = 0;
+		}
+		else
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		// we've already wrapped around, so free space is between the head and the
+		// tail
+		if(parser->buffer.ring_head + length < parser->buffer.ring_tail)
+		{
+			parser->frame_start = parser->buffer.ring_head;
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	parser->frame_length = length;
+	return 1;
+}
+
+// validate an xbee packet by comparing the checksum that the xbee sends to the
+// one we've been keeping track of while parsing the data field
+static int validate_packet(const xbee_parser_t * parser, uint8_t checksum)
+{
+	return ((0xFF - (parser->sum & 0xFF)) == checksum);
+}
+
+// FRAME ACCESS
+
+// get the descriptor of the oldest completed frame (returns 0 if there isn't
+// one waiting)
+int xbee_get_frame(const xbee_parser_t * parser, xbee_frame_t * frame)
+{
+	if(parser->queue.num_frames == 0)
+	{
+		return 0;
+	}
+	*frame = parser->queue.frames[parser->queue.frame_tail];
+	return 1;
+}
+
+// get a pointer to the frame bytes (which are only valid until the frame is
+// released)
+const uint8_t * xbee_frame_data(const xbee_parser_t * parser, const xbee_frame_t * frame)
+{
+	return &parser->buffer.data[frame->offset];
+}
+
+// release the oldest completed frame so its space can be reused
+void xbee_release_frame(xbee_parser_t * parser)
+{
+	if(parser->queue.num_frames == 0)
+	{
+		return;
+	}
+
+	parser->buffer.num_bytes -= parser->queue.frames[parser->queue.frame_tail].length;
+	parser->queue.frame_tail = (parser->queue.frame_tail + 1) % XBEE_FRAME_SLOTS;
+	parser->queue.num_frames--;
+
+	// the tail moves up to the next frame waiting (or to the frame currently
+	// being parsed if there aren't any)
+	if(parser->queue.num_frames > 0)
+	{
+		parser->buffer.ring_tail = parser->queue.frames[parser->queue.frame_tail].offset;
+	}
+	else if(parser->state == DATAFIELD || parser->state == CHECKSUM)
+	{
+		parser->buffer.ring_tail = parser->frame_start;
+	}
+	else
+	{
+		parser->buffer.ring_tail = parser->buffer.ring_head;
+	}
+}
+
+// ESCAPING
+
+// escape a frame for api mode 2 in a single pass (everything apart from the
+// initial delimiter that is 0x7E, 0x7D, 0x11 or 0x13 gets sent as 0x7D followed
+// by the byte xor-ed with 0x20) - returns the escaped length
+int xbee_escape_frame(const uint8_t * frame, int length, uint8_t * out)
+{
+	int i;
+	int j = 0;
+
+	if(length > 0)
+	{
+		out[j++] = frame[0];
+	}
+	for(i = 1; i < length; i++)
+	{
+		uint8_t c = frame[i];
+		if(c == 0x7e || c == 0x7d || c == 0x11 || c == 0x13)
+		{
+			out[j++] = 0x7d;
+			c ^= 0x20;
+		}
+		out[j++] = c;
 	}
+	return j;
 }
@@ -22,8 +22,23 @@
 #include "xbee.h"
 #include "itm_debug.h"
 
-// include the xbee packet parser
+// include the binary trace log (which the busy threads use instead of printf)
+#include "trace.h"
+
+// include the xbee packet parser, frame decoder and actuation batching
 #include "xbee_packet_parser.h"
+#include "xbee_frames.h"
+#include "xbee_actuation.h"
+#include "xbee_requests.h"
+
+// include the node registry (so we can find a frame's room from its address)
+// and node discovery (which fills it in)
+#include "node_registry.h"
+#include "node_discovery.h"
+
+// include the settings saved in flash
+#include "config_store.h"
+#include "config_qspi.h"
 
 // include main.h with the mail type declaration
 #include "main.h"
@@ -54,10 +69,9 @@ void display_thread(void const *argument);
 osThreadId tid_display_thread;
 osThreadDef (display_thread, osPriorityBelowNormal, 1, 0);
 
-// setup a message queue to use for receiving characters from the interrupt
-// callback
-osMessageQDef(message_q, 512, uint8_t);
-osMessageQId msg_q;
+void config_thread(void const *argument);
+osThreadId tid_config_thread;
+osThreadDef(config_thread, osPriorityLow, 1, 0);
 
 // set up the mail queues
 osMailQDef(mail_box, 64, mail_t);
@@ -68,16 +82,30 @@ osMailQDef(thresh_over_box, 64, thresh_over_mail);
 osMailQId	thresh_over_box;
 osMailQDef(display_box, 64, display_mail);
 osMailQId display_box;
+osMailQDef(config_box, 16, room_config_t);
+osMailQId config_box;
 
 //Timer definition
 void poll_Button_Inputs(void const *arg);
 osTimerDef(poll_Button_In, poll_Button_Inputs);
 
+// and one for checking whether any requests need resending
+void check_requests(void const *arg);
+osTimerDef(check_req, check_requests);
+
+// and one for waking the rx thread up to look after node discovery
+void discovery_tick(void const *arg);
+osTimerDef(discovery_timer, discovery_tick);
+
 // Semaphores & Mutexes
 osMutexDef (thresh_over_state);    
 osMutexId  (thresh_over_state_id);
 osMutexDef (xbee_rx_lock);
 osMutexId  (xbee_rx_lock_id);
+osMutexDef (xbee_request_lock);
+osMutexId  (xbee_request_lock_id);
+osMutexDef (config_lock);
+osMutexId  (config_lock_id);
 
 //GPIO defines
 gpio_pin_t pb1 = {PA_8, GPIOA, GPIO_PIN_8};
@@ -88,32 +116,127 @@ gpio_pin_t alarmOutput = {PB_15, GPIOB, GPIO_PIN_15};
 
 
 // process packet function
-void process_packet(uint8_t* packet, int length);
+void parse_bytes(const uint8_t* data, size_t length);
+void process_packet(const uint8_t* packet, int length);
+
+// frame handlers (one for each api frame type we are interested in)
+void io_sample_handler(const void *frame);
+void remote_at_response_handler(const void *frame);
+void at_response_handler(const void *frame);
+void tx_status_handler(const void *frame);
+
+//Send commands to the nodes
+void flush_actuation(xbee_actuation_batch_t *batch);
+void send_frame(uint8_t *frame, int length);
+void send_prebuilt_frame(uint8_t *frame, int length, volatile uint8_t *in_flight);
+static void track_frame(uint8_t *frame, int length);
+static void prebuilt_frame_sent(const uint8_t *frame, int length, void *context);
+static void collect_resend(uint8_t *frame, int length);
+
+//Find the node a frame came from (learning it if it's new)
+static node_id_t find_node(uint16_t myAddress, uint64_t serial);
+static node_id_t node_heard(node_id_t id, int change, uint16_t myAddress, uint64_t serial);
+static void check_discovery(void);
+
+//Save and restore the rooms' settings
+static void restore_room(node_id_t id);
+static void save_room(node_id_t id);
+
+//Keep track of the commands waiting for a response
+void complete_request(uint8_t frame_id, uint8_t status);
+void request_done(uint8_t frame_id, uint8_t status, uint32_t latency, void *context);
+
+//Send a local at command and wait for the answer
+int xbee_at_command(const char *command, const uint8_t *param, int length, uint32_t timeout);
+static void at_command_done(uint8_t frame_id, uint8_t status, uint32_t latency, void *context);
 
 // STRUCT & VARIABLE DEFINES
 
 
-struct Room {
-	uint8_t id;
-	uint16_t myAddress;
-	uint32_t slAddress;
-	uint8_t upperHeatThreshold;
-	uint8_t lowerHeatThreshold;
-	uint8_t lightThreshold;
-	uint8_t	lightOverride;
-	uint8_t	heatingOverride;
-	uint8_t acOverride;
-	uint8_t overThreshButtonState;
-	uint64_t lastTimeStamp;
-	uint8_t overrideChangeCheck;
-}node[2];
+//The nodes we know about (only the rx thread changes this, through discovery
+//- the other threads just use the node ids it hands out)
+static node_registry_t nodes;
+static node_discovery_t discovery;
+
+//How often (in seconds of system uptime) to send a node discover sweep, and
+//how long a node can go without sending us anything before we forget it (the
+//nodes send a sample every ~6 s, so this is a lot of missed samples)
+#define DISCOVERY_PERIOD		60
+#define DISCOVERY_EXPIRY		300
+#define DISCOVERY_CHECK			1000
+
+//The signal the discovery timer wakes the rx thread up with, and the frame id
+//we send ND with (its responses are picked out by the command, so this can
+//share an id with a tracked request)
+#define DISCOVERY_SIGNAL		0x04
+#define DISCOVERY_FRAME_ID	0xFE
+
+//Set when the rx thread has asked the action thread to send an ND sweep
+static volatile uint8_t sweep_pending = 0;
 
+//The settings saved in the qspi flash (shared between the rx thread, which
+//reads them back when a room turns up, and the config thread, which saves
+//them - so only touch it while holding config_lock_id). the config thread
+//tidies the store up when it hasn't had anything to save for CONFIG_IDLE ms
+static config_store_t config;
+static uint8_t config_ok = 0;
+#define CONFIG_IDLE					1000
+
+//The state for each room, indexed by node id (kept as one array per field, so
+//going round all the rooms only touches the field we want)
+static struct {
+	xbee_address_t address[NODE_REGISTRY_SIZE];
+	uint8_t upperHeatThreshold[NODE_REGISTRY_SIZE];
+	uint8_t lowerHeatThreshold[NODE_REGISTRY_SIZE];
+	uint8_t lightThreshold[NODE_REGISTRY_SIZE];
+	uint8_t lightOverride[NODE_REGISTRY_SIZE];
+	uint8_t heatingOverride[NODE_REGISTRY_SIZE];
+	uint8_t acOverride[NODE_REGISTRY_SIZE];
+	uint8_t overrideChangeCheck[NODE_REGISTRY_SIZE];
+	
+	//process ir thread
+	uint8_t prevPirLevel[NODE_REGISTRY_SIZE];
+	uint8_t currentPirLevel[NODE_REGISTRY_SIZE];
+	uint8_t tempChangeCheck[NODE_REGISTRY_SIZE];
+	uint8_t lightChangeCheck[NODE_REGISTRY_SIZE];
+	
+	//thresh over thread
+	uint8_t threshFlag[NODE_REGISTRY_SIZE];
+	uint8_t selector[NODE_REGISTRY_SIZE];
+} rooms;
 
-int arrSize = sizeof(node) / sizeof(node[0]);
 uint8_t armedState = 0, doArmedOnce = 0;
 
 uint64_t systemUptime = 0, uptimeCorrection;
 
+// packet parser for the xbee on usart6 (each radio needs its own parser, and 
+// only the rx thread for that radio touches it)
+static xbee_parser_t xbee_parser;
+
+// commands we've sent that are waiting for a response (shared between the
+// action thread, the rx thread and the request timer - so only touch it while
+// holding xbee_request_lock_id)
+xbee_request_table_t xbee_requests;
+
+// how long to wait (in ms) for the first response to a command (this doubles 
+// for each retry) and how often to check for anything that has run out of time
+#define REQUEST_TIMEOUT		500
+#define REQUEST_CHECK			100
+
+// set when the timer has asked the action thread to resend something
+static volatile uint8_t retry_pending = 0;
+
+// the frames the request table wants resending (copied out while the table is
+// locked and sent once it isn't - only the action thread uses these)
+static uint8_t resend_frames[XBEE_REQUEST_SLOTS][XBEE_REQUEST_MAX_FRAME];
+static int resend_lengths[XBEE_REQUEST_SLOTS];
+static int num_resends;
+
+// the signal a thread waiting in xbee_at_command gets when the answer comes 
+// back (and the status it came back with)
+#define XBEE_AT_SIGNAL 0x02
+static volatile uint8_t at_command_status;
+
 // THREAD INITIALISATION
 
 // create the uart thread(s)
@@ -123,9 +246,6 @@ int init_xbee_threads(void)
 	init_uart(9600);
 	printf("we are alive!\r\n");
 	
-	// create the message queue
-	msg_q = osMessageCreate(osMessageQ(message_q), NULL);
-
 	// create the mailbox
 	mail_box = osMailCreate(osMailQ(mail_box), NULL);
 	proc_box = osMailCreate(osMailQ(proc_box), NULL);
@@ -142,6 +262,21 @@ int init_xbee_threads(void)
 	if (xbee_rx_lock_id != NULL){
     printf("Xbee Lock Mutex created \n");
   }   
+	xbee_request_lock_id = osMutexCreate(osMutex(xbee_request_lock));
+	config_lock_id = osMutexCreate(osMutex(config_lock));
+	
+	//Read the settings we saved last time out of the qspi flash
+	config_box = osMailCreate(osMailQ(config_box), NULL);
+	if(config_qspi_open(&config) == CONFIG_STORE_OK){
+		config_ok = 1;
+		printf("%d rooms saved in flash\n", config.count);
+	}
+	else{
+		printf("Couldn't read the saved settings, using the defaults\n");
+	}
+	
+	//set up the table of outstanding requests (timeouts are in kernel ticks)
+	xbee_requests_init(&xbee_requests, osKernelSysTickMicroSec(REQUEST_TIMEOUT * 1000));
 
 	// create the threads and get their task id
 	tid_xbee_rx_thread = osThreadCreate(osThread(xbee_rx_thread), NULL);
@@ -149,6 +284,7 @@ int init_xbee_threads(void)
 	tid_thresh_over_thread = osThreadCreate(osThread(thresh_over_thread), NULL);
 	tid_process_ir_thread = osThreadCreate(osThread(process_ir_thread), NULL);
 	tid_display_thread = osThreadCreate(osThread(display_thread), NULL);
+	tid_config_thread = osThreadCreate(osThread(config_thread), NULL);
 	
 
 	//Init GPIO
@@ -171,6 +307,14 @@ int init_xbee_threads(void)
 	osTimerId pollButton = osTimerCreate(osTimer(poll_Button_In), osTimerPeriodic, NULL);
 	osTimerStart(pollButton, 20);
 	
+	//Create timer for resending requests that haven't been answered
+	osTimerId checkRequests = osTimerCreate(osTimer(check_req), osTimerPeriodic, NULL);
+	osTimerStart(checkRequests, REQUEST_CHECK);
+	
+	//Create timer for node discovery
+	osTimerId discoveryTimer = osTimerCreate(osTimer(discovery_timer), osTimerPeriodic, NULL);
+	osTimerStart(discoveryTimer, DISCOVERY_CHECK);
+	
 
 	//Init LCD
 	
@@ -197,6 +341,10 @@ int init_xbee_threads(void)
 		printf("Display thread not created!\r\n");
 		return(-1);
 	}
+	if(!tid_config_thread){
+		printf("Config thread not created!\r\n");
+		return(-1);
+	}
 	
 	return(0);
 }
@@ -210,382 +358,627 @@ void xbee_rx_thread(void const *argument)
 	printf("xbee rx thread running!\r\n");
 
 
-	//Itterate through struct and assign defaults
+	//Start with no nodes (each one is added as it's heard from, and gets its
+	//saved settings back then)
+	node_registry_init(&nodes);
+	node_discovery_init(&discovery, &nodes, DISCOVERY_PERIOD, DISCOVERY_EXPIRY,
+		(uint32_t)systemUptime);
+	
+	// reset the packet parser (and its ring buffer of received frames)
+	init_parser(&xbee_parser);
 	
-	for(int i = 0; i < arrSize; i++){
-		node[i].id = i;
-		node[i].slAddress = 0;
-		node[i].myAddress = 0;
-		node[i].upperHeatThreshold = 18;
-		node[i].lowerHeatThreshold = 17;
-		node[i].lightThreshold = 40;
-		node[i].heatingOverride = 0;
-		node[i].lightOverride = 0;
-		node[i].acOverride = 0;
-		node[i].overThreshButtonState = 2;
-		node[i].overrideChangeCheck = 0;
-	}	
+	// register the frame handlers
+	xbee_register_handler(XBEE_IO_SAMPLE, io_sample_handler);
+	xbee_register_handler(XBEE_REMOTE_AT_RESPONSE, remote_at_response_handler);
+	xbee_register_handler(XBEE_LOCAL_AT_RESPONSE, at_response_handler);
+	xbee_register_handler(XBEE_TX_STATUS, tx_status_handler);
 	
 	// infinite loop ...
 	while(1)
 	{
-		// wait for there to be something in the message queue
-		osEvent evt = osMessageGet(msg_q, osWaitForever);
+		// wait for the uart to tell us there is new data (either in the dma 
+		// buffer or the receive ring) or for the discovery timer
+		osEvent evt = osSignalWait(0, osWaitForever);
+		
+		if(evt.status == osEventSignal && (evt.value.signals & DISCOVERY_SIGNAL))
+		{
+			check_discovery();
+		}
 
-		// process the message queue ...
-		if(evt.status == osEventMessage)
+		// parse the new data straight out of the buffer (this takes two goes if it
+		// wraps round the end of the buffer) - keep going until it's empty, as the
+		// interrupt doesn't signal us again for data that arrives while we're busy
+		if(evt.status == osEventSignal && (evt.value.signals & XBEE_RX_SIGNAL))
 		{
-			// get the message and increment the counter
-			uint8_t byte = evt.value.v;
-			
-			// feed the packet 1 byte at a time to the xbee packet parser
-			int len = xbee_parse_packet(byte);
-			
-			// if len > 0 then we have a complete packet so dump it to the virtual 
-			// com port
-			if(len > 0)
+			const uint8_t * data;
+			size_t length;
+			while(1)
 			{
-				
-				printf(">> packet received @ %llu s\r\n", systemUptime);
-				
-				// get the packet
-				uint8_t packet[len];
-				get_packet(packet);
-				
-				// display the packet
-				
-						
-				//Packet Processing
-				
-				//Packet is MY command implying new node
-				if(packet[15] == 0x4D && packet[16] == 0x59){
-					static int myId;
-					uint32_t slAddress = packet[9];
-					
-					//itterate to gain SL address and store to first available node
-					for(int j = 10; j < 13; j++){
-						slAddress = slAddress << 8;
-						slAddress = slAddress | packet[j];
-					}
-					node[myId].slAddress = slAddress; 
-					
-					uint16_t myAddress = packet[18];
-					myAddress = myAddress << 8;
-					myAddress = myAddress | packet[19]; 
-					node[myId].myAddress = myAddress;
-					printf("Node %d SL Address = %08X\n", myId, node[myId].slAddress);
-					printf("Node %d Network Address = %04X\n", myId, node[myId].myAddress);
-					//Set all low here
-					myId++;
+				length = xbee_rx_span(&data);
+				if(length > 0)
+				{
+					parse_bytes(data, length);
+					xbee_rx_consume(length);
 				}
-				
-				//IO Data sample RX Indicator Processing
-				if(packet[3] == 0x92){
-					static uint64_t timeCheck;
-					uint16_t myAddress = packet[12];
-					myAddress = myAddress << 8;
-					myAddress = myAddress | packet[13];
-											
-					//Normal Packet
-					if(len >= 28){
-						uptimeCorrection = systemUptime;
-						//Identify array element tied to address
-						int i = 0;
-						for (i = 0; i < arrSize; i++){
-							if (myAddress == node[i].myAddress){
-								break;
-							}
-						}
-						
-						//Pass to another thread to process
-						proc_mail* procValMail = (proc_mail*) osMailAlloc(proc_box, osWaitForever);
-						procValMail->addrArrayElem = i;
-						procValMail->slAddress = node[i].slAddress;
-						procValMail->myAddress = myAddress;
-						
-						procValMail->pirVal = (packet[20] & 0x8)>> 3;
-						
-						uint16_t ldrVal = packet[21];
-						ldrVal = ldrVal << 8;
-						ldrVal = ldrVal | packet[22];
-						procValMail->ldrVal = ldrVal;
-						uint16_t tempVal = packet[23];
-						tempVal = tempVal << 8;
-						tempVal = tempVal | packet[24];
-						procValMail->tempVal = tempVal;
-						osMailPut(proc_box, procValMail);
-					}
-					//Button press
-					else if(len == 22){
-						//Can cause UART 6 ORE flag in rare occasions, in which case reset is required (Until a means to reset ORE flag found)
-						uint8_t buttonCheck = (packet[20] >> 4) & 0x1;
-						//Psuedo debounce to prevent multiple IS packets send on button press
-						if(buttonCheck == 0x0 && systemUptime > timeCheck + 1){
-							printf("sending IS packet when mutex free\n");
-							timeCheck = systemUptime;
-							//Identify array element tied to address
-							int i = 0;
-							for (i = 0; i < arrSize; i++){
-								if (myAddress == node[i].myAddress){
-									break;
-								}
-							}
-							//propogate and send to mail action thread to create and send IS packetosMutexWait(xbee_rx_lock_id, osWaitForever);
-							mail_t* isMail = (mail_t*) osMailAlloc(mail_box, osWaitForever);
-							
-							isMail->isCommand = 1;
-							isMail->acState = 2;
-							isMail->heaterState = 2;
-							isMail->lightState = 2;
-							isMail->slAddress = node[i].slAddress;
-							isMail->myAddress = node[i].myAddress;
-							osMailPut(mail_box, isMail);
-						}
-					}
-				}
-				//IS processing
-				
-				if(packet[15] == 0x49 && packet[16] == 0x53){
+				else if(xbee_rx_error())
+				{
+					// the uart lost some bytes here, so whatever frame we're part way
+					// through is broken - drop it and wait for the next one
+					xbee_parser_resync(&xbee_parser);
 					
-					//Get address
-					uint16_t myAddress = packet[13];
-					myAddress = myAddress << 8;
-					myAddress = myAddress | packet[14];
-					
-					int i = 0;
-					for (i = 0; i < arrSize; i++){
-						if (myAddress == node[i].myAddress){
-							break;
-						}
-					}
-					//Push payload into mailqueue for handling
-					thresh_over_mail* threshValMail = (thresh_over_mail*) osMailAlloc(thresh_over_box, osWaitForever);
-					
-					threshValMail->addrArrayElem = i;
-					//Pot payload in [28]-[29]
-					uint16_t adcPayload = packet[28];
-					adcPayload = adcPayload << 8;
-					adcPayload = adcPayload | packet[29];
-					threshValMail->adcVal = adcPayload;
-					
-					osMailPut(thresh_over_box, threshValMail);
+					uart_error_stats_t errors;
+					xbee_get_uart_errors(&errors);
+					TRACE(UART6_RESYNC, errors.overrun, errors.framing, errors.noise);
+				}
+				else
+				{
+					break;
 				}
 			}
 		}
-		else if (evt.status == osEventTimeout){
-				printf("Something has gone, please reset system\n");
-		}		
 	}
 }
 
+// feed a block of received bytes to the xbee packet parser
+void parse_bytes(const uint8_t* data, size_t length)
+{
+	size_t done = 0;
+	while(done < length)
+	{
+		done += xbee_parse_bytes(&xbee_parser, &data[done], length - done, NULL);
+		
+		// if we have complete packets then process them straight out of the 
+		// parser's ring buffer (and then hand the space back)
+		xbee_frame_t frame;
+		while(xbee_get_frame(&xbee_parser, &frame))
+		{
+			TRACE(PACKET_RECEIVED, (uint32_t)systemUptime);
+			process_packet(xbee_frame_data(&xbee_parser, &frame), frame.length);
+			xbee_release_frame(&xbee_parser);
+		}
+	}
+}
 
-//Set value template packet
-//							|  SH bits  | SL bits  || MY |      |pn|st|chk
-//7E 00 10 17 01 00 13 A2 00 FF FF FF FF FF FE 02 44 32 04 BD
-//
-//SL bits = array elements 9 -> 12
-//MY bits = array elements 13 -> 14
-//pin bits = array element 17 (Light = 35(D5), Heater = 32(D11), AC = 36(D7))
-//set bits = array element 18 (low = 04, high = 05)
-//Checksum = array element 19
+// process a complete xbee api frame (by handing it to the frame decoder, which
+// calls the handler registered for its frame type below)
+void process_packet(const uint8_t* packet, int len)
+{
+	if(xbee_dispatch_frame(packet, len) < 0){
+		TRACE(SHORT_FRAME, packet[3], len);
+	}
+}
 
-void action_thread(void const *argument){
-	uint8_t const hard_Set_Packet[] = {0x7E, 0x00, 0x10, 0x17, 0x01, 0x00, 0x13, 0xA2, 0x00, 
-		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02, 0x44, 0x32, 0x04, 0x00};
+// FRAME HANDLERS
+
+//IO Data sample RX Indicator Processing
+void io_sample_handler(const void *frame)
+{
+	const xbee_io_sample_t *sample = frame;
+	static uint64_t timeCheck;
+	uint16_t myAddress = sample->source_16;
+	
+	//Normal Packet (LDR and temp samples included)
+	if((sample->analog_mask & 0x3) == 0x3){
+		uptimeCorrection = systemUptime;
+		//Identify the node tied to the address
+		node_id_t id = find_node(myAddress, sample->source_64);
+		if(id == NODE_NONE){
+			return;
+		}
+		
+		//Pass to another thread to process
+		proc_mail* procValMail = (proc_mail*) osMailAlloc(proc_box, osWaitForever);
+		procValMail->addrArrayElem = id;
+		procValMail->slAddress = (uint32_t)(sample->source_64 & 0xFFFFFFFF);
+		procValMail->myAddress = myAddress;
+		
+		procValMail->pirVal = (sample->digital_samples & 0x8) >> 3;
+		procValMail->ldrVal = sample->analog[0];
+		procValMail->tempVal = sample->analog[1];
+		osMailPut(proc_box, procValMail);
+	}
+	//Button press (change detect sample, digital only)
+	else if(sample->analog_mask == 0 && sample->digital_mask != 0){
+		//Can cause UART 6 ORE flag in rare occasions - the error is cleared and counted, and the parser resyncs at the next frame
+		uint8_t buttonCheck = (sample->digital_samples >> 4) & 0x1;
+		//Psuedo debounce to prevent multiple IS packets send on button press
+		if(buttonCheck == 0x0 && systemUptime > timeCheck + 1){
+			//Identify the node tied to the address
+			node_id_t id = find_node(myAddress, sample->source_64);
+			if(id == NODE_NONE){
+				return;
+			}
+			TRACE0(SENDING_IS);
+			timeCheck = systemUptime;
+			//propogate and send to mail action thread to create and send IS packet
+			mail_t* isMail = (mail_t*) osMailAlloc(mail_box, osWaitForever);
+			
+			isMail->isCommand = 1;
+			isMail->acState = 2;
+			isMail->heaterState = 2;
+			isMail->lightState = 2;
+			isMail->address = rooms.address[id];
+			isMail->myAddress = myAddress;
+			osMailPut(mail_box, isMail);
+		}
+	}
+}
+
+//Remote AT command responses (MY and IS)
+void remote_at_response_handler(const void *frame)
+{
+	const xbee_remote_at_response_t *response = frame;
+	complete_request(response->frame_id, response->status);
+	
+	//Packet is MY command implying new node
+	if(response->command[0] == 'M' && response->command[1] == 'Y' && response->data_length >= 2){
+		find_node((response->data[0] << 8) | response->data[1], response->source_64);
+	}
+	
+	//IS processing
+	else if(response->command[0] == 'I' && response->command[1] == 'S'){
+		xbee_io_sample_t sample;
+		
+		//Pot is on AD2
+		if(!xbee_decode_io_data(response->data, response->data_length, &sample) || !(sample.analog_mask & 0x4)){
+			TRACE(IS_NO_POT, response->source_16);
+			return;
+		}
+		
+		//Get the node
+		node_id_t id = find_node(response->source_16, response->source_64);
+		if(id == NODE_NONE){
+			return;
+		}
+		//Push payload into mailqueue for handling
+		thresh_over_mail* threshValMail = (thresh_over_mail*) osMailAlloc(thresh_over_box, osWaitForever);
+		
+		threshValMail->addrArrayElem = id;
+		threshValMail->adcVal = sample.analog[2];
+		
+		osMailPut(thresh_over_box, threshValMail);
+	}
+}
+
+//Find the node a frame came from - nodes we've not heard from before are added
+//(and nodes that have rejoined with a new network address are updated) so they
+//can join at any time. returns NODE_NONE if the frame can't be from a node or
+//there's no room for it
+static node_id_t find_node(uint16_t myAddress, uint64_t serial){
+	int change;
+	node_id_t id = node_discovery_heard(&discovery, serial, myAddress, (uint32_t)systemUptime,
+		&change);
+	return node_heard(id, change, myAddress, serial);
+}
+
+//Set up a node discovery has just told us about (giving new rooms the default
+//thresholds, and working out the address to send them commands on)
+static node_id_t node_heard(node_id_t id, int change, uint16_t myAddress, uint64_t serial){
+	if(id == NODE_NONE){
+		if(nodes.free_count == 0 && nodes.count == NODE_REGISTRY_SIZE){
+			TRACE(NODE_TABLE_FULL, (uint32_t)(serial & 0xFFFFFFFF));
+		}
+		else{
+			TRACE(UNKNOWN_NODE, myAddress, (uint32_t)(serial & 0xFFFFFFFF));
+		}
+		return NODE_NONE;
+	}
+	
+	if(change == NODE_HEARD_NEW){
+		rooms.upperHeatThreshold[id] = 18;
+		rooms.lowerHeatThreshold[id] = 17;
+		rooms.lightThreshold[id] = 40;
+		rooms.heatingOverride[id] = 0;
+		rooms.lightOverride[id] = 0;
+		rooms.acOverride[id] = 0;
+		rooms.overrideChangeCheck[id] = 0;
+		rooms.prevPirLevel[id] = 0;
+		rooms.currentPirLevel[id] = 0;
+		rooms.tempChangeCheck[id] = 0;
+		rooms.lightChangeCheck[id] = 0;
+		rooms.threshFlag[id] = 0;
+		rooms.selector[id] = 0;
+	}
+	
+	if(change != NODE_HEARD_KNOWN){
+		//Work out the address (and its checksum) once, ready for sending commands
+		xbee_address_init(&rooms.address[id], serial, myAddress);
+		TRACE(NODE_SL_ADDRESS, id, (uint32_t)(serial & 0xFFFFFFFF));
+		TRACE(NODE_MY_ADDRESS, id, myAddress);
+	}
+	
+	//Give new rooms back the settings they had (saving the defaults if we've not
+	//seen them before), and keep the saved network address up to date
+	if(change == NODE_HEARD_NEW){
+		restore_room(id);
+	}
+	else if(change == NODE_HEARD_MOVED){
+		save_room(id);
+	}
+	return id;
+}
+
+//Put a room's saved settings back (overrides that were on get turned back on)
+static void restore_room(node_id_t id){
+	room_config_t saved;
+	int length = CONFIG_STORE_NOT_FOUND;
+	
+	if(config_ok){
+		osMutexWait(config_lock_id, osWaitForever);
+		length = config_store_get(&config, (uint32_t)nodes.serial[id], &saved, sizeof(saved));
+		osMutexRelease(config_lock_id);
+	}
+	if(length != sizeof(saved) || saved.serial != nodes.serial[id]){
+		save_room(id);
+		return;
+	}
+	
+	rooms.upperHeatThreshold[id] = saved.upperHeatThreshold;
+	rooms.lowerHeatThreshold[id] = saved.lowerHeatThreshold;
+	rooms.lightThreshold[id] = saved.lightThreshold;
+	rooms.lightOverride[id] = (saved.overrides & SAVED_LIGHT_OVERRIDE) != 0;
+	rooms.heatingOverride[id] = (saved.overrides & SAVED_HEATING_OVERRIDE) != 0;
+	rooms.acOverride[id] = (saved.overrides & SAVED_AC_OVERRIDE) != 0;
+	TRACE(ROOM_RESTORED, id, (uint32_t)(nodes.serial[id] & 0xFFFFFFFF));
+	
+	//The same outputs as turning the overrides on from the buttons
+	if(saved.overrides != 0){
+		mail_t* overrideMail = (mail_t*) osMailAlloc(mail_box, 0);
+		if(overrideMail != NULL){
+			overrideMail->isCommand = 0;
+			overrideMail->address = rooms.address[id];
+			overrideMail->myAddress = nodes.my_address[id];
+			overrideMail->lightState = rooms.lightOverride[id] ? 1 : 2;
+			overrideMail->heaterState = rooms.heatingOverride[id] ? 1 : (rooms.acOverride[id] ? 0 : 2);
+			overrideMail->acState = rooms.acOverride[id] ? 1 : (rooms.heatingOverride[id] ? 0 : 2);
+			osMailPut(mail_box, overrideMail);
+		}
+	}
+	
+	//Save it again if it's moved since
+	if(saved.myAddress != nodes.my_address[id]){
+		save_room(id);
+	}
+}
+
+//Ask the config thread to save a room's settings (if the queue is full the
+//change is lost, but the next one for the room saves everything again)
+static void save_room(node_id_t id){
+	if(!config_ok){
+		return;
+	}
+	room_config_t* room = (room_config_t*) osMailAlloc(config_box, 0);
+	if(room == NULL){
+		TRACE(ROOM_NOT_SAVED, id);
+		return;
+	}
+	memset(room, 0, sizeof(room_config_t));
+	room->serial = nodes.serial[id];
+	room->myAddress = nodes.my_address[id];
+	room->upperHeatThreshold = rooms.upperHeatThreshold[id];
+	room->lowerHeatThreshold = rooms.lowerHeatThreshold[id];
+	room->lightThreshold = rooms.lightThreshold[id];
+	room->overrides = (rooms.lightOverride[id] ? SAVED_LIGHT_OVERRIDE : 0) |
+		(rooms.heatingOverride[id] ? SAVED_HEATING_OVERRIDE : 0) |
+		(rooms.acOverride[id] ? SAVED_AC_OVERRIDE : 0);
+	osMailPut(config_box, room);
+}
+
+//Forget any nodes that have gone quiet, and ask the action thread to send a
+//node discover sweep when one is due (this runs in the rx thread, as that's
+//the only thread that changes the registry)
+static void check_discovery(void){
+	uint32_t now = (uint32_t)systemUptime;
+	node_id_t id;
+	
+	while((id = node_discovery_expire(&discovery, now)) != NODE_NONE){
+		TRACE(NODE_EXPIRED, id, (uint32_t)(nodes.serial[id] & 0xFFFFFFFF));
+	}
+	
+	if(!sweep_pending && node_discovery_sweep_due(&discovery, now)){
+		mail_t* sweepMail = (mail_t*) osMailAlloc(mail_box, 0);
+		if(sweepMail != NULL){
+			sweepMail->isCommand = 3;
+			sweep_pending = 1;
+			osMailPut(mail_box, sweepMail);
+		}
+	}
+}
+
+//Wake the rx thread up to look after discovery
+void discovery_tick(void const *arg){
+	osSignalSet(tid_xbee_rx_thread, DISCOVERY_SIGNAL);
+}
+
+//Local AT command responses
+void at_response_handler(const void *frame)
+{
+	const xbee_at_response_t *response = frame;
+	
+	//Node discover responses (one for each node that answers, so these don't
+	//complete a request)
+	if(response->command[0] == 'N' && response->command[1] == 'D'){
+		if(response->status == 0 && response->data_length > 0){
+			int change;
+			node_id_t id = node_discovery_nd_response(&discovery, response->data,
+				response->data_length, (uint32_t)systemUptime, &change);
+			if(id != NODE_NONE){
+				node_heard(id, change, nodes.my_address[id], nodes.serial[id]);
+			}
+		}
+		return;
+	}
+	
+	complete_request(response->frame_id, response->status);
+	if(response->status != 0){
+		TRACE(AT_FAILED, response->command[0], response->command[1], response->status);
+	}
+}
+
+//Transmit status
+void tx_status_handler(const void *frame)
+{
+	const xbee_tx_status_t *status = frame;
+	complete_request(status->frame_id, status->delivery_status);
+	if(status->delivery_status != 0){
+		TRACE(TX_FAILED, status->dest_16, status->delivery_status);
+	}
+}
+
+//Send everything waiting in the batch, and resend anything that hasn't been
+//answered in time (holding the xbee lock while we do)
+void flush_actuation(xbee_actuation_batch_t *batch){
+	osMutexWait(xbee_rx_lock_id, osWaitForever); 
+	TRACE0(SEND_LOCKED);
+	int num_nodes = batch->num_pending;
+	int frames = xbee_actuation_flush(batch, send_frame);
+	
+	//Resend anything that hasn't been answered - sending can block if the
+	//transmit queue is full, so the table is only locked while we find them
+	//(otherwise the rx thread couldn't match up responses in the meantime)
+	retry_pending = 0;
+	num_resends = 0;
+	osMutexWait(xbee_request_lock_id, osWaitForever);
+	xbee_request_poll(&xbee_requests, osKernelSysTick(), collect_resend);
+	osMutexRelease(xbee_request_lock_id);
+	int resent;
+	for(resent = 0; resent < num_resends; resent++){
+		send_xbee(resend_frames[resent], resend_lengths[resent]);
+	}
+	
+	//Node discover sweep (the responses trickle in over the next few seconds, so
+	//this isn't tracked like the other commands)
+	if(sweep_pending){
+		uint8_t frame[XBEE_MAX_TX_FRAME];
+		int length = xbee_build_local_at(frame, sizeof(frame), DISCOVERY_FRAME_ID, "ND", NULL, 0);
+		send_xbee(frame, length);
+		sweep_pending = 0;
+		TRACE0(ND_SWEEP);
+	}
+	
+	osMutexRelease(xbee_rx_lock_id);
+	
+	xbee_tx_stats_t tx_stats;
+	uint32_t tx_depth;
+	xbee_tx_get_stats(&tx_stats, &tx_depth);
+	TRACE(SENT_COMMANDS, frames, num_nodes, resent);
+	ITM_SEND(ITM_CH_ACTUATION, ITM_EV_FLUSH, frames, num_nodes, resent);
+	TRACE(TX_QUEUE_STATS, tx_depth, tx_stats.high_water, tx_stats.full);
+	ITM_SEND(ITM_CH_METRICS, ITM_EV_TX_QUEUE, tx_depth, tx_stats.high_water, tx_stats.full);
+	
+	log_ring_stats_t log_stats;
+	vcom_get_log_stats(&log_stats);
+	TRACE(VCOM_STATS, log_stats.high_water, log_stats.dropped, log_stats.overwritten, log_stats.blocked);
+	ITM_SEND(ITM_CH_METRICS, ITM_EV_VCOM_OUTPUT, log_stats.high_water, log_stats.dropped, 
+		log_stats.overwritten);
+	
+	uart_error_stats_t vcom_errors;
+	vcom_get_uart_errors(&vcom_errors);
+	TRACE(VCOM_UART_ERRORS, vcom_errors.overrun, vcom_errors.framing, vcom_errors.noise, 
+		vcom_errors.dma);
+	ITM_SEND(ITM_CH_METRICS, ITM_EV_VCOM_ERRORS, vcom_errors.overrun, vcom_errors.framing, 
+		vcom_errors.noise, vcom_errors.dma);
+	
+	uart_error_stats_t errors;
+	xbee_get_uart_errors(&errors);
+	ITM_SEND(ITM_CH_METRICS, ITM_EV_UART_ERRORS, errors.overrun, errors.framing, errors.noise);
+	
+	//The parser belongs to the rx thread, but its counters are only ever added
+	//to, so a copy that's slightly behind is fine here
+	xbee_parser_stats_t parser_stats;
+	xbee_get_stats(&xbee_parser, &parser_stats);
+	TRACE(PARSER_STATS, parser_stats.bad_checksums, parser_stats.resyncs, 
+		parser_stats.dropped_bytes);
+	ITM_SEND(ITM_CH_METRICS, ITM_EV_PARSER_STATS, parser_stats.bad_checksums, 
+		parser_stats.resyncs, parser_stats.dropped_bytes);
+	
+#if XBEE_RX_DMA
+	uint32_t dma_events, dma_overruns;
+	xbee_get_dma_stats(&dma_events, &dma_overruns);
+	TRACE(RX_DMA_STATS, dma_events, dma_overruns);
+	ITM_SEND(ITM_CH_METRICS, ITM_EV_RX_DMA, dma_events, dma_overruns);
+#endif
+	
+#if XBEE_FLOW_CONTROL
+	uint32_t rts_stops, rx_high_water;
+	xbee_get_flow_stats(&rts_stops, &rx_high_water);
+	TRACE(RX_FLOW_STATS, rx_high_water, rts_stops);
+#endif
+}
+
+//Send a frame, keeping track of it if it should get a response
+void send_frame(uint8_t *frame, int length){
+	track_frame(frame, length);
+	send_xbee(frame, length);
+}
+
+//Send a frame that stays put (like the sampling packets main.c builds at start
+//up) from where it is, rather than copying it into the transmit queue -
+//in_flight is set until the uart has sent it, and if it's still set when the
+//frame is sent again we send a copy instead (tracking rewrites the frame id
+//in place, which mustn't happen while the dma is reading it)
+void send_prebuilt_frame(uint8_t *frame, int length, volatile uint8_t *in_flight){
+	if(*in_flight){
+		uint8_t copy[XBEE_MAX_TX_FRAME];
+		if(length > XBEE_MAX_TX_FRAME){
+			return;
+		}
+		memcpy(copy, frame, length);
+		send_frame(copy, length);
+		return;
+	}
+	
+	track_frame(frame, length);
+	*in_flight = 1;
+	if(xbee_queue_frame(frame, length, prebuilt_frame_sent, (void *)in_flight) == 0){
+		*in_flight = 0;
+	}
+}
+
+//A prebuilt frame has gone (called from the uart interrupt)
+static void prebuilt_frame_sent(const uint8_t *frame, int length, void *context){
+	*(volatile uint8_t *)context = 0;
+}
+
+//Give a frame a frame id and keep track of it, if it should get a response (a
+//frame id of 0 means the xbee won't send one)
+static void track_frame(uint8_t *frame, int length){
+	if(frame[4] != 0){
+		osMutexWait(xbee_request_lock_id, osWaitForever);
+		xbee_request_track(&xbee_requests, frame, length, osKernelSysTick(), request_done, NULL);
+		osMutexRelease(xbee_request_lock_id);
+	}
+}
+
+//Keep a copy of a frame that needs resending (it's already being tracked)
+static void collect_resend(uint8_t *frame, int length){
+	memcpy(resend_frames[num_resends], frame, length);
+	resend_lengths[num_resends++] = length;
+}
+
+//Match a response up with the command that it answers
+void complete_request(uint8_t frame_id, uint8_t status){
+	osMutexWait(xbee_request_lock_id, osWaitForever);
+	xbee_request_complete(&xbee_requests, frame_id, status, osKernelSysTick());
+	osMutexRelease(xbee_request_lock_id);
+}
+
+//Send a local at command and wait (for up to timeout ms) for the answer -
+//returns the status from the response, or -1 if it didn't come
+int xbee_at_command(const char *command, const uint8_t *param, int length, uint32_t timeout){
+	uint8_t frame[XBEE_MAX_TX_FRAME];
+	int frame_length = xbee_build_local_at(frame, sizeof(frame), 0x01, command, param, length);
+	osThreadId self = osThreadGetId();
 	
-	uint8_t template_Dig_Out[20] = {0};
+	osMutexWait(xbee_request_lock_id, osWaitForever);
+	uint8_t frame_id = xbee_request_track(&xbee_requests, frame, frame_length, osKernelSysTick(), 
+		at_command_done, self);
+	osMutexRelease(xbee_request_lock_id);
+	if(frame_id == 0){
+		return -1;
+	}
 	
+	osSignalClear(self, XBEE_AT_SIGNAL);
+	send_xbee(frame, frame_length);
+	osEvent evt = osSignalWait(XBEE_AT_SIGNAL, timeout);
+	if(evt.status != osEventSignal){
+		//Give up on it ourselves (rather than letting it be resent)
+		osMutexWait(xbee_request_lock_id, osWaitForever);
+		xbee_request_cancel(&xbee_requests, frame_id);
+		osMutexRelease(xbee_request_lock_id);
+		return -1;
+	}
+	return (at_command_status == XBEE_REQUEST_TIMED_OUT) ? -1 : at_command_status;
+}
+
+//Wake up the thread waiting for an at command
+static void at_command_done(uint8_t frame_id, uint8_t status, uint32_t latency, void *context){
+	at_command_status = status;
+	osSignalSet((osThreadId)context, XBEE_AT_SIGNAL);
+}
+
+//Called when a command is answered, or when we give up on it
+void request_done(uint8_t frame_id, uint8_t status, uint32_t latency, void *context){
+	ITM_SEND(ITM_CH_SCHEDULER, ITM_EV_REQUEST_DONE, frame_id, status, latency);
+	if(status == XBEE_REQUEST_TIMED_OUT){
+		TRACE(REQUEST_UNANSWERED, frame_id);
+	}
+	else if(status != 0){
+		TRACE(REQUEST_FAILED, frame_id, status);
+	}
+}
+
+//Check whether anything needs resending (this runs in the timer thread, so it
+//mustn't block - if the table is busy we just check again next time) and if
+//so wake the action thread up to do it
+void check_requests(void const *arg){
+	if(retry_pending || osMutexWait(xbee_request_lock_id, 0) != osOK){
+		return;
+	}
+	int due = xbee_request_due(&xbee_requests, osKernelSysTick());
+	osMutexRelease(xbee_request_lock_id);
 	
-	uint8_t lightPin = 0x35, heaterPin = 0x31, acPin = 0x37, dPrefix = 0x44, pPrefix = 0x50;
-	uint8_t setLow = 0x4, setHigh = 0x5;
+	if(due){
+		ITM_SEND(ITM_CH_SCHEDULER, ITM_EV_RETRY_DUE, due);
+		mail_t* retryMail = (mail_t*) osMailAlloc(mail_box, 0);
+		if(retryMail != NULL){
+			retryMail->isCommand = 2;
+			retry_pending = 1;
+			osMailPut(mail_box, retryMail);
+		}
+	}
+}
+
+void action_thread(void const *argument){
+	static xbee_actuation_batch_t batch;
+	xbee_actuation_init(&batch);
 	
 	while(1){
 		//idle until action event
 		osEvent evt = osMailGet(mail_box, osWaitForever);
-		osMutexWait(xbee_rx_lock_id, osWaitForever); 
-		if(evt.status == osEventMail){
+		
+		//add it to the batch, along with anything else that turns up within the
+		//scheduling window (if batching is turned off we only pick up what is 
+		//already waiting)
+		while(evt.status == osEventMail){
 			mail_t *mail = (mail_t*)evt.value.p;
 			
+			//the request timer just wants us to resend things, or the rx thread
+			//wants a discovery sweep (which we do when we send the batch)
+			if(mail->isCommand == 2 || mail->isCommand == 3){
+				osMailFree(mail_box, mail);
+				break;
+			}
 			
-			printf("Mutex grabbed for sending \n");
 			/*
 			Three states - 	0 = turn off
 											1 = turn on
 											2 = don't care / do nothing
 			*/
+			uint8_t state[NUM_OUTPUTS] = {OUTPUT_NO_CHANGE, OUTPUT_NO_CHANGE, OUTPUT_NO_CHANGE};
 			
-			//send DIO command
+			//DIO command
 			if(mail->isCommand == 0){
-				//Create packet
-				for (int i = 0; i < 20; i++){
-					template_Dig_Out[i] = hard_Set_Packet[i];
-				}
-
-					//Set SH
-					
-					template_Dig_Out[9] = (0xFF000000 & mail->slAddress) >> 24;
-					template_Dig_Out[10] = (0x00FF0000 & mail->slAddress) >> 16;
-					template_Dig_Out[11] = (0x0000FF00 & mail->slAddress) >> 8;
-					template_Dig_Out[12] = (0x000000FF & mail->slAddress);
-					
-					//Set MY
-					template_Dig_Out[13] = (0xFF00 & mail->myAddress) >> 8;
-					template_Dig_Out[14] = (0xFF & mail->myAddress);
-					
-					//Send Light
-					if(mail->lightState != 2){
-						printf("Turning light pin ");
-						//set pin
-						template_Dig_Out[16] = dPrefix;
-						template_Dig_Out[17] = lightPin;
-						//set pin state based on passed value
-						if (mail->lightState == 0){
-							template_Dig_Out[18] = setLow;
-							printf("off ");
-						}
-						else if(mail->lightState == 1){
-							template_Dig_Out[18] = setHigh;
-							printf("on ");
-						}
-						
-						printf("for net addr = %02X%02X\n", template_Dig_Out[13], template_Dig_Out[14]);
-						//set checksum
-						uint16_t checksum = 0;
-						//itterate through values
-						for (int i = 3; i < 19; i++){
-							checksum = checksum + template_Dig_Out[i];
-						}
-
-						//strip down to 8 bit number
-						checksum = checksum & 0xff;
-						template_Dig_Out[19] = 0xFF - checksum;
-						
-						printf("sending: ");
-						for(int i = 0; i < 20; i++){
-							printf("%02X ", template_Dig_Out[i]);
-						}
-						printf("\r\n");
-						
-						send_xbee(template_Dig_Out, 20);
-					}
-									
-					//Send Heater
-					if(mail->heaterState != 2){
-						printf("Turning heat pin ");
-						//set pin
-						template_Dig_Out[16] = pPrefix;
-						template_Dig_Out[17] = heaterPin;
-						//set pin state based on passed value
-						if (mail->heaterState == 0){
-							template_Dig_Out[18] = setLow;
-							printf("off ");
-						}
-						else if(mail->heaterState == 1){
-							template_Dig_Out[18] = setHigh;
-							printf("on ");
-						}
-						
-						printf("for net addr = %02X%02X\n", template_Dig_Out[13], template_Dig_Out[14]);
-						//set checksum
-						uint16_t checksum = 0;
-						//itterate through values
-						for (int i = 3; i < 19; i++){
-							checksum = checksum + template_Dig_Out[i];
-						}
-						
-						//strip down to 8 bit number
-						checksum = checksum & 0xff;
-						template_Dig_Out[19] = 0xFF - checksum;
-						
-						printf("sending: ");
-						for(int i = 0; i < 20; i++){
-							printf("%02X ", template_Dig_Out[i]);
-						}
-						printf("\r\n");
-						send_xbee(template_Dig_Out, 20);
-					}
-					
-					//Send Heater
-					if(mail->acState != 2){
-						printf("Turning ac pin ");
-						//set pin
-						template_Dig_Out[16] = dPrefix;
-						template_Dig_Out[17] = acPin;
-						//set pin state based on passed value
-						if (mail->acState == 0){
-							template_Dig_Out[18] = setLow;
-							printf("off ");
-						}
-						else if(mail->acState == 1){
-							template_Dig_Out[18] = setHigh;
-							printf("on ");
-						}
-						
-						printf("for net addr = %02X%02X\n", template_Dig_Out[13], template_Dig_Out[14]);
-						//set checksum
-						uint16_t checksum = 0;
-						//itterate through values
-						for (int i = 3; i < 19; i++){
-							checksum = checksum + template_Dig_Out[i];
-						}
-						
-						//strip down to 8 bit number
-						checksum = checksum & 0xff;
-						template_Dig_Out[19] = 0xFF - checksum;
-						
-						printf("sending: ");
-						for(int i = 0; i < 20; i++){
-							printf("%02X ", template_Dig_Out[i]);
-						}
-						printf("\r\n");
-						
-						send_xbee(template_Dig_Out, 20);
-				}
+				state[OUTPUT_LIGHT] = mail->lightState;
+				state[OUTPUT_HEATER] = mail->heaterState;
+				state[OUTPUT_AC] = mail->acState;
 			}
-			//send IS packet
-			else if(mail->isCommand == 1){
-				for (int i = 0; i < 19; i++){
-					template_Dig_Out[i] = hard_Set_Packet[i];
-				}
-				
-				//Set length
-				template_Dig_Out[2] = 0x0F;
-				
-				//set SL
-				template_Dig_Out[9] = (0xFF000000 & mail->slAddress) >> 24;
-				template_Dig_Out[10] = (0x00FF0000 & mail->slAddress) >> 16;
-				template_Dig_Out[11] = (0x0000FF00 & mail->slAddress) >> 8;
-				template_Dig_Out[12] = (0x000000FF & mail->slAddress);
-				
-				//Set MY
-				template_Dig_Out[13] = (0xFF00 & mail->myAddress) >> 8;
-				template_Dig_Out[14] = (0xFF & mail->myAddress);
-				
-				template_Dig_Out[16] = 0x49;
-				template_Dig_Out[17] = 0x53;
-				uint16_t checksum = 0;
-				
-				//itterate through values
-				for (int i = 3; i < 18; i++){
-					checksum = checksum + template_Dig_Out[i];
-				}
-				
-				//strip down to 8 bit number
-				checksum = checksum & 0xff;
-				template_Dig_Out[18] = 0xFF - checksum;
-				
-				printf("sending: ");
-				for(int i = 0; i < 19; i++){
-					printf("%02X ", template_Dig_Out[i]);
-				}
-				printf("\r\n");
-				
-				send_xbee(template_Dig_Out, 19);
+			
+			//if there are changes for too many nodes waiting, send them now
+			if(!xbee_actuation_add(&batch, &mail->address, mail->myAddress, state, mail->isCommand == 1)){
+				flush_actuation(&batch);
+				xbee_actuation_add(&batch, &mail->address, mail->myAddress, state, mail->isCommand == 1);
 			}
 			osMailFree(mail_box, mail);
-			osMutexRelease(xbee_rx_lock_id);
-			printf("mutex released from sending func\n");
+			
+#if XBEE_ACTUATION_BATCHING
+			evt = osMailGet(mail_box, XBEE_ACTUATION_WINDOW);
+#else
+			evt = osMailGet(mail_box, 0);
+#endif
 		}
+		
+		flush_actuation(&batch);
 	}
 }
 
@@ -647,8 +1040,9 @@ void poll_Button_Inputs(void const *arg){
 				if(armingVar == 0){
 					//Turn off arming system
 					osMutexWait(thresh_over_state_id, osWaitForever);
-					for (int j = 0; j < arrSize; j++){
-						node[j].overrideChangeCheck = 1;
+					for (int j = 0; j < nodes.count; j++){
+						//(setting this for ids that aren't in use doesn't matter)
+						rooms.overrideChangeCheck[j] = 1;
 					}
 					timeTillArm = 10;
 					printf("Disarming System Now!\r\n");
@@ -680,29 +1074,18 @@ void poll_Button_Inputs(void const *arg){
 }
 
 void process_ir_thread(void const *argument){
-	static uint8_t prevPirLevel[4];
-	static uint8_t currentPirLevel[4];
-	static uint8_t tempChangeCheck[4];
-	static uint8_t lightChangeCheck[4];
-	
-	for (int i = 0; i < 4; i++){
-		prevPirLevel[i] = 0;
-		currentPirLevel[i] = 0;
-		tempChangeCheck[i] = 0;
-		lightChangeCheck[i] = 0;
-	}
-		
 	while(1){
 		osEvent evt = osMailGet(proc_box, osWaitForever);
 			
 		if(evt.status == osEventMail){
 			proc_mail *procValMail = (proc_mail*)evt.value.p;
+			node_id_t id = procValMail->addrArrayElem;
 			
 			//Process Values
 			//Store pir
-			prevPirLevel[procValMail->addrArrayElem] = prevPirLevel[procValMail->addrArrayElem]  << 1;
-			prevPirLevel[procValMail->addrArrayElem] = currentPirLevel[procValMail->addrArrayElem] | prevPirLevel[procValMail->addrArrayElem];
-			currentPirLevel[procValMail->addrArrayElem] = procValMail->pirVal;
+			rooms.prevPirLevel[id] = rooms.prevPirLevel[id]  << 1;
+			rooms.prevPirLevel[id] = rooms.currentPirLevel[id] | rooms.prevPirLevel[id];
+			rooms.currentPirLevel[id] = procValMail->pirVal;
 			
 			//Evaluate Light
 			float lightVal = procValMail->ldrVal;
@@ -714,10 +1097,10 @@ void process_ir_thread(void const *argument){
 			float tempVal = procValMail->tempVal;
 			tempVal = tempVal * (1200.0 / 1023.0);
 			tempVal = (tempVal - 500.0) / 10.0;
-			printf("Node address: %02X\n",node[procValMail->addrArrayElem].myAddress);
-			printf("Time: %llu s\n",systemUptime);
-			printf("Current PIR:%d, Prev PIR:%d\n",currentPirLevel[procValMail->addrArrayElem], prevPirLevel[procValMail->addrArrayElem]);
-			printf("Light: %f, Temp: %f\n",lightVal, tempVal); 
+			TRACE(SAMPLE_NODE, nodes.my_address[id]);
+			TRACE(SAMPLE_TIME, (uint32_t)systemUptime);
+			TRACE(SAMPLE_PIR, rooms.currentPirLevel[id], rooms.prevPirLevel[id]);
+			TRACE(SAMPLE_VALUES, TRACE_FLOAT(lightVal), TRACE_FLOAT(tempVal));
 			
 			/*Post to display*//*
 			display_mail* displayMail = (display_mail*)osMailAlloc(display_box, osWaitForever);
@@ -732,16 +1115,19 @@ void process_ir_thread(void const *argument){
 				if(doArmedOnce == 0){
 					doArmedOnce = 1;
 					//Reset PIR
-					for (int i = 0; i < 2; i++){
-						prevPirLevel[i] = 0;
-						currentPirLevel[i] = 0;
+					for (int i = 0; i < nodes.count; i++){
+						if(!nodes.in_use[i]){
+							continue;
+						}
+						rooms.prevPirLevel[i] = 0;
+						rooms.currentPirLevel[i] = 0;
 						mail_t* armedMail = (mail_t*) osMailAlloc(mail_box, osWaitForever);
 						
 						//Change to broadcast?
 						//Turn off all pins
 						armedMail->isCommand = 0;
-						armedMail->slAddress = node[i].slAddress;
-						armedMail->myAddress = node[i].myAddress;
+						armedMail->address = rooms.address[i];
+						armedMail->myAddress = nodes.my_address[i];
 						armedMail->acState = 0;
 						armedMail->heaterState = 0;
 						armedMail->lightState = 0;
@@ -749,8 +1135,8 @@ void process_ir_thread(void const *argument){
 						}
 					doAlertOnce = 1;
 				}
-				if(currentPirLevel[procValMail->addrArrayElem] == 1 && doAlertOnce == 1){
-					printf("!!intruder Alert!!\r\n");
+				if(rooms.currentPirLevel[id] == 1 && doAlertOnce == 1){
+					TRACE0(INTRUDER_ALERT);
 					doAlertOnce = 0;
 					write_gpio(alarmOutput, 1);
 				}
@@ -759,52 +1145,52 @@ void process_ir_thread(void const *argument){
 				uint8_t heaterState = 0, acState = 0, lightState = 0;
 				osMutexWait(thresh_over_state_id, osWaitForever);
 				//Reset change checks as override has been turned off so need to ensure states haven't changed
-				if(node[procValMail->addrArrayElem].overrideChangeCheck == 1){
-					lightChangeCheck[procValMail->addrArrayElem] = 0;
-					tempChangeCheck[procValMail->addrArrayElem] = 0;
-					node[procValMail->addrArrayElem].overrideChangeCheck = 0;
+				if(rooms.overrideChangeCheck[id] == 1){
+					rooms.lightChangeCheck[id] = 0;
+					rooms.tempChangeCheck[id] = 0;
+					rooms.overrideChangeCheck[id] = 0;
 				}
 				//Process based on Light
-				if(node[procValMail->addrArrayElem].lightOverride == 0){
+				if(rooms.lightOverride[id] == 0){
 					//Someone has entered or room is occupied
-					if(currentPirLevel[procValMail->addrArrayElem] == 1){
+					if(rooms.currentPirLevel[id] == 1){
 						//Room is occupied
-						if((prevPirLevel[procValMail->addrArrayElem] & 0x1) == 1){
-							printf("The room is occupied ");
-							if(lightVal < node[procValMail->addrArrayElem].lightThreshold){
-								if(lightChangeCheck[procValMail->addrArrayElem] == 0){	
-									printf("and the light is too low so turning the lights on.\n");
+						if((rooms.prevPirLevel[id] & 0x1) == 1){
+							TRACE0(ROOM_OCCUPIED);
+							if(lightVal < rooms.lightThreshold[id]){
+								if(rooms.lightChangeCheck[id] == 0){	
+									TRACE0(LIGHT_LOW_ON);
 									lightState = 1;
-									lightChangeCheck[procValMail->addrArrayElem] = 1;
+									rooms.lightChangeCheck[id] = 1;
 								}
 								else
 								{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									lightState = 2;
 								}
 							}
 							else{
-								if(lightChangeCheck[procValMail->addrArrayElem] == 1){
-									printf("and the light is too high so turning the lights off\n");
+								if(rooms.lightChangeCheck[id] == 1){
+									TRACE0(LIGHT_HIGH_OFF);
 									lightState = 0;
-									lightChangeCheck[procValMail->addrArrayElem] = 0;
+									rooms.lightChangeCheck[id] = 0;
 								}
 								else{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									lightState = 2;
 								}
 							}
 						}
 						//Someone has entered
 						else{
-							printf("Someone has entered the room ");
-							if(lightVal < node[procValMail->addrArrayElem].lightThreshold){
-									printf("and the light is too low so turning the lights on.\n");
-									lightChangeCheck[procValMail->addrArrayElem] = 1;
+							TRACE0(ROOM_ENTERED);
+							if(lightVal < rooms.lightThreshold[id]){
+									TRACE0(LIGHT_LOW_ON);
+									rooms.lightChangeCheck[id] = 1;
 									lightState = 1;
 								}
 								else{
-									printf("light is too high so don't need to turn the lights on.\n");
+									TRACE0(LIGHT_HIGH_STAY_OFF);
 									lightState = 2;
 								}
 						}
@@ -812,41 +1198,41 @@ void process_ir_thread(void const *argument){
 					//Someone has left or room is empty
 					else{
 						//Room is vacant
-						if((prevPirLevel[procValMail->addrArrayElem] | 0x0) == 0){
-							printf("The room is vacant ");
-							if(lightChangeCheck[procValMail->addrArrayElem] == 1){
-									printf("so turning lights off.\n");
+						if((rooms.prevPirLevel[id] | 0x0) == 0){
+							TRACE0(ROOM_VACANT);
+							if(rooms.lightChangeCheck[id] == 1){
+									TRACE0(LIGHTS_OFF);
 									lightState = 0;
-									lightChangeCheck[procValMail->addrArrayElem] = 0;
+									rooms.lightChangeCheck[id] = 0;
 								}
 								else{
-									printf("and the lights are already off.\n");
+									TRACE0(LIGHTS_ALREADY_OFF);
 									lightState = 2;
 								}
 						}
 						//Someone has left
 						else{
-							printf("Someone has left or is idle in the room ");
-							if(lightVal < node[procValMail->addrArrayElem].lightThreshold){
-								if(lightChangeCheck[procValMail->addrArrayElem] == 0){	
-									printf("and the light is too low so turning the lights on.\n");
+							TRACE0(ROOM_LEFT);
+							if(lightVal < rooms.lightThreshold[id]){
+								if(rooms.lightChangeCheck[id] == 0){	
+									TRACE0(LIGHT_LOW_ON);
 									lightState = 1;
-									lightChangeCheck[procValMail->addrArrayElem] = 1;
+									rooms.lightChangeCheck[id] = 1;
 								}
 								else
 								{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									lightState = 2;
 								}
 							}
 							else{
-								if(lightChangeCheck[procValMail->addrArrayElem] == 1){
-									printf("and the light is too high so turning the lights off\n");
+								if(rooms.lightChangeCheck[id] == 1){
+									TRACE0(LIGHT_HIGH_OFF);
 									lightState = 0;
-									lightChangeCheck[procValMail->addrArrayElem] = 0;
+									rooms.lightChangeCheck[id] = 0;
 								}
 								else{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									lightState = 2;
 								}
 							}
@@ -854,58 +1240,58 @@ void process_ir_thread(void const *argument){
 					}
 				}
 				else{
-					printf("override enabled\n");
+					TRACE0(OVERRIDE_ENABLED);
 					lightState = 2;
 				}
 				//Process based on Temp
-				if(node[procValMail->addrArrayElem].heatingOverride == 0 && node[procValMail->addrArrayElem].acOverride == 0){
+				if(rooms.heatingOverride[id] == 0 && rooms.acOverride[id] == 0){
 					//Someone has entered or room is occupied
-					if(currentPirLevel[procValMail->addrArrayElem] == 1){
+					if(rooms.currentPirLevel[id] == 1){
 						//Room is occupied
-						if((prevPirLevel[procValMail->addrArrayElem] & 0x1) == 1){
-							printf("The room is occupied ");
+						if((rooms.prevPirLevel[id] & 0x1) == 1){
+							TRACE0(ROOM_OCCUPIED);
 							//Room too cold
-							if(tempVal < node[procValMail->addrArrayElem].lowerHeatThreshold){
+							if(tempVal < rooms.lowerHeatThreshold[id]){
 								//Turning heater on from being off
-								if(tempChangeCheck[procValMail->addrArrayElem] == 0){
-									printf("and the temp is too low so turning the heating on.\n");
+								if(rooms.tempChangeCheck[id] == 0){
+									TRACE0(TEMP_LOW_HEAT_ON);
 									heaterState = 1;
 									acState = 2;
-									tempChangeCheck[procValMail->addrArrayElem] = 1;
+									rooms.tempChangeCheck[id] = 1;
 								}
 								//Turning heater on from being on AC
-								else if(tempChangeCheck[procValMail->addrArrayElem] == 2){
-									printf("and the temp is too low so turning the AC off and the heating on.\n");
+								else if(rooms.tempChangeCheck[id] == 2){
+									TRACE0(TEMP_LOW_SWAP_TO_HEAT);
 									heaterState = 1;
 									acState = 0;
-									tempChangeCheck[procValMail->addrArrayElem] = 1;
+									rooms.tempChangeCheck[id] = 1;
 								}
 								//Don't need to do anything
 								else{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									acState = 2;
 									heaterState = 2;
 								}
 							}
 							//Room too hot
-							else if (tempVal > node[procValMail->addrArrayElem].upperHeatThreshold){
+							else if (tempVal > rooms.upperHeatThreshold[id]){
 								//Turning ac on from being off
-								if(tempChangeCheck[procValMail->addrArrayElem] == 0){
-									printf("and the temp is too high so turning the AC on.\n");
+								if(rooms.tempChangeCheck[id] == 0){
+									TRACE0(TEMP_HIGH_AC_ON);
 									heaterState = 2;
 									acState = 1;
-									tempChangeCheck[procValMail->addrArrayElem] = 2;
+									rooms.tempChangeCheck[id] = 2;
 								}
 								//Turning heater on from being on AC
-								else if(tempChangeCheck[procValMail->addrArrayElem] == 1){
-									printf("and the temp is too high so turning the heating off and the AC on.\n");
+								else if(rooms.tempChangeCheck[id] == 1){
+									TRACE0(TEMP_HIGH_SWAP_TO_AC);
 									heaterState = 0;
 									acState = 1;
-									tempChangeCheck[procValMail->addrArrayElem] = 2;
+									rooms.tempChangeCheck[id] = 2;
 								}
 								//Don't need to do anything
 								else{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									acState = 2;
 									heaterState = 2;
 								}
@@ -913,22 +1299,22 @@ void process_ir_thread(void const *argument){
 							//Room just fine
 							else{
 								//Turn off heating
-								if(tempChangeCheck[procValMail->addrArrayElem] == 1){
-									printf("and the temp is fine so turning the heating off.\n");
+								if(rooms.tempChangeCheck[id] == 1){
+									TRACE0(TEMP_FINE_HEAT_OFF);
 									heaterState = 0;
 									acState = 2;
-									tempChangeCheck[procValMail->addrArrayElem] = 0;
+									rooms.tempChangeCheck[id] = 0;
 								}
 								//Turn off ac
-								else if(tempChangeCheck[procValMail->addrArrayElem] == 2){
-									printf("and the temp is fine so turning the AC off.\n");
+								else if(rooms.tempChangeCheck[id] == 2){
+									TRACE0(TEMP_FINE_AC_OFF);
 									heaterState = 2;
 									acState = 0;
-									tempChangeCheck[procValMail->addrArrayElem] = 0;
+									rooms.tempChangeCheck[id] = 0;
 								}
 								//Nothing needs to be done
 								else{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									acState = 2;
 									heaterState = 2;
 								}
@@ -936,21 +1322,21 @@ void process_ir_thread(void const *argument){
 						}
 						//Someone has entered
 						else{
-							printf("Someone has entered the room ");
-							if(tempVal < node[procValMail->addrArrayElem].lowerHeatThreshold){
-								printf("and the temp is too low so turning the heating on.\n");
+							TRACE0(ROOM_ENTERED);
+							if(tempVal < rooms.lowerHeatThreshold[id]){
+								TRACE0(TEMP_LOW_HEAT_ON);
 								heaterState = 1;
 								acState = 2;
-								tempChangeCheck[procValMail->addrArrayElem] = 1;
+								rooms.tempChangeCheck[id] = 1;
 							}
-							else if(tempVal > node[procValMail->addrArrayElem].upperHeatThreshold){
-								printf("and the temp is too high so turning the AC on.\n");
+							else if(tempVal > rooms.upperHeatThreshold[id]){
+								TRACE0(TEMP_HIGH_AC_ON);
 								acState = 1;
 								heaterState = 2;
-								tempChangeCheck[procValMail->addrArrayElem] = 2;
+								rooms.tempChangeCheck[id] = 2;
 							}
 							else{
-								printf("and nothing has changed.\n");
+								TRACE0(NO_CHANGE);
 								heaterState = 2;
 								acState = 2;
 							}
@@ -959,72 +1345,72 @@ void process_ir_thread(void const *argument){
 					//Someone has left or room is empty
 					else{
 						//Room is vacant
-						if((prevPirLevel[procValMail->addrArrayElem] | 0x0) == 0){
-							printf("The room is vacant ");
+						if((rooms.prevPirLevel[id] | 0x0) == 0){
+							TRACE0(ROOM_VACANT);
 							//First time since left then turn off
-							if(tempChangeCheck[procValMail->addrArrayElem] == 1){
-								printf("so turning the heating off.\n");
+							if(rooms.tempChangeCheck[id] == 1){
+								TRACE0(HEAT_OFF);
 								heaterState = 0;
 								acState = 2;
-								tempChangeCheck[procValMail->addrArrayElem] = 0;
+								rooms.tempChangeCheck[id] = 0;
 							}
-							else if(tempChangeCheck[procValMail->addrArrayElem] == 2){
-								printf("so turning the AC off.\n");
+							else if(rooms.tempChangeCheck[id] == 2){
+								TRACE0(AC_OFF);
 								acState = 0;
 								heaterState = 2;
-								tempChangeCheck[procValMail->addrArrayElem] = 0;
+								rooms.tempChangeCheck[id] = 0;
 							}
 							else{
-								printf("and nothing has changed.\n");
+								TRACE0(NO_CHANGE);
 								acState = 2;
 								heaterState = 2;
 							}
 						}
 						//Someone has left
 						else{
-							printf("Someone has left or is idle in the room ");
+							TRACE0(ROOM_LEFT);
 							//Room too cold
-							if(tempVal < node[procValMail->addrArrayElem].lowerHeatThreshold){
+							if(tempVal < rooms.lowerHeatThreshold[id]){
 								//Turning heater on from being off
-								if(tempChangeCheck[procValMail->addrArrayElem] == 0){
-									printf("and the temp is too low so turning the heating on.\n");
+								if(rooms.tempChangeCheck[id] == 0){
+									TRACE0(TEMP_LOW_HEAT_ON);
 									heaterState = 1;
 									acState = 2;
-									tempChangeCheck[procValMail->addrArrayElem] = 1;
+									rooms.tempChangeCheck[id] = 1;
 								}
 								//Turning heater on from being on AC
-								else if(tempChangeCheck[procValMail->addrArrayElem] == 2){
-									printf("and the temp is too low so turning the AC off and the heating on.\n");
+								else if(rooms.tempChangeCheck[id] == 2){
+									TRACE0(TEMP_LOW_SWAP_TO_HEAT);
 									heaterState = 1;
 									acState = 0;
-									tempChangeCheck[procValMail->addrArrayElem] = 1;
+									rooms.tempChangeCheck[id] = 1;
 								}
 								//Don't need to do anything
 								else{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									acState = 2;
 									heaterState = 2;
 								}
 							}
 							//Room too hot
-							else if (tempVal > node[procValMail->addrArrayElem].upperHeatThreshold){
+							else if (tempVal > rooms.upperHeatThreshold[id]){
 								//Turning ac on from being off
-								if(tempChangeCheck[procValMail->addrArrayElem] == 0){
-									printf("and the temp is too high so turning the AC on.\n");
+								if(rooms.tempChangeCheck[id] == 0){
+									TRACE0(TEMP_HIGH_AC_ON);
 									heaterState = 2;
 									acState = 1;
-									tempChangeCheck[procValMail->addrArrayElem] = 2;
+									rooms.tempChangeCheck[id] = 2;
 								}
 								//Turning heater on from being on AC
-								else if(tempChangeCheck[procValMail->addrArrayElem] == 1){
-									printf("and the temp is too high so turning the heating off and the AC on.\n");
+								else if(rooms.tempChangeCheck[id] == 1){
+									TRACE0(TEMP_HIGH_SWAP_TO_AC);
 									heaterState = 0;
 									acState = 1;
-									tempChangeCheck[procValMail->addrArrayElem] = 2;
+									rooms.tempChangeCheck[id] = 2;
 								}
 								//Don't need to do anything
 								else{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									acState = 2;
 									heaterState = 2;
 								}
@@ -1032,22 +1418,22 @@ void process_ir_thread(void const *argument){
 							//Room just fine
 							else{
 								//Turn off heating
-								if(tempChangeCheck[procValMail->addrArrayElem] == 1){
-									printf("and the temp is fine so turning the heating off.\n");
+								if(rooms.tempChangeCheck[id] == 1){
+									TRACE0(TEMP_FINE_HEAT_OFF);
 									heaterState = 0;
 									acState = 2;
-									tempChangeCheck[procValMail->addrArrayElem] = 0;
+									rooms.tempChangeCheck[id] = 0;
 								}
 								//Turn off ac
-								else if(tempChangeCheck[procValMail->addrArrayElem] == 2){
-									printf("and the temp is fine so turning the AC off.\n");
+								else if(rooms.tempChangeCheck[id] == 2){
+									TRACE0(TEMP_FINE_AC_OFF);
 									heaterState = 2;
 									acState = 0;
-									tempChangeCheck[procValMail->addrArrayElem] = 0;
+									rooms.tempChangeCheck[id] = 0;
 								}
 								//Nothing needs to be done
 								else{
-									printf("and nothing has changed.\n");
+									TRACE0(NO_CHANGE);
 									acState = 2;
 									heaterState = 2;
 								}
@@ -1056,17 +1442,17 @@ void process_ir_thread(void const *argument){
 					}
 				}
 				else{
-					printf("override enabled\n");
+					TRACE0(OVERRIDE_ENABLED);
 					heaterState = 2;
 					acState = 2;
 				}
-				printf("\n");
+				TRACE0(END_OF_SAMPLE);
 				//If changes have occured send to action thread
 				if (acState + heaterState + lightState != 6){
 					mail_t* varMail = (mail_t*) osMailAlloc(mail_box, osWaitForever);
 					varMail->isCommand = 0;
-					varMail->slAddress = node[procValMail->addrArrayElem].slAddress;
-					varMail->myAddress = node[procValMail->addrArrayElem].myAddress;
+					varMail->address = rooms.address[id];
+					varMail->myAddress = nodes.my_address[id];
 					varMail->lightState = lightState;
 					varMail->acState = acState;
 					varMail->heaterState = heaterState;
@@ -1082,17 +1468,15 @@ void process_ir_thread(void const *argument){
 
 
 void thresh_over_thread(void const *argument){
-	static uint8_t threshFlag[2] = {0};
-	static uint8_t selector[2] = {0};
-	
 	while (1){
 		
 		osEvent evt = osMailGet(thresh_over_box, osWaitForever);
 			
 		if(evt.status == osEventMail){
 			thresh_over_mail *threshValMail = (thresh_over_mail*)evt.value.p;
-			uint16_t myAddress = node[threshValMail->addrArrayElem].myAddress;
-			printf("Setting for %02X\n", myAddress);
+			node_id_t id = threshValMail->addrArrayElem;
+			uint16_t myAddress = nodes.my_address[id];
+			TRACE(SETTING_FOR, myAddress);
 			//remap Potentiometer to percent
 			float potVal = threshValMail->adcVal;
 			potVal = (potVal - 0) * (100 - 1) / (940 - 0) + 1;
@@ -1105,53 +1489,55 @@ void thresh_over_thread(void const *argument){
 			
 			//Check state of pot + if last button was in lower third
 			//Set new threshold as 2nd click
-			if(threshFlag[threshValMail->addrArrayElem] == 1){
-				threshFlag[threshValMail->addrArrayElem] = 0;
-				printf("Button presed a second time.\n");
-				switch(selector[threshValMail->addrArrayElem]){
+			if(rooms.threshFlag[id] == 1){
+				rooms.threshFlag[id] = 0;
+				TRACE0(SECOND_PRESS);
+				switch(rooms.selector[id]){
 					case 0:
-						printf("light threshold set to %f\n", potVal);
-						node[threshValMail->addrArrayElem].lightThreshold = potVal;
+						TRACE(LIGHT_THRESHOLD, TRACE_FLOAT(potVal));
+						rooms.lightThreshold[id] = potVal;
 						break;
 					case 1:
 						//Re-adjust both heating and AC thresholds if needed
-						printf("Heating threshold set to %f\n", potVal);
-						node[threshValMail->addrArrayElem].lowerHeatThreshold = potVal;
-						if (node[threshValMail->addrArrayElem].lowerHeatThreshold >= node[threshValMail->addrArrayElem].upperHeatThreshold){
+						TRACE(HEAT_THRESHOLD, TRACE_FLOAT(potVal));
+						rooms.lowerHeatThreshold[id] = potVal;
+						if (rooms.lowerHeatThreshold[id] >= rooms.upperHeatThreshold[id]){
 							float acSymThresh = potVal + 5;
-							node[threshValMail->addrArrayElem].upperHeatThreshold = acSymThresh;
-							printf("AC threshold auto adjusted to %f\n",  acSymThresh);
+							rooms.upperHeatThreshold[id] = acSymThresh;
+							TRACE(AC_THRESHOLD_ADJUSTED, TRACE_FLOAT(acSymThresh));
 						}
 						break;
 					case 2:
 						//Re-adjust both heating and AC thresholds if needed
-						printf("AC threshold set to %f\n", potVal);
-						node[threshValMail->addrArrayElem].upperHeatThreshold = potVal;
-						if (node[threshValMail->addrArrayElem].upperHeatThreshold <= node[threshValMail->addrArrayElem].lowerHeatThreshold){
+						TRACE(AC_THRESHOLD, TRACE_FLOAT(potVal));
+						rooms.upperHeatThreshold[id] = potVal;
+						if (rooms.upperHeatThreshold[id] <= rooms.lowerHeatThreshold[id]){
 							float heatSymThresh = potVal - 5;
-							node[threshValMail->addrArrayElem].lowerHeatThreshold = heatSymThresh;
-							printf("heating threshold auto adjusted to %f\n",  heatSymThresh); 
+							rooms.lowerHeatThreshold[id] = heatSymThresh;
+							TRACE(HEAT_THRESHOLD_ADJUSTED, TRACE_FLOAT(heatSymThresh)); 
 						}
 						break;
 				}
+				//Keep the new thresholds over a reset
+				save_room(id);
 			}
 			//Register that next click will be new threshold
 			else if(potVal < 25){
 			//Start timer
-			threshFlag[threshValMail->addrArrayElem] = 1;
-				printf("Button presed once, Next press will set ");
-				switch(selector[threshValMail->addrArrayElem]){
+			rooms.threshFlag[id] = 1;
+				TRACE0(FIRST_PRESS);
+				switch(rooms.selector[id]){
 					case 0:
-						printf("light ");
+						TRACE0(NEXT_LIGHT);
 						break;
 					case 1:
-						printf("heating ");
+						TRACE0(NEXT_HEATING);
 						break;
 					case 2: 
-						printf("AC ");
+						TRACE0(NEXT_AC);
 						break;
 				}
-				printf("based on potentiometer value\n");
+				TRACE0(BASED_ON_POT);
 			}
 			//Toggle override based on selector
 			else if(potVal >= 25 && potVal < 66){
@@ -1159,92 +1545,93 @@ void thresh_over_thread(void const *argument){
 				osMutexWait(thresh_over_state_id, osWaitForever);
 				mail_t* overrideMail = (mail_t*) osMailAlloc(mail_box, osWaitForever);
 				overrideMail->isCommand = 0;
-				overrideMail->slAddress = node[threshValMail->addrArrayElem].slAddress;
-				overrideMail->myAddress = node[threshValMail->addrArrayElem].myAddress;
-				switch(selector[threshValMail->addrArrayElem]){
+				overrideMail->address = rooms.address[id];
+				overrideMail->myAddress = nodes.my_address[id];
+				switch(rooms.selector[id]){
 					case 0:
-						printf("Light override ");
-						if(node[threshValMail->addrArrayElem].lightOverride == 0){
-							node[threshValMail->addrArrayElem].lightOverride = 1;
+						TRACE0(LIGHT_OVERRIDE);
+						if(rooms.lightOverride[id] == 0){
+							rooms.lightOverride[id] = 1;
 							overrideMail->lightState = 1;
 							overrideMail->acState = 2;
 							overrideMail->heaterState = 2;
-							printf("on\n");
+							TRACE0(OVERRIDE_ON);
 							//Mail to set light on
 						}
 						else{
-							node[threshValMail->addrArrayElem].overrideChangeCheck = 1;
-							node[threshValMail->addrArrayElem].lightOverride = 0;
+							rooms.overrideChangeCheck[id] = 1;
+							rooms.lightOverride[id] = 0;
 							overrideMail->lightState = 0;
 							overrideMail->acState = 2;
 							overrideMail->heaterState = 2;
-							printf("off\n");
+							TRACE0(OVERRIDE_OFF);
 							//Mail to set light off
 						}
 						break;
 					case 1:
-						printf("Heating ");
-						if(node[threshValMail->addrArrayElem].heatingOverride == 0){
+						TRACE0(HEATING_OVERRIDE);
+						if(rooms.heatingOverride[id] == 0){
 							overrideMail->lightState = 2;
 							overrideMail->acState = 0;
 							overrideMail->heaterState = 1;
-							node[threshValMail->addrArrayElem].heatingOverride = 1;
-							node[threshValMail->addrArrayElem].acOverride = 0;
-							printf("on\n");
+							rooms.heatingOverride[id] = 1;
+							rooms.acOverride[id] = 0;
+							TRACE0(OVERRIDE_ON);
 							//Mail to set heater on & AC off
 						}
 						else{
-							node[threshValMail->addrArrayElem].overrideChangeCheck = 1;
-							node[threshValMail->addrArrayElem].heatingOverride = 0;
+							rooms.overrideChangeCheck[id] = 1;
+							rooms.heatingOverride[id] = 0;
 							overrideMail->lightState = 2;
 							overrideMail->acState = 0;
 							overrideMail->heaterState = 0;
-							printf("off\n");
+							TRACE0(OVERRIDE_OFF);
 							//Mail to set heater off
 						}
 						break;
 					case 2:
 						
-						printf("AC ");
-						if(node[threshValMail->addrArrayElem].acOverride == 0){
+						TRACE0(AC_OVERRIDE);
+						if(rooms.acOverride[id] == 0){
 							overrideMail->lightState = 2;
 							overrideMail->acState = 1;
 							overrideMail->heaterState = 0;
-							node[threshValMail->addrArrayElem].acOverride = 1;
-							node[threshValMail->addrArrayElem].heatingOverride = 0;
-							printf("on\n");
+							rooms.acOverride[id] = 1;
+							rooms.heatingOverride[id] = 0;
+							TRACE0(OVERRIDE_ON);
 							//Mail to set AC on & heater off
 						}
 						else{
-							node[threshValMail->addrArrayElem].overrideChangeCheck = 1;
-							node[threshValMail->addrArrayElem].acOverride = 0;
+							rooms.overrideChangeCheck[id] = 1;
+							rooms.acOverride[id] = 0;
 							overrideMail->lightState = 2;
 							overrideMail->acState = 0;
 							overrideMail->heaterState = 0;
-							printf("off\n");
+							TRACE0(OVERRIDE_OFF);
 							//Mail to set AC off
 						}
 						break;
 				}
+				save_room(id);
 				osMutexRelease(thresh_over_state_id);
 				osMailPut(mail_box, overrideMail);
 			}
 			//itterate through selector
 			else if(potVal >= 66){
-				selector[threshValMail->addrArrayElem] ++;
-				if(selector[threshValMail->addrArrayElem] == 3){
-					selector[threshValMail->addrArrayElem] = 0;
+				rooms.selector[id] ++;
+				if(rooms.selector[id] == 3){
+					rooms.selector[id] = 0;
 				}
-				printf("Selector for %02X set to ", myAddress);
-				switch(selector[threshValMail->addrArrayElem]){
+				TRACE(SELECTOR, myAddress);
+				switch(rooms.selector[id]){
 					case 0:
-						printf("light\n");
+						TRACE0(SELECTED_LIGHT);
 						break;
 					case 1:
-						printf("heating\n");
+						TRACE0(SELECTED_HEATING);
 						break;
 					case 2:
-						printf("AC\n");
+						TRACE0(SELECTED_AC);
 						break;
 				}
 			}
@@ -1272,9 +1659,12 @@ void display_thread(void const *argument){
 	if(evt.status == osEventMail){
 		display_mail *displayMail = (display_mail*)evt.value.p;
 		
-		addresses[displayMail->addrArrayElem] = node[displayMail->addrArrayElem].myAddress;
-		temperatures[displayMail->addrArrayElem] = displayMail->temperature;
-		lights[displayMail->addrArrayElem] = displayMail->light;
+		//Only the first two rooms fit on the screen
+		if(displayMail->addrArrayElem < 2){
+			addresses[displayMail->addrArrayElem] = nodes.my_address[displayMail->addrArrayElem];
+			temperatures[displayMail->addrArrayElem] = displayMail->temperature;
+			lights[displayMail->addrArrayElem] = displayMail->light;
+		}
 		
 		
 		if (i == 0){
@@ -1316,3 +1706,55 @@ void display_thread(void const *argument){
 	}
 	
 }
+
+//Save the rooms' settings to flash as they change (a room whose settings are
+//the same as what's saved already isn't written again), and tidy the store up
+//when there's nothing to save
+void config_thread(void const *argument){
+	room_config_t saved;
+	uint32_t oldest;
+	int result;
+	
+	while(1){
+		osEvent evt = osMailGet(config_box, CONFIG_IDLE);
+		
+		if(evt.status == osEventMail){
+			room_config_t *room = (room_config_t*)evt.value.p;
+			
+			osMutexWait(config_lock_id, osWaitForever);
+			result = config_store_get(&config, (uint32_t)room->serial, &saved, sizeof(saved));
+			if(result != sizeof(saved) || memcmp(&saved, room, sizeof(saved)) != 0){
+				result = config_store_put(&config, (uint32_t)room->serial, room, sizeof(room_config_t));
+				
+				//Make room by forgetting the rooms that have gone longest without a
+				//change (they start again from the defaults if they're heard from)
+				while(result == CONFIG_STORE_FULL && config_store_oldest(&config, &oldest) == CONFIG_STORE_OK){
+					TRACE(ROOM_FORGOTTEN, oldest);
+					result = config_store_delete(&config, oldest);
+					if(result == CONFIG_STORE_OK){
+						result = config_store_put(&config, (uint32_t)room->serial, room, sizeof(room_config_t));
+					}
+				}
+			}
+			else{
+				result = CONFIG_STORE_OK;
+			}
+			osMutexRelease(config_lock_id);
+			
+			if(result != CONFIG_STORE_OK){
+				TRACE(ROOM_SAVE_FAILED, (uint32_t)(room->serial & 0xFFFFFFFF), -result);
+			}
+			osMailFree(config_box, room);
+		}
+		else if(config_ok){
+			//One block at a time, so the rx thread never waits long for the lock
+			osMutexWait(config_lock_id, osWaitForever);
+			result = config_store_maintain(&config);
+			osMutexRelease(config_lock_id);
+			
+			if(result < 0){
+				TRACE(CONFIG_TIDY_FAILED, -result);
+			}
+		}
+	}
+}
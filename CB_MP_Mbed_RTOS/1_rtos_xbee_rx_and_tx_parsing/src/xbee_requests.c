@@ -0,0 +1,196 @@
+/*
+ * xbee_requests.c
+ *
+ * keep track of the frames we've sent that the xbee should answer, match the
+ * responses up with them and resend anything that isn't answered in time
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include <string.h>
+#include "xbee_requests.h"
+
+// the frame id is the byte after the frame type for every request frame type
+// we send (0x08, 0x10 and 0x17)
+#define FRAME_ID_OFFSET 4
+
+// has a deadline passed (this still works when the clock wraps round)
+#define EXPIRED(now, deadline) ((int32_t)((now) - (deadline)) >= 0)
+
+// METHODS
+
+// empty the table (the timeout is how long to wait for the first response -
+// it doubles for every retry)
+void xbee_requests_init(xbee_request_table_t * table, uint32_t timeout)
+{
+	memset(table, 0, sizeof(*table));
+	table->next_id = 1;
+	table->timeout = timeout;
+}
+
+// give a frame the next free frame id and keep a copy of it so we can resend
+// it - this rewrites the frame id (and the checksum) in the frame, so call it
+// just before sending the frame
+//
+// returns the frame id, or 0 if the frame can't be tracked (in which case it
+// should still be sent, but nobody will notice if it goes missing)
+uint8_t xbee_request_track(xbee_request_table_t * table, uint8_t * frame, int length,
+	uint32_t now, xbee_request_callback callback, void * context)
+{
+	int i;
+
+	if(length < FRAME_ID_OFFSET + 2 || length > XBEE_REQUEST_MAX_FRAME)
+	{
+		table->stats.full++;
+		return 0;
+	}
+
+	// find the next id whose slot is free (skipping 0, which tells the xbee not
+	// to send a response)
+	uint8_t id = table->next_id;
+	xbee_request_t * request = NULL;
+	for(i = 0; i < XBEE_REQUEST_SLOTS; i++)
+	{
+		if(!table->slots[id & (XBEE_REQUEST_SLOTS - 1)].in_use)
+		{
+			request = &table->slots[id & (XBEE_REQUEST_SLOTS - 1)];
+			break;
+		}
+		id = (id == 255) ? 1 : id + 1;
+	}
+	if(request == NULL)
+	{
+		table->stats.full++;
+		return 0;
+	}
+	table->next_id = (id == 255) ? 1 : id + 1;
+
+	// swap the frame id over and patch the checksum to match
+	uint8_t old_id = frame[FRAME_ID_OFFSET];
+	frame[FRAME_ID_OFFSET] = id;
+	frame[length - 1] += old_id - id;
+
+	request->in_use = 1;
+	request->frame_id = id;
+	request->retries = 0;
+	request->length = length;
+	request->sent = now;
+	request->deadline = now + table->timeout;
+	request->callback = callback;
+	request->context = context;
+	memcpy(request->frame, frame, length);
+
+	table->stats.sent++;
+	return id;
+}
+
+// match a response to its request - returns 1 if it was waiting, 0 if not (a
+// late response to a request we gave up on, or a second answer to a broadcast)
+int xbee_request_complete(xbee_request_table_t * table, uint8_t frame_id,
+	uint8_t status, uint32_t now)
+{
+	xbee_request_t * request = &table->slots[frame_id & (XBEE_REQUEST_SLOTS - 1)];
+
+	if(frame_id == 0 || !request->in_use || request->frame_id != frame_id)
+	{
+		table->stats.unmatched++;
+		return 0;
+	}
+
+	uint32_t latency = now - request->sent;
+	table->stats.completed++;
+	table->stats.latency_total += latency;
+	if(latency > table->stats.latency_max)
+	{
+		table->stats.latency_max = latency;
+	}
+	if(status != 0)
+	{
+		table->stats.errors++;
+	}
+
+	request->in_use = 0;
+	if(request->callback != NULL)
+	{
+		request->callback(frame_id, status, latency, request->context);
+	}
+	return 1;
+}
+
+// stop waiting for a request (without calling its callback) - e.g. when the
+// caller has its own, shorter, timeout
+void xbee_request_cancel(xbee_request_table_t * table, uint8_t frame_id)
+{
+	xbee_request_t * request = &table->slots[frame_id & (XBEE_REQUEST_SLOTS - 1)];
+
+	if(frame_id != 0 && request->in_use && request->frame_id == frame_id)
+	{
+		request->in_use = 0;
+		table->stats.cancelled++;
+	}
+}
+
+// is there anything that has run out of time (so we know whether it's worth
+// calling xbee_request_poll)
+int xbee_request_due(const xbee_request_table_t * table, uint32_t now)
+{
+	int i;
+	for(i = 0; i < XBEE_REQUEST_SLOTS; i++)
+	{
+		if(table->slots[i].in_use && EXPIRED(now, table->slots[i].deadline))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// resend anything that has run out of time (doubling its timeout), or give up
+// on it if it's been sent enough times already - returns the number of frames
+// resent
+int xbee_request_poll(xbee_request_table_t * table, uint32_t now, xbee_request_send send)
+{
+	int i;
+	int resent = 0;
+
+	for(i = 0; i < XBEE_REQUEST_SLOTS; i++)
+	{
+		xbee_request_t * request = &table->slots[i];
+		if(!request->in_use || !EXPIRED(now, request->deadline))
+		{
+			continue;
+		}
+
+		if(request->retries == XBEE_REQUEST_RETRIES)
+		{
+			table->stats.timeouts++;
+			request->in_use = 0;
+			if(request->callback != NULL)
+			{
+				request->callback(request->frame_id, XBEE_REQUEST_TIMED_OUT,
+					now - request->sent, request->context);
+			}
+			continue;
+		}
+
+		request->retries++;
+		request->deadline = now + (table->timeout << request->retries);
+		table->stats.retries++;
+		send(request->frame, request->length);
+		resent++;
+	}
+	return resent;
+}
+
+// the number of requests still waiting for a response
+int xbee_request_outstanding(const xbee_request_table_t * table)
+{
+	int i;
+	int count = 0;
+	for(i = 0; i < XBEE_REQUEST_SLOTS; i++)
+	{
+		count += table->slots[i].in_use;
+	}
+	return count;
+}
@@ -0,0 +1,80 @@
+/*
+ * xbee_tx_queue.c
+ *
+ * a queue of frames waiting to go out of the xbee uart
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the relevant header files
+#include <string.h>
+#include "xbee_tx_queue.h"
+
+// METHODS
+
+// empty the queue and reset the counters
+void xbee_tx_queue_init(xbee_tx_queue_t * queue)
+{
+	memset(queue, 0, sizeof(*queue));
+}
+
+// get the next free slot to fill in
+xbee_tx_frame_t * xbee_tx_queue_claim(xbee_tx_queue_t * queue)
+{
+	if(queue->head - queue->tail >= XBEE_TX_QUEUE_DEPTH)
+	{
+		queue->stats.full++;
+		return NULL;
+	}
+	return &queue->frames[queue->head & (XBEE_TX_QUEUE_DEPTH - 1)];
+}
+
+// hand the slot we've just filled in to the interrupt
+void xbee_tx_queue_commit(xbee_tx_queue_t * queue)
+{
+	XBEE_TX_QUEUE_BARRIER();
+	queue->head++;
+
+	queue->stats.queued++;
+	uint32_t depth = queue->head - queue->tail;
+	if(depth > queue->stats.high_water)
+	{
+		queue->stats.high_water = depth;
+	}
+}
+
+// get the frame at the front of the queue if nothing is being sent (and mark
+// the uart as busy sending it)
+const xbee_tx_frame_t * xbee_tx_queue_start(xbee_tx_queue_t * queue)
+{
+	if(queue->busy || queue->head == queue->tail)
+	{
+		return NULL;
+	}
+	queue->busy = 1;
+	return &queue->frames[queue->tail & (XBEE_TX_QUEUE_DEPTH - 1)];
+}
+
+// the frame at the front of the queue has gone - let whoever sent it know,
+// free its slot and get the next one
+const xbee_tx_frame_t * xbee_tx_queue_complete(xbee_tx_queue_t * queue)
+{
+	const xbee_tx_frame_t * frame = &queue->frames[queue->tail & (XBEE_TX_QUEUE_DEPTH - 1)];
+
+	queue->stats.sent++;
+	queue->stats.bytes += frame->length;
+	if(frame->callback != NULL)
+	{
+		frame->callback(frame->data, frame->length, frame->context);
+	}
+
+	queue->tail++;
+	queue->busy = 0;
+	return xbee_tx_queue_start(queue);
+}
+
+// the number of frames waiting
+uint32_t xbee_tx_queue_depth(const xbee_tx_queue_t * queue)
+{
+	return queue->head - queue->tail;
+}
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+#
+# swo_demux.py
+#
+# split a captured swo / itm stream up into a file for each stimulus port -
+# port 0 is the print_debug text, and the others carry the binary records sent
+# with itm_send (see inc/itm_debug.h), which are written out one per line
+#
+# the capture has to be the raw itm packets (without the tpiu formatter), e.g.
+# from openocd with "tpiu config internal swo.bin uart off 216000000" (or
+# "stm32f7x.tpiu configure -output swo.bin ..." on newer versions), or from
+# orbuculum
+#
+# usage: swo_demux.py [--header inc/itm_debug.h] [--out dir] [--clock hz] capture
+#
+# purpose:   55-604481 embedded computer networks : lab 104
+#
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+ITM_SYNC = 0xA5
+
+
+# get the port names and the event names out of the header
+def read_header(path):
+    channels = {}
+    events = {}
+    with open(path) as header:
+        for line in header:
+            match = re.match(r"\s*#define\s+ITM_CH_(\w+)\s+(\d+)", line)
+            if match:
+                channels[int(match.group(2))] = match.group(1).lower()
+            match = re.match(r"\s*ITM_EV_(\w+)\s*=\s*(\d+)", line)
+            if match:
+                events[int(match.group(2))] = match.group(1).lower()
+    return channels, events
+
+
+# pull the software source packets out of the itm stream - returns a list of
+# (port, payload bytes) and the number of overflow packets seen
+def read_packets(data):
+    packets = []
+    overflows = 0
+    i = 0
+    while i < len(data):
+        header = data[i]
+        i += 1
+        if header == 0x00 or header == 0x80:
+            # part of a synchronisation packet
+            continue
+        if header == 0x70:
+            overflows += 1
+            continue
+        size = header & 0x3
+        if size == 0:
+            # a timestamp or extension packet - skip its continuation bytes
+            if header & 0x80:
+                while i < len(data) and data[i] & 0x80:
+                    i += 1
+                i += 1
+            continue
+        length = 4 if size == 3 else size
+        payload = data[i:i + length]
+        i += length
+        if len(payload) < length:
+            break
+        if header & 0x4:
+            # hardware source (dwt) packet - not ours
+            continue
+        packets.append((header >> 3, payload))
+    return packets, overflows
+
+
+# split a port's words back up into records - if the fifo filled up part way
+# through a record, the next header turns up early and we start again from
+# there (only trusting headers for events we know inside a record, as a data
+# word or time stamp could look like one)
+def read_records(words, events):
+    def is_header(word):
+        return word >> 24 == ITM_SYNC and (word & 0xFFFF) in events
+
+    records = []
+    lost = 0
+    i = 0
+    while i < len(words):
+        if words[i] >> 24 != ITM_SYNC:
+            lost += 1
+            i += 1
+            continue
+        count = (words[i] >> 16) & 0xFF
+        record = words[i + 1:i + 2 + count]
+        short = next((j for j, word in enumerate(record) if is_header(word)), None)
+        if short is not None:
+            lost += short + 1
+            i += short + 1
+            continue
+        if len(record) < count + 1:
+            lost += len(record) + 1
+            break
+        records.append((words[i] & 0xFFFF, record[0], record[1:]))
+        i += count + 2
+    return records, lost
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description="split an itm / swo capture up by port")
+    parser.add_argument("capture", help="raw itm stream captured from the swo pin")
+    parser.add_argument("--header", default=os.path.join(here, "..", "inc", "itm_debug.h"),
+                        help="where to find the port and event names (default: inc/itm_debug.h)")
+    parser.add_argument("--out", default=".", help="directory to write the files to")
+    parser.add_argument("--clock", type=float, default=216e6,
+                        help="core clock in hz (for the time stamps - default 216 MHz)")
+    args = parser.parse_args()
+
+    channels, events = read_header(args.header)
+    with open(args.capture, "rb") as capture:
+        packets, overflows = read_packets(capture.read())
+
+    # gather up what was sent on each port (the records are sent a word at a
+    # time, and the text a byte at a time)
+    ports = {}
+    for port, payload in packets:
+        ports.setdefault(port, []).append(payload)
+
+    os.makedirs(args.out, exist_ok=True)
+    for port in sorted(ports):
+        name = channels.get(port, "port%d" % port)
+        path = os.path.join(args.out, "%s.txt" % name)
+        with open(path, "w") as out:
+            if port == 0:
+                out.write(b"".join(ports[port]).decode("latin-1"))
+                print("%s: %d characters" % (path, sum(len(p) for p in ports[port])))
+                continue
+
+            words = [struct.unpack("<I", p)[0] for p in ports[port] if len(p) == 4]
+            records, lost = read_records(words, events)
+
+            # the cycle counter wraps round every 20 s or so, so keep a running
+            # total (this assumes records on a port are never that far apart)
+            elapsed = 0
+            previous = records[0][1] if records else 0
+            for event, stamp, data in records:
+                elapsed += (stamp - previous) & 0xFFFFFFFF
+                previous = stamp
+                out.write("%12.6f %-14s %s\n" % (elapsed / args.clock,
+                          events.get(event, "event%d" % event), " ".join(str(w) for w in data)))
+            print("%s: %d records (%d words skipped)" % (path, len(records), lost))
+
+    if overflows:
+        print("warning: the itm overflowed %d times (some packets were lost)" % overflows,
+              file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
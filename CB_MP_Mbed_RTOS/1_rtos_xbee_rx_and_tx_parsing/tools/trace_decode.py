@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+#
+# trace_decode.py
+#
+# turn a memory dump of the binary trace log (trace_log in trace.c) back into
+# text, using the format strings from inc/trace_msgs.h
+#
+# the dump can be raw binary (e.g. from gdb - dump binary memory trace.bin
+# &trace_log (char *)&trace_log + sizeof(trace_log)) or intel hex (e.g. from
+# the uvision SAVE command, with the start and end addresses of trace_log)
+#
+# usage: trace_decode.py [--table inc/trace_msgs.h] [--no-time] dump
+#
+# purpose:   55-604481 embedded computer networks : lab 104
+#
+
+import argparse
+import ast
+import os
+import re
+import struct
+import sys
+
+TRACE_MAGIC = 0x31435254
+TRACE_SYNC = 0xA5
+HEADER_WORDS = 8
+
+# a printf conversion (we only need to know which sort of argument it takes)
+CONVERSION = re.compile(r"%[-+ #0]*\d*(?:\.\d+)?(?:hh|h|ll|l|z)?([diouxXcfeEgGs%])")
+
+
+# read the message table - the ids are just the order the messages appear in
+def read_table(path):
+    messages = []
+    pattern = re.compile(r'^\s*TRACE_MSG\(\s*(\w+)\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)\)')
+    with open(path) as table:
+        for line in table:
+            match = pattern.match(line)
+            if match:
+                parts = re.findall(r'"(?:[^"\\]|\\.)*"', match.group(2))
+                text = "".join(ast.literal_eval(part) for part in parts)
+                messages.append((match.group(1), text))
+    return messages
+
+
+# read an intel hex file into a block of bytes (starting at the lowest address)
+def read_hex(text):
+    data = {}
+    base = 0
+    for line in text.splitlines():
+        line = line.strip()
+        if not line.startswith(":"):
+            continue
+        record = bytes.fromhex(line[1:])
+        length, address, kind = record[0], (record[1] << 8) | record[2], record[3]
+        payload = record[4:4 + length]
+        if kind == 0:
+            for i, byte in enumerate(payload):
+                data[base + address + i] = byte
+        elif kind == 2:
+            base = ((payload[0] << 8) | payload[1]) << 4
+        elif kind == 4:
+            base = ((payload[0] << 8) | payload[1]) << 16
+        elif kind == 1:
+            break
+    if not data:
+        return b""
+    start = min(data)
+    return bytes(data.get(start + i, 0) for i in range(max(data) - start + 1))
+
+
+def read_dump(path):
+    with open(path, "rb") as dump:
+        raw = dump.read()
+    if raw[:1] == b":":
+        return read_hex(raw.decode("ascii", "replace"))
+    return raw
+
+
+# convert the raw argument words to the types the format string expects
+def convert(text, words):
+    values = []
+    for kind in CONVERSION.findall(text):
+        if kind == "%":
+            continue
+        word = words[len(values)] if len(values) < len(words) else 0
+        if kind in "di":
+            values.append(word - (1 << 32) if word & 0x80000000 else word)
+        elif kind in "feEgG":
+            values.append(struct.unpack("<f", struct.pack("<I", word))[0])
+        elif kind == "s":
+            values.append("0x%08X" % word)
+        else:
+            values.append(word)
+    # python doesn't know about the length modifiers (or %u on some versions)
+    text = re.sub(r"(%[-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z)?u", r"\1d", text)
+    text = re.sub(r"(%[-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z)", r"\1", text)
+    return text % tuple(values)
+
+
+# walk through the records from the oldest to the newest
+def decode(raw, messages):
+    if len(raw) < HEADER_WORDS * 4:
+        raise ValueError("dump is too short to be a trace log")
+    magic, size, count, clock, head, first, records, lost = struct.unpack_from("<8I", raw)
+    if magic != TRACE_MAGIC:
+        raise ValueError("dump doesn't start with the trace log magic number")
+    if count != len(messages):
+        print("warning: the log has %d messages but the table has %d (is the table "
+              "from the same build?)" % (count, len(messages)), file=sys.stderr)
+    words = struct.unpack_from("<%dI" % size, raw, HEADER_WORDS * 4)
+
+    entries = []
+    position = first
+    while (head - position) & 0xFFFFFFFF > 0:
+        header = words[position % size]
+        if header >> 24 != TRACE_SYNC:
+            # shouldn't happen (unless the dump was taken half way through a write)
+            print("warning: lost sync at word %d" % position, file=sys.stderr)
+            position += 1
+            continue
+        length = (header >> 16) & 0xFF
+        ident = header & 0xFFFF
+        stamp = words[(position + 1) % size]
+        args = [words[(position + 2 + i) % size] for i in range(length)]
+        entries.append((ident, stamp, args))
+        position += length + 2
+    return clock, records, lost, entries
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description="decode a binary trace log dump")
+    parser.add_argument("dump", help="raw binary or intel hex dump of trace_log")
+    parser.add_argument("--table", default=os.path.join(here, "..", "inc", "trace_msgs.h"),
+                        help="the message table (default: inc/trace_msgs.h)")
+    parser.add_argument("--no-time", action="store_true",
+                        help="don't put a time stamp at the start of each line")
+    args = parser.parse_args()
+
+    messages = read_table(args.table)
+    clock, records, lost, entries = decode(read_dump(args.dump), messages)
+
+    # the cycle counter wraps round (every 20 s or so at 216 MHz) so keep a
+    # running total - this assumes there's never that long between records
+    elapsed = 0
+    previous = entries[0][1] if entries else 0
+    line_start = True
+    out = sys.stdout
+    for ident, stamp, words in entries:
+        elapsed += (stamp - previous) & 0xFFFFFFFF
+        previous = stamp
+        if ident < len(messages):
+            text = convert(messages[ident][1], words)
+        else:
+            text = "<unknown message %d: %s>\n" % (ident, " ".join("%08X" % w for w in words))
+        for piece in text.splitlines(True):
+            if line_start and not args.no_time:
+                out.write("[%12.6f] " % (elapsed / clock if clock else elapsed))
+            out.write(piece)
+            line_start = piece.endswith("\n")
+    if not line_start:
+        out.write("\n")
+    print("%d records (%d written, %d overwritten)" % (len(entries), records, lost),
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
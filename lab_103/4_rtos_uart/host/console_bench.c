@@ -0,0 +1,193 @@
+/*
+ * console_bench.c
+ *
+ * a pc build of the console core - runs a few command lines through it (so
+ * the parsing can be tried out without the board) and then times the command
+ * lookup with a big table, against going down the table doing strcmp's like
+ * the old if / else chain did
+ *
+ * usage: make && ./console_bench [commands]
+ *
+ * purpose:   55-604481 embedded computer networks : lab 103
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// include the console
+#include "console.h"
+
+// how many lookups to time
+#define LOOKUPS 2000000
+
+// the biggest table we'll make
+#define MAX_COMMANDS (CONSOLE_HASH_SIZE / 2)
+
+// the generated command names and table
+static char names[MAX_COMMANDS][24];
+static console_command_t commands[MAX_COMMANDS];
+static console_t console;
+
+// handlers that just show what they were given
+static int cmd_int(int argc, const console_arg_t * argv)
+{
+  printf("  -> %d\r\n", argv[0].i);
+  return 0;
+}
+
+static int cmd_uint(int argc, const console_arg_t * argv)
+{
+  printf("  -> %d argument(s): %u %u\r\n", argc, argv[0].u,
+    (argc > 1) ? argv[1].u : 0);
+  return 0;
+}
+
+static int cmd_float(int argc, const console_arg_t * argv)
+{
+  printf("  -> %g\r\n", argv[0].f);
+  return 0;
+}
+
+static int cmd_word(int argc, const console_arg_t * argv)
+{
+  printf("  -> '%s'\r\n", argv[0].s);
+  return 0;
+}
+
+// a handler that does nothing (for the timings)
+static volatile int calls;
+static int cmd_nothing(int argc, const console_arg_t * argv)
+{
+  calls++;
+  return 0;
+}
+
+// the time now in nanoseconds
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// look a command up the old way
+static const console_command_t * linear_find(const char * name, int count)
+{
+  int i;
+  for(i = 0; i < count; i++)
+  {
+    if(strcmp(commands[i].name, name) == 0)
+    {
+      return &commands[i];
+    }
+  }
+  return NULL;
+}
+
+// run a few lines through the console to show the parsing
+static void demo(void)
+{
+  static const console_command_t demo_commands[] =
+  {
+    CONSOLE_COMMAND("int",   "i",   cmd_int,   "an int"),
+    CONSOLE_COMMAND("uint",  "u|u", cmd_uint,  "a uint and maybe another"),
+    CONSOLE_COMMAND("float", "f",   cmd_float, "a float"),
+    CONSOLE_COMMAND("word",  "s",   cmd_word,  "a word"),
+  };
+  static const char * lines[] =
+  {
+    "int -42\r\n", "int 0x10\r\n", "int 12abc\r\n", "uint 7\n", "uint 7 8\n",
+    "uint -1\n", "uint\n", "float 2.5\r", "word hello\r", "word hello there\r",
+    "nope\r\n", "\r\n", "  uint   3  \r\n",
+  };
+  size_t i;
+  const char * c;
+
+  console_init(&console, demo_commands,
+    sizeof(demo_commands) / sizeof(demo_commands[0]));
+  console_help(&console);
+  for(i = 0; i < sizeof(lines) / sizeof(lines[0]); i++)
+  {
+    printf("> %.*s\r\n", (int)strcspn(lines[i], "\r\n"), lines[i]);
+    for(c = lines[i]; *c; c++)
+    {
+      console_input(&console, *c);
+    }
+  }
+
+  // a line that's too long gets thrown away, not run
+  printf("> (a %d character line)\r\n", CONSOLE_LINE_SIZE + 10);
+  for(i = 0; i < CONSOLE_LINE_SIZE + 10; i++)
+  {
+    console_input(&console, 'x');
+  }
+  console_input(&console, '\n');
+  printf("\r\n");
+}
+
+int main(int argc, char ** argv)
+{
+  int count = (argc > 1) ? atoi(argv[1]) : MAX_COMMANDS;
+  int i;
+  double start, hashed, linear;
+  const console_command_t * found = NULL;
+
+  demo();
+
+  if(count < 1 || count > MAX_COMMANDS)
+  {
+    printf("between 1 and %d commands please\r\n", MAX_COMMANDS);
+    return 1;
+  }
+
+  // make up a table of commands with names like the real ones
+  for(i = 0; i < count; i++)
+  {
+    snprintf(names[i], sizeof(names[i]), "%s-node%03d", (i & 1) ? "off" : "on", i);
+    commands[i].name = names[i];
+    commands[i].args = "|u";
+    commands[i].handler = cmd_nothing;
+    commands[i].help = "";
+  }
+  if(!console_init(&console, commands, count))
+  {
+    printf("console_init failed\r\n");
+    return 1;
+  }
+
+  // look them all up in a scrambled order (the same for both ways)
+  start = now();
+  for(i = 0; i < LOOKUPS; i++)
+  {
+    found = console_find(&console, names[(i * 7919u) % count]);
+  }
+  hashed = (now() - start) / LOOKUPS;
+
+  start = now();
+  for(i = 0; i < LOOKUPS; i++)
+  {
+    found = linear_find(names[(i * 7919u) % count], count);
+  }
+  linear = (now() - start) / LOOKUPS;
+
+  printf("%d commands, %d lookups\r\n", count, LOOKUPS);
+  printf("  hashed: %6.1f ns a lookup (%.2f probes on average)\r\n", hashed,
+    (double)console_get_stats(&console)->probes / LOOKUPS);
+  printf("  strcmp: %6.1f ns a lookup\r\n", linear);
+
+  // and a whole command line (split, lookup, argument parse and call)
+  char line[CONSOLE_LINE_SIZE];
+  start = now();
+  for(i = 0; i < LOOKUPS; i++)
+  {
+    snprintf(line, sizeof(line), "%s 42", names[(i * 7919u) % count]);
+    console_execute(&console, line);
+  }
+  printf("  execute: %5.1f ns a line (including the snprintf)\r\n",
+    (now() - start) / LOOKUPS);
+
+  return (found == NULL) || (calls != LOOKUPS);
+}
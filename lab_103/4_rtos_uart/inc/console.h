@@ -0,0 +1,133 @@
+/*
+ * console.h
+ *
+ * a simple command shell for the virtual com port - a line editor that builds
+ * up a command line a character at a time, and a table of commands that are
+ * looked up by a hash of their name and have their arguments parsed for them
+ *
+ * the commands are listed in a table built with the CONSOLE_COMMAND macro:
+ *
+ *   const console_command_t commands[] =
+ *   {
+ *     CONSOLE_COMMAND("threshold", "|u", cmd_threshold, "get / set the threshold"),
+ *     ...
+ *   };
+ *
+ * the argument string has one character per argument - i (int), u (unsigned),
+ * f (float) or s (a word) - and any arguments after a | are optional.  the
+ * handler gets the number of arguments actually given and their values.
+ *
+ * nothing here touches the hardware (the output is all through printf) so it
+ * can be built and tried out on a pc as well
+ *
+ * purpose:   55-604481 embedded computer networks : lab 103
+ */
+
+// define to prevent recursive inclusion
+#ifndef __CONSOLE_H
+#define __CONSOLE_H
+
+// include the standard integer types
+#include <stdint.h>
+
+// CONFIGURATION
+
+// the longest command line we can take (including the terminator)
+#ifndef CONSOLE_LINE_SIZE
+#define CONSOLE_LINE_SIZE 128
+#endif
+
+// the most arguments a command can have
+#ifndef CONSOLE_MAX_ARGS
+#define CONSOLE_MAX_ARGS 8
+#endif
+
+// the number of hash table slots (a power of two, and at least twice the
+// number of commands so the lookups stay short)
+#ifndef CONSOLE_HASH_SIZE
+#define CONSOLE_HASH_SIZE 256
+#endif
+
+// what console_execute returns when it can't run a command (otherwise it's
+// whatever the handler returned)
+#define CONSOLE_EMPTY       1
+#define CONSOLE_UNKNOWN     -1
+#define CONSOLE_BAD_ARGS    -2
+#define CONSOLE_TOO_LONG    -3
+
+// TYPES
+
+// a parsed argument (which member is set depends on the argument string)
+typedef union
+{
+  int32_t i;
+  uint32_t u;
+  float f;
+  const char * s;
+}
+console_arg_t;
+
+// a command handler - gets the number of arguments given and their values
+typedef int (*console_handler_t)(int argc, const console_arg_t * argv);
+
+// a command
+typedef struct
+{
+  const char * name;
+  const char * args;
+  console_handler_t handler;
+  const char * help;
+}
+console_command_t;
+
+// add a command to a table
+#define CONSOLE_COMMAND(name, args, handler, help) {name, args, handler, help}
+
+// some numbers on how the console is getting on
+typedef struct
+{
+  uint32_t lines;
+  uint32_t unknown;
+  uint32_t bad_args;
+  uint32_t too_long;
+  uint32_t probes;
+}
+console_stats_t;
+
+// the console (the line being edited and the hashed command table)
+typedef struct
+{
+  const console_command_t * commands;
+  uint16_t count;
+  uint16_t slots[CONSOLE_HASH_SIZE];
+  char line[CONSOLE_LINE_SIZE];
+  uint16_t length;
+  uint8_t overflow;
+  console_stats_t stats;
+}
+console_t;
+
+// FUNCTIONS
+
+// set up a console with a table of commands - returns 0 if the table has too
+// many commands or the same name twice
+int console_init(console_t * console, const console_command_t * commands,
+  uint16_t count);
+
+// feed a character in from the uart - returns 1 when it finished a line (and
+// the line was run)
+int console_input(console_t * console, char c);
+
+// run a command line (this chops the line up in place)
+int console_execute(console_t * console, char * line);
+
+// look up a command by name (returns NULL if there isn't one)
+const console_command_t * console_find(console_t * console, const char * name);
+
+// print the list of commands
+void console_help(const console_t * console);
+
+// get the console numbers
+const console_stats_t * console_get_stats(const console_t * console);
+
+#endif // CONSOLE_H
@@ -0,0 +1,319 @@
+/*
+ * console.c
+ *
+ * a simple command shell for the virtual com port - a bounded line editor, a
+ * hashed table of commands, and typed argument parsing
+ *
+ * purpose:   55-604481 embedded computer networks : lab 103
+ */
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// include the console header
+#include "console.h"
+
+// HELPER FUNCTIONS
+
+// fnv-1a hash of a command name
+static uint32_t console_hash(const char * name)
+{
+  uint32_t hash = 2166136261UL;
+  while(*name)
+  {
+    hash ^= (uint8_t)(*name++);
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+// is a character a space between words
+static int console_space(char c)
+{
+  return (c == ' ') || (c == '\t');
+}
+
+// the name to show for each sort of argument
+static const char * console_arg_name(char type)
+{
+  switch(type)
+  {
+    case 'i':
+      return "<int>";
+    case 'u':
+      return "<uint>";
+    case 'f':
+      return "<float>";
+    default:
+      return "<word>";
+  }
+}
+
+// print how a command should be used (optional arguments are in brackets)
+static void console_usage(const console_command_t * command)
+{
+  const char * type;
+  int optional = 0;
+
+  printf("%s", command->name);
+  for(type = command->args; *type; type++)
+  {
+    if(*type == '|')
+    {
+      optional = 1;
+      continue;
+    }
+    printf(optional ? " [%s]" : " %s", console_arg_name(*type));
+  }
+}
+
+// parse one argument - returns 0 if it isn't the right type
+static int console_parse(char type, const char * word, console_arg_t * arg)
+{
+  char * end;
+  long value;
+  unsigned long unsigned_value;
+
+  errno = 0;
+  switch(type)
+  {
+    case 'i':
+      value = strtol(word, &end, 0);
+      if(value < INT32_MIN || value > INT32_MAX)
+      {
+        return 0;
+      }
+      arg->i = (int32_t)value;
+      break;
+
+    case 'u':
+      if(*word == '-')
+      {
+        return 0;
+      }
+      unsigned_value = strtoul(word, &end, 0);
+      if(unsigned_value > UINT32_MAX)
+      {
+        return 0;
+      }
+      arg->u = (uint32_t)unsigned_value;
+      break;
+
+    case 'f':
+      arg->f = strtof(word, &end);
+      break;
+
+    case 's':
+      arg->s = word;
+      return 1;
+
+    default:
+      return 0;
+  }
+  return (errno == 0) && (end != word) && (*end == '\0');
+}
+
+// METHODS
+
+// set up a console (building the hash table of commands)
+int console_init(console_t * console, const console_command_t * commands,
+  uint16_t count)
+{
+  uint16_t i;
+
+  memset(console, 0, sizeof(console_t));
+  if(count > CONSOLE_HASH_SIZE / 2)
+  {
+    return 0;
+  }
+  console->commands = commands;
+  console->count = count;
+
+  // put each command in the first free slot from where its name hashes to (the
+  // slots hold the table index plus one, so zero is free)
+  for(i = 0; i < count; i++)
+  {
+    uint32_t slot = console_hash(commands[i].name) & (CONSOLE_HASH_SIZE - 1);
+    while(console->slots[slot] != 0)
+    {
+      if(strcmp(commands[console->slots[slot] - 1].name, commands[i].name) == 0)
+      {
+        console->count = 0;
+        return 0;
+      }
+      slot = (slot + 1) & (CONSOLE_HASH_SIZE - 1);
+    }
+    console->slots[slot] = i + 1;
+  }
+  return 1;
+}
+
+// look up a command by name
+const console_command_t * console_find(console_t * console, const char * name)
+{
+  uint32_t slot = console_hash(name) & (CONSOLE_HASH_SIZE - 1);
+
+  if(console->count == 0)
+  {
+    return NULL;
+  }
+  while(console->slots[slot] != 0)
+  {
+    const console_command_t * command = &console->commands[console->slots[slot] - 1];
+    console->stats.probes++;
+    if(strcmp(command->name, name) == 0)
+    {
+      return command;
+    }
+    slot = (slot + 1) & (CONSOLE_HASH_SIZE - 1);
+  }
+  return NULL;
+}
+
+// chop a command line up into words, find the command and parse its arguments
+int console_execute(console_t * console, char * line)
+{
+  char * words[CONSOLE_MAX_ARGS + 1];
+  console_arg_t argv[CONSOLE_MAX_ARGS];
+  int count = 0;
+  int argc = 0;
+  int required = -1;
+  const char * type;
+
+  // split the line up at the spaces
+  while(*line)
+  {
+    while(console_space(*line))
+    {
+      *line++ = '\0';
+    }
+    if(*line == '\0')
+    {
+      break;
+    }
+    if(count == CONSOLE_MAX_ARGS + 1)
+    {
+      count++;
+      break;
+    }
+    words[count++] = line;
+    while(*line && !console_space(*line))
+    {
+      line++;
+    }
+  }
+  if(count == 0)
+  {
+    return CONSOLE_EMPTY;
+  }
+  console->stats.lines++;
+
+  // find the command
+  const console_command_t * command = console_find(console, words[0]);
+  if(command == NULL)
+  {
+    console->stats.unknown++;
+    printf("unknown command: %s (type help for commands)\r\n", words[0]);
+    return CONSOLE_UNKNOWN;
+  }
+
+  // parse the arguments against the argument string
+  for(type = command->args; *type; type++)
+  {
+    if(*type == '|')
+    {
+      required = argc;
+      continue;
+    }
+    if(argc + 1 >= count)
+    {
+      break;
+    }
+    if(!console_parse(*type, words[argc + 1], &argv[argc]))
+    {
+      break;
+    }
+    argc++;
+  }
+  if(required < 0)
+  {
+    required = strlen(command->args);
+  }
+  if(argc + 1 != count || argc < required)
+  {
+    console->stats.bad_args++;
+    printf("usage: ");
+    console_usage(command);
+    printf("\r\n");
+    return CONSOLE_BAD_ARGS;
+  }
+
+  return command->handler(argc, argv);
+}
+
+// line editor - build up the line a character at a time and run it at the end
+// of the line (anything past the end of the buffer is thrown away, and the
+// line is rejected rather than run half finished)
+int console_input(console_t * console, char c)
+{
+  if(c == '\r' || c == '\n')
+  {
+    int overflow = console->overflow;
+    console->line[console->length] = '\0';
+    console->length = 0;
+    console->overflow = 0;
+
+    if(overflow)
+    {
+      console->stats.too_long++;
+      printf("line too long (the most is %d characters)\r\n",
+        CONSOLE_LINE_SIZE - 1);
+      return 1;
+    }
+    return console_execute(console, console->line) != CONSOLE_EMPTY;
+  }
+
+  // backspace (or delete)
+  if(c == '\b' || c == 0x7F)
+  {
+    if(console->length > 0 && !console->overflow)
+    {
+      console->length--;
+    }
+    return 0;
+  }
+
+  // anything else goes on the end of the line (if there's room)
+  if(console->length < CONSOLE_LINE_SIZE - 1)
+  {
+    console->line[console->length++] = c;
+  }
+  else
+  {
+    console->overflow = 1;
+  }
+  return 0;
+}
+
+// print the list of commands
+void console_help(const console_t * console)
+{
+  uint16_t i;
+
+  printf("Available commands are:\r\n");
+  for(i = 0; i < console->count; i++)
+  {
+    printf("  ");
+    console_usage(&console->commands[i]);
+    printf(" - %s\r\n", console->commands[i].help);
+  }
+}
+
+// get the console numbers
+const console_stats_t * console_get_stats(const console_t * console)
+{
+  return &console->stats;
+}
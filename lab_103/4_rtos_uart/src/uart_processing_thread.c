@@ -26,6 +26,10 @@
 #include "clock.h"
 #include "gpio.h"
 #include "adc.h"
+
+// include the console
+#include "console.h"
+
 // RTOS DEFINES
 
 // declare the thread function prototypes, thread id, and priority
@@ -79,18 +83,163 @@ int init_uart_threads(void)
   return(0);
 }
 
+// CONSOLE COMMANDS
+
+// the pot reading above which read-pot warns us (settable from the console)
+static uint32_t pot_threshold = 4095;
+
+// whether to echo each command back (like the old debugging message)
+static uint32_t echo_lines = 1;
+
+// the console (this is quite big, so it lives here rather than on the
+// thread's stack)
+static console_t console;
+
+// switch one of the leds (1 to 3) or all of them on or off
+static void set_leds(uint32_t which, int state)
+{
+  if(which == 0 || which == 1)
+  {
+    write_gpio(led, state);
+  }
+  if(which == 0 || which == 2)
+  {
+    write_gpio(led2, state);
+  }
+  if(which == 0 || which == 3)
+  {
+    write_gpio(led3, state);
+  }
+  if(which == 0)
+  {
+    printf("all led's %s\r\n", (state == HIGH) ? "on" : "off");
+  }
+  else
+  {
+    printf("led %u %s\r\n", which, (state == HIGH) ? "on" : "off");
+  }
+}
+
+static int cmd_on_led1(int argc, const console_arg_t * argv)  { set_leds(1, HIGH); return 0; }
+static int cmd_on_led2(int argc, const console_arg_t * argv)  { set_leds(2, HIGH); return 0; }
+static int cmd_on_led3(int argc, const console_arg_t * argv)  { set_leds(3, HIGH); return 0; }
+static int cmd_on_all(int argc, const console_arg_t * argv)   { set_leds(0, HIGH); return 0; }
+static int cmd_off_led1(int argc, const console_arg_t * argv) { set_leds(1, LOW); return 0; }
+static int cmd_off_led2(int argc, const console_arg_t * argv) { set_leds(2, LOW); return 0; }
+static int cmd_off_led3(int argc, const console_arg_t * argv) { set_leds(3, LOW); return 0; }
+static int cmd_off_all(int argc, const console_arg_t * argv)  { set_leds(0, LOW); return 0; }
+
+// switch an led on or off by number (0 for all of them)
+static int cmd_led(int argc, const console_arg_t * argv)
+{
+  if(argv[0].u > 3)
+  {
+    printf("there are only 3 led's\r\n");
+    return -1;
+  }
+  set_leds(argv[0].u, argv[1].u ? HIGH : LOW);
+  return 0;
+}
+
+// read the pot (and say if it's over the threshold)
+static int cmd_read_pot(int argc, const console_arg_t * argv)
+{
+  uint16_t potVal = read_adc(pot);
+  printf("Value on pot is: %d%s\r\n", potVal,
+    (potVal > pot_threshold) ? " (over threshold)" : "");
+  return 0;
+}
+
+// read the button
+static int cmd_read_button(int argc, const console_arg_t * argv)
+{
+  uint8_t buttonVal = read_gpio(button);
+  if (buttonVal == 0)
+  {
+    printf("Button is un-pressed\r\n");
+  }
+  else
+  {
+    printf("Button is pressed\r\n");
+  }
+  return 0;
+}
+
+// get (or with an argument, set) the pot threshold
+static int cmd_threshold(int argc, const console_arg_t * argv)
+{
+  if(argc > 0)
+  {
+    if(argv[0].u > 4095)
+    {
+      printf("the pot only goes up to 4095\r\n");
+      return -1;
+    }
+    pot_threshold = argv[0].u;
+  }
+  printf("pot threshold is %u\r\n", pot_threshold);
+  return 0;
+}
+
+// get (or set) whether command lines are echoed back
+static int cmd_echo(int argc, const console_arg_t * argv)
+{
+  if(argc > 0)
+  {
+    echo_lines = argv[0].u;
+  }
+  printf("echo is %s\r\n", echo_lines ? "on" : "off");
+  return 0;
+}
+
+// print the console numbers
+static int cmd_stats(int argc, const console_arg_t * argv)
+{
+  const console_stats_t * stats = console_get_stats(&console);
+  printf("lines: %u, unknown: %u, bad arguments: %u, too long: %u, "
+    "lookups: %u\r\n", stats->lines, stats->unknown, stats->bad_args,
+    stats->too_long, stats->probes);
+  return 0;
+}
+
+// list the commands
+static int cmd_help(int argc, const console_arg_t * argv)
+{
+  console_help(&console);
+  return 0;
+}
+
+// the command table
+static const console_command_t commands[] =
+{
+  CONSOLE_COMMAND("on-led1",     "",   cmd_on_led1,     "turn led 1 on"),
+  CONSOLE_COMMAND("off-led1",    "",   cmd_off_led1,    "turn led 1 off"),
+  CONSOLE_COMMAND("on-led2",     "",   cmd_on_led2,     "turn led 2 on"),
+  CONSOLE_COMMAND("off-led2",    "",   cmd_off_led2,    "turn led 2 off"),
+  CONSOLE_COMMAND("on-led3",     "",   cmd_on_led3,     "turn led 3 on"),
+  CONSOLE_COMMAND("off-led3",    "",   cmd_off_led3,    "turn led 3 off"),
+  CONSOLE_COMMAND("on-all",      "",   cmd_on_all,      "turn all the led's on"),
+  CONSOLE_COMMAND("off-all",     "",   cmd_off_all,     "turn all the led's off"),
+  CONSOLE_COMMAND("led",         "uu", cmd_led,         "set led n (0 for all) on (1) or off (0)"),
+  CONSOLE_COMMAND("read-pot",    "",   cmd_read_pot,    "read the pot"),
+  CONSOLE_COMMAND("read-button", "",   cmd_read_button, "read the button"),
+  CONSOLE_COMMAND("threshold",   "|u", cmd_threshold,   "get / set the pot threshold"),
+  CONSOLE_COMMAND("echo",        "|u", cmd_echo,        "get / set command echo"),
+  CONSOLE_COMMAND("stats",       "",   cmd_stats,       "show the console numbers"),
+  CONSOLE_COMMAND("help",        "",   cmd_help,        "list the commands"),
+};
+
 // ACTUAL THREADS
 
 // uart receive thread
 void uart_rx_thread(void const *argument)
 {
+  // set up the console with our commands
+  console_init(&console, commands, sizeof(commands) / sizeof(commands[0]));
+
   // print some status message ...
   printf("still alive!\r\nType help for commands\r\n");
   
-  // create a packet array to use as a buffer to build up our string
-  uint8_t packet[128];
-  int i = 0;
-  
   // infinite loop ...
   while(1)
   {     
@@ -100,119 +249,16 @@ void uart_rx_thread(void const *argument)
     // process the message queue ...
     if(evt.status == osEventMessage)
     {
-      // get the message and increment the counter
-      uint8_t byte = evt.value.v;
-      // if we get a new line character ...
-      if(byte == '\n')
-      {    
-        // add string terminator (we need this - otherwise we will keep reading 
-        // past the end of the last packet received ...)
-        packet[i] = '\0';
-        
-        // decide whether to turn the led on or off by doing a string 
-        // comparison ...
-        // note: the strcmp function requires an exact match so if you are 
-        // using teraterm or putty you will need to set the tx options 
-        // correctly
-        // see: http://www.tutorialspoint.com/c_standard_library/c_function_strcmp.htm
-        // for strcmp details ...
-				
-				//Test start of line to prevent excessive checks when false inputs
-				if(strncmp((char*)packet, "on-",3) == 0){
-					if(strcmp((char*)packet, "on-led1\r") == 0)
-					{
-						write_gpio(led, HIGH);
-						printf("led 1 on\r\n");
-					}
-					if(strcmp((char*)packet, "on-led2\r") == 0)
-					{
-						write_gpio(led2, HIGH);
-						printf("led 2 on\r\n");
-					}
-					if(strcmp((char*)packet, "on-led3\r") == 0)
-					{
-						write_gpio(led3, HIGH);
-						printf("led 3 on\r\n");
-					}
-					if(strcmp((char*)packet, "on-all\r") == 0)
-					{
-						write_gpio(led, HIGH);
-						write_gpio(led2, HIGH);
-						write_gpio(led3, HIGH);
-						printf("all led's on\r\n");
-					}
-				}
-				if(strncmp((char*)packet, "off-",3) == 0){
-					if(strcmp((char*)packet, "off-led1\r") == 0)
-					{
-						write_gpio(led, LOW);
-						printf("led 1 off\r\n");
-					}
-					if(strcmp((char*)packet, "off-led2\r") == 0)
-					{
-						write_gpio(led2, LOW);
-						printf("led 2 off\r\n");
-					}
-					if(strcmp((char*)packet, "off-led3\r") == 0)
-					{
-						write_gpio(led3, LOW);
-						printf("led 3 off\r\n");
-					}
-					if(strcmp((char*)packet, "off-all\r") == 0)
-					{
-						write_gpio(led, LOW);
-						write_gpio(led2, LOW);
-						write_gpio(led3, LOW);
-						printf("all led's off\r\n");
-					}
-				}
-				if(strncmp((char*)packet, "read-",3) == 0){
-					if(strcmp((char*)packet, "read-pot\r") == 0){
-						uint16_t potVal = read_adc(pot);
-						printf("Value on pot is: %d",potVal);
-						printf("\r\n");
-					}
-					if(strcmp((char*)packet, "read-button\r") == 0){
-						uint8_t buttonVal = read_gpio(button);
-						if (buttonVal == 0){
-							printf("Button is un-pressed\r\n");
-						}
-						else{
-							printf("Button is pressed\r\n");
-						}
-					}
-				}
-				if(strcmp((char*)packet, "help\r") == 0)
-        {
-          printf("Available commands are:\r\n");
-					printf("on-led1\n");
-					printf("off-led1\n");
-					printf("on-led2\n");
-					printf("off-led2\n");
-					printf("on-led3\n");
-					printf("off-led3\n");
-					printf("on-all\n");
-					printf("off-all\n");
-					printf("read-pot\n");
-					printf("read-button\n");
-        }
-				
-        // print debugging message to the uart
-        printf("DEBUGGING: %s\r\n", packet);
-        
-        // zero the packet index
-        i = 0;
-      }
-      else
+      // hand the character to the console's line editor (which runs the
+      // command at the end of the line) - line endings can be \r, \n or both
+      // so teraterm / putty don't need setting up specially
+      char byte = (char)evt.value.v;
+      if(console_input(&console, byte) && echo_lines)
       {
-				if((byte == '\b') && (i != 0)){
-					i--;
-				}
-				else{
-					packet[i] = byte;
-					i++;
-				}
-      }       
+        // print debugging message to the uart (the line has been chopped up
+        // into words by now, so this is just the command name)
+        printf("DEBUGGING: %s\r\n", console.line);
+      }
     }
   } 
 }
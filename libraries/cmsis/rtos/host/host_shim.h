@@ -0,0 +1,28 @@
+/*
+ * host_shim.h
+ *
+ * what the kernel list code gets from the arm compiler and the cortex-m core,
+ * done in plain c so rt_List.c can be built on a pc (forced in with -include)
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// define to prevent recursive inclusion
+#ifndef __HOST_SHIM_H
+#define __HOST_SHIM_H
+
+// interrupts don't exist here - the test provides these as do nothing functions
+unsigned int __disable_irq(void);
+void __enable_irq(void);
+
+// armcc keywords used in cmsis_os.h
+#define __value_in_regs
+#define __declspec(x)
+
+// count leading zeros (the armcc intrinsic)
+static inline unsigned char __clz(unsigned int value)
+{
+	return (value == 0) ? 32 : (unsigned char)__builtin_clz(value);
+}
+
+#endif // HOST_SHIM_H
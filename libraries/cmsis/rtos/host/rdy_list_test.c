@@ -0,0 +1,459 @@
+/*
+ * rdy_list_test.c
+ *
+ * run the rtx ready list code (src/rt_List.c) on a pc - built once with the
+ * sorted list and once with the priority bitmap (OS_RDY_BITMAP):
+ *
+ * - test: random make ready / dispatch / preempt / pass / remove / change
+ *   priority / round robin / delay steps, checking the ready list against a
+ *   simple model (highest priority first, first in first out within a
+ *   priority) and, with the bitmap, that the bitmap and tails agree with it
+ * - bench: how long making a low priority task ready and a round robin swap
+ *   take with 8, 32 and 128 tasks ready
+ *
+ * usage: make && ./rdy_list_test_list && ./rdy_list_test_bitmap
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the kernel headers (first, as rt_TypeDef.h defines NULL itself)
+#include "rt_TypeDef.h"
+#include "RTX_Config.h"
+#include "rt_List.h"
+#include "rt_Task.h"
+#include "rt_Time.h"
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_TASKS		40
+#define TEST_STEPS		2000000
+#define BENCH_WAKES		8
+#define BENCH_LOOPS		200000
+
+// what the rest of the kernel would provide
+struct OS_TSK os_tsk;
+U32 os_time;
+U32 os_fifo[4];
+
+unsigned int __disable_irq(void)
+{
+	return 0;
+}
+
+void __enable_irq(void)
+{
+}
+
+void os_error(uint32_t err_code)
+{
+	printf("os_error(%u)\n", err_code);
+	exit(1);
+}
+
+static struct OS_TCB tasks[TEST_TASKS];
+static struct OS_TCB running;
+static struct OS_SCB sem;
+
+// the ready list and the semaphore wait list as they should be
+static P_TCB model_rdy[TEST_TASKS], model_sem[TEST_TASKS];
+static int model_rdy_count, model_sem_count;
+
+// the task sleeping in the delay list (there's only ever one, so it's clear
+// where it should end up)
+static P_TCB sleeper;
+static U32 sleeper_wakes;
+
+static int errors = 0;
+
+// LIST MODEL
+
+// put a task in behind the ones of the same or higher priority
+static void model_put(P_TCB * list, int * count, P_TCB task)
+{
+	int i = 0;
+	while(i < *count && list[i]->prio >= task->prio)
+	{
+		i++;
+	}
+	memmove(&list[i + 1], &list[i], (*count - i) * sizeof(P_TCB));
+	list[i] = task;
+	(*count)++;
+}
+
+static void model_remove(P_TCB * list, int * count, P_TCB task)
+{
+	int i;
+	for(i = 0; i < *count; i++)
+	{
+		if(list[i] == task)
+		{
+			memmove(&list[i], &list[i + 1], (*count - i - 1) * sizeof(P_TCB));
+			(*count)--;
+			return;
+		}
+	}
+}
+
+static U8 random_prio(void)
+{
+	// mostly the cmsis priorities (and the idle task's 0), sometimes ones that
+	// share the top bucket of the bitmap
+	static const U8 high[] = {30, 31, 40, 255};
+	return (rand() % 8) ? (U8)(rand() % 9) : high[rand() % 4];
+}
+
+// pick a task that isn't in any list
+static P_TCB idle_task(void)
+{
+	int i, start = rand() % TEST_TASKS;
+	for(i = 0; i < TEST_TASKS; i++)
+	{
+		P_TCB task = &tasks[(start + i) % TEST_TASKS];
+		if(task->state == INACTIVE)
+		{
+			return task;
+		}
+	}
+	return NULL;
+}
+
+// CHECKS
+
+static void check(const char * step, long n)
+{
+	P_TCB task;
+	int i;
+
+	for(task = os_rdy.p_lnk, i = 0; task != NULL; task = task->p_lnk, i++)
+	{
+		if(i >= model_rdy_count || task != model_rdy[i] || task->p_rlnk != NULL)
+		{
+			break;
+		}
+	}
+	if(task != NULL || i != model_rdy_count)
+	{
+		printf("step %ld (%s): ready list differs at entry %d\n", n, step, i);
+		errors++;
+	}
+
+	for(task = sem.p_lnk, i = 0; task != NULL; task = task->p_lnk, i++)
+	{
+		if(i >= model_sem_count || task != model_sem[i] ||
+			task->p_rlnk != ((i == 0) ? (P_TCB)&sem : model_sem[i - 1]))
+		{
+			break;
+		}
+	}
+	if(task != NULL || i != model_sem_count)
+	{
+		printf("step %ld (%s): wait list differs at entry %d\n", n, step, i);
+		errors++;
+	}
+
+#if (OS_RDY_BITMAP != 0U)
+	// each bucket's bit is set if it has tasks, and its tail is the last one
+	U32 bucket;
+	for(bucket = 0; bucket < OS_RDY_BUCKETS; bucket++)
+	{
+		P_TCB last = NULL;
+		for(i = 0; i < model_rdy_count; i++)
+		{
+			U32 prio = model_rdy[i]->prio;
+			if(((prio < OS_RDY_BUCKETS - 1U) ? prio : OS_RDY_BUCKETS - 1U) == bucket)
+			{
+				last = model_rdy[i];
+			}
+		}
+		int set = (os_rdy_map >> bucket) & 1U;
+		if(set != (last != NULL) || (set && os_rdy_tail[bucket] != last))
+		{
+			printf("step %ld (%s): bucket %u is wrong\n", n, step, bucket);
+			errors++;
+		}
+	}
+#endif
+	if(errors > 10)
+	{
+		exit(1);
+	}
+}
+
+// TEST
+
+static void test(void)
+{
+	long n;
+	int i;
+	P_TCB task;
+
+	memset(tasks, 0, sizeof(tasks));
+	for(i = 0; i < TEST_TASKS; i++)
+	{
+		tasks[i].cb_type = TCB;
+		tasks[i].task_id = (U8)(i + 1);
+		tasks[i].prio = random_prio();
+		tasks[i].state = INACTIVE;
+	}
+	os_rdy.cb_type = HCB;
+	os_rdy.p_lnk = NULL;
+#if (OS_RDY_BITMAP != 0U)
+	os_rdy_map = 0;
+#endif
+	os_dly.cb_type = HCB;
+	sem.cb_type = SCB;
+	running.cb_type = TCB;
+	os_tsk.run = &running;
+
+	for(n = 0; n < TEST_STEPS; n++)
+	{
+		const char * step;
+
+		switch(rand() % 10)
+		{
+			// make a task ready
+			case 0:
+			case 1:
+				step = "ready";
+				if((task = idle_task()) != NULL)
+				{
+					task->state = READY;
+					rt_put_prio(&os_rdy, task);
+					model_put(model_rdy, &model_rdy_count, task);
+				}
+				break;
+
+			// run the highest priority task
+			case 2:
+				step = "dispatch";
+				if(model_rdy_count > 0)
+				{
+					task = rt_get_first(&os_rdy);
+					if(task != model_rdy[0] || task->p_lnk != NULL)
+					{
+						printf("step %ld: dispatched the wrong task\n", n);
+						errors++;
+					}
+					model_remove(model_rdy, &model_rdy_count, task);
+					task->state = INACTIVE;
+				}
+				break;
+
+			// a preempted task goes back on the front
+			case 3:
+				step = "preempt";
+				if((task = idle_task()) != NULL)
+				{
+					if(model_rdy_count > 0 && task->prio < model_rdy[0]->prio)
+					{
+						task->prio = model_rdy[0]->prio;
+					}
+					task->state = READY;
+					rt_put_rdy_first(task);
+					memmove(&model_rdy[1], &model_rdy[0], model_rdy_count * sizeof(P_TCB));
+					model_rdy[0] = task;
+					model_rdy_count++;
+				}
+				break;
+
+			// the running task passes to another one of the same priority
+			case 4:
+				step = "pass";
+				if(model_rdy_count > 0)
+				{
+					running.prio = (rand() % 2) ? model_rdy[0]->prio : random_prio();
+					task = rt_get_same_rdy_prio();
+					if(model_rdy[0]->prio == running.prio)
+					{
+						if(task != model_rdy[0])
+						{
+							printf("step %ld: passed to the wrong task\n", n);
+							errors++;
+						}
+						model_remove(model_rdy, &model_rdy_count, model_rdy[0]);
+						task->p_lnk = NULL;
+						task->state = INACTIVE;
+					}
+					else if(task != NULL)
+					{
+						printf("step %ld: passed to a lower priority task\n", n);
+						errors++;
+					}
+				}
+				break;
+
+			// take a task out (deleted), or change its priority
+			case 5:
+			case 6:
+				step = "priority";
+				task = &tasks[rand() % TEST_TASKS];
+				if(task->state == READY || task->state == WAIT_SEM)
+				{
+					int ready = (task->state == READY);
+					if(rand() % 4 == 0)
+					{
+						step = "remove";
+						rt_rmv_list(task);
+						model_remove(ready ? model_rdy : model_sem, ready ? &model_rdy_count :
+							&model_sem_count, task);
+						task->p_lnk = task->p_rlnk = NULL;
+						task->state = INACTIVE;
+					}
+					else
+					{
+						task->prio = random_prio();
+						rt_resort_prio(task);
+						model_remove(ready ? model_rdy : model_sem, ready ? &model_rdy_count :
+							&model_sem_count, task);
+						model_put(ready ? model_rdy : model_sem, ready ? &model_rdy_count :
+							&model_sem_count, task);
+					}
+				}
+				break;
+
+			// round robin swap
+			case 7:
+				step = "robin";
+				if(model_rdy_count > 0)
+				{
+					task = rt_get_first(&os_rdy);
+					rt_put_prio(&os_rdy, task);
+					model_remove(model_rdy, &model_rdy_count, task);
+					model_put(model_rdy, &model_rdy_count, task);
+				}
+				break;
+
+			// wait on (or get released by) the semaphore
+			case 8:
+				step = "semaphore";
+				if(model_sem_count > 0 && rand() % 2)
+				{
+					task = rt_get_first((P_XCB)&sem);
+					model_remove(model_sem, &model_sem_count, task);
+					task->state = READY;
+					rt_put_prio(&os_rdy, task);
+					model_put(model_rdy, &model_rdy_count, task);
+				}
+				else if((task = idle_task()) != NULL)
+				{
+					task->state = WAIT_SEM;
+					rt_put_prio((P_XCB)&sem, task);
+					model_put(model_sem, &model_sem_count, task);
+				}
+				break;
+
+			// sleep, and let the clock tick
+			default:
+				step = "delay";
+				if(sleeper == NULL && (task = idle_task()) != NULL)
+				{
+					task->state = WAIT_DLY;
+					rt_put_dly(task, (U16)(1 + rand() % 4));
+					sleeper = task;
+				}
+				os_time++;
+				rt_dec_dly();
+				if(sleeper != NULL && sleeper->state == READY)
+				{
+					model_put(model_rdy, &model_rdy_count, sleeper);
+					sleeper = NULL;
+					sleeper_wakes++;
+				}
+				break;
+		}
+		check(step, n);
+	}
+	printf("test: %d steps, %u wakes from the delay list - %s\n", TEST_STEPS, sleeper_wakes,
+		errors ? "FAILED" : "the ready list always matched");
+}
+
+// BENCHMARK
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct OS_TCB bench_idle;
+static struct OS_TCB bench_tasks[128 + BENCH_WAKES];
+
+// empty the ready list, apart from the idle task
+static void bench_empty(void)
+{
+	os_rdy.p_lnk = NULL;
+#if (OS_RDY_BITMAP != 0U)
+	os_rdy_map = 0;
+#endif
+	memset(bench_tasks, 0, sizeof(bench_tasks));
+	bench_idle.prio = 0;
+	rt_put_prio(&os_rdy, &bench_idle);
+}
+
+static void bench(int ready)
+{
+	double start, wake, robin;
+	long loop;
+	int i;
+
+	// wake a few priority 1 tasks with the rest ready at priorities 7 to 1 -
+	// they go in behind all of them
+	bench_empty();
+	for(i = 0; i < ready; i++)
+	{
+		bench_tasks[i].prio = (U8)(7 - i % 7);
+		rt_put_prio(&os_rdy, &bench_tasks[i]);
+	}
+	wake = 0;
+	for(loop = 0; loop < BENCH_LOOPS / BENCH_WAKES; loop++)
+	{
+		start = now_ns();
+		for(i = ready; i < ready + BENCH_WAKES; i++)
+		{
+			bench_tasks[i].prio = 1;
+			rt_put_prio(&os_rdy, &bench_tasks[i]);
+		}
+		wake += now_ns() - start;
+		for(i = ready; i < ready + BENCH_WAKES; i++)
+		{
+			rt_rmv_list(&bench_tasks[i]);
+		}
+	}
+	wake /= (BENCH_LOOPS / BENCH_WAKES) * BENCH_WAKES;
+
+	// round robin between tasks of the same priority
+	bench_empty();
+	for(i = 0; i < ready; i++)
+	{
+		bench_tasks[i].prio = 4;
+		rt_put_prio(&os_rdy, &bench_tasks[i]);
+	}
+	start = now_ns();
+	for(loop = 0; loop < BENCH_LOOPS; loop++)
+	{
+		rt_put_prio(&os_rdy, rt_get_first(&os_rdy));
+	}
+	robin = (now_ns() - start) / BENCH_LOOPS;
+
+	printf("bench: %3d tasks ready - wake a low priority task %6.1f ns, round robin swap %6.1f ns\n",
+		ready, wake, robin);
+}
+
+int main(void)
+{
+	srand(2468);
+	printf("ready list: %s\n", OS_RDY_BITMAP ? "priority bitmap" : "sorted list");
+
+	test();
+	bench(8);
+	bench(32);
+	bench(128);
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
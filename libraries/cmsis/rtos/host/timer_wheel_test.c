@@ -0,0 +1,437 @@
+/*
+ * timer_wheel_test.c
+ *
+ * run the rtx delay list (src/rt_List.c) and the cmsis timer list
+ * (src/rt_Timer.c) on a pc - built once with the lists sorted by time and
+ * once with the timer wheel (OS_TIMER_WHEEL):
+ *
+ * - test: tasks sleeping (some with a semaphore timeout) and being woken
+ *   early, and one shot / periodic timers being started, restarted and
+ *   stopped, with ticks and tickless sleeps in between - every task has to
+ *   wake, and every timer has to fire, on the tick a model says it's due
+ * - bench: how long a tick takes with 8, 32 and 128 tasks sleeping (or
+ *   timers running), when one of them is woken early (or restarted) every
+ *   tick as well
+ *
+ * usage: make && ./timer_wheel_test_list && ./timer_wheel_test_wheel
+ *
+ * purpose:   55-604481 embedded computer networks : lab 104
+ */
+
+// include the kernel headers (first, as rt_TypeDef.h defines NULL itself)
+#include "rt_TypeDef.h"
+#include "RTX_Config.h"
+#include "rt_List.h"
+#include "rt_Task.h"
+#include "rt_Time.h"
+#include "rt_Timer.h"
+#include "cmsis_os.h"
+
+// include the relevant header files (from the c standard libraries)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_TASKS		48
+#define TEST_TIMERS		48
+#define TEST_TICKS		2000000
+#define BENCH_MAX			128
+#define BENCH_TICKS		200000
+
+// what the rest of the kernel would provide
+struct OS_TSK os_tsk;
+U32 os_time;
+U32 os_fifo[4];
+osMessageQId osMessageQId_osTimerMessageQ;
+
+unsigned int __disable_irq(void)
+{
+	return 0;
+}
+
+void __enable_irq(void)
+{
+}
+
+void os_error(uint32_t err_code)
+{
+	printf("os_error(%u)\n", err_code);
+	exit(1);
+}
+
+static struct OS_TCB tasks[BENCH_MAX];
+static struct OS_SCB sem;
+static os_timer_cb timers[BENCH_MAX];
+
+// the tick each task should wake on, and each timer should fire on (0 for
+// none)
+static U32 task_due[BENCH_MAX], timer_due[BENCH_MAX];
+static U32 woken, fired;
+static int checking = 0;
+static int errors = 0;
+
+// the tasks woken on the last tick
+static P_TCB woken_now[BENCH_MAX];
+static int woken_count;
+
+// a quick random number (so the benchmark is timing the lists, not rand)
+static U32 random_state = 2468;
+static U32 random_next(U32 range)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state % range;
+}
+
+static void failed(const char * what, int i)
+{
+	printf("tick %u: %s %d\n", os_time, what, i);
+	if(++errors > 10)
+	{
+		exit(1);
+	}
+}
+
+// TIMER SERVICE CALLS (what svcTimerStart and svcTimerStop do)
+
+// the timer thread's queue - the only thing a timer does here is get posted
+osStatus isrMessagePut(osMessageQId queue_id, uint32_t info, uint32_t millisec)
+{
+	int i;
+
+	fired++;
+	if(!checking)
+	{
+		return osOK;
+	}
+	for(i = 0; i < TEST_TIMERS && (uint32_t)(size_t)&timers[i] != info; i++)
+	{
+	}
+	if(i == TEST_TIMERS || timer_due[i] != os_time)
+	{
+		failed("timer fired at the wrong time", i);
+		return osOK;
+	}
+	timer_due[i] = (timers[i].type == osTimerPeriodic) ? os_time + timers[i].icnt : 0;
+	return osOK;
+}
+
+static void timer_start(int i, uint32_t tcnt)
+{
+	os_timer_cb * pt = &timers[i];
+
+	if(pt->state == osTimerRunning)
+	{
+		if(rt_timer_remove(pt) != 0)
+		{
+			failed("couldn't remove running timer", i);
+		}
+	}
+	else
+	{
+		pt->state = osTimerRunning;
+		pt->icnt = tcnt;
+	}
+	rt_timer_insert(pt, tcnt);
+	timer_due[i] = os_time + tcnt;
+}
+
+static void timer_stop(int i)
+{
+	if(timers[i].state == osTimerRunning)
+	{
+		timers[i].state = osTimerStopped;
+		if(rt_timer_remove(&timers[i]) != 0)
+		{
+			failed("couldn't remove running timer", i);
+		}
+		timer_due[i] = 0;
+	}
+}
+
+// the same as a tick in rt_systick (without the task switch)
+static void tick(void)
+{
+	P_TCB task;
+
+	os_time++;
+	rt_dec_dly();
+	sysTimerTick();
+
+	// everything woken is in the ready list
+	woken_count = 0;
+	while(os_rdy.p_lnk != NULL)
+	{
+		task = rt_get_first(&os_rdy);
+		woken_now[woken_count++] = task;
+		woken++;
+		if(checking && task_due[task - tasks] != os_time)
+		{
+			failed("task woke at the wrong time", (int)(task - tasks));
+		}
+		task_due[task - tasks] = 0;
+		task->state = INACTIVE;
+	}
+}
+
+static void reset(int count)
+{
+	int i;
+
+	memset(tasks, 0, sizeof(tasks));
+	memset(timers, 0, sizeof(timers));
+	memset(task_due, 0, sizeof(task_due));
+	memset(timer_due, 0, sizeof(timer_due));
+	for(i = 0; i < count; i++)
+	{
+		tasks[i].cb_type = TCB;
+		tasks[i].prio = 1;
+		timers[i].state = osTimerStopped;
+	}
+	os_time = 0;
+	os_rdy.cb_type = HCB;
+	os_rdy.p_lnk = NULL;
+	os_dly.cb_type = HCB;
+	os_dly.p_dlnk = NULL;
+	os_dly.delta_time = 0;
+	sem.cb_type = SCB;
+	sem.p_lnk = NULL;
+#if (OS_RDY_BITMAP != 0U)
+	os_rdy_map = 0;
+#endif
+#if (OS_TIMER_WHEEL != 0U)
+	for(i = 0; i < OS_WHEEL_SLOTS; i++)
+	{
+		os_dly_wheel[i].cb_type = HCB;
+		os_dly_wheel[i].p_dlnk = NULL;
+		os_timer_wheel[i] = NULL;
+	}
+	os_dly_count = 0;
+	os_timer_count = 0;
+	os_timer_time = 0;
+#else
+	os_timer_head = NULL;
+#endif
+}
+
+// TEST
+
+static U16 random_delay(void)
+{
+	// mostly short, sometimes many turns of the wheel
+	switch(random_next(8))
+	{
+		case 0:
+			return (U16)(1 + random_next(0xFFFE));
+		case 1:
+			return (U16)(1 + random_next(3));
+		default:
+			return (U16)(1 + random_next(300));
+	}
+}
+
+static void test_delays(void)
+{
+	long n;
+	int i;
+
+	reset(TEST_TASKS);
+	checking = 1;
+	woken = 0;
+	for(n = 0; n < TEST_TICKS; n++)
+	{
+		i = random_next(TEST_TASKS);
+		if(tasks[i].state == INACTIVE)
+		{
+			// go to sleep, or wait on the semaphore with a time out
+			U16 delay = random_delay();
+			if(random_next(2))
+			{
+				tasks[i].state = WAIT_SEM;
+				rt_put_prio((P_XCB)&sem, &tasks[i]);
+			}
+			else
+			{
+				tasks[i].state = WAIT_DLY;
+			}
+			rt_put_dly(&tasks[i], delay);
+			task_due[i] = os_time + delay;
+		}
+		else if(random_next(4) == 0)
+		{
+			// woken early (what a semaphore release or a signal does)
+			rt_rmv_dly(&tasks[i]);
+			rt_rmv_list(&tasks[i]);
+			tasks[i].p_lnk = tasks[i].p_rlnk = NULL;
+			tasks[i].state = INACTIVE;
+			task_due[i] = 0;
+		}
+		tick();
+
+		// a task that timed out of the semaphore isn't waiting on it any more
+		P_TCB task;
+		for(task = sem.p_lnk; task != NULL; task = task->p_lnk)
+		{
+			if(task->state != WAIT_SEM)
+			{
+				failed("task left waiting on the semaphore", (int)(task - tasks));
+			}
+		}
+
+#if (OS_TIMER_WHEEL != 0U)
+		// what rt_suspend would sleep for
+		if(n % 1000 == 0)
+		{
+			U32 wakeup = 0xFFFF;
+			for(i = 0; i < TEST_TASKS; i++)
+			{
+				if(task_due[i] != 0 && task_due[i] - os_time < wakeup)
+				{
+					wakeup = task_due[i] - os_time;
+				}
+			}
+			if(rt_dly_wakeup() != wakeup)
+			{
+				failed("wrong wake up time", (int)rt_dly_wakeup());
+			}
+		}
+#endif
+	}
+	for(i = 0; i < TEST_TASKS; i++)
+	{
+		if(task_due[i] != 0 && task_due[i] <= os_time)
+		{
+			failed("task never woke", i);
+		}
+	}
+	printf("test: %d ticks, %u tasks woken by their time out - %s\n", TEST_TICKS, woken,
+		errors ? "FAILED" : "every one on time");
+}
+
+static void test_timers(void)
+{
+	long n;
+	int i;
+	U32 sleeps = 0;
+
+	reset(TEST_TIMERS);
+	checking = 1;
+	fired = 0;
+	for(n = 0; n < TEST_TICKS; n++)
+	{
+		i = random_next(TEST_TIMERS);
+		switch(random_next(6))
+		{
+			case 0:
+				timers[i].type = random_next(2) ? osTimerPeriodic : osTimerOnce;
+				timer_start(i, random_delay());
+				break;
+			case 1:
+				timer_stop(i);
+				break;
+		}
+
+		if(random_next(100) == 0)
+		{
+			// a tickless sleep, for as long as rt_suspend would allow
+			U32 wakeup = sysUserTimerWakeupTime();
+			U32 sleep = 1 + random_next((wakeup < 2000) ? wakeup : 2000);
+			os_time += sleep;
+			sysUserTimerUpdate(sleep);
+			sleeps++;
+		}
+		else
+		{
+			tick();
+		}
+
+		for(i = 0; i < TEST_TIMERS; i++)
+		{
+			if(timer_due[i] != 0 && (S32)(os_time - timer_due[i]) >= 0)
+			{
+				failed("timer never fired", i);
+				timer_due[i] = 0;
+			}
+		}
+	}
+	printf("test: %d ticks (%u tickless sleeps), %u timers fired - %s\n", TEST_TICKS, sleeps,
+		fired, errors ? "FAILED" : "every one on time");
+}
+
+// BENCHMARK
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(int count)
+{
+	double start, delays, timing;
+	long n;
+	int i;
+
+	// tasks sleeping up to a second, going back to sleep when they wake, and
+	// one woken early every tick (a reply coming in before the time out)
+	reset(count);
+	checking = 0;
+	for(i = 0; i < count; i++)
+	{
+		tasks[i].state = WAIT_DLY;
+		rt_put_dly(&tasks[i], (U16)(1 + random_next(1000)));
+	}
+	start = now_ns();
+	for(n = 0; n < BENCH_TICKS; n++)
+	{
+		i = random_next(count);
+		if(tasks[i].state == WAIT_DLY)
+		{
+			rt_rmv_dly(&tasks[i]);
+			rt_put_dly(&tasks[i], (U16)(1 + random_next(1000)));
+		}
+		tick();
+		for(i = 0; i < woken_count; i++)
+		{
+			woken_now[i]->state = WAIT_DLY;
+			rt_put_dly(woken_now[i], (U16)(1 + random_next(1000)));
+		}
+	}
+	delays = (now_ns() - start) / BENCH_TICKS;
+
+	// periodic timers up to a second, and one restarted every tick (a retry
+	// timer pushed back)
+	reset(count);
+	for(i = 0; i < count; i++)
+	{
+		timers[i].type = osTimerPeriodic;
+		timer_start(i, 10 + random_next(1000));
+	}
+	start = now_ns();
+	for(n = 0; n < BENCH_TICKS; n++)
+	{
+		timer_start(random_next(count), 10 + random_next(1000));
+		tick();
+	}
+	timing = (now_ns() - start) / BENCH_TICKS;
+
+	printf("bench: %3d sleeping - tick with delays %6.1f ns, tick with timers %6.1f ns\n",
+		count, delays, timing);
+}
+
+int main(void)
+{
+	printf("delays and timers: %s\n", OS_TIMER_WHEEL ? "timer wheel" : "sorted lists");
+
+	test_delays();
+	test_timers();
+	bench(8);
+	bench(32);
+	bench(128);
+
+	printf("%s (%d problems)\n", errors ? "FAILED" : "ok", errors);
+	return errors != 0;
+}
@@ -37,6 +37,25 @@
 #define _declare_box8(pool,size,cnt)  U64 pool[(((size)+7)/8)*(cnt) + 2]
 #define _init_box8(pool,size,bsize)   _init_box (pool,size,(bsize) | BOX_ALIGN_8)
 
+/* Ready list: 0 = one list sorted by walking it, 1 = also keep a priority  */
+/* bitmap and the last task of each priority, so tasks are made ready and  */
+/* dispatched in constant time (uses CLZ, which Cortex-M0 does in software) */
+#ifndef OS_RDY_BITMAP
+ #define OS_RDY_BITMAP                0U
+#endif
+#define OS_RDY_BUCKETS                32U
+
+/* Delays and CMSIS timers: 0 = lists sorted by time, walked to insert,   */
+/* 1 = a timer wheel of OS_WHEEL_SLOTS lists hashed by the expiry tick, so  */
+/* starting and stopping doesn't walk the others; each tick checks the one  */
+/* slot for that tick (OS_WHEEL_SLOTS must be a power of 2)                 */
+#ifndef OS_TIMER_WHEEL
+ #define OS_TIMER_WHEEL               0U
+#endif
+#ifndef OS_WHEEL_SLOTS
+ #define OS_WHEEL_SLOTS               32U
+#endif
+
 /* Variables */
 extern U32 mp_tcb[];
 extern U64 mp_stk[];
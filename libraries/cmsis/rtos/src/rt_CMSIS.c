@@ -47,6 +47,7 @@
 #include "rt_Mailbox.h"
 #include "rt_MemBox.h"
 #include "rt_Memory.h"
+#include "rt_Timer.h"
 #include "rt_HAL_CM.h"
 
 #define os_thread_cb OS_TCB
@@ -898,78 +899,7 @@ os_InRegs osEvent osWait (uint32_t millisec) {
 
 // ==== Timer Management ====
 
-// Timer definitions
-#define osTimerInvalid  0U
-#define osTimerStopped  1U
-#define osTimerRunning  2U
-
-// Timer structures 
-
-typedef struct os_timer_cb_ {                   // Timer Control Block
-  struct os_timer_cb_ *next;                    // Pointer to next active Timer
-  uint8_t             state;                    // Timer State
-  uint8_t              type;                    // Timer Type (Periodic/One-shot)
-  uint16_t         reserved;                    // Reserved
-  uint32_t             tcnt;                    // Timer Delay Count
-  uint32_t             icnt;                    // Timer Initial Count 
-  void                 *arg;                    // Timer Function Argument
-  const osTimerDef_t *timer;                    // Pointer to Timer definition
-} os_timer_cb;
-
-// Timer variables
-os_timer_cb *os_timer_head;                     // Pointer to first active Timer
-
-
-// Timer Helper Functions
-
-// Insert Timer into the list sorted by time
-static void rt_timer_insert (os_timer_cb *pt, uint32_t tcnt) {
-  os_timer_cb *p, *prev;
-
-  prev = NULL;
-  p = os_timer_head;
-  while (p != NULL) {
-    if (tcnt < p->tcnt) { break; }
-    tcnt -= p->tcnt;
-    prev = p;
-    p = p->next;
-  }
-  pt->next = p;
-  pt->tcnt = tcnt;
-  if (p != NULL) {
-    p->tcnt -= pt->tcnt;
-  }
-  if (prev != NULL) {
-    prev->next = pt;
-  } else {
-    os_timer_head = pt;
-  }
-}
-
-// Remove Timer from the list
-static int32_t rt_timer_remove (os_timer_cb *pt) {
-  os_timer_cb *p, *prev;
-
-  prev = NULL;
-  p = os_timer_head;
-  while (p != NULL) {
-    if (p == pt) { break; }
-    prev = p;
-    p = p->next;
-  }
-  if (p == NULL) { return -1; }
-  if (prev != NULL) {
-    prev->next = pt->next;
-  } else {
-    os_timer_head = pt->next;
-  }
-  if (pt->next != NULL) {
-    pt->next->tcnt += pt->tcnt;
-  }
-
-  return 0;
-}
-
+// Timer Control Block and the active Timers are in rt_Timer.c
 
 // Timer Service Calls declarations
 SVC_3_1(svcTimerCreate,           osTimerId,  const osTimerDef_t *, os_timer_type, void *, RET_pointer)
@@ -1114,58 +1044,6 @@ os_InRegs osCallback_type svcTimerCall (osTimerId timer_id) {
   return osCallback_ret;
 }
 
-osStatus isrMessagePut (osMessageQId queue_id, uint32_t info, uint32_t millisec);
-
-/// Timer Tick (called each SysTick)
-void sysTimerTick (void) {
-  os_timer_cb *pt, *p;
-  osStatus     status;
-
-  p = os_timer_head;
-  if (p == NULL) { return; }
-
-  p->tcnt--;
-  while ((p != NULL) && (p->tcnt == 0U)) {
-    pt = p;
-    p = p->next;
-    os_timer_head = p;
-    status = isrMessagePut(osMessageQId_osTimerMessageQ, (uint32_t)pt, 0U);
-    if (status != osOK) {
-      os_error(OS_ERR_TIMER_OVF);
-    }
-    if (pt->type == (uint8_t)osTimerPeriodic) {
-      rt_timer_insert(pt, pt->icnt);
-    } else {
-      pt->state = osTimerStopped;
-    }
-  }
-}
-
-/// Get user timers wake-up time 
-uint32_t sysUserTimerWakeupTime (void) {
-
-  if (os_timer_head) {
-    return os_timer_head->tcnt;
-  }
-  return 0xFFFFFFFFU;
-}
-
-/// Update user timers on resume
-void sysUserTimerUpdate (uint32_t sleep_time) {
-
-  while ((os_timer_head != NULL) && (sleep_time != 0U)) {
-    if (sleep_time >= os_timer_head->tcnt) {
-      sleep_time -= os_timer_head->tcnt;
-      os_timer_head->tcnt = 1U;
-      sysTimerTick();
-    } else {
-      os_timer_head->tcnt -= sleep_time;
-      break;
-    }
-  }
-}
-
-
 // Timer Management Public API
 
 /// Create timer
@@ -40,6 +40,126 @@ struct OS_XCB  os_rdy;
 /* List head of chained delay tasks */
 struct OS_XCB  os_dly;
 
+#if (OS_RDY_BITMAP != 0U)
+/* Ready list index: one bit for each priority that has tasks ready and the */
+/* last ready task of each priority. The ready list itself stays one chain  */
+/* ordered by priority, so "os_rdy.p_lnk" is still the highest ready task.  */
+U32    os_rdy_map;
+P_TCB  os_rdy_tail[OS_RDY_BUCKETS];
+#endif
+
+#if (OS_TIMER_WHEEL != 0U)
+/* Delay wheel: delayed tasks chained by the tick they wake on, which is    */
+/* kept in "delta_time" (in place of the time since the previous task).     */
+struct OS_XCB  os_dly_wheel[OS_WHEEL_SLOTS];
+U32            os_dly_count;
+#endif
+
+
+/*----------------------------------------------------------------------------
+ *      Local Functions
+ *---------------------------------------------------------------------------*/
+
+#if (OS_RDY_BITMAP != 0U)
+
+/* Priorities above the last bucket share it; that bucket is kept sorted by */
+/* walking it (only the kernel start up, at priority 255, ever uses it).    */
+#define RDY_TOP           (OS_RDY_BUCKETS - 1U)
+#define RDY_BUCKET(prio)  (((U32)(prio) < RDY_TOP) ? (U32)(prio) : RDY_TOP)
+
+/*--------------------------- rt_rdy_front ----------------------------------*/
+
+static P_TCB rt_rdy_front (U32 bucket) {
+  /* Return the entry a task at the front of "bucket" goes after: the last  */
+  /* task of the next higher priority that has tasks ready, or the head.    */
+  U32 higher;
+
+  higher = os_rdy_map & ~((2U << bucket) - 1U);
+  if (higher == 0U) {
+    return ((P_TCB)&os_rdy);
+  }
+  return (os_rdy_tail[31U - __clz (higher & (0U - higher))]);
+}
+
+
+/*--------------------------- rt_put_rdy ------------------------------------*/
+
+static void rt_put_rdy (P_TCB p_task) {
+  /* Put task "p_task" into the ready list behind the tasks of the same     */
+  /* priority, without walking the list.                                    */
+  P_TCB p_CB, p_CB2;
+  U32 bucket, prio;
+
+  prio   = p_task->prio;
+  bucket = RDY_BUCKET(prio);
+  if ((os_rdy_map & (1U << bucket)) == 0U) {
+    p_CB = rt_rdy_front (bucket);
+    os_rdy_tail[bucket] = p_task;
+    os_rdy_map |= (1U << bucket);
+  }
+  else if (bucket != RDY_TOP) {
+    p_CB = os_rdy_tail[bucket];
+    os_rdy_tail[bucket] = p_task;
+  }
+  else {
+    p_CB  = (P_TCB)&os_rdy;
+    p_CB2 = p_CB->p_lnk;
+    while ((p_CB2 != NULL) && (prio <= p_CB2->prio)) {
+      p_CB  = p_CB2;
+      p_CB2 = p_CB2->p_lnk;
+    }
+    if (p_CB == os_rdy_tail[bucket]) {
+      os_rdy_tail[bucket] = p_task;
+    }
+  }
+  p_task->p_lnk  = p_CB->p_lnk;
+  p_task->p_rlnk = NULL;
+  p_CB->p_lnk    = p_task;
+}
+
+
+/*--------------------------- rt_get_rdy ------------------------------------*/
+
+static P_TCB rt_get_rdy (void) {
+  /* Take the task at the head of the ready list. */
+  P_TCB p_first;
+  U32 bucket;
+
+  p_first = os_rdy.p_lnk;
+  os_rdy.p_lnk = p_first->p_lnk;
+  bucket = RDY_BUCKET(p_first->prio);
+  if (os_rdy_tail[bucket] == p_first) {
+    os_rdy_map &= ~(1U << bucket);
+  }
+  return (p_first);
+}
+
+
+/*--------------------------- rt_rmv_rdy ------------------------------------*/
+
+static void rt_rmv_rdy (P_TCB p_task, P_TCB p_b) {
+  /* Fix up the index for "p_task" taken out after "p_b". The priority of   */
+  /* "p_task" may already have been changed, so find it by its tail entry.  */
+  U32 map, bucket;
+
+  map = os_rdy_map;
+  while (map != 0U) {
+    bucket = 31U - __clz (map);
+    if (os_rdy_tail[bucket] == p_task) {
+      if ((p_b != (P_TCB)&os_rdy) && (RDY_BUCKET(p_b->prio) == bucket)) {
+        os_rdy_tail[bucket] = p_b;
+      }
+      else {
+        os_rdy_map &= ~(1U << bucket);
+      }
+      return;
+    }
+    map &= ~(1U << bucket);
+  }
+}
+
+#endif
+
 
 /*----------------------------------------------------------------------------
  *      Functions
@@ -56,6 +176,12 @@ void rt_put_prio (P_XCB p_CB, P_TCB p_task) {
   U32 prio;
   BOOL sem_mbx = __FALSE;
 
+#if (OS_RDY_BITMAP != 0U)
+  if (p_CB == &os_rdy) {
+    rt_put_rdy (p_task);
+    return;
+  }
+#endif
   if ((p_CB->cb_type == SCB) || (p_CB->cb_type == MCB) || (p_CB->cb_type == MUCB)) {
     sem_mbx = __TRUE;
   }
@@ -88,6 +214,13 @@ P_TCB rt_get_first (P_XCB p_CB) {
   /* "p_CB" points to head of list. */
   P_TCB p_first;
 
+#if (OS_RDY_BITMAP != 0U)
+  if (p_CB == &os_rdy) {
+    p_first = rt_get_rdy ();
+    p_first->p_lnk = NULL;
+    return (p_first);
+  }
+#endif
   p_first = p_CB->p_lnk;
   p_CB->p_lnk = p_first->p_lnk;
   if ((p_CB->cb_type == SCB) || (p_CB->cb_type == MCB) || (p_CB->cb_type == MUCB)) {
@@ -112,6 +245,12 @@ void rt_put_rdy_first (P_TCB p_task) {
   p_task->p_lnk = os_rdy.p_lnk;
   p_task->p_rlnk = NULL;
   os_rdy.p_lnk = p_task;
+#if (OS_RDY_BITMAP != 0U)
+  if ((os_rdy_map & (1U << RDY_BUCKET(p_task->prio))) == 0U) {
+    os_rdy_tail[RDY_BUCKET(p_task->prio)] = p_task;
+    os_rdy_map |= (1U << RDY_BUCKET(p_task->prio));
+  }
+#endif
 }
 
 
@@ -124,8 +263,12 @@ P_TCB rt_get_same_rdy_prio (void) {
 
   p_first = os_rdy.p_lnk;
   if (p_first->prio == os_tsk.run->prio) {
+#if (OS_RDY_BITMAP != 0U)
+    return (rt_get_rdy ());
+#else
     os_rdy.p_lnk = os_rdy.p_lnk->p_lnk;
     return (p_first);
+#endif
   }
   return (NULL);
 }
@@ -162,6 +305,19 @@ void rt_put_dly (P_TCB p_task, U16 delay) {
   /* Put a task identified with "p_task" into chained delay wait list using */
   /* a delay value of "delay".                                              */
   P_TCB p;
+#if (OS_TIMER_WHEEL != 0U)
+  U32 time = os_time + delay;
+
+  p = (P_TCB)&os_dly_wheel[time & (OS_WHEEL_SLOTS - 1U)];
+  p_task->p_dlnk = p->p_dlnk;
+  p_task->p_blnk = p;
+  if (p->p_dlnk != NULL) {
+    p->p_dlnk->p_blnk = p_task;
+  }
+  p->p_dlnk = p_task;
+  p_task->delta_time = (U16)time;
+  os_dly_count++;
+#else
   U32 delta,idelay = delay;
 
   p = (P_TCB)&os_dly;
@@ -193,6 +349,7 @@ last: p_task->p_dlnk = NULL;
   }
   p_task->delta_time = (U16)(delta - idelay);
   p->delta_time -= p_task->delta_time;
+#endif
 }
 
 
@@ -201,6 +358,40 @@ last: p_task->p_dlnk = NULL;
 void rt_dec_dly (void) {
   /* Decrement delta time of list head: remove tasks having a value of zero.*/
   P_TCB p_rdy;
+#if (OS_TIMER_WHEEL != 0U)
+  /* Wheel: wake the tasks in this tick's slot that are due now; the rest   */
+  /* wake on a later turn of the wheel.                                     */
+  P_TCB p_next;
+
+  if (os_dly_count == 0U) {
+    return;
+  }
+  p_next = os_dly_wheel[os_time & (OS_WHEEL_SLOTS - 1U)].p_dlnk;
+  while (p_next != NULL) {
+    p_rdy  = p_next;
+    p_next = p_rdy->p_dlnk;
+    if (p_rdy->delta_time != (U16)os_time) {
+      continue;
+    }
+    rt_rmv_dly (p_rdy);
+    if (p_rdy->p_rlnk != NULL) {
+      /* Task is really enqueued, remove task from semaphore/mailbox */
+      /* timeout waiting list. */
+      p_rdy->p_rlnk->p_lnk = p_rdy->p_lnk;
+      if (p_rdy->p_lnk != NULL) {
+        p_rdy->p_lnk->p_rlnk = p_rdy->p_rlnk;
+        p_rdy->p_lnk = NULL;
+      }
+      p_rdy->p_rlnk = NULL;
+    }
+    rt_put_prio (&os_rdy, p_rdy);
+    if (p_rdy->state == WAIT_ITV) {
+      /* Calculate the next time for interval wait. */
+      p_rdy->delta_time = p_rdy->interval_time + (U16)os_time;
+    }
+    p_rdy->state = READY;
+  }
+#else
 
   if (os_dly.p_dlnk == NULL) {
     return;
@@ -232,6 +423,7 @@ void rt_dec_dly (void) {
     }
     p_rdy->p_blnk = NULL;
   }
+#endif
 }
 
 
@@ -256,6 +448,9 @@ void rt_rmv_list (P_TCB p_task) {
     /* Search the ready list for task "p_task" */
     if (p_b->p_lnk == p_task) {
       p_b->p_lnk = p_task->p_lnk;
+#if (OS_RDY_BITMAP != 0U)
+      rt_rmv_rdy (p_task, p_b);
+#endif
       return;
     }
     p_b = p_b->p_lnk;
@@ -270,6 +465,18 @@ void rt_rmv_dly (P_TCB p_task) {
   P_TCB p_b;
 
   p_b = p_task->p_blnk;
+#if (OS_TIMER_WHEEL != 0U)
+  if (p_b != NULL) {
+    /* Task is really enqueued: wake-up times are absolute, just unlink it */
+    p_b->p_dlnk = p_task->p_dlnk;
+    if (p_task->p_dlnk != NULL) {
+      p_task->p_dlnk->p_blnk = p_b;
+      p_task->p_dlnk = NULL;
+    }
+    p_task->p_blnk = NULL;
+    os_dly_count--;
+  }
+#else
   if (p_b != NULL) {
     /* Task is really enqueued */
     p_b->p_dlnk = p_task->p_dlnk;
@@ -285,7 +492,32 @@ void rt_rmv_dly (P_TCB p_task) {
     }
     p_task->p_blnk = NULL;
   }
+#endif
+}
+
+
+#if (OS_TIMER_WHEEL != 0U)
+/*--------------------------- rt_dly_wakeup ---------------------------------*/
+
+U32 rt_dly_wakeup (void) {
+  /* Return the ticks until the next delayed task wakes (at most 0xFFFF).   */
+  P_TCB p;
+  U32 i, delta, wakeup = 0xFFFFU;
+
+  if (os_dly_count == 0U) {
+    return (wakeup);
+  }
+  for (i = 0U; i < OS_WHEEL_SLOTS; i++) {
+    for (p = os_dly_wheel[i].p_dlnk; p != NULL; p = p->p_dlnk) {
+      delta = (U16)(p->delta_time - (U16)os_time);
+      if ((delta != 0U) && (delta < wakeup)) {
+        wakeup = delta;
+      }
+    }
+  }
+  return (wakeup);
 }
+#endif
 
 
 /*--------------------------- rt_psq_enq ------------------------------------*/
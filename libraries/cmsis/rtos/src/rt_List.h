@@ -35,6 +35,14 @@
 /* Variables */
 extern struct OS_XCB os_rdy;
 extern struct OS_XCB os_dly;
+#if (OS_RDY_BITMAP != 0U)
+extern U32    os_rdy_map;
+extern P_TCB  os_rdy_tail[OS_RDY_BUCKETS];
+#endif
+#if (OS_TIMER_WHEEL != 0U)
+extern struct OS_XCB os_dly_wheel[OS_WHEEL_SLOTS];
+extern U32    os_dly_count;
+#endif
 
 /* Functions */
 extern void  rt_put_prio      (P_XCB p_CB, P_TCB p_task);
@@ -46,6 +54,9 @@ extern void  rt_put_dly       (P_TCB p_task, U16 delay);
 extern void  rt_dec_dly       (void);
 extern void  rt_rmv_list      (P_TCB p_task);
 extern void  rt_rmv_dly       (P_TCB p_task);
+#if (OS_TIMER_WHEEL != 0U)
+extern U32   rt_dly_wakeup    (void);
+#endif
 extern void  rt_psq_enq       (OS_ID entry, U32 arg);
 
 /* This is a fast macro generating in-line code */
@@ -80,9 +80,13 @@ U32 rt_suspend (void) {
 
   rt_tsk_lock();
   
+#if (OS_TIMER_WHEEL != 0U)
+  delta = rt_dly_wakeup();
+#else
   if (os_dly.p_dlnk) {
     delta = os_dly.delta_time;
   }
+#endif
 #ifdef __CMSIS_RTOS
   sleep = sysUserTimerWakeupTime();
   if (sleep < delta) { delta = sleep; }
@@ -111,6 +115,17 @@ void rt_resume (U32 sleep_time) {
   os_robin.task = NULL;
 
   /* Update delays. */
+#if (OS_TIMER_WHEEL != 0U)
+  /* Step the wheel through the ticks slept for (it only has the slot for  */
+  /* each tick, so it can't jump ahead like the sorted list).              */
+  delta = sleep_time;
+  while ((os_dly_count != 0U) && (delta != 0U)) {
+    os_time++;
+    rt_dec_dly();
+    delta--;
+  }
+  os_time += delta;
+#else
   if (os_dly.p_dlnk) {
     delta = sleep_time;
     if (delta >= os_dly.delta_time) {
@@ -130,6 +145,7 @@ void rt_resume (U32 sleep_time) {
   } else {
     os_time += sleep_time;
   }
+#endif
 
   /* Check the user timers. */
 #ifdef __CMSIS_RTOS
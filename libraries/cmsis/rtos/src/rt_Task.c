@@ -378,11 +378,21 @@ void rt_sys_init (FUNCP first_task, U32 prio_stksz, void *stk) {
   /* Set up ready list: initially empty */
   os_rdy.cb_type = HCB;
   os_rdy.p_lnk   = NULL;
+#if (OS_RDY_BITMAP != 0U)
+  os_rdy_map     = 0U;
+#endif
   /* Set up delay list: initially empty */
   os_dly.cb_type = HCB;
   os_dly.p_dlnk  = NULL;
   os_dly.p_blnk  = NULL;
   os_dly.delta_time = 0U;
+#if (OS_TIMER_WHEEL != 0U)
+  for (i = 0U; i < OS_WHEEL_SLOTS; i++) {
+    os_dly_wheel[i].cb_type = HCB;
+    os_dly_wheel[i].p_dlnk  = NULL;
+  }
+  os_dly_count = 0U;
+#endif
 
   /* Fix SP and system variables to assume idle task is running */
   /* Transform main program into idle task by assuming idle TCB */
@@ -25,9 +25,14 @@
 
 #include "rt_TypeDef.h"
 #include "RTX_Config.h"
+#include "rt_Time.h"
 #include "rt_Timer.h"
 #include "rt_MemBox.h"
 
+#ifdef __CMSIS_RTOS
+#include "cmsis_os.h"
+#endif
+
 #ifndef __CMSIS_RTOS
 
 
@@ -118,6 +123,237 @@ OS_ID rt_tmr_kill (OS_ID timer)  {
 }
 
 
+#else
+
+// ==== CMSIS-RTOS Timers (osTimer) ====
+
+// Timer variables
+#if (OS_TIMER_WHEEL != 0U)
+os_timer_cb *os_timer_wheel[OS_WHEEL_SLOTS];    // Active Timers by expiry tick
+uint32_t     os_timer_count;                    // Number of active Timers
+uint32_t     os_timer_time;                     // Last tick the Timers were checked
+#else
+os_timer_cb *os_timer_head;                     // Pointer to first active Timer
+#endif
+
+extern osMessageQId osMessageQId_osTimerMessageQ;
+
+osStatus isrMessagePut (osMessageQId queue_id, uint32_t info, uint32_t millisec);
+
+
+#if (OS_TIMER_WHEEL != 0U)
+
+// Timer Helper Functions
+
+// Insert Timer into the wheel slot for the tick it expires on
+void rt_timer_insert (os_timer_cb *pt, uint32_t tcnt) {
+  uint32_t slot;
+
+  pt->tcnt = os_timer_time + tcnt;
+  slot = pt->tcnt & (OS_WHEEL_SLOTS - 1U);
+  pt->next = os_timer_wheel[slot];
+  os_timer_wheel[slot] = pt;
+  os_timer_count++;
+}
+
+// Remove Timer from its wheel slot
+int32_t rt_timer_remove (os_timer_cb *pt) {
+  os_timer_cb *p, *prev;
+  uint32_t slot;
+
+  slot = pt->tcnt & (OS_WHEEL_SLOTS - 1U);
+  prev = NULL;
+  p = os_timer_wheel[slot];
+  while (p != NULL) {
+    if (p == pt) { break; }
+    prev = p;
+    p = p->next;
+  }
+  if (p == NULL) { return -1; }
+  if (prev != NULL) {
+    prev->next = pt->next;
+  } else {
+    os_timer_wheel[slot] = pt->next;
+  }
+  os_timer_count--;
+
+  return 0;
+}
+
+/// Timer Tick (called each SysTick, and on resume to catch up)
+void sysTimerTick (void) {
+  os_timer_cb *pt, *p, *prev, *expired;
+  uint32_t     slot;
+  osStatus     status;
+
+  while ((os_timer_count != 0U) && (os_timer_time != os_time)) {
+    os_timer_time++;
+    slot = os_timer_time & (OS_WHEEL_SLOTS - 1U);
+
+    // Take the Timers due now out of the slot (the rest are a turn or more away)
+    expired = NULL;
+    prev = NULL;
+    p = os_timer_wheel[slot];
+    while (p != NULL) {
+      pt = p;
+      p = p->next;
+      if (pt->tcnt != os_timer_time) {
+        prev = pt;
+        continue;
+      }
+      if (prev != NULL) {
+        prev->next = p;
+      } else {
+        os_timer_wheel[slot] = p;
+      }
+      os_timer_count--;
+      pt->next = expired;
+      expired = pt;
+    }
+
+    while (expired != NULL) {
+      pt = expired;
+      expired = pt->next;
+      status = isrMessagePut(osMessageQId_osTimerMessageQ, (uint32_t)pt, 0U);
+      if (status != osOK) {
+        os_error(OS_ERR_TIMER_OVF);
+      }
+      if (pt->type == (uint8_t)osTimerPeriodic) {
+        rt_timer_insert(pt, pt->icnt);
+      } else {
+        pt->state = osTimerStopped;
+      }
+    }
+  }
+  os_timer_time = os_time;
+}
+
+/// Get user timers wake-up time 
+uint32_t sysUserTimerWakeupTime (void) {
+  os_timer_cb *p;
+  uint32_t     i, wakeup;
+
+  wakeup = 0xFFFFFFFFU;
+  for (i = 0U; (i < OS_WHEEL_SLOTS) && (os_timer_count != 0U); i++) {
+    for (p = os_timer_wheel[i]; p != NULL; p = p->next) {
+      if ((p->tcnt - os_timer_time) < wakeup) {
+        wakeup = p->tcnt - os_timer_time;
+      }
+    }
+  }
+  return wakeup;
+}
+
+/// Update user timers on resume (os_time already has the time slept added)
+void sysUserTimerUpdate (uint32_t sleep_time) {
+
+  (void)sleep_time;
+  sysTimerTick();
+}
+
+#else
+
+// Timer Helper Functions
+
+// Insert Timer into the list sorted by time
+void rt_timer_insert (os_timer_cb *pt, uint32_t tcnt) {
+  os_timer_cb *p, *prev;
+
+  prev = NULL;
+  p = os_timer_head;
+  while (p != NULL) {
+    if (tcnt < p->tcnt) { break; }
+    tcnt -= p->tcnt;
+    prev = p;
+    p = p->next;
+  }
+  pt->next = p;
+  pt->tcnt = tcnt;
+  if (p != NULL) {
+    p->tcnt -= pt->tcnt;
+  }
+  if (prev != NULL) {
+    prev->next = pt;
+  } else {
+    os_timer_head = pt;
+  }
+}
+
+// Remove Timer from the list
+int32_t rt_timer_remove (os_timer_cb *pt) {
+  os_timer_cb *p, *prev;
+
+  prev = NULL;
+  p = os_timer_head;
+  while (p != NULL) {
+    if (p == pt) { break; }
+    prev = p;
+    p = p->next;
+  }
+  if (p == NULL) { return -1; }
+  if (prev != NULL) {
+    prev->next = pt->next;
+  } else {
+    os_timer_head = pt->next;
+  }
+  if (pt->next != NULL) {
+    pt->next->tcnt += pt->tcnt;
+  }
+
+  return 0;
+}
+
+/// Timer Tick (called each SysTick)
+void sysTimerTick (void) {
+  os_timer_cb *pt, *p;
+  osStatus     status;
+
+  p = os_timer_head;
+  if (p == NULL) { return; }
+
+  p->tcnt--;
+  while ((p != NULL) && (p->tcnt == 0U)) {
+    pt = p;
+    p = p->next;
+    os_timer_head = p;
+    status = isrMessagePut(osMessageQId_osTimerMessageQ, (uint32_t)pt, 0U);
+    if (status != osOK) {
+      os_error(OS_ERR_TIMER_OVF);
+    }
+    if (pt->type == (uint8_t)osTimerPeriodic) {
+      rt_timer_insert(pt, pt->icnt);
+    } else {
+      pt->state = osTimerStopped;
+    }
+  }
+}
+
+/// Get user timers wake-up time 
+uint32_t sysUserTimerWakeupTime (void) {
+
+  if (os_timer_head) {
+    return os_timer_head->tcnt;
+  }
+  return 0xFFFFFFFFU;
+}
+
+/// Update user timers on resume
+void sysUserTimerUpdate (uint32_t sleep_time) {
+
+  while ((os_timer_head != NULL) && (sleep_time != 0U)) {
+    if (sleep_time >= os_timer_head->tcnt) {
+      sleep_time -= os_timer_head->tcnt;
+      os_timer_head->tcnt = 1U;
+      sysTimerTick();
+    } else {
+      os_timer_head->tcnt -= sleep_time;
+      break;
+    }
+  }
+}
+
+#endif
+
 #endif
 
 /*----------------------------------------------------------------------------
@@ -23,6 +23,44 @@
  * limitations under the License.
  *---------------------------------------------------------------------------*/
 
+#ifdef __CMSIS_RTOS
+
+// Timer definitions
+#define osTimerInvalid  0U
+#define osTimerStopped  1U
+#define osTimerRunning  2U
+
+// Timer structures 
+
+typedef struct os_timer_cb_ {                   // Timer Control Block
+  struct os_timer_cb_ *next;                    // Pointer to next active Timer
+  uint8_t             state;                    // Timer State
+  uint8_t              type;                    // Timer Type (Periodic/One-shot)
+  uint16_t         reserved;                    // Reserved
+  uint32_t             tcnt;                    // Timer Delay Count (or expiry tick)
+  uint32_t             icnt;                    // Timer Initial Count 
+  void                 *arg;                    // Timer Function Argument
+  const struct os_timer_def *timer;             // Pointer to Timer definition
+} os_timer_cb;
+
+// Timer variables
+#if (OS_TIMER_WHEEL != 0U)
+extern os_timer_cb *os_timer_wheel[OS_WHEEL_SLOTS];
+extern uint32_t     os_timer_count;
+extern uint32_t     os_timer_time;
+#else
+extern os_timer_cb *os_timer_head;
+#endif
+
+// Timer functions
+extern void     rt_timer_insert        (os_timer_cb *pt, uint32_t tcnt);
+extern int32_t  rt_timer_remove        (os_timer_cb *pt);
+extern void     sysTimerTick           (void);
+extern uint32_t sysUserTimerWakeupTime (void);
+extern void     sysUserTimerUpdate     (uint32_t sleep_time);
+
+#else
+
 /* Variables */
 extern struct OS_XTMR os_tmr;
 
@@ -31,6 +69,8 @@ extern void  rt_tmr_tick   (void);
 extern OS_ID rt_tmr_create (U16 tcnt, U16 info);
 extern OS_ID rt_tmr_kill   (OS_ID timer);
 
+#endif
+
 /*----------------------------------------------------------------------------
  * end of file
  *---------------------------------------------------------------------------*/